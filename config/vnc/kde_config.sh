@@ -1,40 +1,47 @@
 #!/bin/bash
 # KDE window manager configuration for MyVNC
+# Sourced by xstartup.sh, which applies desktop_settings in the background
+# (only when this file changed) and then starts DESKTOP_SESSION_CMD
 
 # Set KDE-specific environment variables
 export KDE_FULL_SESSION=true
 export DESKTOP_SESSION=plasma
 export XDG_CURRENT_DESKTOP=KDE
 
-# Disable screen locking and power management
-mkdir -p $HOME/.config/kscreenlockerrc
-cat > $HOME/.config/kscreenlockerrc << EOF
+desktop_settings() {
+    mkdir -p $HOME/.config
+
+    # Disable screen locking and power management
+    cat > $HOME/.config/kscreenlockerrc << EOF_KSCREENLOCKER
 [Daemon]
 Autolock=false
 LockOnResume=false
-EOF
+EOF_KSCREENLOCKER
 
-# Disable compositor effects for better VNC performance
-mkdir -p $HOME/.config/kwinrc
-cat > $HOME/.config/kwinrc << EOF
+    # Disable compositor effects for better VNC performance
+    cat > $HOME/.config/kwinrc << EOF_KWIN
 [Compositing]
 Enabled=false
 OpenGLIsUnsafe=true
-EOF
+EOF_KWIN
 
-# Disable animations
-mkdir -p $HOME/.config/kdeglobals
-cat >> $HOME/.config/kdeglobals << EOF
+    # Disable animations (kdeglobals holds the user's other settings too)
+    if command -v kwriteconfig5 >/dev/null 2>&1; then
+        kwriteconfig5 --file kdeglobals --group KDE --key AnimationDurationFactor 0
+    elif ! grep -qs '^AnimationDurationFactor=0' $HOME/.config/kdeglobals; then
+        cat >> $HOME/.config/kdeglobals << EOF_KDEGLOBALS
 [KDE]
 AnimationDurationFactor=0
-EOF
+EOF_KDEGLOBALS
+    fi
+}
 
 # Start KDE Plasma
 if command -v startkde >/dev/null 2>&1; then
-    exec startkde
+    DESKTOP_SESSION_CMD="startkde"
 elif command -v startplasma-x11 >/dev/null 2>&1; then
-    exec startplasma-x11
+    DESKTOP_SESSION_CMD="startplasma-x11"
 else
     echo "KDE Plasma startup command not found."
     exit 1
-fi 
\ No newline at end of file
+fi
@@ -1,13 +1,16 @@
 #!/bin/bash
 # XFCE window manager configuration for MyVNC
+# Sourced by xstartup.sh, which applies desktop_settings in the background
+# (only when this file changed) and then starts DESKTOP_SESSION_CMD
 
 # Set XFCE-specific environment variables
 export XDG_CURRENT_DESKTOP=XFCE
 export DESKTOP_SESSION=xfce
 
-# Disable screensaver and all lock screen features
-mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
-cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-screensaver.xml << 'EOF'
+desktop_settings() {
+    # Disable screensaver and all lock screen features
+    mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
+    cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-screensaver.xml << 'EOF'
 <?xml version="1.0" encoding="UTF-8"?>
 
 <channel name="xfce4-screensaver" version="1.0">
@@ -31,8 +34,8 @@ cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-screensaver.xml << 'E
 </channel>
 EOF
 
-# Disable power management
-cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-power-manager.xml << EOF
+    # Disable power management
+    cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-power-manager.xml << EOF
 <?xml version="1.0" encoding="UTF-8"?>
 <channel name="xfce4-power-manager" version="1.0">
   <property name="xfce4-power-manager" type="empty">
@@ -48,9 +51,9 @@ cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-power-manager.xml <<
 </channel>
 EOF
 
-# Disable XFCE session saving
-mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
-cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-session.xml << EOF
+    # Disable XFCE session saving
+    mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
+    cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-session.xml << EOF
 <?xml version="1.0" encoding="UTF-8"?>
 <channel name="xfce4-session" version="1.0">
   <property name="general" type="empty">
@@ -62,9 +65,9 @@ cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfce4-session.xml << EOF
 </channel>
 EOF
 
-# Configure window manager for performance
-mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
-cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfwm4.xml << EOF
+    # Configure window manager for performance
+    mkdir -p $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/
+    cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfwm4.xml << EOF
 <?xml version="1.0" encoding="UTF-8"?>
 <channel name="xfwm4" version="1.0">
   <property name="general" type="empty">
@@ -76,33 +79,33 @@ cat > $HOME/.config/xfce4/xfconf/xfce-perchannel-xml/xfwm4.xml << EOF
 </channel>
 EOF
 
+    ## Time to disable a ton of start that xfce autostarts and its total crap for us...
+    # Define the target directory
+    AUTOSTART_DIR="$HOME/.config/autostart"
+    mkdir -p "$AUTOSTART_DIR"
 
-## Time to disable a ton of start that xfce autostarts and its total crap for us...
-# Define the target directory
-AUTOSTART_DIR="$HOME/.config/autostart"
-mkdir -p "$AUTOSTART_DIR"
+    DISABLE_LIST=(
+        "geoclue-demo-agent.desktop"
+        "tracker-extract.desktop"
+        "tracker-miner-apps.desktop"
+        "tracker-miner-fs.desktop"
+        "tracker-store.desktop"
+        "xdg-user-dirs.desktop"
+        "xfce4-power-manager.desktop"
+        "xfce4-screensaver.desktop"
+        "xfce-polkit.desktop"
+    )
 
-DISABLE_LIST=(
-    "geoclue-demo-agent.desktop"
-    "tracker-extract.desktop"
-    "tracker-miner-apps.desktop"
-    "tracker-miner-fs.desktop"
-    "tracker-store.desktop"
-    "xdg-user-dirs.desktop"
-    "xfce4-power-manager.desktop"
-    "xfce4-screensaver.desktop"
-    "xfce-polkit.desktop"
-)
-
-for file in "${DISABLE_LIST[@]}"; do
-    cat > "$AUTOSTART_DIR/$file" << EOF
+    for file in "${DISABLE_LIST[@]}"; do
+        cat > "$AUTOSTART_DIR/$file" << EOF
 [Desktop Entry]
 Hidden=true
 EOF
-    echo "Disabled: $file"
-done
+        echo "Disabled: $file"
+    done
 
-echo "All specified autostart entries have been disabled."
+    echo "All specified autostart entries have been disabled."
+}
 
 # Disable screensaver and lock screen via xfconf-query after the session starts
 # (needs a running xfconf daemon, so we background it with a delay)
@@ -112,4 +115,4 @@ echo "All specified autostart entries have been disabled."
  echo "Screensaver and lock screen disabled via xfconf-query") &
 
 # Start XFCE session
-exec startxfce4 
+DESKTOP_SESSION_CMD="startxfce4"
@@ -1,6 +1,26 @@
 #!/bin/bash
 # MyVNC custom xstartup script for VNC server
 # This script is automatically used when starting a VNC session
+#
+# Each startup phase is timed into $HOME/.vnc/startup_timings.<host>:<N> as
+# VNC_STARTUP_<phase>=<ms> lines; vncserver_wrapper adds them to the display
+# report once VNC_STARTUP_DONE is written, right before the desktop starts.
+# Reading the watchdog's configuration, applying the X settings and seeding
+# the desktop's settings do not depend on each other and run at the same
+# time; the watchdog itself is launched from this shell. The desktop
+# settings are only applied again when the ${WM}_config.sh that defines them
+# changed (or MYVNC_RESEED_SETTINGS=1 is set).
+
+# Milliseconds since the epoch; bash 5 has it without running date
+myvnc_now_ms() {
+    if [ -n "${EPOCHREALTIME:-}" ]; then
+        local now="${EPOCHREALTIME/[.,]/}"
+        echo $(( now / 1000 ))
+    else
+        date +%s%3N
+    fi
+}
+MYVNC_STARTED_MS=$(myvnc_now_ms)
 
 # Load system-wide environment
 if [ -f /etc/profile ]; then
@@ -26,6 +46,49 @@ unset DBUS_SESSION_BUS_ADDRESS
 exec >> "$HOME/.vnc/xstartup.${HOSTNAME}${DISPLAY}.log" 2>&1
 echo "Starting VNC session at $(date)"
 
+MYVNC_TIMINGS="$HOME/.vnc/startup_timings.${HOSTNAME}${DISPLAY}"
+echo "VNC_STARTUP_JOB=${MYVNC_JOBID:-${SLURM_JOB_ID:-}}" > "$MYVNC_TIMINGS"
+echo "VNC_STARTUP_profile=$(( $(myvnc_now_ms) - MYVNC_STARTED_MS ))" >> "$MYVNC_TIMINGS"
+
+# myvnc_phase NAME COMMAND...: run COMMAND and record how long it took.
+# Lines are appended in one write each, so phases running at once can share the file.
+myvnc_phase() {
+    local name="$1" start rc elapsed
+    shift
+    start=$(myvnc_now_ms)
+    "$@"
+    rc=$?
+    elapsed=$(( $(myvnc_now_ms) - start ))
+    echo "VNC_STARTUP_${name}=${elapsed}" >> "$MYVNC_TIMINGS"
+    echo "Startup phase ${name} took ${elapsed} ms"
+    return $rc
+}
+
+# Wait for the phases running in the background and mark the timings complete
+myvnc_startup_done() {
+    local total
+    wait $MYVNC_PHASE_PIDS
+    total=$(( $(myvnc_now_ms) - MYVNC_STARTED_MS ))
+    printf 'VNC_STARTUP_DESKTOP=%s\nVNC_STARTUP_total=%s\nVNC_STARTUP_DONE=1\n' "$WM" "$total" >> "$MYVNC_TIMINGS"
+    echo "Desktop ready to start after ${total} ms"
+}
+
+# myvnc_seed_settings FUNCTION: run FUNCTION (a desktop's settings writes)
+# unless it already ran for this user with the same definition
+myvnc_seed_settings() {
+    local stamp_dir="${XDG_CACHE_HOME:-$HOME/.cache}/myvnc"
+    local stamp="${stamp_dir}/${WM}_settings"
+    local digest
+    digest=$(declare -f "$1" | md5sum | cut -d' ' -f1)
+    if [ "${MYVNC_RESEED_SETTINGS:-0}" != "1" ] && [ "$(cat "$stamp" 2>/dev/null)" = "$digest" ]; then
+        echo "Desktop settings for $WM are up to date, not applying them again"
+        return 0
+    fi
+    if "$1"; then
+        mkdir -p "$stamp_dir" && echo "$digest" > "$stamp"
+    fi
+}
+
 # Per-cgroup early-OOM watcher: kills the largest non-protected child before
 # LSF's OOM killer takes down the whole job (and Xvnc with it).
 # Controlled by the "cgroup_earlyoom" block in server_config.json:
@@ -33,67 +96,84 @@ echo "Starting VNC session at $(date)"
 #   "pretend": true/false   -- dry-run mode, log but don't kill (default: false)
 SCRIPT_ROOT="$(dirname "$(readlink -f "$0")")"
 EARLYOOM_SH="${SCRIPT_ROOT}/../../utils/cgroup_earlyoom.sh"
+# Prefer the compiled watchdog (make -C src); it takes the same flags
+if [ -x "${SCRIPT_ROOT}/../../src/cgroup_watchdog" ]; then
+    EARLYOOM_SH="${SCRIPT_ROOT}/../../src/cgroup_watchdog"
+fi
 SERVER_CFG="${SCRIPT_ROOT}/../../config/server_config.json"
 
-# Read earlyoom settings from server_config.json (default: disabled).
-EARLYOOM_ENABLED=false
-EARLYOOM_PRETEND_CFG=false
-if [ -r "$SERVER_CFG" ]; then
-    if command -v python3 >/dev/null 2>&1; then
-        EARLYOOM_ENABLED=$(python3 -c "
-import json, sys
-try:
-    cfg = json.load(open('$SERVER_CFG'))
-    print(str(cfg.get('cgroup_earlyoom', {}).get('enabled', False)).lower())
-except Exception:
-    print('false')
-" 2>/dev/null)
-        EARLYOOM_PRETEND_CFG=$(python3 -c "
-import json, sys
+# Read earlyoom settings from server_config.json (default: disabled). The
+# read runs in the background; launch_earlyoom waits for it.
+MYVNC_EARLYOOM_CFG="$HOME/.vnc/earlyoom_config.${HOSTNAME}${DISPLAY}"
+read_earlyoom_config() {
+    local settings="false false"
+    if [ -r "$SERVER_CFG" ]; then
+        if command -v python3 >/dev/null 2>&1; then
+            settings=$(python3 -c "
+import json
 try:
-    cfg = json.load(open('$SERVER_CFG'))
-    print(str(cfg.get('cgroup_earlyoom', {}).get('pretend', False)).lower())
+    cfg = json.load(open('$SERVER_CFG')).get('cgroup_earlyoom', {})
+    print(str(cfg.get('enabled', False)).lower(), str(cfg.get('pretend', False)).lower())
 except Exception:
-    print('false')
+    print('false false')
 " 2>/dev/null)
-    else
-        echo "WARNING: python3 not found; cannot read cgroup_earlyoom config"
+        else
+            echo "WARNING: python3 not found; cannot read cgroup_earlyoom config"
+        fi
     fi
-fi
+    echo "$settings" > "$MYVNC_EARLYOOM_CFG"
+}
+myvnc_phase watchdog_config read_earlyoom_config &
+MYVNC_EARLYOOM_CFG_PID=$!
+
+# Started from this shell, not a background phase: the watchdog protects the
+# processes on its parent chain, and this shell becomes the desktop session
+launch_earlyoom() {
+    local enabled=false pretend=false
+    wait "$MYVNC_EARLYOOM_CFG_PID"
+    read -r enabled pretend < "$MYVNC_EARLYOOM_CFG"
+    rm -f "$MYVNC_EARLYOOM_CFG"
 
-if [ "$EARLYOOM_ENABLED" = "true" ]; then
-    if [ -x "$EARLYOOM_SH" ]; then
-        EARLYOOM_ARGS=""
-        if [ "$EARLYOOM_PRETEND_CFG" = "true" ]; then
-            EARLYOOM_ARGS="--pretend"
-            echo "Launching cgroup_earlyoom watcher in PRETEND mode: $EARLYOOM_SH"
+    if [ "$enabled" = "true" ]; then
+        if [ -x "$EARLYOOM_SH" ]; then
+            local args=""
+            if [ "$pretend" = "true" ]; then
+                args="--pretend"
+                echo "Launching cgroup_earlyoom watcher in PRETEND mode: $EARLYOOM_SH"
+            else
+                echo "Launching cgroup_earlyoom watcher: $EARLYOOM_SH"
+            fi
+            nohup "$EARLYOOM_SH" $args \
+                > "$HOME/.vnc/cgroup_earlyoom.${HOSTNAME}${DISPLAY}.log" 2>&1 &
+            disown
         else
-            echo "Launching cgroup_earlyoom watcher: $EARLYOOM_SH"
+            echo "WARNING: cgroup_earlyoom watcher not found or not executable at $EARLYOOM_SH"
         fi
-        nohup "$EARLYOOM_SH" $EARLYOOM_ARGS \
-            > "$HOME/.vnc/cgroup_earlyoom.${HOSTNAME}${DISPLAY}.log" 2>&1 &
-        disown
     else
-        echo "WARNING: cgroup_earlyoom.sh not found or not executable at $EARLYOOM_SH"
+        echo "cgroup_earlyoom watcher is disabled in server_config.json (cgroup_earlyoom.enabled=false)"
     fi
-else
-    echo "cgroup_earlyoom watcher is disabled in server_config.json (cgroup_earlyoom.enabled=false)"
-fi
+}
+
+x_settings() {
+    ## disable screensaver and any lockscreen
+    xset -dpms
+    xset s off
+    xset s 0 0
+    xset s noblank
+    ## print out verification that these settings are in place
+    echo "These are the screen saver settings which should be all off: "
+    xset q
 
-## disable screensaver and any lockscreen
-xset -dpms
-xset s off
-xset s 0 0
-xset s noblank
-## print out verification that these settings are in place
-echo "These are the screen saver settings which should be all off: "
-xset q
-
-# Set basic X settings
-touch $HOME/.Xresources
-xrdb $HOME/.Xresources
-xsetroot -solid grey
-vncconfig -iconic &
+    # Set basic X settings
+    touch $HOME/.Xresources
+    xrdb $HOME/.Xresources
+    xsetroot -solid grey
+    vncconfig -iconic &
+}
+myvnc_phase x_settings x_settings &
+MYVNC_PHASE_PIDS="$!"
+
+myvnc_phase watchdog launch_earlyoom
 
 # Preserve SSH agent forwarding inside the VNC desktop.
 if [ -n "$SSH_AUTH_SOCK" ] && [ -S "$SSH_AUTH_SOCK" ]; then
@@ -116,13 +196,28 @@ echo "Using window manager: $WM"
 SCRIPT_DIR="$(dirname "$(readlink -f "$0")")"
 echo "Script directory: $SCRIPT_DIR"
 
-# Load window manager specific configuration if available
+# Load window manager specific configuration if available. A config sets
+# the desktop's environment, defines desktop_settings (seeded in the
+# background, cached) and names the session command in DESKTOP_SESSION_CMD;
+# one that starts the session itself is still supported, just not timed.
 WM_CONFIG="${SCRIPT_DIR}/${WM}_config.sh"
 if [ -f "$WM_CONFIG" ]; then
     echo "Loading window manager config from $WM_CONFIG"
+    unset -f desktop_settings
+    DESKTOP_SESSION_CMD=""
     source "$WM_CONFIG"
+    if declare -F desktop_settings >/dev/null; then
+        myvnc_phase desktop_settings myvnc_seed_settings desktop_settings &
+        MYVNC_PHASE_PIDS="$MYVNC_PHASE_PIDS $!"
+    fi
+    myvnc_startup_done
+    if [ -n "$DESKTOP_SESSION_CMD" ]; then
+        exec $DESKTOP_SESSION_CMD
+    fi
+    echo "Window manager config $WM_CONFIG did not set DESKTOP_SESSION_CMD"
 else
     echo "Window manager config not found: $WM_CONFIG"
+    myvnc_startup_done
     
     # Default fallback based on window manager
     case "$WM" in
@@ -70,6 +70,8 @@ except ImportError:
 
 # Import the central load_server_config function from the new module
 from myvnc.utils.config_loader import load_server_config
+from myvnc.utils.session_store import get_session_store
+from myvnc.utils.directory_cache import get_directory_cache
 
 class AuthManager:
     """
@@ -136,8 +138,10 @@ class AuthManager:
         else:
             self.msal_app = None
         
-        # Session management
-        self.sessions = {}
+        # Group memberships cached between logins, refreshed with an app-only Graph token
+        self.group_cache = get_directory_cache(self.server_config, 'entra_groups') if self.msal_app else None
+        if self.group_cache is not None:
+            self.group_cache.set_refresher(self._refresh_user_groups)
         
         # Use data directory from config, falling back to default
         self.session_dir = self.server_config.get("datadir", "myvnc/data")
@@ -278,7 +282,7 @@ class AuthManager:
             email = graph_data.get('mail', username)
             
             # Get group memberships
-            groups = self._get_user_groups_from_graph(result['access_token'])
+            groups = self._get_cached_user_groups(username, graph_data, result['access_token'])
             
             # Create session
             session_id = self.create_session(username, display_name, email, groups)
@@ -345,16 +349,16 @@ class AuthManager:
             ldap_session = self.ldap_manager.sessions.get(session_id)
             if ldap_session:
                 # Copy the session data to our local sessions dictionary
-                self.sessions[session_id] = ldap_session.copy()
+                session = ldap_session.copy()
                 self.logger.info(f"Copied LDAP session to auth_manager sessions: {session_id[:8]}...")
                 
                 # Ensure the session has an expiry time
-                if 'expiry' not in self.sessions[session_id]:
-                    self.sessions[session_id]['expiry'] = time.time() + self.session_expiry
+                if 'expiry' not in session:
+                    session['expiry'] = time.time() + self.session_expiry
                     self.logger.info(f"Added missing expiry to cloned session")
                 
-                # Save sessions to disk
-                self.save_sessions()
+                # Store it (persisted in the background)
+                self.sessions.put(session_id, session)
             else:
                 self.logger.warning(f"Could not find session {session_id[:8]}... in LDAP manager sessions")
             
@@ -400,8 +404,37 @@ class AuthManager:
             self.logger.error(f"Exception fetching user info: {str(e)}")
             return None
     
-    def _get_user_groups_from_graph(self, access_token):
-        """Get user group memberships from Microsoft Graph API"""
+    def _get_cached_user_groups(self, username, graph_data, access_token):
+        """Get user group memberships from the directory cache, or from Graph (caching them)"""
+        if self.group_cache is not None:
+            cached = self.group_cache.get(username)
+            if cached is not None:
+                return cached['groups']
+        groups = self._get_user_groups_from_graph(access_token)
+        if groups is None:
+            return []
+        if self.group_cache is not None:
+            self.group_cache.put(username, {'id': graph_data.get('id'), 'groups': groups})
+        return groups
+    
+    def _refresh_user_groups(self, username, cached):
+        """Look a cached user's groups up again with an app-only token (directory cache refresher thread)"""
+        if not cached.get('id') or not self.msal_app:
+            return None
+        result = self.msal_app.acquire_token_for_client(scopes=self.scopes)
+        if "error" in result or 'access_token' not in result:
+            self.logger.warning(f"Could not get an app token to refresh groups: {result.get('error_description', result.get('error'))}")
+            return None
+        groups = self._get_user_groups_from_graph(result['access_token'], cached['id'])
+        if groups is None:
+            return None
+        return {'id': cached['id'], 'groups': groups}
+    
+    def _get_user_groups_from_graph(self, access_token, user_id=None):
+        """
+        Get user group memberships from Microsoft Graph API, for the token's
+        user or (with an app-only token) for user_id; None if the request failed
+        """
         # Check if this is a mock token (for testing)
         if access_token and access_token.startswith('mock_access_token_'):
             # Return mock group data based on username
@@ -422,8 +455,9 @@ class AuthManager:
                 'Authorization': f'Bearer {access_token}',
                 'Content-Type': 'application/json'
             }
+            user_path = f"users/{user_id}" if user_id else 'me'
             response = requests.get(
-                'https://graph.microsoft.com/v1.0/me/memberOf',
+                f'https://graph.microsoft.com/v1.0/{user_path}/memberOf',
                 headers=headers
             )
             
@@ -432,10 +466,10 @@ class AuthManager:
                 return [group.get('displayName', '') for group in data.get('value', [])]
             else:
                 self.logger.error(f"Error fetching user groups: {response.status_code} - {response.text}")
-                return []
+                return None
         except Exception as e:
             self.logger.error(f"Exception fetching user groups: {str(e)}")
-            return []
+            return None
     
     def handle_auth_code(self, code: str) -> Tuple[bool, str, Optional[str]]:
         """
@@ -495,7 +529,7 @@ class AuthManager:
             email = graph_data.get('mail', '')
             
             # Get group memberships
-            groups = self._get_user_groups_from_graph(result['access_token'])
+            groups = self._get_cached_user_groups(username, graph_data, result['access_token'])
             
             # Create session - returns session_id string
             session_id = self.create_session(username, display_name, email, groups)
@@ -536,14 +570,14 @@ class AuthManager:
                 return False, "Invalid session ID format", None
         
         # Check if the session exists in our local cache
-        if session_id in self.sessions:
-            session = self.sessions[session_id]
+        session = self.sessions.get(session_id)
+        if session is not None:
             
             # Debug log session details
             self.logger.debug(f"Found session for user: {session.get('username', 'unknown')}")
             self.logger.debug(f"Session details: {session}")
             
-            # Check for session expiry
+            # Check for session expiry (the store drops expired sessions in the background too)
             if 'expiry' in session:
                 current_time = time.time()
                 expiry_time = session['expiry']
@@ -561,8 +595,9 @@ class AuthManager:
                 # If no expiry set, add one now (8 hours from now)
                 session['expiry'] = time.time() + self.session_expiry
                 self.logger.debug(f"Added missing expiry to session: {session['expiry']}")
+                self.sessions.put(session_id, session)
             
-            # Update last access time
+            # Update last access time (in memory; saved with the next compaction)
             session['last_access'] = time.time()
             
             return True, "Session is valid", session
@@ -578,16 +613,13 @@ class AuthManager:
                 self.logger.debug(f"LDAP session: {session}")
             
             if success and session:
-                # Cache the session locally
-                self.sessions[session_id] = session
-                
                 # Ensure it has expiry time
                 if 'expiry' not in session:
                     session['expiry'] = time.time() + self.session_expiry
                     self.logger.debug(f"Added expiry to LDAP session: {session['expiry']}")
                 
-                # Save sessions to persist
-                self.save_sessions()
+                # Cache the session locally (persisted in the background)
+                self.sessions.put(session_id, session)
                 
                 return True, message, session
         
@@ -605,9 +637,7 @@ class AuthManager:
             Tuple of (success, message)
         """
         # Check local sessions
-        if session_id in self.sessions:
-            self.sessions.pop(session_id)
-            self.save_sessions()
+        if self.sessions.pop(session_id) is not None:
             return True, "Logged out successfully"
         
         # Check LDAP manager if using LDAP
@@ -711,39 +741,18 @@ class AuthManager:
             'last_access': time.time()
         }
         
-        # Store session
-        self.sessions[session_id] = session
-        
-        # Save sessions to persist across server restarts
-        self.save_sessions()
+        # Store session; the session store persists it across server restarts
+        self.sessions.put(session_id, session)
         
         self.logger.info(f"Created new session for user {username}: {session_id[:8]}...")
         
         return session_id
     
     def save_sessions(self):
-        """Save sessions to a file"""
-        try:
-            with open(self.session_file, 'w') as f:
-                json.dump(self.sessions, f)
-        except Exception as e:
-            print(f"Error saving sessions: {str(e)}")
+        """Write all sessions to the sessions file soon (changes are journaled as they happen)"""
+        self.sessions.request_compaction()
     
     def load_sessions(self):
-        """Load sessions from a file"""
-        self.sessions = {}  # Initialize with empty dict
-        
-        if os.path.exists(self.session_file):
-            try:
-                with open(self.session_file, 'r') as f:
-                    loaded_sessions = json.load(f)
-                    
-                # Validate the loaded sessions to ensure they're properly formatted
-                for session_id, session_data in loaded_sessions.items():
-                    # Ensure session has the required fields
-                    if isinstance(session_data, dict) and 'username' in session_data:
-                        self.sessions[session_id] = session_data
-                        
-                self.logger.info(f"Loaded {len(self.sessions)} sessions from {self.session_file}")
-            except Exception as e:
-                self.logger.error(f"Error loading sessions: {str(e)}")
+        """Attach to the shared in-memory session store for the sessions file, loading it on first use"""
+        self.sessions = get_session_store(self.session_file)
+        self.logger.info(f"Using {len(self.sessions)} sessions from {self.session_file}")
@@ -6,14 +6,18 @@ import os
 import json
 import logging
 from pathlib import Path
-from myvnc.utils.config_manager import ConfigManager
+from myvnc.utils.config_manager import ConfigManager, file_stamp
 
 # Global configuration manager instance
 _config_manager = None
 
+# Parsed server config files: path -> (file_stamp, config)
+_server_config_cache = {}
+
 def get_config_manager(config_dir=None):
     """
-    Get or create a ConfigManager instance
+    Get or create the shared ConfigManager instance, reloading its
+    configuration first if the files changed on disk
     
     Args:
         config_dir: Optional directory containing configuration files
@@ -24,12 +28,35 @@ def get_config_manager(config_dir=None):
     global _config_manager
     if _config_manager is None:
         _config_manager = ConfigManager(config_dir)
+    else:
+        _config_manager.reload_if_changed()
     return _config_manager
 
+def _load_cached_json(config_path):
+    """
+    Parse a config file, reusing the previous result while the file is unchanged
+    
+    Returns a shallow copy, so callers may set top-level keys (e.g. command
+    line overrides) without affecting other callers.
+    
+    Raises:
+        json.JSONDecodeError, FileNotFoundError: As json.load/open
+    """
+    stamp = file_stamp(config_path)
+    cached = _server_config_cache.get(config_path)
+    if stamp is None or cached is None or cached[0] != stamp:
+        with open(config_path, 'r') as f:
+            config = json.load(f)
+        cached = (stamp, config)
+        _server_config_cache[config_path] = cached
+    return dict(cached[1])
+
 def load_server_config(config_dir=None):
     """
     Load server configuration
     
+    The file is parsed again only when it changed since the last call.
+    
     Args:
         config_dir: Optional directory containing configuration files
         
@@ -40,8 +67,7 @@ def load_server_config(config_dir=None):
     
     if config_path and os.path.exists(config_path):
         try:
-            with open(config_path, 'r') as f:
-                return json.load(f)
+            return _load_cached_json(config_path)
         except (json.JSONDecodeError, FileNotFoundError) as e:
             logging.error(f"Error loading server config from {config_path}: {e}")
     
@@ -52,11 +78,10 @@ def load_server_config(config_dir=None):
             # Use default path relative to this file
             config_dir = Path(__file__).parent.parent.parent / "config"
     
-    config_path = Path(config_dir) / "server_config.json"
+    config_path = str(Path(config_dir) / "server_config.json")
     
     try:
-        with open(config_path, 'r') as f:
-            return json.load(f)
+        return _load_cached_json(config_path)
     except (json.JSONDecodeError, FileNotFoundError) as e:
         logging.error(f"Error loading server config from {config_path}: {e}")
         # Return default configuration
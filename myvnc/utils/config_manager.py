@@ -3,8 +3,22 @@
 import json
 import os
 import logging
+import threading
+import time
 from pathlib import Path
 
+# Minimum seconds between checks of the config files for changes
+RELOAD_CHECK_INTERVAL = 1.0
+
+
+def file_stamp(path):
+    """Return a value that changes whenever the file at path is replaced or modified, or None if it is missing"""
+    try:
+        st = os.stat(path)
+    except OSError:
+        return None
+    return (st.st_ino, st.st_size, st.st_mtime_ns)
+
 class ConfigManager:
     """Manages application configuration loaded from JSON files"""
     
@@ -41,6 +55,17 @@ class ConfigManager:
             self.config_dir = Path(config_dir)
             self.logger.info(f"ConfigManager: Using explicitly provided config directory: {config_dir}")
         
+        # Paths of the files loaded below and their state when read, for reload_if_changed()
+        self._config_stamps = {}
+        self._reload_lock = threading.Lock()
+        self._last_reload_check = time.monotonic()
+        # Bumped whenever the configuration is (re)loaded, so derived caches know to rebuild
+        self.version = 0
+        
+        self._load_configs()
+    
+    def _load_configs(self):
+        """Load all configuration files"""
         # Load configurations - use the default_prefix in filenames
         self.vnc_config = self._load_config("vnc_config.json", os.environ.get("MYVNC_VNC_CONFIG_FILE"))
         self.lsf_config = self._load_config("lsf_config.json", os.environ.get("MYVNC_LSF_CONFIG_FILE"))
@@ -51,6 +76,43 @@ class ConfigManager:
         except RuntimeError:
             self.slurm_config = None
             self.logger.info("ConfigManager: slurm_config.json not found, SLURM support unavailable")
+        self.version += 1
+    
+    def reload_if_changed(self):
+        """
+        Reload the configuration files if any of them changed on disk
+        
+        The files are checked at most once per RELOAD_CHECK_INTERVAL. If a
+        changed file cannot be loaded (e.g. it is being edited), the previous
+        configuration stays in effect until the file changes again.
+        
+        Returns:
+            True if the configuration was reloaded
+        """
+        now = time.monotonic()
+        if now - self._last_reload_check < RELOAD_CHECK_INTERVAL:
+            return False
+        with self._reload_lock:
+            if now - self._last_reload_check < RELOAD_CHECK_INTERVAL:
+                return False
+            self._last_reload_check = now
+            changed = [str(path) for path, stamp in self._config_stamps.items() if file_stamp(path) != stamp]
+            if not changed:
+                return False
+            
+            self.logger.info(f"ConfigManager: Configuration changed on disk ({', '.join(changed)}), reloading")
+            previous = (self.vnc_config, self.lsf_config, self.slurm_config, dict(self._config_stamps))
+            try:
+                self._load_configs()
+            except RuntimeError as e:
+                self.vnc_config, self.lsf_config, self.slurm_config, stamps = previous
+                # Retry only once the files change again
+                for path in changed:
+                    stamps[Path(path)] = file_stamp(path)
+                self._config_stamps = stamps
+                self.logger.error(f"ConfigManager: Reload failed, keeping the previous configuration: {e}")
+                return False
+            return True
     
     def _load_config(self, filename, env_path=None):
         """
@@ -73,6 +135,9 @@ class ConfigManager:
         else:
             config_path = self.config_dir / filename
             self.logger.info(f"ConfigManager: Loading {filename} from config directory: {config_path}")
+        
+        # Tracked even when missing, so that creating the file is noticed
+        self._config_stamps[config_path] = file_stamp(config_path)
             
         try:
             with open(config_path, 'r') as f:
@@ -85,6 +150,7 @@ class ConfigManager:
                 alt_filename = filename.replace("default_", "", 1)
                 alt_path = self.config_dir / alt_filename
                 self.logger.info(f"ConfigManager: Trying alternate filename: {alt_path}")
+                self._config_stamps[alt_path] = file_stamp(alt_path)
                 try:
                     with open(alt_path, 'r') as f:
                         config = json.load(f)
@@ -5,15 +5,44 @@
 
 """
 Database manager for MyVNC application
+
+Each thread keeps one connection to the database, opened in WAL mode so
+readers do not block on a writer, and sqlite3 reuses the prepared statements
+of a connection across calls. Manager overrides are read on every session
+start and change rarely, so they are cached in memory and the cache is
+dropped whenever this manager writes them.
 """
 
 import os
+import copy
 import json
 import sqlite3
+import threading
 import time
 import logging
+import functools
 from pathlib import Path
 
+from myvnc.utils import metrics
+
+# Seconds a connection waits for a lock held by another writer
+BUSY_TIMEOUT = 10.0
+
+# Prepared statements kept per connection
+STATEMENT_CACHE_SIZE = 64
+
+# Marks a username with no override in the cache
+_NO_OVERRIDE = object()
+
+
+def _timed(method):
+    """Record the method's latency in the myvnc_db_operation_seconds histogram"""
+    @functools.wraps(method)
+    def wrapper(*args, **kwargs):
+        with metrics.db_seconds.time(operation=method.__name__):
+            return method(*args, **kwargs)
+    return wrapper
+
 class DatabaseManager:
     """
     Manages SQLite database connections and operations for MyVNC
@@ -30,16 +59,68 @@ class DatabaseManager:
         # Database file path
         self.db_path = os.path.join(self.data_dir, 'myvnc.db')
         
+        # Per-thread connections; bumping the generation makes every thread reconnect
+        self._local = threading.local()
+        self._generation = 0
+        
+        # username -> override dict (or _NO_OVERRIDE), and the list of all overrides
+        self._cache_lock = threading.Lock()
+        self._override_cache = {}
+        self._all_overrides_cache = None
+        # Bumped on every invalidation, so a read that raced a write is not cached
+        self._cache_version = 0
+        
         # Initialize database
         self._init_db()
         
         # Ensure manager_overrides table exists (migration support)
         self._ensure_manager_overrides_table()
     
+    def _connection(self):
+        """Return this thread's connection to the database, opening it on first use"""
+        local = self._local
+        if getattr(local, 'conn', None) is not None and local.generation == self._generation:
+            return local.conn
+        if getattr(local, 'conn', None) is not None:
+            local.conn.close()
+        conn = sqlite3.connect(self.db_path, timeout=BUSY_TIMEOUT, cached_statements=STATEMENT_CACHE_SIZE)
+        # WAL is safe for commits with synchronous=NORMAL; only the last ones may be lost on power failure
+        conn.execute("PRAGMA synchronous=NORMAL")
+        local.conn = conn
+        local.generation = self._generation
+        return conn
+    
+    def _reconnect_all(self):
+        """Make every thread open a new connection, e.g. after the database file was recreated"""
+        self._generation += 1
+        self._invalidate_overrides()
+    
+    def _rollback(self):
+        """Roll back this thread's open transaction after an error, so it does not keep the database locked"""
+        conn = getattr(self._local, 'conn', None)
+        if conn is not None:
+            try:
+                conn.rollback()
+            except sqlite3.Error:
+                pass
+    
+    def _invalidate_overrides(self):
+        with self._cache_lock:
+            self._override_cache.clear()
+            self._all_overrides_cache = None
+            self._cache_version += 1
+    
     def _init_db(self):
         """Initialize the database schema if it doesn't exist"""
         try:
-            conn = sqlite3.connect(self.db_path)
+            conn = self._connection()
+            
+            # WAL mode is stored in the database file, so setting it once is enough;
+            # it needs a local filesystem (the data directory is under /localdev)
+            journal_mode = conn.execute("PRAGMA journal_mode=WAL").fetchone()[0]
+            if journal_mode.lower() != 'wal':
+                self.logger.warning(f"Database {self.db_path} stays in {journal_mode} journal mode")
+            
             cursor = conn.cursor()
             
             # Create user_settings table if it doesn't exist
@@ -68,17 +149,17 @@ class DatabaseManager:
             ''')
             
             conn.commit()
-            conn.close()
             
             self.logger.info(f"Database initialized at {self.db_path}")
         except Exception as e:
+            self._rollback()
             self.logger.error(f"Error initializing database: {str(e)}")
     
     def _ensure_manager_overrides_table(self):
         """Ensure the manager_overrides table exists with correct schema (for migration support)"""
         try:
             self.logger.info(f"Checking for manager_overrides table in {self.db_path}")
-            conn = sqlite3.connect(self.db_path)
+            conn = self._connection()
             cursor = conn.cursor()
             
             # Check if the table exists
@@ -129,13 +210,13 @@ class DatabaseManager:
                 cursor.execute("PRAGMA table_info(manager_overrides)")
                 verify_columns = cursor.fetchall()
                 self.logger.info(f"New table columns: {[col[1] for col in verify_columns]}")
-            
-            conn.close()
         except Exception as e:
+            self._rollback()
             self.logger.error(f"Error ensuring manager_overrides table: {str(e)}")
             import traceback
             self.logger.error(f"Traceback: {traceback.format_exc()}")
     
+    @_timed
     def get_user_settings(self, username):
         """
         Get settings for a specific user
@@ -147,17 +228,11 @@ class DatabaseManager:
             Dictionary of user settings, or empty dict if no settings found
         """
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
             # Query for user settings
-            cursor.execute(
+            result = self._connection().execute(
                 "SELECT settings FROM user_settings WHERE username = ?", 
                 (username,)
-            )
-            
-            result = cursor.fetchone()
-            conn.close()
+            ).fetchone()
             
             if result:
                 # Parse JSON settings from database
@@ -169,6 +244,7 @@ class DatabaseManager:
             self.logger.error(f"Error getting user settings for {username}: {str(e)}")
             return {}
     
+    @_timed
     def save_user_settings(self, username, settings):
         """
         Save settings for a specific user
@@ -181,34 +257,22 @@ class DatabaseManager:
             True if successful, False otherwise
         """
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
             # Convert settings to JSON string
             settings_json = json.dumps(settings)
             current_time = int(time.time())
             
-            # Check if user already has settings
-            cursor.execute(
-                "SELECT 1 FROM user_settings WHERE username = ?", 
-                (username,)
-            )
-            
-            if cursor.fetchone():
-                # Update existing settings
-                cursor.execute(
+            # Commits on success, rolls back on error
+            with self._connection() as conn:
+                # Update existing settings, or insert new ones if the user has none
+                cursor = conn.execute(
                     "UPDATE user_settings SET settings = ?, updated_at = ? WHERE username = ?",
                     (settings_json, current_time, username)
                 )
-            else:
-                # Insert new settings
-                cursor.execute(
-                    "INSERT INTO user_settings (username, settings, created_at, updated_at) VALUES (?, ?, ?, ?)",
-                    (username, settings_json, current_time, current_time)
-                )
-            
-            conn.commit()
-            conn.close()
+                if cursor.rowcount == 0:
+                    conn.execute(
+                        "INSERT INTO user_settings (username, settings, created_at, updated_at) VALUES (?, ?, ?, ?)",
+                        (username, settings_json, current_time, current_time)
+                    )
             
             self.logger.info(f"Saved settings for user {username}")
             return True
@@ -217,6 +281,7 @@ class DatabaseManager:
             self.logger.error(f"Error saving user settings for {username}: {str(e)}")
             return False
     
+    @_timed
     def delete_user_settings(self, username):
         """
         Delete settings for a specific user
@@ -228,17 +293,12 @@ class DatabaseManager:
             True if successful, False otherwise
         """
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
             # Delete user settings
-            cursor.execute(
-                "DELETE FROM user_settings WHERE username = ?", 
-                (username,)
-            )
-            
-            conn.commit()
-            conn.close()
+            with self._connection() as conn:
+                conn.execute(
+                    "DELETE FROM user_settings WHERE username = ?", 
+                    (username,)
+                )
             
             self.logger.info(f"Deleted settings for user {username}")
             return True
@@ -247,6 +307,7 @@ class DatabaseManager:
             self.logger.error(f"Error deleting user settings for {username}: {str(e)}")
             return False
     
+    @_timed
     def get_manager_override(self, username):
         """
         Get manager override for a specific user
@@ -257,20 +318,21 @@ class DatabaseManager:
         Returns:
             Dictionary of override settings, or None if no override found
         """
+        with self._cache_lock:
+            cached = self._override_cache.get(username)
+            cache_version = self._cache_version
+        if cached is not None:
+            return None if cached is _NO_OVERRIDE else copy.deepcopy(cached)
+        
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
-            cursor.execute(
+            result = self._connection().execute(
                 "SELECT cores, memory, window_managers, queues, os_options, created_by, created_at, updated_at FROM manager_overrides WHERE username = ?",
                 (username,)
-            )
-            
-            result = cursor.fetchone()
-            conn.close()
+            ).fetchone()
             
+            override = None
             if result:
-                return {
+                override = {
                     'username': username,
                     'cores': json.loads(result[0]) if result[0] else None,
                     'memory': json.loads(result[1]) if result[1] else None,
@@ -281,13 +343,16 @@ class DatabaseManager:
                     'created_at': result[6],
                     'updated_at': result[7]
                 }
-            else:
-                return None
+            with self._cache_lock:
+                if cache_version == self._cache_version:
+                    self._override_cache[username] = _NO_OVERRIDE if override is None else override
+            return copy.deepcopy(override)
                 
         except Exception as e:
             self.logger.error(f"Error getting manager override for {username}: {str(e)}")
             return None
     
+    @_timed
     def get_all_manager_overrides(self):
         """
         Get all manager overrides
@@ -295,16 +360,16 @@ class DatabaseManager:
         Returns:
             List of dictionaries with override settings
         """
+        with self._cache_lock:
+            cached = self._all_overrides_cache
+            cache_version = self._cache_version
+        if cached is not None:
+            return copy.deepcopy(cached)
+        
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
-            cursor.execute(
+            results = self._connection().execute(
                 "SELECT username, cores, memory, window_managers, queues, os_options, created_by, created_at, updated_at FROM manager_overrides"
-            )
-            
-            results = cursor.fetchall()
-            conn.close()
+            ).fetchall()
             
             overrides = []
             for result in results:
@@ -320,12 +385,16 @@ class DatabaseManager:
                     'updated_at': result[8]
                 })
             
-            return overrides
+            with self._cache_lock:
+                if cache_version == self._cache_version:
+                    self._all_overrides_cache = overrides
+            return copy.deepcopy(overrides)
                 
         except Exception as e:
             self.logger.error(f"Error getting all manager overrides: {str(e)}")
             return []
     
+    @_timed
     def save_manager_override(self, username, overrides, created_by):
         """
         Save manager override for a specific user
@@ -339,14 +408,6 @@ class DatabaseManager:
             True if successful, False otherwise
         """
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
-            # First, let's check what columns exist in the table
-            cursor.execute("PRAGMA table_info(manager_overrides)")
-            columns = cursor.fetchall()
-            self.logger.info(f"manager_overrides table columns: {columns}")
-            
             current_time = int(time.time())
             
             # Convert lists to JSON strings (None values remain None)
@@ -358,42 +419,30 @@ class DatabaseManager:
             
             self.logger.info(f"Attempting to save override for username: {username}")
             
-            # Check if override already exists
             try:
-                cursor.execute(
-                    "SELECT 1 FROM manager_overrides WHERE username = ?",
-                    (username,)
-                )
-                exists = cursor.fetchone()
-                self.logger.info(f"Override exists check result: {exists}")
-            except Exception as e:
-                self.logger.error(f"Error checking if override exists: {str(e)}")
-                raise
-            
-            if exists:
-                # Update existing override
-                self.logger.info("Updating existing override")
-                cursor.execute(
-                    """UPDATE manager_overrides 
-                       SET cores = ?, memory = ?, window_managers = ?, queues = ?, os_options = ?, 
-                           created_by = ?, updated_at = ? 
-                       WHERE username = ?""",
-                    (cores_json, memory_json, window_managers_json, queues_json, os_options_json,
-                     created_by, current_time, username)
-                )
-            else:
-                # Insert new override
-                self.logger.info("Inserting new override")
-                cursor.execute(
-                    """INSERT INTO manager_overrides 
-                       (username, cores, memory, window_managers, queues, os_options, created_by, created_at, updated_at) 
-                       VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)""",
-                    (username, cores_json, memory_json, window_managers_json, queues_json, os_options_json,
-                     created_by, current_time, current_time)
-                )
-            
-            conn.commit()
-            conn.close()
+                with self._connection() as conn:
+                    # Update existing override, or insert a new one
+                    cursor = conn.execute(
+                        """UPDATE manager_overrides 
+                           SET cores = ?, memory = ?, window_managers = ?, queues = ?, os_options = ?, 
+                               created_by = ?, updated_at = ? 
+                           WHERE username = ?""",
+                        (cores_json, memory_json, window_managers_json, queues_json, os_options_json,
+                         created_by, current_time, username)
+                    )
+                    if cursor.rowcount == 0:
+                        self.logger.info("Inserting new override")
+                        conn.execute(
+                            """INSERT INTO manager_overrides 
+                               (username, cores, memory, window_managers, queues, os_options, created_by, created_at, updated_at) 
+                               VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)""",
+                            (username, cores_json, memory_json, window_managers_json, queues_json, os_options_json,
+                             created_by, current_time, current_time)
+                        )
+                    else:
+                        self.logger.info("Updated existing override")
+            finally:
+                self._invalidate_overrides()
             
             self.logger.info(f"Saved manager override for user {username} by {created_by}")
             return True
@@ -404,6 +453,7 @@ class DatabaseManager:
             self.logger.error(f"Full traceback: {traceback.format_exc()}")
             return False
     
+    @_timed
     def delete_manager_override(self, username):
         """
         Delete manager override for a specific user
@@ -415,16 +465,14 @@ class DatabaseManager:
             True if successful, False otherwise
         """
         try:
-            conn = sqlite3.connect(self.db_path)
-            cursor = conn.cursor()
-            
-            cursor.execute(
-                "DELETE FROM manager_overrides WHERE username = ?",
-                (username,)
-            )
-            
-            conn.commit()
-            conn.close()
+            try:
+                with self._connection() as conn:
+                    conn.execute(
+                        "DELETE FROM manager_overrides WHERE username = ?",
+                        (username,)
+                    )
+            finally:
+                self._invalidate_overrides()
             
             self.logger.info(f"Deleted manager override for user {username}")
             return True
@@ -454,10 +502,11 @@ class DatabaseManager:
                 self.logger.warning(f"Database file does not exist: {self.db_path}")
                 issues_found.append("Database file missing")
                 self.logger.info("Attempting to initialize database...")
+                self._reconnect_all()
                 self._init_db()
                 fixes_applied.append("Created new database file")
             
-            conn = sqlite3.connect(self.db_path)
+            conn = self._connection()
             cursor = conn.cursor()
             
             # Define expected schemas
@@ -588,7 +637,8 @@ class DatabaseManager:
                         self.logger.info(f"  ✓ Schema is correct")
             
             conn.commit()
-            conn.close()
+            if fixes_applied:
+                self._invalidate_overrides()
             
             # Summary
             self.logger.info("\n" + "=" * 60)
@@ -613,6 +663,7 @@ class DatabaseManager:
                 return True, "Database integrity verified", []
             
         except Exception as e:
+            self._rollback()
             self.logger.error(f"Error during database verification: {str(e)}")
             import traceback
             self.logger.error(f"Traceback: {traceback.format_exc()}")
@@ -0,0 +1,161 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Bounded cache of directory lookups (user attributes and group memberships)
+
+Logins still verify the password against LDAP or Entra ID every time, but
+the attribute and group search that follows is answered from here while the
+entry is younger than 'ttl' seconds, so a slow directory only costs the bind.
+At most 'max_entries' users are kept; the least recently used are dropped
+first.
+
+An entry read after 'refresh_after' seconds is still returned, and a
+background thread looks the user up again (with the service account the
+owner registered via set_refresher) so that users who log in regularly
+never wait for the search. Entries that are not read again simply expire.
+Without a refresher, or when a refresh fails, the entry is dropped at 'ttl'
+and the next login searches the directory itself.
+"""
+
+import copy
+import queue
+import threading
+import time
+from collections import OrderedDict
+from typing import Any, Callable, Dict, Optional
+
+from myvnc.utils.log_manager import get_logger
+
+DEFAULT_TTL = 900.0
+DEFAULT_REFRESH_AFTER = 600.0
+DEFAULT_MAX_ENTRIES = 5000
+
+
+class DirectoryCache:
+    """LRU of directory lookups keyed by lower-cased username, with TTL and refresh-ahead"""
+
+    def __init__(self, name: str, ttl: float = DEFAULT_TTL, refresh_after: float = DEFAULT_REFRESH_AFTER,
+                 max_entries: int = DEFAULT_MAX_ENTRIES):
+        """
+        Args:
+            name: What is cached, for log messages and the refresher thread
+            ttl: Seconds an entry is served for
+            refresh_after: Age in seconds after which a read also queues a refresh
+            max_entries: Users kept before the least recently used are dropped
+        """
+        self.name = name
+        self.ttl = ttl
+        self.refresh_after = refresh_after
+        self.max_entries = max_entries
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        # key -> (value, monotonic time it was looked up), least recently used first
+        self._entries = OrderedDict()
+        self._refresher: Optional[Callable[[str, Any], Any]] = None
+        self._pending = set()
+        self._queue = queue.Queue()
+        self._thread = None
+
+    @staticmethod
+    def _key(username: str) -> str:
+        return username.lower()
+
+    def get(self, username: str) -> Optional[Any]:
+        """Return a copy of the cached value, or None if there is none or it expired"""
+        key = self._key(username)
+        now = time.monotonic()
+        with self._lock:
+            entry = self._entries.get(key)
+            if entry is None:
+                return None
+            value, loaded_at = entry
+            if now - loaded_at >= self.ttl:
+                del self._entries[key]
+                return None
+            self._entries.move_to_end(key)
+            if now - loaded_at >= self.refresh_after and self._refresher is not None:
+                self._queue_refresh(key)
+        return copy.deepcopy(value)
+
+    def put(self, username: str, value: Any):
+        """Cache a value looked up just now"""
+        key = self._key(username)
+        with self._lock:
+            self._entries[key] = (copy.deepcopy(value), time.monotonic())
+            self._entries.move_to_end(key)
+            while len(self._entries) > self.max_entries:
+                self._entries.popitem(last=False)
+
+    def invalidate(self, username: Optional[str] = None):
+        """Drop one user's entry, or every entry"""
+        with self._lock:
+            if username is None:
+                self._entries.clear()
+            else:
+                self._entries.pop(self._key(username), None)
+
+    def set_refresher(self, refresher: Optional[Callable[[str, Any], Any]]):
+        """
+        Register the function that looks a user up again in the background;
+        it is called with the lower-cased username and a copy of the cached
+        value and returns the new value, or None to leave the entry to expire
+        """
+        with self._lock:
+            self._refresher = refresher
+
+    def _queue_refresh(self, key: str):
+        """Queue one refresh per key (called with the lock held)"""
+        if key in self._pending:
+            return
+        self._pending.add(key)
+        self._queue.put(key)
+        if self._thread is None:
+            self._thread = threading.Thread(target=self._refresh_loop, name=f'{self.name}-refresh', daemon=True)
+            self._thread.start()
+
+    def _refresh_loop(self):
+        while True:
+            key = self._queue.get()
+            with self._lock:
+                refresher = self._refresher
+                entry = self._entries.get(key)
+            value = None
+            if refresher is not None and entry is not None:
+                try:
+                    value = refresher(key, copy.deepcopy(entry[0]))
+                except Exception as e:
+                    self.logger.warning(f"Refreshing {self.name} for {key} failed: {e}")
+            with self._lock:
+                self._pending.discard(key)
+                # Only refresh users that are still cached, so dropped entries stay dropped
+                if value is not None and key in self._entries:
+                    self._entries[key] = (copy.deepcopy(value), time.monotonic())
+
+
+_caches: Dict[str, DirectoryCache] = {}
+_caches_lock = threading.Lock()
+
+
+def get_directory_cache(server_config: Dict, name: str) -> Optional[DirectoryCache]:
+    """
+    Return the shared DirectoryCache called name when 'directory_cache' is
+    enabled in server_config.json, otherwise None. The cache outlives
+    AuthManager rebuilds; changed settings apply to it in place.
+    """
+    cache_config = server_config.get('directory_cache') or {}
+    if not cache_config.get('enabled', False):
+        return None
+    ttl = float(cache_config.get('ttl', DEFAULT_TTL))
+    refresh_after = float(cache_config.get('refresh_after', min(DEFAULT_REFRESH_AFTER, ttl)))
+    max_entries = int(cache_config.get('max_entries', DEFAULT_MAX_ENTRIES))
+    with _caches_lock:
+        cache = _caches.get(name)
+        if cache is None:
+            cache = DirectoryCache(name, ttl=ttl, refresh_after=refresh_after, max_entries=max_entries)
+            _caches[name] = cache
+        else:
+            with cache._lock:
+                cache.ttl = ttl
+                cache.refresh_after = refresh_after
+                cache.max_entries = max(1, max_entries)
+        return cache
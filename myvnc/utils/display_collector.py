@@ -0,0 +1,292 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Collector for VNC displays pushed by utils/vncserver_wrapper
+
+The wrapper reports the display vncserver actually bound to as a file
+'<job_id>.<user>' containing "VNC_DISPLAY=:N" in a shared spool directory
+(sticky and world-writable, like /tmp). The collector keeps these in memory,
+updated from inotify events, so job listings know a job's display without
+running bread or cat-ing files through setuid_runner.
+
+A report is only trusted when the file is owned by the user named in it and
+that user owns the job being looked up. inotify does not see files created
+by other hosts on a network filesystem, so a lookup that misses also
+rescans the directory when its mtime changed, at most once per
+RESCAN_INTERVAL.
+
+Reports also carry the epoch times the wrapper reported the display
+(VNC_DISPLAY_AT) and saw the first viewer connection in the vncserver log
+(VNC_CONNECTED_AT), which the session timeline records, and the
+milliseconds each phase of config/vnc/xstartup.sh took (VNC_STARTUP_<phase>,
+with the desktop in VNC_STARTUP_DESKTOP). Phase timings are logged and
+observed into myvnc_desktop_startup_phase_seconds the first time a report
+with them is seen.
+"""
+
+import ctypes
+import os
+import pwd
+import re
+import struct
+import threading
+import time
+from typing import Dict, Optional, Tuple
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils import metrics
+
+# Minimum seconds between directory rescans on a lookup miss
+RESCAN_INTERVAL = 2.0
+
+# Reports older than this are removed during rescans
+DEFAULT_RETENTION_DAYS = 30
+
+_REPORT_NAME = re.compile(r'^(\d+)\.([A-Za-z0-9_][A-Za-z0-9._-]*)$')
+_REPORT_CONTENT = re.compile(r'VNC_DISPLAY=:(\d+)')
+_REPORT_TIMES = re.compile(r'VNC_(DISPLAY|CONNECTED)_AT=(\d+)')
+_REPORT_PHASES = re.compile(r'^VNC_STARTUP_([a-z_]+)=(\d+)$', re.MULTILINE)
+_REPORT_DESKTOP = re.compile(r'^VNC_STARTUP_DESKTOP=([A-Za-z0-9_.-]+)$', re.MULTILINE)
+
+# Largest report read; phase timings make it a few hundred bytes
+MAX_REPORT_SIZE = 4096
+
+# From <sys/inotify.h>
+_IN_CLOSE_WRITE = 0x00000008
+_IN_MOVED_FROM = 0x00000040
+_IN_MOVED_TO = 0x00000080
+_IN_DELETE = 0x00000200
+_IN_Q_OVERFLOW = 0x00004000
+_IN_CLOEXEC = 0o2000000
+_EVENT_HEADER = struct.Struct('iIII')
+
+
+class DisplayCollector:
+    """In-memory view of the display reports in a spool directory"""
+
+    def __init__(self, spool_dir: str, retention_days: float = DEFAULT_RETENTION_DAYS):
+        self.spool_dir = spool_dir
+        self.retention = retention_days * 86400
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        # (job_id, user) -> display
+        self._displays: Dict[Tuple[str, str], str] = {}
+        # (job_id, user) -> {'display': epoch, 'connect': epoch} as reported
+        self._events: Dict[Tuple[str, str], Dict[str, float]] = {}
+        # (job_id, user) -> {'desktop': name, 'phases': {phase: seconds}}
+        self._startups: Dict[Tuple[str, str], Dict] = {}
+        # Reports already there at start() were observed by an earlier server run
+        self._observing = False
+        self._scanned_mtime = None
+        self._scanned_at = 0.0
+
+    def start(self):
+        """Load the current reports and watch the spool directory for new ones"""
+        self.rescan()
+        self._observing = True
+        try:
+            fd = self._inotify_watch()
+        except OSError as e:
+            self.logger.warning(f"Not watching display spool {self.spool_dir} with inotify: {e}")
+            return
+        threading.Thread(target=self._watch, args=(fd,), name='display-collector', daemon=True).start()
+
+    def get(self, job_id: str, user: str) -> Optional[str]:
+        """
+        Return the display reported for a job as a string (e.g. "6"), or None
+
+        Args:
+            job_id: Job ID
+            user: Owner of the job; reports made by anyone else are ignored
+        """
+        key = (str(job_id).strip(), user)
+        with self._lock:
+            display = self._displays.get(key)
+        if display is None and self._rescan_due():
+            self.rescan()
+            with self._lock:
+                display = self._displays.get(key)
+        return display
+
+    def events(self, job_id: str, user: str) -> Dict[str, float]:
+        """The times a job's display and first connection were reported, of those that were"""
+        with self._lock:
+            return dict(self._events.get((str(job_id).strip(), user), {}))
+
+    def startup(self, job_id: str, user: str) -> Optional[Dict]:
+        """The desktop and startup phase timings (seconds) reported for a job, or None"""
+        with self._lock:
+            startup = self._startups.get((str(job_id).strip(), user))
+        return dict(startup, phases=dict(startup['phases'])) if startup else None
+
+    def _store(self, job_id: str, user: str, display: str, times: Dict[str, float], startup: Optional[Dict]):
+        """Keep a report, logging and observing its startup timings if they are new"""
+        key = (job_id, user)
+        with self._lock:
+            self._displays[key] = display
+            self._events[key] = times
+            new_startup = startup is not None and key not in self._startups
+            if startup is not None:
+                self._startups[key] = startup
+        if new_startup and self._observing:
+            phases = ', '.join(f"{phase} {seconds:.1f}s" for phase, seconds in startup['phases'].items())
+            self.logger.info(f"Desktop startup of job {job_id} ({startup['desktop']}): {phases}")
+            for phase, seconds in startup['phases'].items():
+                metrics.desktop_startup_phase_seconds.observe(seconds, desktop=startup['desktop'], phase=phase)
+
+    def _forget(self, key: Tuple[str, str]):
+        with self._lock:
+            self._displays.pop(key, None)
+            self._events.pop(key, None)
+            self._startups.pop(key, None)
+
+    def _rescan_due(self) -> bool:
+        if time.monotonic() - self._scanned_at < RESCAN_INTERVAL:
+            return False
+        try:
+            return os.stat(self.spool_dir).st_mtime != self._scanned_mtime
+        except OSError:
+            return False
+
+    def rescan(self):
+        """Reload every report in the spool directory, removing expired ones"""
+        self._scanned_at = time.monotonic()
+        try:
+            mtime = os.stat(self.spool_dir).st_mtime
+            entries = list(os.scandir(self.spool_dir))
+        except OSError as e:
+            self.logger.warning(f"Could not scan display spool {self.spool_dir}: {e}")
+            return
+
+        reports = {}
+        now = time.time()
+        for entry in entries:
+            report = self._read_report(entry.name)
+            if report is None:
+                continue
+            job_id, user, display, reported_at, times, startup = report
+            if now - reported_at > self.retention:
+                try:
+                    os.unlink(entry.path)
+                except OSError:
+                    pass
+                continue
+            reports[(job_id, user)] = (display, times, startup)
+
+        with self._lock:
+            for key in set(self._displays) - set(reports):
+                self._displays.pop(key, None)
+                self._events.pop(key, None)
+                self._startups.pop(key, None)
+            self._scanned_mtime = mtime
+        for (job_id, user), (display, times, startup) in reports.items():
+            self._store(job_id, user, display, times, startup)
+
+    def _read_report(self, name: str) -> Optional[Tuple[str, str, str, float, Dict[str, float], Optional[Dict]]]:
+        """
+        Parse one report file; returns (job_id, user, display, mtime, event
+        times, startup timings or None) or None if it is not a valid report
+        """
+        match = _REPORT_NAME.match(name)
+        if not match:
+            return None
+        job_id, user = match.groups()
+        path = os.path.join(self.spool_dir, name)
+        try:
+            # O_NOFOLLOW: the owner check below must be about this file, not a link target
+            fd = os.open(path, os.O_RDONLY | os.O_NOFOLLOW | os.O_NONBLOCK)
+            try:
+                st = os.fstat(fd)
+                content = os.read(fd, MAX_REPORT_SIZE).decode('utf-8', 'replace')
+            finally:
+                os.close(fd)
+        except OSError:
+            return None
+
+        try:
+            owner = pwd.getpwuid(st.st_uid).pw_name
+        except KeyError:
+            owner = None
+        if owner != user:
+            self.logger.warning(f"Ignoring display report {name} owned by uid {st.st_uid}")
+            return None
+        display_match = _REPORT_CONTENT.search(content)
+        if not display_match:
+            return None
+        times = {('display' if kind == 'DISPLAY' else 'connect'): float(at)
+                 for kind, at in _REPORT_TIMES.findall(content)}
+        times.setdefault('display', st.st_mtime)
+        startup = None
+        phases = {phase: int(ms) / 1000.0 for phase, ms in _REPORT_PHASES.findall(content)}
+        if phases:
+            desktop_match = _REPORT_DESKTOP.search(content)
+            startup = {'desktop': desktop_match.group(1) if desktop_match else 'unknown', 'phases': phases}
+        return job_id, user, display_match.group(1), st.st_mtime, times, startup
+
+    def _inotify_watch(self) -> int:
+        libc = ctypes.CDLL(None, use_errno=True)
+        fd = libc.inotify_init1(_IN_CLOEXEC)
+        if fd < 0:
+            err = ctypes.get_errno()
+            raise OSError(err, os.strerror(err))
+        mask = _IN_CLOSE_WRITE | _IN_MOVED_TO | _IN_MOVED_FROM | _IN_DELETE
+        if libc.inotify_add_watch(fd, os.fsencode(self.spool_dir), mask) < 0:
+            err = ctypes.get_errno()
+            os.close(fd)
+            raise OSError(err, os.strerror(err))
+        return fd
+
+    def _watch(self, fd: int):
+        """Apply inotify events for the spool directory to the in-memory reports"""
+        while True:
+            try:
+                data = os.read(fd, 64 * 1024)
+            except InterruptedError:
+                continue
+            except OSError as e:
+                self.logger.error(f"Display spool watch stopped: {e}")
+                return
+
+            offset = 0
+            while offset + _EVENT_HEADER.size <= len(data):
+                _, mask, _, name_len = _EVENT_HEADER.unpack_from(data, offset)
+                offset += _EVENT_HEADER.size
+                name = data[offset:offset + name_len].split(b'\0', 1)[0].decode('utf-8', 'replace')
+                offset += name_len
+
+                if mask & _IN_Q_OVERFLOW:
+                    self.rescan()
+                elif mask & (_IN_CLOSE_WRITE | _IN_MOVED_TO):
+                    report = self._read_report(name)
+                    if report:
+                        job_id, user, display, _, times, startup = report
+                        self._store(job_id, user, display, times, startup)
+                        self.logger.info(f"Display report for job {job_id}: :{display}")
+                elif mask & (_IN_DELETE | _IN_MOVED_FROM):
+                    match = _REPORT_NAME.match(name)
+                    if match:
+                        self._forget(match.groups())
+
+
+_collectors = {}
+_collectors_lock = threading.Lock()
+
+
+def get_display_collector(server_config: Dict) -> Optional[DisplayCollector]:
+    """
+    Return the shared DisplayCollector for the configured spool directory, or
+    None when 'display_collector' is not enabled in server_config.json
+    """
+    collector_config = server_config.get('display_collector') or {}
+    if not collector_config.get('enabled', False) or not collector_config.get('spool_dir'):
+        return None
+
+    spool_dir = collector_config['spool_dir']
+    with _collectors_lock:
+        collector = _collectors.get(spool_dir)
+        if collector is None:
+            collector = DisplayCollector(spool_dir,
+                                         retention_days=float(collector_config.get('retention_days', DEFAULT_RETENTION_DAYS)))
+            collector.start()
+            _collectors[spool_dir] = collector
+        return collector
@@ -0,0 +1,357 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Federation of several LSF and SLURM clusters behind one myvnc server
+
+With 'federation' enabled the server holds one manager per configured
+cluster instead of the single LSFManager or SLURMManager 'scheduler' picks.
+Each cluster has a name, a scheduler type, the scheduler environment its
+commands run with (LSF_ENVDIR, SLURM_CONF, PATH, ...) and optionally
+server_config.json settings of its own (e.g. 'slurm_rest'). Every cluster
+gets a setuid_runner daemon socket of its own (setuid_runner-<name>.sock
+next to the configured one), since the daemon passes the environment it
+was started with on to the commands it runs.
+
+FederatedManager has the manager methods the web server calls:
+
+- Listings run on every cluster at once. Each cluster has 'list_timeout'
+  seconds (capped by the request's own deadline); a cluster that fails or
+  is too slow is logged, counted and left out, so the others' sessions are
+  still shown. Only when every cluster fails does the listing fail.
+- Job IDs are qualified with the cluster name ("aus:12345"), so stopping,
+  copying and connecting to a session goes to the cluster that runs it.
+- A submission goes to the 'cluster' the request names, or else to the
+  least loaded cluster that serves its queue (clusters' 'queues', any
+  queue when not given). A cluster's load is its pending sessions plus
+  'running_weight' per running session, divided by its 'weight'; it is
+  refreshed every 'load_interval' seconds from all users' listings, and a
+  cluster whose last listing failed is only used when no other can take the
+  request.
+
+Incremental job updates (/api/vnc/updates) are not offered in federated
+mode; the web UI polls the listing instead.
+"""
+
+import os
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor, TimeoutError as FutureTimeout
+from typing import Callable, Dict, List, NamedTuple, Optional, Tuple
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils.runner_client import current_deadline, deadline_scope, submit as submit_call
+from myvnc.utils import metrics
+
+DEFAULT_LIST_TIMEOUT = 10.0
+DEFAULT_LOAD_INTERVAL = 60.0
+DEFAULT_RUNNING_WEIGHT = 0.1
+
+# Threads running calls on the clusters; a call past its deadline holds one
+# until the broker has stopped its commands
+FANOUT_WORKERS = 32
+
+# Separates the cluster name from the scheduler's job ID
+JOB_ID_SEPARATOR = ':'
+
+# Settings kept out of the clusters' own copies of server_config.json
+_SERVER_ONLY = ('federation', 'job_updates')
+
+
+class ClusterLoad(NamedTuple):
+    """Sessions of a cluster at its last load refresh"""
+    pending: int
+    running: int
+    ok: bool
+    refreshed_at: float
+
+
+class ClusterUnavailable(Exception):
+    """A cluster did not answer within its timeout"""
+
+
+def cluster_environment(cluster: Dict) -> Dict[str, str]:
+    """The environment a cluster's commands run with: the server's, with the cluster's variables set"""
+    env = os.environ.copy()
+    env.update({key: str(value) for key, value in (cluster.get('environment') or {}).items()})
+    return env
+
+
+def cluster_server_config(server_config: Dict, cluster: Dict) -> Dict:
+    """A cluster manager's server_config.json: the server's, the cluster's 'settings' over it"""
+    merged = {key: value for key, value in server_config.items() if key not in _SERVER_ONLY}
+    merged.update(cluster.get('settings') or {})
+    daemon_config = dict(merged.get('setuid_runner_daemon') or {})
+    base_socket = (server_config.get('setuid_runner_daemon') or {}).get('socket') or '/run/myvnc/setuid_runner.sock'
+    if daemon_config.get('enabled') and (daemon_config.get('socket') or base_socket) == base_socket:
+        stem, ext = os.path.splitext(base_socket)
+        daemon_config['socket'] = f"{stem}-{cluster['name']}{ext}"
+        merged['setuid_runner_daemon'] = daemon_config
+    return merged
+
+
+def qualify(cluster: str, job_id: str) -> str:
+    """A cluster's job ID as the federation shows it"""
+    return f"{cluster}{JOB_ID_SEPARATOR}{job_id}"
+
+
+class FederatedManager:
+    """Scheduler managers of several clusters, used like one"""
+
+    def __init__(self, clusters: List[Tuple[Dict, object]], list_timeout: float = DEFAULT_LIST_TIMEOUT,
+                 load_interval: float = DEFAULT_LOAD_INTERVAL, running_weight: float = DEFAULT_RUNNING_WEIGHT):
+        """
+        Args:
+            clusters: (cluster configuration, its LSFManager or SLURMManager), in order of preference
+            list_timeout: Seconds each cluster has to answer a listing
+            load_interval: Seconds between refreshes of the clusters' load
+            running_weight: Load a running session adds, against 1 for a pending one
+        """
+        self.clusters = {config['name']: config for config, _ in clusters}
+        self.managers = {config['name']: manager for config, manager in clusters}
+        self.list_timeout = list_timeout
+        self.load_interval = load_interval
+        self.running_weight = running_weight
+        self.logger = get_logger()
+        self._executor = ThreadPoolExecutor(max_workers=FANOUT_WORKERS, thread_name_prefix='federation')
+        self._lock = threading.Lock()
+        self._loads: Dict[str, ClusterLoad] = {}
+        self._load_thread = None
+
+        first = next(iter(self.managers.values()))
+        self.job_snapshot = None
+        self.job_feed = None
+        self.job_snapshot_user = first.job_snapshot_user
+        self.session_timeline = first.session_timeline
+
+    @property
+    def command_history(self) -> List[Dict]:
+        """Every cluster's command history, oldest first, each entry with its cluster"""
+        history = [dict(entry, cluster=name, command=f"[{name}] {entry.get('command', '')}")
+                   for name, manager in self.managers.items() for entry in manager.command_history]
+        return sorted(history, key=lambda entry: entry.get('timestamp', ''))
+
+    def call_async(self, fn, *args, deadline: float = None, **kwargs):
+        """Start fn(*args, **kwargs) in the background under the deadline, as the managers' call_async does"""
+        return submit_call(fn, *args, deadline=deadline, **kwargs)
+
+    def split_job_id(self, job_id: str) -> Tuple[str, str]:
+        """(cluster, scheduler job ID) of a qualified job ID"""
+        cluster, separator, raw_id = str(job_id).partition(JOB_ID_SEPARATOR)
+        if not separator or cluster not in self.managers:
+            raise ValueError(f"Job ID {job_id} does not name a cluster of this server "
+                             f"({', '.join(self.managers)})")
+        return cluster, raw_id
+
+    def _fan_out(self, call: Callable[[str, object], object], names: Optional[List[str]] = None) -> Dict[str, object]:
+        """
+        Run call(name, manager) on the clusters at once and return each cluster's
+        result, or the exception it raised (ClusterUnavailable past its timeout)
+        """
+        names = list(self.managers) if names is None else names
+        outer = current_deadline()
+        started = time.monotonic()
+        deadline = started + self.list_timeout if self.list_timeout else None
+        if outer is not None:
+            deadline = outer if deadline is None else min(deadline, outer)
+
+        def run(name):
+            with deadline_scope(deadline):
+                return call(name, self.managers[name])
+
+        futures = {name: self._executor.submit(run, name) for name in names}
+        results = {}
+        for name, future in futures.items():
+            try:
+                timeout = None if deadline is None else max(0.0, deadline - time.monotonic())
+                results[name] = future.result(timeout=timeout)
+                metrics.federation_call_seconds.observe(time.monotonic() - started, cluster=name)
+            except FutureTimeout:
+                results[name] = ClusterUnavailable(f"no answer within {time.monotonic() - started:.1f}s")
+                metrics.federation_cluster_errors.inc(cluster=name, reason='timeout')
+            except Exception as e:
+                results[name] = e
+                metrics.federation_cluster_errors.inc(cluster=name, reason='error')
+        return results
+
+    def get_active_vnc_jobs(self, authenticated_user: str = None, all_users: bool = False) -> List[Dict]:
+        """
+        The sessions of every cluster that answered in time, job IDs qualified
+        with the cluster name and each job's 'cluster' set
+
+        Raises:
+            Exception: The first cluster's error, if no cluster answered
+        """
+        results = self._fan_out(lambda name, manager: manager.get_active_vnc_jobs(authenticated_user, all_users=all_users))
+        jobs, errors = [], []
+        for name, result in results.items():
+            if isinstance(result, Exception):
+                self.logger.warning(f"Leaving cluster {name} out of the session listing: {result}")
+                errors.append(result)
+                continue
+            for job in result:
+                job = dict(job, cluster=name, job_id=qualify(name, job.get('job_id')))
+                jobs.append(job)
+            if all_users:
+                self._store_load(name, result)
+        if errors and len(errors) == len(results):
+            raise errors[0]
+        return jobs
+
+    def get_vnc_connection_details_many(self, job_ids: List[str], authenticated_user: str = None) -> Dict[str, Optional[Dict]]:
+        """Connection details of qualified job IDs, looked up on each cluster at once"""
+        by_cluster: Dict[str, List[str]] = {}
+        details: Dict[str, Optional[Dict]] = {}
+        for job_id in job_ids:
+            try:
+                cluster, raw_id = self.split_job_id(job_id)
+            except ValueError:
+                details[job_id] = None
+                continue
+            by_cluster.setdefault(cluster, []).append(raw_id)
+        results = self._fan_out(lambda name, manager: manager.get_vnc_connection_details_many(
+            by_cluster[name], authenticated_user), list(by_cluster))
+        for cluster, raw_ids in by_cluster.items():
+            result = results[cluster]
+            if isinstance(result, Exception):
+                self.logger.warning(f"No connection details from cluster {cluster}: {result}")
+                result = {}
+            for raw_id in raw_ids:
+                found = result.get(raw_id)
+                details[qualify(cluster, raw_id)] = dict(found, job_id=qualify(cluster, raw_id)) if found else None
+        return details
+
+    def get_job_owner(self, job_id: str, authenticated_user: str = None) -> Optional[str]:
+        cluster, raw_id = self.split_job_id(job_id)
+        return self.managers[cluster].get_job_owner(raw_id, authenticated_user)
+
+    def kill_vnc_job(self, job_id: str, authenticated_user: str = None, reason: str = None) -> bool:
+        cluster, raw_id = self.split_job_id(job_id)
+        self.logger.info(f"Killing job {raw_id} on cluster {cluster}")
+        return self.managers[cluster].kill_vnc_job(raw_id, authenticated_user, reason=reason)
+
+    def submit_vnc_job(self, vnc_config: Dict, scheduler_config: Dict, authenticated_user: str = None,
+                       fake_no_home: bool = False, server_hostname: str = None) -> str:
+        cluster = self.route(vnc_config, scheduler_config)
+        job_id = self.managers[cluster].submit_vnc_job(vnc_config, scheduler_config, authenticated_user,
+                                                       fake_no_home=fake_no_home, server_hostname=server_hostname)
+        return qualify(cluster, job_id)
+
+    def submit_tmux_job(self, session_config: Dict, scheduler_config: Dict, authenticated_user: str = None,
+                        server_hostname: str = None) -> str:
+        cluster = self.route(session_config, scheduler_config)
+        job_id = self.managers[cluster].submit_tmux_job(session_config, scheduler_config, authenticated_user,
+                                                        server_hostname=server_hostname)
+        return qualify(cluster, job_id)
+
+    def submit_jobs(self, session_type: str, session_config: Dict, scheduler_config: Dict, users: List[str],
+                    server_hostname: str = None) -> Dict[str, Dict]:
+        """Submit the same session for several users, all on the cluster routed to"""
+        cluster = self.route(session_config, scheduler_config)
+        results = self.managers[cluster].submit_jobs(session_type, session_config, scheduler_config, users,
+                                                     server_hostname=server_hostname)
+        return {user: dict(result, job_id=qualify(cluster, result['job_id'])) if 'job_id' in result else result
+                for user, result in results.items()}
+
+    def route(self, session_config: Dict, scheduler_config: Dict) -> str:
+        """
+        The cluster a submission goes to
+
+        Raises:
+            ValueError: If the request names an unknown cluster or no cluster serves its queue
+        """
+        requested = scheduler_config.get('cluster') or session_config.get('cluster')
+        if requested:
+            if requested not in self.managers:
+                raise ValueError(f"Unknown cluster {requested}; one of: {', '.join(self.managers)}")
+            return requested
+        queue = scheduler_config.get('partition', scheduler_config.get('queue'))
+        eligible = [name for name, config in self.clusters.items()
+                    if not config.get('queues') or queue in config['queues']]
+        if not eligible:
+            raise ValueError(f"No cluster serves queue {queue}")
+        loads = self._current_loads()
+        healthy = [name for name in eligible if name not in loads or loads[name].ok] or eligible
+        order = list(self.clusters)
+        cluster = min(healthy, key=lambda name: (self._score(name, loads.get(name)), order.index(name)))
+        self.logger.info(f"Routing {queue} submission to cluster {cluster}")
+        metrics.federation_submissions.inc(cluster=cluster)
+        return cluster
+
+    def _score(self, name: str, load: Optional[ClusterLoad]) -> float:
+        if load is None or not load.ok:
+            return float('inf')
+        weight = float(self.clusters[name].get('weight', 1.0)) or 1.0
+        return (load.pending + self.running_weight * load.running) / weight
+
+    def _store_load(self, name: str, jobs: List[Dict]):
+        pending = sum(1 for job in jobs if job.get('status') == 'PEND')
+        running = sum(1 for job in jobs if job.get('status') == 'RUN')
+        with self._lock:
+            self._loads[name] = ClusterLoad(pending, running, True, time.monotonic())
+
+    def refresh_loads(self):
+        """List all users' sessions on every cluster and store each cluster's load"""
+        with deadline_scope(None):
+            results = self._fan_out(lambda name, manager: manager.get_active_vnc_jobs(manager.job_snapshot_user,
+                                                                                      all_users=True))
+        for name, result in results.items():
+            if isinstance(result, Exception):
+                self.logger.warning(f"Could not refresh the load of cluster {name}: {result}")
+                with self._lock:
+                    self._loads[name] = ClusterLoad(0, 0, False, time.monotonic())
+            else:
+                self._store_load(name, result)
+
+    def _load_loop(self):
+        while True:
+            started = time.monotonic()
+            try:
+                self.refresh_loads()
+            except Exception as e:
+                self.logger.warning(f"Cluster load refresh failed: {e}")
+            time.sleep(max(1.0, self.load_interval - (time.monotonic() - started)))
+
+    def _current_loads(self) -> Dict[str, ClusterLoad]:
+        """The clusters' loads, starting the refresh thread on first use; loads too old to route by are left out"""
+        with self._lock:
+            if self._load_thread is None:
+                self._load_thread = threading.Thread(target=self._load_loop, name='federation-load', daemon=True)
+                self._load_thread.start()
+            now = time.monotonic()
+            return {name: load for name, load in self._loads.items()
+                    if now - load.refreshed_at <= self.load_interval * 3}
+
+
+_federation = None
+_federation_lock = threading.Lock()
+
+
+def get_federated_manager(server_config: Dict) -> Optional[FederatedManager]:
+    """
+    Return the FederatedManager of the configured clusters, or None when
+    'federation' is not enabled in server_config.json
+
+    Like the managers themselves it is built once; changing the clusters
+    takes a restart.
+    """
+    global _federation
+    federation_config = server_config.get('federation') or {}
+    clusters = federation_config.get('clusters') or []
+    if not federation_config.get('enabled', False) or not clusters:
+        return None
+    with _federation_lock:
+        if _federation is None:
+            # Imported here since the managers use this module's helpers
+            from myvnc.utils.lsf_manager import LSFManager
+            from myvnc.utils.slurm_manager import SLURMManager
+            members = []
+            for cluster in clusters:
+                manager_class = SLURMManager if (cluster.get('scheduler') or 'lsf').lower() == 'slurm' else LSFManager
+                members.append((cluster, manager_class(cluster)))
+            _federation = FederatedManager(
+                members,
+                list_timeout=float(federation_config.get('list_timeout', DEFAULT_LIST_TIMEOUT)),
+                load_interval=float(federation_config.get('load_interval', DEFAULT_LOAD_INTERVAL)),
+                running_weight=float(federation_config.get('running_weight', DEFAULT_RUNNING_WEIGHT)))
+            get_logger().info(f"Federating {len(members)} clusters: {', '.join(c['name'] for c, _ in members)}")
+        return _federation
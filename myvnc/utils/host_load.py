@@ -0,0 +1,199 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Background-refreshed load of the execution hosts, for session placement hints
+
+Every 'interval' seconds a thread asks the scheduler for each host's CPU
+utilisation and free memory (lsload/lshosts, sinfo) and counts the myvnc
+sessions running there from a listing of all users' jobs. A host's score
+is its CPU utilisation plus the share of its memory in use plus
+'session_weight' per session; lower is better.
+
+The managers turn the table into a hint on the submission, never into a
+hard constraint, so a stale or wrong table cannot keep a session from
+starting:
+
+- LSF: a host preference list, bsub -m "best+3 next+2 third+1 others",
+  naming only hosts known to serve the job's queue (hosts where the queue's
+  sessions have run, plus 'queue_hosts' from the configuration), since bsub
+  rejects hosts outside the queue.
+- SLURM: --exclude for the partition's nodes that are down or score at
+  least 'avoid_score', as long as some node of the partition is left;
+  sbatch has no soft node preference (--nodelist is a requirement).
+
+The thread starts on the first hint requested, so the first submission
+after a restart goes without one. A table older than MAX_AGE intervals
+(the refresh keeps failing) gives no hints.
+"""
+
+import threading
+import time
+from typing import Callable, Dict, Iterable, List, NamedTuple, Optional
+
+from myvnc.utils.log_manager import get_logger
+
+DEFAULT_INTERVAL = 60.0
+DEFAULT_PREFERRED_HOSTS = 3
+DEFAULT_SESSION_WEIGHT = 0.25
+DEFAULT_AVOID_SCORE = 1.5
+
+# Refresh intervals after which the table is too old to place by
+MAX_AGE = 3
+
+
+class HostLoad(NamedTuple):
+    """One host as the scheduler reports it"""
+    host: str
+    available: bool
+    cpu: Optional[float]         # utilisation, 1.0 = every CPU busy
+    mem_used: Optional[float]    # share of memory in use
+    groups: frozenset = frozenset()  # queues/partitions the host is known to serve
+
+
+def short_name(host: str) -> str:
+    return host.split('.')[0] if host else ''
+
+
+def parse_size_mb(value: str) -> Optional[float]:
+    """A memory figure as the scheduler prints it (512M, 120G, 1.5T, plain MB) in MB"""
+    value = (value or '').strip().upper()
+    if not value or value == '-':
+        return None
+    factor = {'K': 1 / 1024, 'M': 1, 'G': 1024, 'T': 1024 * 1024}.get(value[-1])
+    try:
+        return float(value[:-1]) * factor if factor else float(value)
+    except ValueError:
+        return None
+
+
+class HostLoadTable:
+    """Host load and session counts, refreshed in the background"""
+
+    def __init__(self, fetch_hosts: Callable[[], List[HostLoad]], fetch_sessions: Callable[[], List[Dict]],
+                 interval: float = DEFAULT_INTERVAL, preferred_hosts: int = DEFAULT_PREFERRED_HOSTS,
+                 session_weight: float = DEFAULT_SESSION_WEIGHT, avoid_score: float = DEFAULT_AVOID_SCORE,
+                 queue_hosts: Optional[Dict[str, Iterable[str]]] = None):
+        """
+        Args:
+            fetch_hosts: Returns the load of every host; raises on failure
+            fetch_sessions: Returns all users' myvnc jobs (dicts with
+                'status', 'host' and 'queue')
+            interval: Seconds between refreshes
+            preferred_hosts: Hosts named in an LSF preference list
+            session_weight: Score added per myvnc session on a host
+            avoid_score: Score from which a SLURM node is excluded
+            queue_hosts: Hosts known to serve each queue, in addition to
+                those seen running its sessions
+        """
+        self.fetch_hosts = fetch_hosts
+        self.fetch_sessions = fetch_sessions
+        self.interval = interval
+        self.preferred_hosts = preferred_hosts
+        self.session_weight = session_weight
+        self.avoid_score = avoid_score
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        self._hosts: Dict[str, HostLoad] = {}
+        self._sessions: Dict[str, int] = {}
+        self._queue_hosts: Dict[str, set] = {queue: {short_name(h) for h in hosts}
+                                             for queue, hosts in (queue_hosts or {}).items()}
+        self._refreshed_at = 0.0
+        self._thread = None
+
+    def refresh(self):
+        """Read host load and sessions once; the previous table stays on failure"""
+        hosts = {short_name(h.host): h for h in self.fetch_hosts()}
+        sessions = {}
+        queue_hosts = {}
+        for job in self.fetch_sessions() or []:
+            host = short_name(job.get('host') or '')
+            if not host or job.get('status') != 'RUN':
+                continue
+            sessions[host] = sessions.get(host, 0) + 1
+            if job.get('queue'):
+                queue_hosts.setdefault(job['queue'], set()).add(host)
+        with self._lock:
+            self._hosts = hosts
+            self._sessions = sessions
+            for queue, seen in queue_hosts.items():
+                self._queue_hosts.setdefault(queue, set()).update(seen)
+            self._refreshed_at = time.monotonic()
+
+    def _refresh_loop(self):
+        while True:
+            started = time.monotonic()
+            try:
+                self.refresh()
+            except Exception as e:
+                self.logger.warning(f"Host load refresh failed: {e}")
+            time.sleep(max(1.0, self.interval - (time.monotonic() - started)))
+
+    def _current(self) -> Optional[Dict[str, HostLoad]]:
+        """The table, starting the refresh thread on first use; None if it is empty or too old"""
+        with self._lock:
+            if self._thread is None:
+                self._thread = threading.Thread(target=self._refresh_loop, name='host-load', daemon=True)
+                self._thread.start()
+            if not self._hosts or time.monotonic() - self._refreshed_at > self.interval * MAX_AGE:
+                return None
+            return self._hosts
+
+    def score(self, host: HostLoad) -> float:
+        with self._lock:
+            sessions = self._sessions.get(short_name(host.host), 0)
+        return (host.cpu or 0.0) + (host.mem_used or 0.0) + self.session_weight * sessions
+
+    def _members(self, hosts: Dict[str, HostLoad], group: str) -> List[HostLoad]:
+        with self._lock:
+            known = set(self._queue_hosts.get(group, ()))
+        return [h for name, h in hosts.items() if group in h.groups or name in known]
+
+    def preferred(self, queue: str) -> List[str]:
+        """The least loaded available hosts of queue, best first"""
+        hosts = self._current()
+        if not hosts or not queue:
+            return []
+        members = [h for h in self._members(hosts, queue) if h.available]
+        members.sort(key=lambda h: (self.score(h), h.host))
+        return [h.host for h in members[:self.preferred_hosts]]
+
+    def overloaded(self, partition: str) -> List[str]:
+        """The partition's nodes to keep sessions off, never all of them"""
+        hosts = self._current()
+        if not hosts or not partition:
+            return []
+        members = self._members(hosts, partition)
+        avoid = [h for h in members if not h.available or self.score(h) >= self.avoid_score]
+        if len(avoid) >= len(members):
+            return []
+        return sorted(h.host for h in avoid)
+
+    def lsf_hint(self, queue: str) -> List[str]:
+        """bsub arguments preferring the least loaded hosts of queue, or [] for no hint"""
+        preferred = self.preferred(queue)
+        if not preferred:
+            return []
+        levels = [f"{host}+{len(preferred) - i}" for i, host in enumerate(preferred)]
+        return ['-m', ' '.join(levels + ['others'])]
+
+    def slurm_hint(self, partition: str) -> List[str]:
+        """sbatch arguments excluding the partition's overloaded nodes, or [] for no hint"""
+        avoid = self.overloaded(partition)
+        return ['--exclude', ','.join(avoid)] if avoid else []
+
+
+def create_host_load(server_config: Dict, fetch_hosts: Callable[[], List[HostLoad]],
+                     fetch_sessions: Callable[[], List[Dict]]) -> Optional[HostLoadTable]:
+    """
+    Return a HostLoadTable for the manager when 'host_load' is enabled in
+    server_config.json, otherwise None
+    """
+    load_config = server_config.get('host_load') or {}
+    if not load_config.get('enabled', False):
+        return None
+    return HostLoadTable(fetch_hosts, fetch_sessions,
+                         interval=float(load_config.get('interval', DEFAULT_INTERVAL)),
+                         preferred_hosts=int(load_config.get('preferred_hosts', DEFAULT_PREFERRED_HOSTS)),
+                         session_weight=float(load_config.get('session_weight', DEFAULT_SESSION_WEIGHT)),
+                         avoid_score=float(load_config.get('avoid_score', DEFAULT_AVOID_SCORE)),
+                         queue_hosts=load_config.get('queue_hosts') or {})
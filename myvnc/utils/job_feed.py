@@ -0,0 +1,216 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Versioned job table for incremental session list updates
+
+The feed keeps the rows the web UI shows for every job in the shared job
+snapshot (see job_snapshot.py), each tagged with the version at which it
+last changed. A client sends the version it has and gets back only the jobs
+added or changed since then and the ids of the jobs that went away, instead
+of the whole listing. Waiting clients share one refresh per interval, and a
+snapshot invalidation after bsub/bkill wakes them right away.
+
+Only jobs that are new or changed in the snapshot are processed again
+(resource defaults, connection details), plus running VNC jobs that still
+have no port, so a display that shows up later is picked up too; those are
+retried with a backoff of up to MAX_DETAILS_RETRY seconds.
+
+Versions start at the feed's creation time in milliseconds, so a client
+holding a version from before a server restart gets a full listing.
+"""
+
+import threading
+import time
+from collections import OrderedDict
+from typing import Callable, Dict, List, Optional
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils.job_snapshot import JobSnapshot
+
+# Default seconds between refreshes while clients are waiting
+DEFAULT_INTERVAL = 10.0
+
+# Removed job ids remembered for deltas; older clients get a full listing
+DEFAULT_HISTORY = 1000
+
+# Longest wait between connection details lookups for a job that has no port yet
+MAX_DETAILS_RETRY = 300.0
+
+
+class FeedUnavailable(Exception):
+    """The feed has no listing yet because the snapshot could not be taken"""
+
+
+def _needs_details(row: Dict) -> bool:
+    """Whether a row is a running VNC session the UI cannot connect to yet"""
+    return row.get('session_type') != 'tmux' and row.get('status') == 'RUN' and row.get('port') is None
+
+
+class JobFeed:
+    """Versioned view of the job snapshot that serves changes since a version"""
+
+    def __init__(self, snapshot: JobSnapshot, interval: float = DEFAULT_INTERVAL, history: int = DEFAULT_HISTORY):
+        """
+        Args:
+            snapshot: The manager's shared JobSnapshot
+            interval: Seconds between refreshes while clients are waiting
+            history: Removed job ids kept for deltas
+        """
+        self.snapshot = snapshot
+        self.interval = interval
+        self.history = history
+        self.logger = get_logger()
+        self._cond = threading.Condition()
+        self.version = int(time.time() * 1000)
+        # Deltas are known for versions from here on
+        self._floor = self.version
+        # job_id -> (version, snapshot job, row sent to clients)
+        self._rows: Dict[str, tuple] = {}
+        # job_id -> (retry delay, monotonic time of the next details lookup)
+        self._details_retry: Dict[str, tuple] = {}
+        # job_id -> (version, user) of removed jobs, oldest first
+        self._removed = OrderedDict()
+        self._loaded = False
+        self._error = None
+        self._refreshed_at = None
+        self._refreshing = False
+        snapshot.add_invalidate_listener(self._on_invalidate)
+
+    def _on_invalidate(self):
+        with self._cond:
+            self._refreshed_at = None
+            self._cond.notify_all()
+
+    def _refresh_due_in(self) -> float:
+        if self._refreshed_at is None:
+            return 0.0
+        return self._refreshed_at + self.interval - time.monotonic()
+
+    def _changes(self, since: Optional[int], user: Optional[str]) -> Dict:
+        full = since is None or since < self._floor or since > self.version
+        jobs = [dict(row) for version, _, row in self._rows.values()
+                if (full or version > since) and (user is None or row.get('user') == user)]
+        removed = [] if full else [job_id for job_id, (version, owner) in self._removed.items()
+                                   if version > since and (user is None or owner == user)]
+        return {'version': self.version, 'full': full, 'jobs': jobs, 'removed': removed}
+
+    def wait(self, since: Optional[int], timeout: float, process: Callable[[List[Dict]], List[Dict]],
+             user: Optional[str] = None) -> Dict:
+        """
+        Return the changes since a version as soon as there are any, or the
+        (empty) changes after timeout seconds
+
+        Args:
+            since: Version the client has, or None for a full listing
+            timeout: Seconds to wait for changes
+            process: Turns copies of new or changed snapshot jobs into the
+                rows sent to clients; called by whichever waiter refreshes
+            user: Only report this user's jobs, or everyone's if None
+
+        Returns:
+            {'version': int, 'full': bool, 'jobs': [row, ...], 'removed': [job_id, ...]};
+            with 'full' set, 'jobs' is the complete listing and replaces what the client has
+
+        Raises:
+            FeedUnavailable: If no listing could be taken yet
+        """
+        deadline = time.monotonic() + timeout
+        while True:
+            with self._cond:
+                remaining = deadline - time.monotonic()
+                if self._loaded:
+                    result = self._changes(since, user)
+                    if result['full'] or result['jobs'] or result['removed'] or remaining <= 0:
+                        return result
+                elif self._error is not None or remaining <= 0:
+                    raise FeedUnavailable(f"Job listing unavailable: {self._error or 'timed out'}")
+                due_in = self._refresh_due_in()
+                if self._refreshing or due_in > 0:
+                    self._cond.wait(remaining if self._refreshing else min(remaining, due_in))
+                    continue
+                self._refreshing = True
+            self._refresh(process)
+
+    def _refresh(self, process: Callable[[List[Dict]], List[Dict]]):
+        """Take the current snapshot and record what changed in it"""
+        started = time.monotonic()
+        stale = []
+        rows = []
+        error = None
+        try:
+            jobs = self.snapshot.get()
+            with self._cond:
+                known = dict(self._rows)
+                retries = dict(self._details_retry)
+            for job in jobs:
+                entry = known.get(job.get('job_id'))
+                if entry is None or entry[1] != job:
+                    stale.append(job)
+                elif _needs_details(entry[2]) and started >= retries.get(job['job_id'], (0, 0))[1]:
+                    stale.append(job)
+            if stale:
+                rows = process([dict(job) for job in stale])
+        except Exception as e:
+            error = e
+            self.logger.warning(f"Job feed refresh failed: {e}")
+
+        with self._cond:
+            self._refreshing = False
+            self._refreshed_at = started
+            if error is not None:
+                if not self._loaded:
+                    self._error = error
+                self._cond.notify_all()
+                return
+
+            version = self.version + 1
+            changed = False
+            snapshot_jobs = {job['job_id']: job for job in stale if 'job_id' in job}
+            for row in rows:
+                job_id = row.get('job_id')
+                if job_id not in snapshot_jobs:
+                    continue
+                entry = self._rows.get(job_id)
+                if entry is None or entry[2] != row:
+                    self._rows[job_id] = (version, snapshot_jobs[job_id], row)
+                    self._removed.pop(job_id, None)
+                    changed = True
+                else:
+                    self._rows[job_id] = (entry[0], snapshot_jobs[job_id], row)
+                if _needs_details(row):
+                    delay = self._details_retry.get(job_id, (self.interval / 2, 0))[0] * 2
+                    delay = min(delay, max(MAX_DETAILS_RETRY, self.interval))
+                    self._details_retry[job_id] = (delay, started + delay)
+                else:
+                    self._details_retry.pop(job_id, None)
+
+            current = {job.get('job_id') for job in jobs}
+            for job_id in [job_id for job_id in self._rows if job_id not in current]:
+                self._removed[job_id] = (version, self._rows.pop(job_id)[2].get('user'))
+                self._details_retry.pop(job_id, None)
+                changed = True
+            while len(self._removed) > self.history:
+                _, (removed_version, _) = self._removed.popitem(last=False)
+                self._floor = max(self._floor, removed_version)
+
+            if changed:
+                self.version = version
+                self.logger.debug(f"Job feed at version {version}: {len(self._rows)} jobs, "
+                                  f"{len(stale)} reprocessed in {time.monotonic() - started:.2f}s")
+            self._loaded = True
+            self._error = None
+            self._cond.notify_all()
+
+
+def create_job_feed(server_config: Dict, snapshot: Optional[JobSnapshot]) -> Optional[JobFeed]:
+    """
+    Return a JobFeed over the manager's snapshot when 'job_updates' is
+    enabled in server_config.json, otherwise None (the feed needs
+    'job_snapshot' enabled too)
+    """
+    updates_config = server_config.get('job_updates') or {}
+    if not updates_config.get('enabled', False) or snapshot is None:
+        return None
+    return JobFeed(snapshot,
+                   interval=float(updates_config.get('interval', snapshot.ttl)),
+                   history=int(updates_config.get('history', DEFAULT_HISTORY)))
@@ -0,0 +1,144 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Shared cluster-wide snapshot of myvnc jobs
+
+Instead of every sessions poll running its own bjobs/squeue, one listing of
+all users' myvnc jobs is taken per refresh period and every request is
+served a filtered view of it. Concurrent requests for an expired snapshot
+wait for a single refresh instead of each starting one (single flight), and
+the managers invalidate the snapshot after bsub/bkill (sbatch/scancel) so
+users see their own changes on the next poll.
+"""
+
+import threading
+import time
+from typing import Callable, Dict, List, Optional
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils import metrics
+
+DEFAULT_TTL = 10.0
+
+
+class JobSnapshot:
+    """Single-flight, time-bounded cache of one cluster-wide job listing"""
+
+    def __init__(self, fetch: Callable[[], List[Dict]], ttl: float = DEFAULT_TTL):
+        """
+        Args:
+            fetch: Lists all users' jobs; raises on failure (an empty list
+                means there are no jobs)
+            ttl: Seconds a snapshot is served before the next refresh
+        """
+        self.fetch = fetch
+        self.ttl = ttl
+        self.logger = get_logger()
+        self._cond = threading.Condition()
+        self._jobs = None
+        self._fetched_at = 0.0
+        self._fresh = False
+        self._refreshing = False
+        self._flights = 0
+        self._flight_error = None
+        # Bumped by invalidate(); a refresh that started before the bump is
+        # stored but not treated as fresh
+        self._generation = 0
+        self._invalidate_listeners = []
+        # The snapshot of the current manager is the one /metrics reports on
+        metrics.snapshot_age.set_function(self.age)
+
+    def age(self) -> Optional[float]:
+        """Seconds since the snapshot being served was taken, or None before the first one"""
+        if self._jobs is None:
+            return None
+        return time.monotonic() - self._fetched_at
+
+    def _is_fresh(self) -> bool:
+        return self._fresh and time.monotonic() - self._fetched_at < self.ttl
+
+    def add_invalidate_listener(self, callback: Callable[[], None]):
+        """Call callback() after every invalidate(), e.g. to push the change to waiting clients"""
+        self._invalidate_listeners.append(callback)
+
+    def invalidate(self):
+        """Make the next get() take a new snapshot, e.g. after bsub/bkill"""
+        with self._cond:
+            self._generation += 1
+            self._fresh = False
+        for callback in self._invalidate_listeners:
+            callback()
+
+    def get(self) -> List[Dict]:
+        """
+        Return the current snapshot, refreshing it first if it expired
+
+        The returned list and its job dicts are shared between callers and
+        must not be modified; use view() for per-request copies.
+
+        Raises:
+            Exception: Whatever fetch raised, if there is no earlier snapshot to fall back on
+        """
+        with self._cond:
+            shared = False
+            while not self._is_fresh():
+                if not self._refreshing:
+                    self._refreshing = True
+                    generation = self._generation
+                    break
+                # Someone else is already listing jobs; share their result
+                shared = True
+                flight = self._flights
+                while self._refreshing and self._flights == flight:
+                    self._cond.wait()
+                if self._flight_error is not None:
+                    metrics.snapshot_reads.inc(result='stale')
+                    return self._fallback(self._flight_error)
+            else:
+                metrics.snapshot_reads.inc(result='shared' if shared else 'hit')
+                return self._jobs
+
+        jobs, error = None, None
+        started = time.monotonic()
+        try:
+            with metrics.snapshot_refresh_seconds.time():
+                jobs = self.fetch()
+        except Exception as e:
+            error = e
+        metrics.snapshot_reads.inc(result='refresh' if error is None else 'stale')
+
+        with self._cond:
+            self._refreshing = False
+            self._flights += 1
+            self._flight_error = error
+            if error is None:
+                self._jobs = jobs
+                self._fetched_at = started
+                self._fresh = generation == self._generation
+                self.logger.debug(f"Job snapshot refreshed: {len(jobs)} jobs in {time.monotonic() - started:.2f}s")
+            self._cond.notify_all()
+            if error is not None:
+                self.logger.warning(f"Job snapshot refresh failed: {error}")
+                return self._fallback(error)
+            return jobs
+
+    def _fallback(self, error: Exception) -> List[Dict]:
+        """Serve the previous snapshot after a failed refresh; the next request retries it"""
+        if self._jobs is None:
+            raise error
+        return self._jobs
+
+    def view(self, user: Optional[str] = None) -> List[Dict]:
+        """Copies of the snapshot's jobs, only those owned by user unless user is None"""
+        return [dict(job) for job in self.get() if user is None or job.get('user') == user]
+
+
+def create_job_snapshot(server_config: Dict, fetch: Callable[[], List[Dict]]) -> Optional[JobSnapshot]:
+    """
+    Return a JobSnapshot for the manager when 'job_snapshot' is enabled in
+    server_config.json, otherwise None
+    """
+    snapshot_config = server_config.get('job_snapshot') or {}
+    if not snapshot_config.get('enabled', False):
+        return None
+    return JobSnapshot(fetch, ttl=float(snapshot_config.get('ttl', DEFAULT_TTL)))
@@ -0,0 +1,169 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Row tokenizer for delimited bjobs/squeue listings
+
+The native tokenizer (src/job_table.c, built as src/libjobtable.so) splits a
+chunk of output into rows in one pass and hands them back normalized, so a
+whole chunk becomes rows with two str.split() calls. This module loads it
+with ctypes and falls back to an equivalent pure Python split when the
+library is not available.
+"""
+
+import ctypes
+import os
+import threading
+from typing import Iterable, Iterator, List, Optional, Tuple
+
+from myvnc.utils.log_manager import get_logger
+
+LIBRARY_NAME = 'libjobtable.so'
+
+# Must match JOB_TABLE_MAX_COLS in src/job_table.c
+MAX_COLUMNS = 32
+
+# Must match JOB_TABLE_FIELD_SEP, which joins the columns of a native row
+FIELD_SEPARATOR = '\x1f'
+
+# Rows tokenized per native call
+ROWS_PER_CALL = 1024
+
+
+_library = None
+_library_lock = threading.Lock()
+
+
+def load_library(library_path: str = None, search_dirs: Iterable[str] = ()) -> Optional[str]:
+    """
+    Load the native tokenizer once per process
+
+    Args:
+        library_path: Explicit path (server_config.json 'job_table_library')
+        search_dirs: Directories to look for libjobtable.so in, after the
+            repository's src/ build directory
+
+    Returns:
+        Path of the loaded library, or None if the Python fallback is used
+    """
+    global _library
+    with _library_lock:
+        if _library is not None:
+            return _library._name
+
+        repo_src = os.path.join(os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))), 'src')
+        if library_path:
+            candidates = [library_path]
+        else:
+            candidates = [os.path.join(d, LIBRARY_NAME) for d in [repo_src] + list(search_dirs) if d]
+
+        logger = get_logger()
+        for candidate in candidates:
+            if not os.path.exists(candidate):
+                continue
+            try:
+                library = ctypes.CDLL(candidate)
+                parse = library.job_table_parse
+                parse.restype = ctypes.c_int
+                parse.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_size_t, ctypes.c_int,
+                                  ctypes.c_char, ctypes.c_int, ctypes.c_int,
+                                  ctypes.c_char_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_int), ctypes.c_int,
+                                  ctypes.POINTER(ctypes.c_size_t), ctypes.POINTER(ctypes.c_size_t)]
+            except (OSError, AttributeError) as e:
+                logger.warning(f"Could not load job table parser {candidate}: {e}")
+                continue
+            _library = library
+            logger.info(f"Using native job table parser: {candidate}")
+            return candidate
+
+        logger.info("Native job table parser not found, parsing job listings in Python")
+        return None
+
+
+def _split_line(line: str, delimiter: str, ncols: int, greedy_col: int) -> Tuple[int, List[str]]:
+    """Python equivalent of parse_line() in src/job_table.c"""
+    parts = line.split(delimiter)
+    nfields = len(parts)
+    if greedy_col >= 0 and nfields > ncols:
+        ntail = ncols - 1 - greedy_col
+        tail = parts[nfields - ntail:] if ntail else []
+        return nfields, parts[:greedy_col] + [delimiter.join(parts[greedy_col:nfields - ntail])] + tail
+    if nfields < ncols:
+        parts.extend([''] * (ncols - nfields))
+    return nfields, parts[:ncols]
+
+
+def _python_rows(chunks: Iterable[bytes], delimiter: str, ncols: int,
+                 greedy_col: int) -> Iterator[Tuple[int, List[str]]]:
+    pending = b''
+    for chunk in chunks:
+        lines = (pending + chunk).split(b'\n')
+        pending = lines.pop()
+        for line in lines:
+            text = line.decode('utf-8', 'replace')
+            if text.strip():
+                yield _split_line(text, delimiter, ncols, greedy_col)
+    text = pending.decode('utf-8', 'replace')
+    if text.strip():
+        yield _split_line(text, delimiter, ncols, greedy_col)
+
+
+def _native_rows(chunks: Iterable[bytes], delimiter: str, ncols: int,
+                 greedy_col: int) -> Iterator[Tuple[int, List[str]]]:
+    nfields = (ctypes.c_int * ROWS_PER_CALL)()
+    next_offset = ctypes.c_size_t(0)
+    out_used = ctypes.c_size_t(0)
+    delimiter_byte = delimiter.encode('utf-8')
+    out = None
+
+    def parse(data: bytes, final: int) -> Tuple[List[Tuple[int, List[str]]], bytes]:
+        """Tokenize the complete lines of data; returns the rows and the unparsed rest"""
+        nonlocal out
+        # Room for every byte of data plus a separator per column of each row
+        out_len = len(data) + ROWS_PER_CALL * ncols
+        if out is None or len(out) < out_len:
+            out = ctypes.create_string_buffer(out_len)
+        rows, start = [], 0
+        while True:
+            count = _library.job_table_parse(data, len(data), start, final, delimiter_byte, ncols, greedy_col,
+                                             out, len(out), nfields, ROWS_PER_CALL,
+                                             ctypes.byref(next_offset), ctypes.byref(out_used))
+            if count < 0:
+                raise ValueError(f"job_table_parse rejected {ncols} columns")
+            if count:
+                text = ctypes.string_at(out, out_used.value - 1).decode('utf-8', 'replace')
+                rows.extend(zip(nfields[:count], (line.split(FIELD_SEPARATOR) for line in text.split('\n'))))
+            start = next_offset.value
+            if count < ROWS_PER_CALL:
+                return rows, data[start:]
+
+    pending = b''
+    for chunk in chunks:
+        rows, pending = parse(pending + chunk if pending else chunk, 0)
+        yield from rows
+    if pending:
+        rows, _ = parse(pending, 1)
+        yield from rows
+
+
+def iter_rows(chunks: Iterable[bytes], delimiter: str, ncols: int,
+              greedy_col: int = -1) -> Iterator[Tuple[int, List[str]]]:
+    """
+    Tokenize delimited listing output into rows as it arrives
+
+    Args:
+        chunks: Output as bytes chunks, split anywhere
+        delimiter: Single-character field delimiter
+        ncols: Number of columns in each returned row
+        greedy_col: Column that absorbs any surplus fields (with their
+            delimiters), for a free-text column such as bjobs' command
+
+    Yields:
+        (nfields, columns) per non-blank line, where nfields is the number of
+        fields the line split into, as len(line.split(delimiter)), and
+        columns is a list of ncols strings ('' where the line was short)
+    """
+    if not 0 < ncols <= MAX_COLUMNS or greedy_col >= ncols or len(delimiter.encode('utf-8')) != 1:
+        raise ValueError(f"Unsupported job table layout: {ncols} columns, delimiter {delimiter!r}")
+    if _library is not None:
+        return _native_rows(chunks, delimiter, ncols, greedy_col)
+    return _python_rows(chunks, delimiter, ncols, greedy_col)
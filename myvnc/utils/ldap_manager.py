@@ -10,6 +10,7 @@ import uuid
 import time
 import json
 import logging
+import threading
 import traceback
 from pathlib import Path
 
@@ -55,6 +56,106 @@ except ImportError:
 
 # Import the central load_server_config function from the new module
 from myvnc.utils.config_loader import load_server_config
+from myvnc.utils.directory_cache import get_directory_cache
+
+# Open connections kept between binds, and seconds one may sit idle before it
+# is closed instead of reused (AD drops idle connections after 900 seconds)
+DEFAULT_POOL_SIZE = 4
+DEFAULT_POOL_IDLE = 300
+
+
+class StaleLDAPConnection(Exception):
+    """A pooled connection turned out to be closed; never raised for a rejected bind"""
+
+
+def ldap3_rebind(conn, user, password):
+    """
+    conn.rebind() as user. ldap3 reports a connection the server has closed
+    as LDAPBindError (a wrong password just returns False), so that error on
+    a connection that is no longer bound raises StaleLDAPConnection instead.
+    """
+    try:
+        return conn.rebind(user=user, password=password, authentication=ldap3.SIMPLE)
+    except ldap3.core.exceptions.LDAPBindError as e:
+        if conn.closed or not conn.bound:
+            raise StaleLDAPConnection(str(e)) from e
+        raise
+
+
+class LDAPConnectionPool:
+    """
+    Open LDAP connections reused across logins and lookups, so a login costs
+    a bind instead of a TCP (and TLS) handshake plus a bind. Every use binds
+    first, so what a connection was bound as before does not matter.
+    """
+
+    def __init__(self, connect, connection_errors, size=DEFAULT_POOL_SIZE, idle_timeout=DEFAULT_POOL_IDLE):
+        """
+        Args:
+            connect: Returns a new open, unbound connection
+            connection_errors: Exceptions meaning the connection itself is gone
+                (StaleLDAPConnection is always one)
+            size: Idle connections kept
+            idle_timeout: Seconds an idle connection is kept
+        """
+        self._connect = connect
+        self._connection_errors = tuple(connection_errors) + (StaleLDAPConnection,)
+        self.size = size
+        self.idle_timeout = idle_timeout
+        self._lock = threading.Lock()
+        # (connection, monotonic time it was given back), most recent last
+        self._idle = []
+
+    def run(self, operation):
+        """
+        Return operation(connection) run on a pooled connection. A reused
+        connection the server has closed in the meantime is replaced and the
+        operation retried once; on any other error the connection is closed.
+        """
+        conn = None
+        stale = []
+        now = time.monotonic()
+        with self._lock:
+            while self._idle:
+                candidate, returned_at = self._idle.pop()
+                if now - returned_at < self.idle_timeout:
+                    conn = candidate
+                    break
+                stale.append(candidate)
+        for candidate in stale:
+            self._close(candidate)
+        reused = conn is not None
+        if conn is None:
+            conn = self._connect()
+        try:
+            result = operation(conn)
+        except self._connection_errors:
+            self._close(conn)
+            if not reused:
+                raise
+            conn = self._connect()
+            try:
+                result = operation(conn)
+            except BaseException:
+                self._close(conn)
+                raise
+        except BaseException:
+            self._close(conn)
+            raise
+        with self._lock:
+            if len(self._idle) < self.size:
+                self._idle.append((conn, time.monotonic()))
+                conn = None
+        if conn is not None:
+            self._close(conn)
+        return result
+
+    @staticmethod
+    def _close(conn):
+        try:
+            conn.unbind()
+        except Exception:
+            pass
 
 class LDAPManager:
     """Manages LDAP authentication for VNC Manager"""
@@ -103,6 +204,27 @@ class LDAPManager:
         
         # Session tracking
         self.sessions = {}
+
+        # Connections reused across logins, and the attribute/group lookups
+        # cached between them (refreshed in the background when a service
+        # account is configured to search with)
+        self.pool = None
+        if LDAP_AVAILABLE:
+            if LDAP_TYPE == "ldap3":
+                # No schema read per connection; nothing here uses it
+                ldap3_server = ldap3.Server(self.ldap_server, get_info=ldap3.NONE)
+                connect = lambda: ldap3.Connection(ldap3_server, read_only=True)
+                connection_errors = (ldap3.core.exceptions.LDAPCommunicationError,
+                                     ldap3.core.exceptions.LDAPSessionTerminatedByServerError)
+            else:
+                connect = self._connect_python_ldap
+                connection_errors = (ldap.SERVER_DOWN,)
+            self.pool = LDAPConnectionPool(connect, connection_errors,
+                                           size=int(self.config.get('ldap_pool_size', DEFAULT_POOL_SIZE)),
+                                           idle_timeout=float(self.config.get('ldap_pool_idle', DEFAULT_POOL_IDLE)))
+        self.user_cache = get_directory_cache(self.server_config, 'ldap_users')
+        if self.user_cache is not None:
+            self.user_cache.set_refresher(self._refresh_user_info if self.ldap_admin_binddn else None)
         
 # _load_server_config method removed - using central load_server_config function instead
     
@@ -149,6 +271,11 @@ class LDAPManager:
             self.logger.error(error_msg)
             return False, error_msg, None
         
+        # An empty password is an unauthenticated bind, which most servers accept
+        if not password:
+            self.logger.warning(f"Rejected empty password for {username}")
+            return False, "Invalid username or password", None
+        
         # Determine which LDAP library to use
         if LDAP_TYPE == "ldap3":
             success, message, user_info = self._authenticate_ldap3(username, password)
@@ -193,27 +320,25 @@ class LDAPManager:
                 
             self.logger.info(f"Attempting to authenticate user with ldap3: {user_dn}")
             
-            # Initialize LDAP connection
-            conn = ldap3.Connection(
-                ldap3.Server(self.ldap_server, get_info=ldap3.ALL),
-                user=user_dn,
-                password=password,
-                authentication=ldap3.SIMPLE,
-                read_only=True
-            )
-            
-            # Try to bind
-            if not conn.bind():
-                self.logger.warning(f"LDAP authentication failed for {username}: {conn.result}")
-                return False, "Invalid username or password", None
+            def login(conn):
+                # Try to bind
+                if not ldap3_rebind(conn, user_dn, password):
+                    self.logger.warning(f"LDAP authentication failed for {username}: {conn.result}")
+                    return False, None
                 
-            self.logger.info(f"LDAP authentication successful for {username}")
-            
-            # Get user information
-            user_info = self._get_user_info_ldap3(conn, username, user_dn)
-            
-            # Unbind and close connection
-            conn.unbind()
+                self.logger.info(f"LDAP authentication successful for {username}")
+                
+                # Get user information
+                user_info = self.user_cache.get(username) if self.user_cache else None
+                if user_info is None:
+                    user_info = self._get_user_info_ldap3(conn, username, user_dn)
+                    if user_info and self.user_cache:
+                        self.user_cache.put(username, user_info)
+                return True, user_info
+            
+            bound, user_info = self.pool.run(login)
+            if not bound:
+                return False, "Invalid username or password", None
             
             if not user_info:
                 self.logger.warning(f"User found but unable to retrieve details for {username}")
@@ -228,6 +353,9 @@ class LDAPManager:
                 
             return True, "Authentication successful", user_info
             
+        except StaleLDAPConnection as e:
+            self.logger.error(f"LDAP server closed the connection authenticating {username}: {str(e)}")
+            return False, "LDAP server is not available", None
         except ldap3.core.exceptions.LDAPBindError as e:
             self.logger.warning(f"LDAP bind error for {username}: {str(e)}")
             return False, "Invalid username or password", None
@@ -319,26 +447,26 @@ class LDAPManager:
             or None if authentication failed
         """
         try:
-            # Initialize LDAP connection
-            self.logger.info(f"Connecting to LDAP server at {self.ldap_server}")
-            conn = ldap.initialize(self.ldap_server)
-            conn.set_option(ldap.OPT_REFERRALS, 0)
-            
             # User bind DN format - supports both UPN (user@domain) and DN (cn=user,dc=domain,dc=com) formats
             if '@' not in username and ',' not in username:
                 user_dn = f"{username}@{self.ldap_domain}"
             else:
                 user_dn = username
-                
-            # Try to bind with user credentials
-            self.logger.info(f"Attempting to authenticate user: {user_dn}")
-            conn.simple_bind_s(user_dn, password)
             
-            # Get user info with user's account or admin account if available
-            user_info = self._get_user_info_python_ldap(conn, username, user_dn)
+            def login(conn):
+                # Try to bind with user credentials
+                self.logger.info(f"Attempting to authenticate user: {user_dn}")
+                conn.simple_bind_s(user_dn, password)
+                
+                # Get user info with user's account
+                user_info = self.user_cache.get(username) if self.user_cache else None
+                if user_info is None:
+                    user_info = self._get_user_info_python_ldap(conn, username, user_dn)
+                    if user_info and self.user_cache:
+                        self.user_cache.put(username, user_info)
+                return user_info
             
-            # Unbind and close connection
-            conn.unbind()
+            user_info = self.pool.run(login)
             
             if not user_info:
                 return False, "User found but unable to retrieve details", None
@@ -359,6 +487,28 @@ class LDAPManager:
             self.logger.error(traceback.format_exc())
             return False, f"Authentication error: {str(e)}", None
     
+    def _connect_python_ldap(self):
+        """Return a new python-ldap connection (it connects on the first bind)"""
+        self.logger.info(f"Connecting to LDAP server at {self.ldap_server}")
+        conn = ldap.initialize(self.ldap_server)
+        conn.set_option(ldap.OPT_REFERRALS, 0)
+        return conn
+    
+    def _refresh_user_info(self, username, user_info):
+        """Look a cached user up again as the admin bind DN (directory cache refresher thread)"""
+        user_dn = username if '@' in username or ',' in username else f"{username}@{self.ldap_domain}"
+        
+        def lookup(conn):
+            if LDAP_TYPE == "ldap3":
+                if not ldap3_rebind(conn, self.ldap_admin_binddn, self.ldap_admin_password):
+                    self.logger.warning(f"LDAP admin bind failed: {conn.result}")
+                    return None
+                return self._get_user_info_ldap3(conn, username, user_dn)
+            conn.simple_bind_s(self.ldap_admin_binddn, self.ldap_admin_password)
+            return self._get_user_info_python_ldap(conn, username, user_dn)
+        
+        return self.pool.run(lookup)
+    
     def _get_user_info_python_ldap(self, conn, username, user_dn):
         """Get user information using python-ldap library"""
         try:
@@ -8,7 +8,14 @@ import subprocess
 import datetime
 from pathlib import Path
 import json
+import re
 import shlex
+import threading
+import time
+from collections import deque
+
+from myvnc.utils.tracing import tracer
+from myvnc.utils import metrics
 
 # Global logger instance
 logger = None
@@ -22,11 +29,164 @@ original_stderr = sys.stderr
 # Flag to track if subprocess handler has been registered
 subprocess_handler_registered = False
 
+# Log lines queued for the writer thread before low-priority lines are sampled and then dropped
+DEFAULT_BUFFER_LINES = 10000
+# Lines written with one write() call
+DEFAULT_BATCH_LINES = 512
+# Past half the buffer, one DEBUG/INFO line in this many is kept
+DEFAULT_SAMPLE_EVERY = 10
+# Seconds between notes in the file about dropped lines while the writer is behind
+DROP_REPORT_INTERVAL = 5.0
+
+# Credentials commands print (scontrol token); their values never reach the log
+SECRET_PATTERN = re.compile(r'(SLURM_JWT=)\S+')
+
+
+def redact(text: str) -> str:
+    """text with the values of SECRET_PATTERN credentials masked"""
+    return SECRET_PATTERN.sub(r'\1<redacted>', text) if text else text
+
+
+class AsyncLogWriter:
+    """
+    Bounded ring buffer of log text in front of a file, written by its own thread
+
+    Request threads only format their record and append it to the buffer, so
+    a slow log directory (NFS) delays the writer thread and not the request.
+    The writer takes up to batch_lines entries at a time and writes them with
+    one write() and flush.
+
+    Under overload the buffer sheds the least useful lines first: past half
+    its capacity only one DEBUG/INFO line in sample_every is kept, and when
+    full a new DEBUG/INFO line is dropped while a WARNING or worse replaces
+    the oldest line. Dropped lines are counted and reported in the file once
+    the writer catches up.
+    """
+
+    def __init__(self, path: str, buffer_lines: int = DEFAULT_BUFFER_LINES,
+                 batch_lines: int = DEFAULT_BATCH_LINES, sample_every: int = DEFAULT_SAMPLE_EVERY):
+        self.path = path
+        self.buffer_lines = max(2, buffer_lines)
+        self.batch_lines = max(1, batch_lines)
+        self.sample_every = max(1, sample_every)
+        self._file = open(path, 'a', encoding='utf-8', errors='replace')
+        self._buffer = deque()
+        self._cond = threading.Condition()
+        self._sampled = 0
+        self._dropped = 0
+        self._closed = False
+        self._thread = threading.Thread(target=self._run, name='log-writer', daemon=True)
+        self._thread.start()
+        atexit.register(self.close)
+        metrics.log_buffer_pending.set_function(self.pending, file=os.path.basename(path))
+
+    def put(self, text: str, level: int = logging.INFO):
+        """Queue text for the file; never blocks on the disk"""
+        with self._cond:
+            if self._closed:
+                return
+            if len(self._buffer) >= self.buffer_lines // 2 and level < logging.WARNING:
+                self._sampled += 1
+                if self._sampled % self.sample_every or len(self._buffer) >= self.buffer_lines:
+                    self._dropped += 1
+                    return
+            if len(self._buffer) >= self.buffer_lines:
+                self._buffer.popleft()
+                self._dropped += 1
+            self._buffer.append(text)
+            if len(self._buffer) == 1:
+                self._cond.notify()
+
+    def _run(self):
+        unreported = 0
+        reported_at = 0.0
+        while True:
+            with self._cond:
+                while not self._buffer and not self._closed:
+                    self._cond.wait()
+                if not self._buffer and self._closed:
+                    return
+                count = min(len(self._buffer), self.batch_lines)
+                batch = [self._buffer.popleft() for _ in range(count)]
+                dropped, self._dropped = self._dropped, 0
+                caught_up = not self._buffer
+            if dropped:
+                metrics.log_lines_dropped.inc(dropped)
+                unreported += dropped
+            # Noted once the writer catches up, and at most every DROP_REPORT_INTERVAL while it cannot
+            if unreported and (caught_up or time.monotonic() - reported_at >= DROP_REPORT_INTERVAL):
+                stamp = datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S')
+                batch.append(f"{stamp} - myvnc - WARNING - log_manager.py - {unreported} log lines dropped, "
+                             f"the log file could not keep up\n")
+                unreported = 0
+                reported_at = time.monotonic()
+            try:
+                self._file.write(''.join(batch))
+                self._file.flush()
+            except Exception as e:
+                # Nowhere left to log it to but the console
+                original_stderr.write(f"Error writing log file {self.path}: {e}\n")
+                time.sleep(1.0)
+
+    @property
+    def closed(self) -> bool:
+        return self._closed
+
+    def pending(self) -> int:
+        with self._cond:
+            return len(self._buffer)
+
+    def close(self, timeout: float = 5.0):
+        """Write out what is queued (waiting up to timeout seconds) and close the file"""
+        with self._cond:
+            if self._closed:
+                return
+            self._closed = True
+            self._cond.notify()
+        self._thread.join(timeout)
+        try:
+            self._file.close()
+        except Exception:
+            pass
+
+
+class AsyncFileHandler(logging.Handler):
+    """logging handler that formats records on the caller's thread and queues them on an AsyncLogWriter"""
+
+    def __init__(self, writer: AsyncLogWriter):
+        super().__init__()
+        self.writer = writer
+        self.baseFilename = writer.path
+
+    def emit(self, record):
+        try:
+            self.writer.put(self.format(record) + '\n', record.levelno)
+        except Exception:
+            self.handleError(record)
+
+
+# Writer of each log file, shared by its handlers and the stdout/stderr tee
+_async_writers = {}
+
+
+def _file_handler(path: str, buffer_config):
+    """A FileHandler for path, or an AsyncFileHandler when 'log_buffer' is enabled"""
+    if not buffer_config.get('enabled', False):
+        return logging.FileHandler(path)
+    writer = _async_writers.get(path)
+    if writer is None:
+        writer = AsyncLogWriter(path, buffer_lines=int(buffer_config.get('buffer_lines', DEFAULT_BUFFER_LINES)),
+                                batch_lines=int(buffer_config.get('batch_lines', DEFAULT_BATCH_LINES)),
+                                sample_every=int(buffer_config.get('sample_every', DEFAULT_SAMPLE_EVERY)))
+        _async_writers[path] = writer
+    return AsyncFileHandler(writer)
+
 class LoggingTee:
     """
     Class to capture stdout/stderr and redirect to both console and log file
     """
     def __init__(self, file_handler, original_stream):
+        # file_handler is an open file, or an AsyncLogWriter to queue the text on
         self.file_handler = file_handler
         self.original_stream = original_stream
     
@@ -35,6 +195,10 @@ class LoggingTee:
         self.original_stream.write(message)
         
         # Also write to log file
+        if isinstance(self.file_handler, AsyncLogWriter):
+            if message:
+                self.file_handler.put(message, logging.WARNING if self.original_stream is original_stderr else logging.INFO)
+            return
         self.file_handler.write(message)
         self.file_handler.flush()  # Ensure immediate writing to disk
     
@@ -50,7 +214,7 @@ class LoggingTee:
         
         try:
             # Check if the file handler is closed before flushing
-            if not self.file_handler.closed:
+            if not isinstance(self.file_handler, AsyncLogWriter) and not self.file_handler.closed:
                 self.file_handler.flush()
         except Exception as e:
             # Log other exceptions but don't crash
@@ -74,52 +238,63 @@ def register_subprocess_handler():
     old_popen = subprocess.Popen
     
     def new_popen(*args, **kwargs):
-        # Get the command that's about to be executed
-        cmd_str = ' '.join(str(arg) for arg in args[0]) if args and isinstance(args[0], (list, tuple)) else str(args[0])
-        
-        # Create a properly quoted command string for logging
-        quoted_cmd_str = cmd_str
-        if args and isinstance(args[0], (list, tuple)):
-            cmd_list = args[0]
-            # Simple and reliable quoting for logging
-            quoted_args = []
-            for arg in cmd_list:
-                arg_str = str(arg)
-                if ' ' in arg_str or ';' in arg_str or '=' in arg_str or '[' in arg_str or ']' in arg_str:
-                    quoted_args.append(f'"{arg_str}"')
-                else:
-                    quoted_args.append(arg_str)
-            quoted_cmd_str = ' '.join(quoted_args)
+        # Command lines and output are only logged in full for the runs
+        # tracing samples; errors are always logged
+        verbose = tracer.verbose(args[0] if args and isinstance(args[0], (list, tuple)) else str(args[0]))
         
-        # For logging, filter out sudo information if present
-        log_cmd_str = quoted_cmd_str
+        # setuid_runner --batch/--framed answer with binary frames; the managers log the decoded results
+        is_framed = bool(args and isinstance(args[0], (list, tuple)) and len(args[0]) > 1 and
+                         str(args[0][1]) in ('--batch', '--framed'))
         
-        # Check if the command begins with sudo and is modifying an LSF command
-        if log_cmd_str.startswith('sudo -u') and any(lsf_cmd in log_cmd_str for lsf_cmd in ['/bjobs', '/bsub', '/bkill']):
-            # Extract the LSF command part
-            try:
-                # Find the LSF command part after sudo, extract just the command name without path
-                parts = log_cmd_str.split()
-                for i, part in enumerate(parts):
-                    if '/bjobs' in part:
-                        log_cmd_str = 'bjobs ' + ' '.join(parts[i+1:])
-                        break
-                    elif '/bsub' in part:
-                        log_cmd_str = 'bsub ' + ' '.join(parts[i+1:])
-                        break
-                    elif '/bkill' in part:
-                        log_cmd_str = 'bkill ' + ' '.join(parts[i+1:])
-                        break
-            except:
-                # If parsing fails, keep the original command
-                pass
+        def describe_command():
+            """The command as logged: quoted, and with the sudo prefix of LSF commands removed"""
+            # Get the command that's about to be executed
+            cmd_str = ' '.join(str(arg) for arg in args[0]) if args and isinstance(args[0], (list, tuple)) else str(args[0])
             
-            # Log the original command for INFO level
-            if logger:
-                logger.debug(f"DEBUG: Full command: {cmd_str}")
-                logger.info(f"EXECUTING COMMAND: {log_cmd_str}")
-        else:
-            # Log the command that's about to be executed (no modification needed)
+            # Create a properly quoted command string for logging
+            quoted_cmd_str = cmd_str
+            if args and isinstance(args[0], (list, tuple)):
+                cmd_list = args[0]
+                # Simple and reliable quoting for logging
+                quoted_args = []
+                for arg in cmd_list:
+                    arg_str = str(arg)
+                    if ' ' in arg_str or ';' in arg_str or '=' in arg_str or '[' in arg_str or ']' in arg_str:
+                        quoted_args.append(f'"{arg_str}"')
+                    else:
+                        quoted_args.append(arg_str)
+                quoted_cmd_str = ' '.join(quoted_args)
+            
+            # For logging, filter out sudo information if present
+            log_cmd_str = quoted_cmd_str
+            
+            # Check if the command begins with sudo and is modifying an LSF command
+            if log_cmd_str.startswith('sudo -u') and any(lsf_cmd in log_cmd_str for lsf_cmd in ['/bjobs', '/bsub', '/bkill']):
+                # Extract the LSF command part
+                try:
+                    # Find the LSF command part after sudo, extract just the command name without path
+                    parts = log_cmd_str.split()
+                    for i, part in enumerate(parts):
+                        if '/bjobs' in part:
+                            log_cmd_str = 'bjobs ' + ' '.join(parts[i+1:])
+                            break
+                        elif '/bsub' in part:
+                            log_cmd_str = 'bsub ' + ' '.join(parts[i+1:])
+                            break
+                        elif '/bkill' in part:
+                            log_cmd_str = 'bkill ' + ' '.join(parts[i+1:])
+                            break
+                except:
+                    # If parsing fails, keep the original command
+                    pass
+                if logger and verbose:
+                    logger.debug(f"DEBUG: Full command: {cmd_str}")
+            return log_cmd_str
+        
+        log_cmd_str = None
+        if verbose:
+            log_cmd_str = describe_command()
+            # Log the command that's about to be executed
             if logger:
                 logger.info(f"EXECUTING COMMAND: {log_cmd_str}")
         
@@ -139,18 +314,19 @@ def register_subprocess_handler():
         def new_communicate(*args, **kwargs):
             output, error = old_communicate(*args, **kwargs)
             
-            if output:
+            if output and not is_framed and verbose:
                 try:
                     # If universal_newlines=True was used, output is already a string
                     if isinstance(output, str):
                         output_str = output
                     else:
                         output_str = output.decode('utf-8')
+                    output_str = redact(output_str)
                         
                     if logger:
-                        logger.info(f"COMMAND OUTPUT from '{log_cmd_str}':")
-                        for line in output_str.splitlines():
-                            logger.info(f"  {line}")
+                        # One record for all lines, so the output costs one handler call
+                        lines = ''.join(f"\n  {line}" for line in output_str.splitlines())
+                        logger.info(f"COMMAND OUTPUT from '{log_cmd_str}':{lines}")
                 except Exception as e:
                     logger.error(f"Error logging subprocess output: {str(e)}")
             
@@ -161,21 +337,21 @@ def register_subprocess_handler():
                         error_str = error
                     else:
                         error_str = error.decode('utf-8')
+                    error_str = redact(error_str)
+                    
+                    error_cmd_str = log_cmd_str or describe_command()
                         
                     if logger:
                         # Check if this is a benign "not found" error from bjobs
                         # "Job <myvnc_*> is not found" is a normal condition when user has no jobs
-                        is_job_not_found = 'is not found' in error_str and 'bjobs' in log_cmd_str.lower()
+                        is_job_not_found = 'is not found' in error_str and 'bjobs' in error_cmd_str.lower()
                         
+                        lines = ''.join(f"\n  {line}" for line in error_str.splitlines())
                         if is_job_not_found:
                             # Don't log job-not-found as ERROR, it's a normal condition
-                            logger.debug(f"COMMAND RESULT (no jobs found) from '{log_cmd_str}':")
-                            for line in error_str.splitlines():
-                                logger.debug(f"  {line}")
+                            logger.debug(f"COMMAND RESULT (no jobs found) from '{error_cmd_str}':{lines}")
                         else:
-                            logger.error(f"COMMAND ERROR from '{log_cmd_str}':")
-                            for line in error_str.splitlines():
-                                logger.error(f"  {line}")
+                            logger.error(f"COMMAND ERROR from '{error_cmd_str}':{lines}")
                 except Exception as e:
                     logger.error(f"Error logging subprocess error: {str(e)}")
                     
@@ -210,6 +386,10 @@ def setup_logging(config=None):
         # Default to DEBUG if debug flag not specified
         logger.setLevel(logging.DEBUG)
     
+    # How much of the command logging is kept
+    if config and isinstance(config, dict):
+        tracer.configure(config)
+    
     # Clear any existing handlers to avoid duplicate logging
     if logger.handlers:
         logger.handlers.clear()
@@ -264,16 +444,26 @@ def setup_logging(config=None):
         
         full_path = log_file.absolute()
         
+        # With 'log_buffer' enabled the file is written by a thread of its own
+        buffer_config = (config.get('log_buffer') if isinstance(config, dict) else None) or {}
+        
         # Only add file handler if one doesn't already exist for this log file
         if not has_file_handler:
-            file_handler = logging.FileHandler(str(full_path))
+            file_handler = _file_handler(str(full_path), buffer_config)
             file_handler.setFormatter(formatter)
             # Always log at DEBUG level to the file
             file_handler.setLevel(logging.DEBUG)
             logger.addHandler(file_handler)
         
             # Open the log file for stdout/stderr redirection
-            if log_file_handle is None or log_file_handle.closed:
+            if isinstance(file_handler, AsyncFileHandler):
+                if log_file_handle is None:
+                    log_file_handle = file_handler.writer
+                    if sys.stdout is original_stdout:
+                        sys.stdout = LoggingTee(log_file_handle, original_stdout)
+                    if sys.stderr is original_stderr:
+                        sys.stderr = LoggingTee(log_file_handle, original_stderr)
+            elif log_file_handle is None or isinstance(log_file_handle, AsyncLogWriter) or log_file_handle.closed:
                 log_file_handle = open(str(full_path), 'a')
             
                 # Redirect stdout and stderr to both console and log file
@@ -286,6 +476,9 @@ def setup_logging(config=None):
                 # Register close function to avoid file handle leaks
                 atexit.register(lambda: log_file_handle.close() if log_file_handle and not log_file_handle.closed else None)
         
+        if isinstance(file_handler, AsyncFileHandler):
+            logger.info(f"Writing the log file from a background thread (buffer of {file_handler.writer.buffer_lines} lines)")
+        
         # Register subprocess handler to capture output from subprocesses
         register_subprocess_handler()
         
@@ -307,7 +500,7 @@ def setup_logging(config=None):
             # Add dedicated LDAP file handler for more details
             ldap_log_file = logdir_path / f'ldap_debug_{pid}.log'
             try:
-                ldap_file_handler = logging.FileHandler(str(ldap_log_file))
+                ldap_file_handler = _file_handler(str(ldap_log_file), buffer_config)
                 ldap_file_handler.setFormatter(formatter)
                 ldap_file_handler.setLevel(logging.DEBUG)
                 ldap_logger.addHandler(ldap_file_handler)
@@ -468,6 +661,7 @@ def log_command_output(command, stdout, stderr=None, success=True):
     if stdout:
         if isinstance(stdout, bytes):
             stdout = stdout.decode('utf-8')
+        stdout = redact(stdout)
             
         logger.info(f"COMMAND OUTPUT:")
         for line in stdout.splitlines():
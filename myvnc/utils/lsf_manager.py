@@ -7,6 +7,7 @@ LSF Manager for submitting and monitoring LSF jobs
 
 import subprocess
 import shlex
+import shutil
 import re
 import sys
 import time
@@ -18,9 +19,31 @@ from pathlib import Path
 import signal
 
 
-from myvnc.utils.config_manager import ConfigManager
-from myvnc.utils.config_loader import load_server_config
+from myvnc.utils.config_loader import load_server_config, get_config_manager
 from myvnc.utils.log_manager import get_logger
+from myvnc.utils import job_table
+from myvnc.utils.job_snapshot import create_job_snapshot
+from myvnc.utils.job_feed import create_job_feed
+from myvnc.utils.host_load import HostLoad, create_host_load, parse_size_mb
+from myvnc.utils.warm_pool import HOLDER_PREFIX, PoolSlot, create_warm_pool
+from myvnc.utils.display_collector import get_display_collector
+from myvnc.utils.session_timeline import get_session_timeline
+from myvnc.utils.federation import cluster_environment, cluster_server_config
+from myvnc.utils.runner_client import (get_runner_client, run_batch_direct, stream_direct, RunnerUnavailable,
+                                      run_direct, setuid_argv, backstop_timeout, remaining_time,
+                                      deadline_scope, submit as submit_call)
+from myvnc.utils.tracing import tracer, command_name
+from myvnc.utils.submission import (SubmissionPlan, SubmissionPlans, can_substitute, placeholders, plan_key,
+                                    user_credentials)
+
+# Streamed command output kept in the command history, which is only for debugging
+STREAM_HISTORY_LIMIT = 64 * 1024
+
+# Seconds a scheduler command may run unless 'scheduler_timeouts' says otherwise
+DEFAULT_COMMAND_TIMEOUT = 60
+
+# Submissions of a submit_jobs() batch in flight at once
+BATCH_SUBMIT_PARALLEL = 8
 
 
 def _capture_jobid_script_path(vnc_config: Dict) -> str:
@@ -45,32 +68,41 @@ class LSFError(Exception):
 class LSFManager:
     """Manages interactions with the LSF job scheduler via command line"""
     
-    # Singleton instance
-    _instance = None
+    # One instance, or one per cluster of a federation (see federation.py)
+    _instances = {}
     _initialized = False
     
-    def __new__(cls):
-        """Ensure only one instance of LSFManager is created"""
-        if cls._instance is None:
-            cls._instance = super(LSFManager, cls).__new__(cls)
-        return cls._instance
+    def __new__(cls, cluster: Dict = None):
+        """Ensure only one instance of LSFManager is created per cluster"""
+        name = cluster['name'] if cluster else None
+        if name not in cls._instances:
+            cls._instances[name] = super(LSFManager, cls).__new__(cls)
+        return cls._instances[name]
     
-    def __init__(self):
+    def __init__(self, cluster: Dict = None):
         """
         Initialize the LSF manager and check if LSF is available
         
+        Args:
+            cluster: Federated cluster configuration (name, environment,
+                settings); None for the server's only scheduler
+        
         Raises:
             RuntimeError: If LSF is not available
         """
         # Only initialize once
-        if LSFManager._initialized:
+        if self._initialized:
             return
+        
+        # Federated clusters' commands run with the cluster's scheduler environment
+        self.cluster = cluster['name'] if cluster else None
+        self.command_env = cluster_environment(cluster) if cluster else None
             
         # For storing command execution history for debugging
         self.command_history = []
         
         # Initialize config manager for site domain lookups
-        self.config_manager = ConfigManager()
+        self.config_manager = get_config_manager()
         
         # Initialize environment and logger
         self.environment = os.environ.copy()
@@ -78,6 +110,8 @@ class LSFManager:
         
         # Load server configuration to get setuid_runner path
         server_config = load_server_config()
+        if cluster:
+            server_config = cluster_server_config(server_config, cluster)
         default_path = os.path.join(os.path.dirname(os.path.dirname(os.path.dirname(__file__))), 'setuid_runner')
         self.setuid_binary = server_config.get('setuid_runner', default_path)
         
@@ -86,6 +120,42 @@ class LSFManager:
         else:
             self.logger.info(f"Using default setuid_runner path: {self.setuid_binary}")
         
+        # Resident broker, used for commands run as a user when enabled
+        self.runner_client = get_runner_client(server_config, self.setuid_binary, env=self.command_env)
+        if self.runner_client:
+            self.logger.info(f"Using setuid_runner daemon at: {self.runner_client.socket_path}")
+        
+        # Native bjobs/squeue tokenizer, looked for next to setuid_runner
+        job_table.load_library(server_config.get('job_table_library'), [os.path.dirname(self.setuid_binary)])
+        
+        # Every scheduler command is stopped after this long (SIGTERM, then SIGKILL)
+        self.command_timeout = float((server_config.get('scheduler_timeouts') or {}).get('command', DEFAULT_COMMAND_TIMEOUT)) or None
+        
+        # Shared listing of all users' jobs, refreshed at most once per ttl
+        self.job_snapshot = create_job_snapshot(server_config, self._fetch_job_snapshot)
+        self.job_snapshot_user = (server_config.get('job_snapshot') or {}).get('run_as') or None
+        if self.job_snapshot:
+            self.logger.info(f"Serving job listings from a shared snapshot (ttl {self.job_snapshot.ttl}s)")
+        # Versioned view of the snapshot for /api/vnc/updates (needs the snapshot)
+        self.job_feed = create_job_feed(server_config, self.job_snapshot)
+        if self.job_feed:
+            self.logger.info(f"Serving incremental job updates (refresh every {self.job_feed.interval}s)")
+        # Host load refreshed in the background, for -m preferences on submissions
+        self.host_load = create_host_load(server_config, self._fetch_host_load, self._fetch_host_sessions)
+        if self.host_load:
+            self.logger.info(f"Preferring the least loaded hosts on submission (refresh every {self.host_load.interval}s)")
+        
+        # Displays pushed by vncserver_wrapper, checked before bread
+        self.display_collector = get_display_collector(server_config)
+        if self.display_collector:
+            self.logger.info(f"Collecting VNC displays from spool: {self.display_collector.spool_dir}")
+        
+        # Submit, dispatch, display and connect times of every session, for startup reports
+        self.session_timeline = get_session_timeline(server_config)
+        
+        # bsub commands compiled per configuration, filled in with the user at launch
+        self.submission_plans = SubmissionPlans()
+        
         try:
             self._check_lsf_available()
             self._check_setuid_binary()
@@ -93,8 +163,27 @@ class LSFManager:
             print(f"Warning: LSF initialization error: {str(e)}", file=sys.stderr)
             # Don't raise here, let individual methods handle errors
             
+        # Slots held by the pool account for VNC requests matching a profile; the
+        # refill thread starts right away, so it comes after the command checks
+        self.warm_pool_user = (server_config.get('warm_pool') or {}).get('run_as') or None
+        self.warm_pool = create_warm_pool(server_config, self._list_pool_holders, self._submit_pool_holder,
+                                          self._release_pool_holder)
+        if self.warm_pool:
+            self.logger.info(f"Keeping {self.warm_pool.size} warm pool slot(s) for each of {len(self.warm_pool.profiles)} profile(s)")
+        
         # Mark as initialized
-        LSFManager._initialized = True
+        self._initialized = True
+    
+    def call_async(self, fn, *args, deadline: float = None, **kwargs):
+        """
+        Start fn(*args, **kwargs), usually one of this manager's methods, in
+        the background and return its concurrent.futures.Future
+        
+        Scheduler commands run by the call are stopped at the time.monotonic()
+        deadline, so a caller that waits with future.result(timeout=...) can
+        give up without leaving them running.
+        """
+        return submit_call(fn, *args, deadline=deadline, **kwargs)
     
     def get_command_history(self, limit=10):
         """Return the last N commands executed with their outputs"""
@@ -241,7 +330,7 @@ class LSFManager:
             try:
                 # Compatible with Python 3.6 - removed text=True
                 self.logger.debug(f"Running 'which {cmd}' to find command path")
-                result = subprocess.run(['which', cmd], check=True, 
+                result = subprocess.run(['which', cmd], check=True, env=self.command_env,
                                        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
                 cmd_path = result.stdout.decode('utf-8').strip()
                 self.logger.info(f"Found {cmd} at: {cmd_path}")
@@ -266,6 +355,13 @@ class LSFManager:
             self.logger.warning(f"Some LSF commands not found: {', '.join(missing)}")
         else:
             self.logger.info(f"All LSF commands found successfully: {', '.join(lsf_commands)}")
+        
+        # Helper commands run through setuid_runner; with absolute paths the
+        # broker spawns them directly instead of searching PATH
+        for cmd in ['test', 'cat']:
+            cmd_path = shutil.which(cmd)
+            if cmd_path:
+                self.lsf_cmd_paths[cmd] = cmd_path
     
     def _check_setuid_binary(self):
         """
@@ -331,13 +427,26 @@ class LSFManager:
             self.logger.debug(f"DEBUG: Running as authenticated user: {authenticated_user}")
         
         try:
-            # Compatible with Python 3.6 - removed text=True
-            result = subprocess.run(modified_cmd, check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            result = None
+            timeout = remaining_time(self.command_timeout)
+            with tracer.span(cmd):
+                verbose = tracer.verbose(cmd)
+                if authenticated_user and self.runner_client:
+                    try:
+                        result = self.runner_client.run(authenticated_user, modified_cmd[2:], timeout=timeout, check=True)
+                    except RunnerUnavailable as e:
+                        self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} directly: {e}")
+                if result is None and authenticated_user:
+                    # setuid_runner enforces the deadline on the command itself
+                    result = run_direct(setuid_argv(self.setuid_binary, authenticated_user, modified_cmd[2:], timeout),
+                                        timeout=backstop_timeout(timeout), check=True, env=self.command_env)
+                elif result is None:
+                    result = run_direct(modified_cmd, timeout=timeout, check=True, env=self.command_env)
             stdout = result.stdout.decode('utf-8')
             stderr = result.stderr.decode('utf-8')
             
             # Log the command output
-            if stdout:
+            if stdout and verbose:
                 self.logger.info(f"Command output: {stdout}")
             if stderr:
                 self.logger.info(f"Command stderr: {stderr}")
@@ -355,40 +464,203 @@ class LSFManager:
         except subprocess.CalledProcessError as e:
             stderr = e.stderr.decode('utf-8')
             stdout = e.stdout.decode('utf-8') if e.stdout else ''
+            raise self._command_failed(cmd_str, stdout, stderr)
+        finally:
+            # Job state may have changed; the next listing must not come from the old snapshot
+            if self.job_snapshot and os.path.basename(lsf_command) in ('bsub', 'bkill'):
+                self.job_snapshot.invalidate()
+    
+    def _command_failed(self, cmd_str: str, stdout: str, stderr: str) -> LSFError:
+        """Log a failed command, add it to the command history and return the LSFError to raise"""
+        # Check if this is a benign "not found" error from bjobs
+        # "Job <myvnc_*> is not found" is a normal condition when user has no jobs
+        is_job_not_found = 'is not found' in stderr and 'bjobs' in cmd_str
+        
+        # Log the error - using the original command format for logs
+        # Use DEBUG level for benign job-not-found errors
+        if is_job_not_found:
+            self.logger.debug(f"Command completed with no results: {cmd_str}")
+            self.logger.debug(f"Command stderr: {stderr}")
+        else:
+            self.logger.error(f"Command failed: {cmd_str}")
+            self.logger.error(f"Command stdout: {stdout}")
+            self.logger.error(f"Command stderr: {stderr}")
+        
+        # Add failed command to history for debugging
+        self.command_history.append({
+            'command': cmd_str,
+            'stdout': stdout,
+            'stderr': stderr,
+            'success': False,
+            'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+        })
+        
+        return LSFError(stderr.strip(), stderr=stderr, stdout=stdout)
+    
+    def _stream_command(self, cmd: List[str], authenticated_user: str = None, raw: bool = False):
+        """
+        Run a command and yield its stdout line by line as it is produced
+        
+        Commands run as authenticated_user go through setuid_runner in framed
+        mode, so large listings (bjobs -u all) are parsed as they arrive
+        instead of being buffered whole. Without an authenticated user this
+        is _run_command split into lines.
+        
+        Args:
+            cmd: Command to run as a list of arguments
+            authenticated_user: Optional authenticated username to run command as
+            raw: Yield stdout as bytes chunks, exactly as they arrive
             
-            # Check if this is a benign "not found" error from bjobs
-            # "Job <myvnc_*> is not found" is a normal condition when user has no jobs
-            is_job_not_found = 'is not found' in stderr and 'bjobs' in cmd_str
+        Yields:
+            Lines of stdout without the newline, or bytes chunks with raw
             
-            # Log the error - using the original command format for logs
-            # Use DEBUG level for benign job-not-found errors
-            if is_job_not_found:
-                self.logger.debug(f"Command completed with no results: {cmd_str}")
-                self.logger.debug(f"Command stderr: {stderr}")
+        Raises:
+            LSFError: After the last line, if the command failed
+        """
+        if not authenticated_user:
+            output = self._run_command(cmd, authenticated_user)
+            yield from tracer.iterate([output.encode('utf-8')] if raw else output.splitlines(),
+                                      command=command_name(cmd))
+            return
+        
+        # Replace LSF commands with their full paths, as _run_command does
+        modified_cmd = cmd.copy()
+        if cmd and cmd[0] in self.lsf_cmd_paths:
+            modified_cmd[0] = self.lsf_cmd_paths[cmd[0]]
+        cmd_str = ' '.join(str(arg) for arg in cmd)
+        self.logger.debug(f"DEBUG: Streaming command as authenticated user {authenticated_user}: {cmd_str}")
+        
+        span = tracer.start(cmd)
+        verbose = not raw and tracer.verbose(cmd)
+        stream = None
+        timeout = remaining_time(self.command_timeout)
+        try:
+            with span.phase('spawn'):
+                if self.runner_client:
+                    try:
+                        stream = self.runner_client.stream(authenticated_user, modified_cmd, timeout=timeout)
+                    except RunnerUnavailable as e:
+                        self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} --framed directly: {e}")
+                if stream is None:
+                    stream = stream_direct(self.setuid_binary, authenticated_user, modified_cmd, timeout=timeout,
+                                           env=self.command_env)
+        except Exception:
+            # The command never started, so the span is not finished by iterate()
+            tracer.finish(span)
+            raise
+        
+        # Only the start of the output is kept for the command history
+        head, head_len = [], 0
+        for item in tracer.iterate(stream.chunks() if raw else stream, span):
+            if head_len < STREAM_HISTORY_LIMIT:
+                head.append(item)
+                head_len += len(item) + 1
+            if verbose:
+                self.logger.info(f"  {item}")
+            yield item
+        
+        stdout = b''.join(head).decode('utf-8', 'replace') if raw else '\n'.join(head)
+        stderr = stream.stderr.decode('utf-8', 'replace')
+        if stream.returncode != 0:
+            raise self._command_failed(cmd_str, stdout, stderr)
+        if stderr:
+            self.logger.info(f"Command stderr: {stderr}")
+        self.command_history.append({
+            'command': cmd_str,
+            'stdout': stdout,
+            'stderr': stderr,
+            'success': True,
+            'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+        })
+
+    def _run_commands(self, cmds: List[List[str]], authenticated_user: str = None) -> List[Optional[str]]:
+        """
+        Run several independent commands and return their outputs
+        
+        Commands run as authenticated_user go to setuid_runner as one batch, so
+        the broker switches credentials once and runs them concurrently instead
+        of being launched once per command.
+        
+        Args:
+            cmds: Commands to run, each a list of arguments
+            authenticated_user: Optional authenticated username to run commands as
+            
+        Returns:
+            List with each command's stdout, or None where the command failed
+        """
+        if not authenticated_user or len(cmds) < 2:
+            outputs = []
+            for cmd in cmds:
+                try:
+                    outputs.append(self._run_command(cmd, authenticated_user))
+                except Exception:
+                    outputs.append(None)
+            return outputs
+        
+        # Replace LSF commands with their full paths, as _run_command does
+        modified_cmds = []
+        for cmd in cmds:
+            modified_cmd = cmd.copy()
+            if cmd and cmd[0] in self.lsf_cmd_paths:
+                modified_cmd[0] = self.lsf_cmd_paths[cmd[0]]
+            modified_cmds.append(modified_cmd)
+        
+        self.logger.debug(f"DEBUG: Running batch of {len(cmds)} commands as authenticated user: {authenticated_user}")
+        results = None
+        timeout = remaining_time(self.command_timeout)
+        with tracer.span(modified_cmds[0]):
+            verbose = tracer.verbose(modified_cmds[0])
+            if self.runner_client:
+                try:
+                    results = self.runner_client.run_batch(authenticated_user, modified_cmds, timeout=timeout)
+                except RunnerUnavailable as e:
+                    self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} --batch directly: {e}")
+            if results is None:
+                results = run_batch_direct(self.setuid_binary, authenticated_user, modified_cmds, timeout=timeout,
+                                           env=self.command_env)
+        
+        outputs = []
+        for cmd, result in zip(cmds, results):
+            cmd_str = ' '.join(str(arg) for arg in cmd)
+            stdout = result.stdout.decode('utf-8')
+            stderr = result.stderr.decode('utf-8')
+            success = result.returncode == 0
+            
+            if success:
+                if stdout and verbose:
+                    self.logger.info(f"Command output: {stdout}")
+                outputs.append(stdout)
             else:
-                self.logger.error(f"Command failed: {cmd_str}")
-                self.logger.error(f"Command stdout: {stdout}")
-                self.logger.error(f"Command stderr: {stderr}")
+                # Failures are expected here (e.g. jobs that finished meanwhile)
+                self.logger.debug(f"Command failed in batch: {cmd_str}")
+                self.logger.debug(f"Command stderr: {stderr}")
+                outputs.append(None)
             
-            # Add failed command to history for debugging
             self.command_history.append({
                 'command': cmd_str,
                 'stdout': stdout,
                 'stderr': stderr,
-                'success': False,
+                'success': success,
                 'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
             })
-            
-            raise LSFError(stderr.strip(), stderr=stderr, stdout=stdout)
+        
+        return outputs
 
-    def _get_bpost_display(self, job_id: str) -> Optional[str]:
+    def _get_bpost_display(self, job_id: str, job_user: str = None) -> Optional[str]:
         """Retrieve the VNC display number posted by the job via bpost/bread.
 
+        A display already pushed to the display collector by the job owner
+        is returned without running bread.
+
         Runs bread without the setuid binary since any user can read
         bpost messages — no need to impersonate the job owner.
 
         Returns the display number as a string (e.g. "6") or None if not available.
         """
+        if self.display_collector and job_user:
+            display = self.display_collector.get(job_id, job_user)
+            if display:
+                return display
         try:
             job_id_str = str(job_id).strip()
             output = self._run_command(['bread', job_id_str])
@@ -404,6 +676,40 @@ class LSFManager:
             self.logger.warning(f"Could not read bpost data for job {job_id}: {e}")
         return None
 
+    def _submission_values(self, user: str, user_home: str, authenticated_user: Optional[str],
+                           name: Optional[str]) -> Dict[str, Optional[str]]:
+        """The per-launch fields of a submission plan; name has its spaces replaced with underscores"""
+        user_uid = None
+        if authenticated_user:
+            # XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS are derived from the UID
+            user_uid = user_credentials(authenticated_user).uid
+            if user_uid:
+                self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
+            else:
+                self.logger.error(f"Failed to get UID for user {authenticated_user}")
+                self.logger.warning("Continuing without XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS")
+        return {
+            'user': user,
+            'home': user_home,
+            'uid': user_uid,
+            'name': name.replace(' ', '_') if name is not None else None,
+        }
+    
+    def _submission_plan(self, kind: str, compile, session_config: Dict, lsf_config: Dict,
+                         values: Dict[str, Optional[str]], authenticated: bool) -> SubmissionPlan:
+        """
+        Return the plan compile(session_config, lsf_config, values, authenticated)
+        builds, compiled once per configuration with placeholders for values
+        unless they cannot be substituted safely
+        """
+        if not can_substitute(values):
+            return compile(session_config, lsf_config, values, authenticated)
+        present = {field: value is not None for field, value in values.items()}
+        key = plan_key(kind, self.config_manager.version,
+                       {k: v for k, v in session_config.items() if k != 'name'}, lsf_config, authenticated, present)
+        return self.submission_plans.get(
+            key, lambda: compile(session_config, lsf_config, placeholders(**present), authenticated))
+    
     def submit_vnc_job(self, vnc_config: Dict, lsf_config: Dict, authenticated_user: str = None, fake_no_home: bool = False, server_hostname: str = None) -> str:
         """Submit a VNC job using bsub
         
@@ -425,7 +731,7 @@ class LSFManager:
             user = authenticated_user if authenticated_user else os.environ.get('USER', '')
             
             # Check if user's VNC password file exists (need to use setuid_runner as server owner can't read user's home)
-            user_home = os.path.expanduser(f'~{user}')
+            user_home = user_credentials(user).home
             vnc_passwd_file = f'/home/{user}/.vnc/passwd'
             passwd_exists = False
             
@@ -474,302 +780,23 @@ class LSFManager:
                 self.logger.error(error_msg)
                 raise LSFError(error_msg)
             
-            # Get the full path to bsub
-            bsub_path = self.lsf_cmd_paths.get('bsub', 'bsub')
-            
-            # Extract parameters from config
-            job_name = 'myvnc_vncserver'  # Fixed name for all VNC jobs
-            num_cores = int(lsf_config.get('num_cores', 2))
-            memory_gb = float(lsf_config.get('memory_gb', 2.0))
-            
-            # Get display name and resolution from vnc_config
-            display_name = vnc_config.get('name', 'MyVNC Session')
-            resolution = vnc_config.get('resolution', '1024x768')
-            color_depth = int(vnc_config.get('color_depth', 24))
-            
-            # Get LSF group (queue) to use
-            queue = lsf_config.get('queue', 'interactive')
-            
-            # Format resource request string with span[hosts=1] and rusage[mem=XG]
-            resource_req = f"span[hosts=1] rusage[mem={memory_gb}G]"
-            
-            # Check if a container is specified - if so, we don't need OS selection
-            # because the container provides the OS environment
-            container_path = lsf_config.get('container', '')
-            using_container = container_path and container_path.strip()
-            
-            # Resolve symlinks in container path to document the actual version
-            if using_container:
-                original_container_path = container_path
-                container_path = os.path.realpath(container_path)
-                if original_container_path != container_path:
-                    self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
-            
-            # Add OS selection if specified (but NOT when using a container)
-            os_select = lsf_config.get('os_select', '')
-            
-            # Add processor architecture selection if specified
-            arch_select = lsf_config.get('arch_select', '')
-            if arch_select and arch_select != "any":
-                self.logger.info(f"Adding architecture selection '{arch_select}' to resource requirements")
-                if resource_req:
-                    resource_req = f"select[{arch_select}] {resource_req}"
-                else:
-                    resource_req = f"select[{arch_select}]"
-            else:
-                self.logger.info(f"Not adding architecture selection - arch_select is '{arch_select}'")
-                
-            # Modify resource string based on OS selection
-            # Skip OS selection if using a container (container provides the OS)
-            if using_container:
-                self.logger.info(f"Using container - skipping OS selection constraint (container provides OS environment)")
-            elif os_select and os_select != "any":
-                self.logger.info(f"Adding OS selection '{os_select}' to resource requirements")
-                resource_req = f"select[{os_select}] {resource_req}"
-            else:
-                self.logger.info(f"Not adding OS selection - os_select is '{os_select}'")
-                
-            self.logger.info(f"Final resource requirements string: '{resource_req}'")
-            
-            # Calculate memory limit using multiplier from configuration
-            # The -M switch sets the memory limit, which can be different from rusage[mem=]
-            memlimit_multiplier = lsf_config.get('memlimit_multiplier', 1.0)
-            memory_limit_gb = int(memory_gb * memlimit_multiplier)
-            self.logger.info(f"Memory limit multiplier: {memlimit_multiplier}x, calculated limit: {memory_limit_gb}G (from {memory_gb}G base)")
-            
-            # Build LSF command with -n for cores, -R for resource requirements, and -M for memory limit
-            # Use GB units for -M parameter to match the mem= specification
-            bsub_cmd = [
-                'bsub',
-                '-q', lsf_config.get('queue', 'interactive'),
-                '-n', str(num_cores),
-                '-R', resource_req,
-                '-M', f'{memory_limit_gb}G',
-                '-J', job_name
-            ]
-            
-            # Add time limit if specified
-            time_limit = lsf_config.get('time_limit', '')
-            if time_limit and time_limit.strip():
-                bsub_cmd.extend(['-W', time_limit])
-            
-            # Add host filter only if specified
-            host_filter = lsf_config.get('host_filter', '')
-            if host_filter and host_filter.strip():
-                bsub_cmd.extend(['-m', host_filter])
-            
-            # Set the current working directory for the job to the user's home directory
-            bsub_cmd.extend(['-cwd', user_home])
-            self.logger.info(f"Setting LSF working directory: {user_home}")
-            
-            # Add LSF output and error log file paths (for both containerized and bare metal submissions)
-            # %J will be replaced by the LSF job ID
-            # Use the real path instead of tilde notation so LSF can properly write the logs
+            # Ensure the .vnc directory exists for the LSF log files
             vnc_log_dir = os.path.join(user_home, '.vnc')
-            
-            # Ensure the .vnc directory exists for log file creation
             try:
                 os.makedirs(vnc_log_dir, mode=0o755, exist_ok=True)
                 self.logger.info(f"Ensured .vnc directory exists: {vnc_log_dir}")
             except Exception as e:
                 self.logger.warning(f"Could not create .vnc directory {vnc_log_dir}: {e}")
             
-            # Set LSF log paths (without quotes - let LSF handle them)
-            stdout_log_path = f'{user_home}/.vnc/myvnc.%J.lsf_stdout.log'
-            stderr_log_path = f'{user_home}/.vnc/myvnc.%J.lsf_stderr.log'
-            
-            bsub_cmd.extend(['-oo', stdout_log_path])
-            bsub_cmd.extend(['-eo', stderr_log_path])
-            
-            self.logger.info(f"Setting LSF stdout log file: {stdout_log_path}")
-            self.logger.info(f"Setting LSF stderr log file: {stderr_log_path}")
-            
-            # Add the VNC server command
-            # Prefer the wrapper script which captures the actual display number
-            # and posts it to the LSF job via bpost.
-            # Fall back to plain vncserver if no wrapper is configured.
-            vncserver_path = vnc_config.get('vncserver_path', '/usr/bin/vncserver')
-            vncserver_wrapper_path = vnc_config.get('vncserver_wrapper_path')
-            vncserver_executable = vncserver_wrapper_path or vncserver_path
-            self.logger.info(f"Using VNC server executable: {vncserver_executable}")
-            
-            vncserver_cmd = [
-                vncserver_executable,
-                '-geometry', resolution,
-                '-depth', str(color_depth),
-                '-localhost', 'no',
-            ]
-            
-            # Add display name parameter to vncserver command only if specified
-            # Only add -name if display_name has content
-            # Replace spaces with underscores in the name to avoid vncserver issues
-            if display_name and display_name.strip():
-                safe_display_name = display_name.replace(' ', '_')
-                vncserver_cmd.extend(['-name', safe_display_name])
-            
-            # Add the PasswordFile parameter to avoid password prompts
-            # This references the VNC password file we already verified exists
-            vncserver_cmd.extend(['-PasswordFile', vnc_passwd_file])
-            self.logger.info(f"Using VNC password file: {vnc_passwd_file}")
-            
-            # Calculate environment variables needed for VNC session
-            # These are used for both LSF and singularity container
-            window_manager = vnc_config.get('window_manager')
-            user_uid = None
-            xdg_runtime_dir = None
-            dbus_session_bus_address = None
-            
-            # Get the UID for the authenticated user to set XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS
-            if authenticated_user:
-                try:
-                    # Get UID for the authenticated user
-                    uid_result = subprocess.run(['id', '-u', authenticated_user], 
-                                               check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                    user_uid = uid_result.stdout.decode('utf-8').strip()
-                    
-                    # Calculate XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS
-                    xdg_runtime_dir = f"/run/user/{user_uid}"
-                    dbus_session_bus_address = f"unix:path={xdg_runtime_dir}/bus"
-                    
-                    self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
-                    self.logger.debug(f"XDG_RUNTIME_DIR={xdg_runtime_dir}")
-                    self.logger.debug(f"DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}")
-                except subprocess.CalledProcessError as e:
-                    self.logger.error(f"Failed to get UID for user {authenticated_user}: {e.stderr.decode('utf-8')}")
-                    self.logger.warning("Continuing without XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS")
-                except Exception as e:
-                    self.logger.error(f"Error getting UID for user {authenticated_user}: {str(e)}")
-                    self.logger.warning("Continuing without XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS")
-            
-            # Add xstartup parameter if configured
-            # Check if custom xstartup is enabled and path is provided
-            use_custom_xstartup = vnc_config.get('use_custom_xstartup', False)
-            xstartup_path = vnc_config.get('xstartup_path', '')
-            
-            if use_custom_xstartup and xstartup_path and xstartup_path.strip():
-                self.logger.info(f"Using custom xstartup script: {xstartup_path}")
-                vncserver_cmd.extend(['-xstartup', xstartup_path])
-                
-                # Build environment variables string for LSF -env flag
-                env_vars = [f'WINDOW_MANAGER={window_manager}']
-                if xdg_runtime_dir:
-                    env_vars.append(f'XDG_RUNTIME_DIR={xdg_runtime_dir}')
-                if dbus_session_bus_address:
-                    env_vars.append(f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}')
-                
-                env_string = ','.join(env_vars)
-                bsub_cmd.extend(['-env', env_string])
-                self.logger.info(f"Setting LSF environment variables: {env_string}")
-            
-            # Pre-exec (-E): loginctl for linger; for container jobs also capture_jobid.sh.
-            # Output path uses $$ (shell PID) so it is explicit digits at runtime — do not use %J and
-            # do not shlex.quote the path or $$ will not expand. vncserver_wrapper uses pointer file.
-            capture_jobid_target = f'{user_home}/.vnc/myvnc_lsb_jobid.$$'
-            if authenticated_user:
-                loginctl_cmd = f'/usr/bin/loginctl enable-linger {authenticated_user}'
-                if using_container:
-                    capture_script = _capture_jobid_script_path(vnc_config)
-                    pre_exec = (
-                        f'{loginctl_cmd} && '
-                        f'{shlex.quote(capture_script)} {capture_jobid_target}'
-                    )
-                    bsub_cmd.extend(['-E', pre_exec])
-                    self.logger.info(
-                        "Adding pre-exec: loginctl and capture_jobid.sh -> %s (PID suffix at -E)",
-                        capture_jobid_target.replace('$$', '<PID>'),
-                    )
-                else:
-                    bsub_cmd.extend(['-E', loginctl_cmd])
-                    self.logger.info(f"Adding pre-execution command to enable user lingering: {loginctl_cmd}")
-            elif using_container:
-                capture_script = _capture_jobid_script_path(vnc_config)
-                pre_exec = f'{shlex.quote(capture_script)} {capture_jobid_target}'
-                bsub_cmd.extend(['-E', pre_exec])
-                self.logger.info(
-                    "Adding pre-exec: capture_jobid.sh -> %s (PID suffix at -E)",
-                    capture_jobid_target.replace('$$', '<PID>'),
-                )
-            
-            
-            # Check if a container is specified for this OS (already retrieved earlier)
-            if using_container:
-                self.logger.info(f"Wrapping vncserver command with singularity container: {container_path}")
-                # Wrap the vncserver command with singularity exec
-                # Build the singularity command with bind mounts for NFS directories
-                # Use --cleanenv to prevent inheriting host environment variables
-                container_cmd = ['singularity', 'exec', '--cleanenv']
-                
-                # Pass environment variables to singularity
-                # This is needed because --cleanenv wipes all environment variables
-                
-                # Always pass USER environment variable
-                if authenticated_user:
-                    container_cmd.extend(['--env', f'USER={authenticated_user}'])
-                    self.logger.info(f"Passing USER={authenticated_user} to container")
-                
-                
-                if use_custom_xstartup and xstartup_path:
-                    container_cmd.extend(['--env', f'WINDOW_MANAGER={window_manager}'])
-                    self.logger.info(f"Passing WINDOW_MANAGER={window_manager} to container")
-                    
-                    # Also pass XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS if available
-                    if xdg_runtime_dir:
-                        container_cmd.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
-                        self.logger.info(f"Passing XDG_RUNTIME_DIR={xdg_runtime_dir} to container")
-                    if dbus_session_bus_address:
-                        container_cmd.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
-                        self.logger.info(f"Passing DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address} to container")
-                
-                # Add cgroup resource limits to match LSF reservation
-                # This ensures the container respects the resource allocation
-                container_cmd.extend(['--cpus', str(num_cores)])
-                container_cmd.extend(['--memory-reservation', f'{memory_gb}G'])
-                container_cmd.extend(['--memory', f'{memory_gb + 2}G'])
-                container_cmd.extend(['--memory-swap', f'{memory_gb * 2}G'])
-                self.logger.info(f"Setting container cgroup limits: cpus={num_cores}, "
-                               f"memory-reservation={memory_gb}G, memory={memory_gb + 2}G, "
-                               f"memory-swap={memory_gb * 2}G")
-                
-                # Get bind paths from configuration
-                bindpaths_name = lsf_config.get('bindpaths', '')
-                if bindpaths_name:
-                    self.logger.info(f"Using configured bindpaths set: {bindpaths_name}")
-                    bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
-                    
-                    if bindpaths:
-                        self.logger.info(f"Found {len(bindpaths)} paths in bindpaths set '{bindpaths_name}'")
-                        for path in bindpaths:
-                            path = path.strip()
-                            if path and os.path.exists(path):
-                                container_cmd.extend(['--bind', f'{path}:{path}'])
-                                self.logger.debug(f"Adding bind mount for: {path}")
-                            else:
-                                self.logger.warning(f"Skipping non-existent bind path: {path}")
-                    else:
-                        self.logger.error(f"Bindpaths set '{bindpaths_name}' not found in configuration")
-                        self.logger.warning("No bind mounts will be added - container may not have access to shared filesystems")
-                else:
-                    self.logger.warning("No bindpaths specified in configuration")
-                    self.logger.warning("No bind mounts will be added - container may not have access to shared filesystems")
-                
-                # Add the container path and inner shell (same argv layout as submit_tmux_job:
-                # bsub ... singularity exec ... image.sif /usr/bin/bash -c '...')
-                container_cmd.append(container_path)
-                
-                # Wrap the vncserver command in bash with sleep infinity
-                # This keeps the container alive after vncserver starts
-                # vncserver daemonizes immediately, so without sleep the container would exit
-                vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
-                inner_bash_cmd = f'unset LSB_QUEUE && {vncserver_cmd_str} && sleep infinity'
-                
-                self.logger.info(f"Container command will keep alive with 'sleep infinity'")
-                
-                container_cmd.extend(['/usr/bin/bash', '-c', inner_bash_cmd])
-                bsub_cmd.extend(container_cmd)
-            else:
-                # No container, prepend unset LSB_QUEUE before the vncserver command
-                vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
-                bsub_cmd.extend(['/usr/bin/bash', '-c', f'unset LSB_QUEUE && {vncserver_cmd_str}'])
+            # Only the user and the display name differ between launches of the same configuration
+            display_name = vnc_config.get('name', 'MyVNC Session')
+            values = self._submission_values(user, user_home, authenticated_user,
+                                             display_name if display_name and display_name.strip() else None)
+            plan = self._submission_plan('vnc', self._compile_vnc_submission, vnc_config, lsf_config, values,
+                                         bool(authenticated_user))
+            bsub_cmd, _ = plan.render(values)
+            slot = self._claim_pool_slot(vnc_config, lsf_config)
+            bsub_cmd = self._with_placement_hint(bsub_cmd, lsf_config, slot)
             
             # Convert command list to string for logging
             cmd_str = ' '.join(str(arg) for arg in bsub_cmd)
@@ -796,10 +823,15 @@ class LSFManager:
                 job_id = job_id_match.group(1) if job_id_match else 'unknown'
                 
                 self.logger.info(f"Job submitted successfully, ID: {job_id}")
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, job_id)
+                self._record_submit(job_id, user, 'vnc', vnc_config, lsf_config, slot)
                 
                 return job_id
                 
             except LSFError as e:
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, None)
                 # LSF errors already have the clean error message
                 self.logger.error(f"Job submission failed: {str(e)}")
                 
@@ -809,6 +841,8 @@ class LSFManager:
                 # Re-raise the LSFError to preserve the original message
                 raise e
             except Exception as e:
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, None)
                 # For other exceptions, wrap them appropriately
                 error_msg = f"Job submission error: {str(e)}"
                 self.logger.error(error_msg)
@@ -832,6 +866,298 @@ class LSFManager:
                 })
             raise
     
+    def _compile_vnc_submission(self, vnc_config: Dict, lsf_config: Dict, values: Dict[str, Optional[str]],
+                                authenticated: bool) -> SubmissionPlan:
+        """Build the bsub command of a VNC job
+        
+        Args:
+            vnc_config: VNC configuration
+            lsf_config: LSF configuration
+            values: The per-launch fields (user, home, uid, name), real values or placeholders
+            authenticated: Whether the job is submitted for an authenticated user
+            
+        Returns:
+            SubmissionPlan of the bsub command
+        """
+        user = values['user']
+        user_home = values['home']
+        user_uid = values['uid']
+        safe_display_name = values['name']
+        authenticated_user = user if authenticated else None
+        vnc_passwd_file = f'/home/{user}/.vnc/passwd'
+        
+        # Extract parameters from config
+        job_name = 'myvnc_vncserver'  # Fixed name for all VNC jobs
+        num_cores = int(lsf_config.get('num_cores', 2))
+        memory_gb = float(lsf_config.get('memory_gb', 2.0))
+        
+        # Get resolution from vnc_config
+        resolution = vnc_config.get('resolution', '1024x768')
+        color_depth = int(vnc_config.get('color_depth', 24))
+        
+        # Get LSF group (queue) to use
+        queue = lsf_config.get('queue', 'interactive')
+        
+        # Format resource request string with span[hosts=1] and rusage[mem=XG]
+        resource_req = f"span[hosts=1] rusage[mem={memory_gb}G]"
+        
+        # Check if a container is specified - if so, we don't need OS selection
+        # because the container provides the OS environment
+        container_path = lsf_config.get('container', '')
+        using_container = container_path and container_path.strip()
+        
+        # Resolve symlinks in container path to document the actual version
+        if using_container:
+            original_container_path = container_path
+            container_path = os.path.realpath(container_path)
+            if original_container_path != container_path:
+                self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
+        
+        # Add OS selection if specified (but NOT when using a container)
+        os_select = lsf_config.get('os_select', '')
+        
+        # Add processor architecture selection if specified
+        arch_select = lsf_config.get('arch_select', '')
+        if arch_select and arch_select != "any":
+            self.logger.info(f"Adding architecture selection '{arch_select}' to resource requirements")
+            if resource_req:
+                resource_req = f"select[{arch_select}] {resource_req}"
+            else:
+                resource_req = f"select[{arch_select}]"
+        else:
+            self.logger.info(f"Not adding architecture selection - arch_select is '{arch_select}'")
+            
+        # Modify resource string based on OS selection
+        # Skip OS selection if using a container (container provides the OS)
+        if using_container:
+            self.logger.info(f"Using container - skipping OS selection constraint (container provides OS environment)")
+        elif os_select and os_select != "any":
+            self.logger.info(f"Adding OS selection '{os_select}' to resource requirements")
+            resource_req = f"select[{os_select}] {resource_req}"
+        else:
+            self.logger.info(f"Not adding OS selection - os_select is '{os_select}'")
+            
+        self.logger.info(f"Final resource requirements string: '{resource_req}'")
+        
+        # Calculate memory limit using multiplier from configuration
+        # The -M switch sets the memory limit, which can be different from rusage[mem=]
+        memlimit_multiplier = lsf_config.get('memlimit_multiplier', 1.0)
+        memory_limit_gb = int(memory_gb * memlimit_multiplier)
+        self.logger.info(f"Memory limit multiplier: {memlimit_multiplier}x, calculated limit: {memory_limit_gb}G (from {memory_gb}G base)")
+        
+        # Build LSF command with -n for cores, -R for resource requirements, and -M for memory limit
+        # Use GB units for -M parameter to match the mem= specification
+        bsub_cmd = [
+            'bsub',
+            '-q', lsf_config.get('queue', 'interactive'),
+            '-n', str(num_cores),
+            '-R', resource_req,
+            '-M', f'{memory_limit_gb}G',
+            '-J', job_name
+        ]
+        
+        # Add time limit if specified
+        time_limit = lsf_config.get('time_limit', '')
+        if time_limit and time_limit.strip():
+            bsub_cmd.extend(['-W', time_limit])
+        
+        # Add host filter only if specified
+        host_filter = lsf_config.get('host_filter', '')
+        if host_filter and host_filter.strip():
+            bsub_cmd.extend(['-m', host_filter])
+        
+        # Set the current working directory for the job to the user's home directory
+        bsub_cmd.extend(['-cwd', user_home])
+        self.logger.info(f"Setting LSF working directory: {user_home}")
+        
+        # Add LSF output and error log file paths (for both containerized and bare metal submissions)
+        # %J will be replaced by the LSF job ID
+        # Use the real path instead of tilde notation so LSF can properly write the logs
+        # Set LSF log paths (without quotes - let LSF handle them)
+        stdout_log_path = f'{user_home}/.vnc/myvnc.%J.lsf_stdout.log'
+        stderr_log_path = f'{user_home}/.vnc/myvnc.%J.lsf_stderr.log'
+        
+        bsub_cmd.extend(['-oo', stdout_log_path])
+        bsub_cmd.extend(['-eo', stderr_log_path])
+        
+        self.logger.info(f"Setting LSF stdout log file: {stdout_log_path}")
+        self.logger.info(f"Setting LSF stderr log file: {stderr_log_path}")
+        
+        # Add the VNC server command
+        # Prefer the wrapper script which captures the actual display number
+        # and posts it to the LSF job via bpost.
+        # Fall back to plain vncserver if no wrapper is configured.
+        vncserver_path = vnc_config.get('vncserver_path', '/usr/bin/vncserver')
+        vncserver_wrapper_path = vnc_config.get('vncserver_wrapper_path')
+        vncserver_executable = vncserver_wrapper_path or vncserver_path
+        self.logger.info(f"Using VNC server executable: {vncserver_executable}")
+        
+        vncserver_cmd = [
+            vncserver_executable,
+            '-geometry', resolution,
+            '-depth', str(color_depth),
+            '-localhost', 'no',
+        ]
+        
+        # Have the wrapper push the display it gets to the display collector
+        if vncserver_wrapper_path and self.display_collector:
+            vncserver_cmd[1:1] = ['--myvnc-display-spool', self.display_collector.spool_dir]
+        
+        # Add display name parameter to vncserver command only if specified
+        # (spaces are already replaced with underscores to avoid vncserver issues)
+        if safe_display_name:
+            vncserver_cmd.extend(['-name', safe_display_name])
+        
+        # Add the PasswordFile parameter to avoid password prompts
+        # This references the VNC password file we already verified exists
+        vncserver_cmd.extend(['-PasswordFile', vnc_passwd_file])
+        self.logger.info(f"Using VNC password file: {vnc_passwd_file}")
+        
+        # Calculate environment variables needed for VNC session
+        # These are used for both LSF and singularity container
+        window_manager = vnc_config.get('window_manager')
+        xdg_runtime_dir = None
+        dbus_session_bus_address = None
+        
+        # XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS follow from the authenticated user's UID
+        if user_uid:
+            xdg_runtime_dir = f"/run/user/{user_uid}"
+            dbus_session_bus_address = f"unix:path={xdg_runtime_dir}/bus"
+            self.logger.debug(f"XDG_RUNTIME_DIR={xdg_runtime_dir}")
+            self.logger.debug(f"DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}")
+        
+        # Add xstartup parameter if configured
+        # Check if custom xstartup is enabled and path is provided
+        use_custom_xstartup = vnc_config.get('use_custom_xstartup', False)
+        xstartup_path = vnc_config.get('xstartup_path', '')
+        
+        if use_custom_xstartup and xstartup_path and xstartup_path.strip():
+            self.logger.info(f"Using custom xstartup script: {xstartup_path}")
+            vncserver_cmd.extend(['-xstartup', xstartup_path])
+            
+            # Build environment variables string for LSF -env flag
+            env_vars = [f'WINDOW_MANAGER={window_manager}']
+            if xdg_runtime_dir:
+                env_vars.append(f'XDG_RUNTIME_DIR={xdg_runtime_dir}')
+            if dbus_session_bus_address:
+                env_vars.append(f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}')
+            
+            env_string = ','.join(env_vars)
+            bsub_cmd.extend(['-env', env_string])
+            self.logger.info(f"Setting LSF environment variables: {env_string}")
+        
+        # Pre-exec (-E): loginctl for linger; for container jobs also capture_jobid.sh.
+        # Output path uses $$ (shell PID) so it is explicit digits at runtime — do not use %J and
+        # do not shlex.quote the path or $$ will not expand. vncserver_wrapper uses pointer file.
+        capture_jobid_target = f'{user_home}/.vnc/myvnc_lsb_jobid.$$'
+        if authenticated_user:
+            loginctl_cmd = f'/usr/bin/loginctl enable-linger {authenticated_user}'
+            if using_container:
+                capture_script = _capture_jobid_script_path(vnc_config)
+                pre_exec = (
+                    f'{loginctl_cmd} && '
+                    f'{shlex.quote(capture_script)} {capture_jobid_target}'
+                )
+                bsub_cmd.extend(['-E', pre_exec])
+                self.logger.info(
+                    "Adding pre-exec: loginctl and capture_jobid.sh -> %s (PID suffix at -E)",
+                    capture_jobid_target.replace('$$', '<PID>'),
+                )
+            else:
+                bsub_cmd.extend(['-E', loginctl_cmd])
+                self.logger.info(f"Adding pre-execution command to enable user lingering: {loginctl_cmd}")
+        elif using_container:
+            capture_script = _capture_jobid_script_path(vnc_config)
+            pre_exec = f'{shlex.quote(capture_script)} {capture_jobid_target}'
+            bsub_cmd.extend(['-E', pre_exec])
+            self.logger.info(
+                "Adding pre-exec: capture_jobid.sh -> %s (PID suffix at -E)",
+                capture_jobid_target.replace('$$', '<PID>'),
+            )
+        
+        
+        # Check if a container is specified for this OS (already retrieved earlier)
+        if using_container:
+            self.logger.info(f"Wrapping vncserver command with singularity container: {container_path}")
+            # Wrap the vncserver command with singularity exec
+            # Build the singularity command with bind mounts for NFS directories
+            # Use --cleanenv to prevent inheriting host environment variables
+            container_cmd = ['singularity', 'exec', '--cleanenv']
+            
+            # Pass environment variables to singularity
+            # This is needed because --cleanenv wipes all environment variables
+            
+            # Always pass USER environment variable
+            if authenticated_user:
+                container_cmd.extend(['--env', f'USER={authenticated_user}'])
+                self.logger.info(f"Passing USER={authenticated_user} to container")
+            
+            
+            if use_custom_xstartup and xstartup_path:
+                container_cmd.extend(['--env', f'WINDOW_MANAGER={window_manager}'])
+                self.logger.info(f"Passing WINDOW_MANAGER={window_manager} to container")
+                
+                # Also pass XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS if available
+                if xdg_runtime_dir:
+                    container_cmd.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
+                    self.logger.info(f"Passing XDG_RUNTIME_DIR={xdg_runtime_dir} to container")
+                if dbus_session_bus_address:
+                    container_cmd.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
+                    self.logger.info(f"Passing DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address} to container")
+            
+            # Add cgroup resource limits to match LSF reservation
+            # This ensures the container respects the resource allocation
+            container_cmd.extend(['--cpus', str(num_cores)])
+            container_cmd.extend(['--memory-reservation', f'{memory_gb}G'])
+            container_cmd.extend(['--memory', f'{memory_gb + 2}G'])
+            container_cmd.extend(['--memory-swap', f'{memory_gb * 2}G'])
+            self.logger.info(f"Setting container cgroup limits: cpus={num_cores}, "
+                           f"memory-reservation={memory_gb}G, memory={memory_gb + 2}G, "
+                           f"memory-swap={memory_gb * 2}G")
+            
+            # Get bind paths from configuration
+            bindpaths_name = lsf_config.get('bindpaths', '')
+            if bindpaths_name:
+                self.logger.info(f"Using configured bindpaths set: {bindpaths_name}")
+                bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
+                
+                if bindpaths:
+                    self.logger.info(f"Found {len(bindpaths)} paths in bindpaths set '{bindpaths_name}'")
+                    for path in bindpaths:
+                        path = path.strip()
+                        if path and os.path.exists(path):
+                            container_cmd.extend(['--bind', f'{path}:{path}'])
+                            self.logger.debug(f"Adding bind mount for: {path}")
+                        else:
+                            self.logger.warning(f"Skipping non-existent bind path: {path}")
+                else:
+                    self.logger.error(f"Bindpaths set '{bindpaths_name}' not found in configuration")
+                    self.logger.warning("No bind mounts will be added - container may not have access to shared filesystems")
+            else:
+                self.logger.warning("No bindpaths specified in configuration")
+                self.logger.warning("No bind mounts will be added - container may not have access to shared filesystems")
+            
+            # Add the container path and inner shell (same argv layout as submit_tmux_job:
+            # bsub ... singularity exec ... image.sif /usr/bin/bash -c '...')
+            container_cmd.append(container_path)
+            
+            # Wrap the vncserver command in bash with sleep infinity
+            # This keeps the container alive after vncserver starts
+            # vncserver daemonizes immediately, so without sleep the container would exit
+            vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
+            inner_bash_cmd = f'unset LSB_QUEUE && {vncserver_cmd_str} && sleep infinity'
+            
+            self.logger.info(f"Container command will keep alive with 'sleep infinity'")
+            
+            container_cmd.extend(['/usr/bin/bash', '-c', inner_bash_cmd])
+            bsub_cmd.extend(container_cmd)
+        else:
+            # No container, prepend unset LSB_QUEUE before the vncserver command
+            vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
+            bsub_cmd.extend(['/usr/bin/bash', '-c', f'unset LSB_QUEUE && {vncserver_cmd_str}'])
+        
+        return SubmissionPlan(bsub_cmd)
+    
     def submit_tmux_job(self, session_config: Dict, lsf_config: Dict, authenticated_user: str = None, server_hostname: str = None) -> str:
         """Submit a tmux job using bsub
         
@@ -850,206 +1176,24 @@ class LSFManager:
         try:
             # Get current user for fallback if no authenticated user
             user = authenticated_user if authenticated_user else os.environ.get('USER', '')
-            user_home = os.path.expanduser(f'~{user}')
-            
-            # Get the full path to bsub
-            bsub_path = self.lsf_cmd_paths.get('bsub', 'bsub')
-            
-            # Extract parameters from config
-            job_name = 'myvnc_tmux'  # Fixed name for all tmux jobs
-            num_cores = int(lsf_config.get('num_cores', 2))
-            memory_gb = float(lsf_config.get('memory_gb', 2.0))
-            
-            # Get session name
-            session_name = session_config.get('name', 'myvnc_tmux_session')
-            # Replace spaces with underscores for tmux session name
-            safe_session_name = session_name.replace(' ', '_')
-            
-            # Get LSF group (queue) to use
-            queue = lsf_config.get('queue', 'interactive')
-            
-            # Format resource request string with span[hosts=1] and rusage[mem=XG]
-            resource_req = f"span[hosts=1] rusage[mem={memory_gb}G]"
-            
-            # Check if a container is specified
-            container_path = lsf_config.get('container', '')
-            using_container = container_path and container_path.strip()
-            
-            # Resolve symlinks in container path to document the actual version
-            if using_container:
-                original_container_path = container_path
-                container_path = os.path.realpath(container_path)
-                if original_container_path != container_path:
-                    self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
-            
-            # Add OS selection if specified (but NOT when using a container)
-            os_select = lsf_config.get('os_select', '')
-            
-            # Add processor architecture selection if specified
-            arch_select = lsf_config.get('arch_select', '')
-            if arch_select and arch_select != "any":
-                self.logger.info(f"Adding architecture selection '{arch_select}' to resource requirements")
-                if resource_req:
-                    resource_req = f"select[{arch_select}] {resource_req}"
-                else:
-                    resource_req = f"select[{arch_select}]"
-            
-            # Modify resource string based on OS selection
-            if using_container:
-                self.logger.info(f"Using container - skipping OS selection constraint (container provides OS environment)")
-            elif os_select and os_select != "any":
-                self.logger.info(f"Adding OS selection '{os_select}' to resource requirements")
-                resource_req = f"select[{os_select}] {resource_req}"
+            user_home = user_credentials(user).home
             
-            self.logger.info(f"Final resource requirements string: '{resource_req}'")
-            
-            # Calculate memory limit using multiplier from configuration
-            # The -M switch sets the memory limit, which can be different from rusage[mem=]
-            memlimit_multiplier = lsf_config.get('memlimit_multiplier', 1.0)
-            memory_limit_gb = int(memory_gb * memlimit_multiplier)
-            self.logger.info(f"Memory limit multiplier: {memlimit_multiplier}x, calculated limit: {memory_limit_gb}G (from {memory_gb}G base)")
-            
-            # Build LSF command
-            bsub_cmd = [
-                'bsub',
-                '-q', queue,
-                '-n', str(num_cores),
-                '-R', resource_req,
-                '-M', f'{memory_limit_gb}G',
-                '-J', job_name
-            ]
-            
-            # Add time limit if specified
-            time_limit = lsf_config.get('time_limit', '')
-            if time_limit and time_limit.strip():
-                bsub_cmd.extend(['-W', time_limit])
-            
-            # Add host filter only if specified
-            host_filter = lsf_config.get('host_filter', '')
-            if host_filter and host_filter.strip():
-                bsub_cmd.extend(['-m', host_filter])
-            
-            # Set the current working directory for the job to the user's home directory
-            bsub_cmd.extend(['-cwd', user_home])
-            self.logger.info(f"Setting LSF working directory: {user_home}")
-            
-            # Add LSF output and error log file paths
+            # Ensure the .tmux directory exists for the LSF log files
             tmux_log_dir = os.path.join(user_home, '.tmux')
-            
-            # Ensure the .tmux directory exists for log file creation
             try:
                 os.makedirs(tmux_log_dir, mode=0o755, exist_ok=True)
                 self.logger.info(f"Ensured .tmux directory exists: {tmux_log_dir}")
             except Exception as e:
                 self.logger.warning(f"Could not create .tmux directory {tmux_log_dir}: {e}")
             
-            # Set LSF log paths
-            stdout_log_path = f'{user_home}/.tmux/myvnc.%J.lsf_stdout.log'
-            stderr_log_path = f'{user_home}/.tmux/myvnc.%J.lsf_stderr.log'
-            
-            bsub_cmd.extend(['-oo', stdout_log_path])
-            bsub_cmd.extend(['-eo', stderr_log_path])
-            
-            self.logger.info(f"Setting LSF stdout log file: {stdout_log_path}")
-            self.logger.info(f"Setting LSF stderr log file: {stderr_log_path}")
+            # Only the user and the session name differ between launches of the same configuration
+            values = self._submission_values(user, user_home, authenticated_user,
+                                             session_config.get('name', 'myvnc_tmux_session'))
+            plan = self._submission_plan('tmux', self._compile_tmux_submission, session_config, lsf_config, values,
+                                         bool(authenticated_user))
+            bsub_cmd, _ = plan.render(values)
+            bsub_cmd = self._with_placement_hint(bsub_cmd, lsf_config)
             
-            # Add loginctl enable-linger command
-            if authenticated_user:
-                loginctl_cmd = f'/usr/bin/loginctl enable-linger {authenticated_user}'
-                bsub_cmd.extend(['-E', loginctl_cmd])
-                self.logger.info(f"Adding pre-execution command to enable user lingering: {loginctl_cmd}")
-            
-            # Get environment variables for container (XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS)
-            user_uid = None
-            xdg_runtime_dir = None
-            dbus_session_bus_address = None
-            
-            # Get the UID for the authenticated user to set XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS
-            if using_container and authenticated_user:
-                try:
-                    # Get UID for the authenticated user
-                    uid_result = subprocess.run(['id', '-u', authenticated_user], 
-                                               check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                    user_uid = uid_result.stdout.decode('utf-8').strip()
-                    
-                    # Calculate XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS
-                    xdg_runtime_dir = f'/run/user/{user_uid}'
-                    dbus_session_bus_address = f'unix:path=/run/user/{user_uid}/bus'
-                    
-                    self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
-                    self.logger.debug(f"XDG_RUNTIME_DIR={xdg_runtime_dir}")
-                    self.logger.debug(f"DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}")
-                except subprocess.CalledProcessError as e:
-                    self.logger.error(f"Failed to get UID for user {authenticated_user}: {e.stderr.decode('utf-8')}")
-                    self.logger.warning("Continuing without XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS")
-                except Exception as e:
-                    self.logger.error(f"Error getting UID for user {authenticated_user}: {str(e)}")
-                    self.logger.warning("Continuing without XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS")
-            
-            # Add environment variables to bsub command for container sessions
-            if using_container:
-                env_vars = []
-                if xdg_runtime_dir:
-                    env_vars.append(f'XDG_RUNTIME_DIR={xdg_runtime_dir}')
-                if dbus_session_bus_address:
-                    env_vars.append(f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}')
-                
-                if env_vars:
-                    env_string = ','.join(env_vars)
-                    bsub_cmd.extend(['-env', env_string])
-                    self.logger.info(f"Adding environment variables to bsub: {env_string}")
-            
-            # Build the tmux command
-            # Start a new tmux session in detached mode, then monitor it
-            # The while loop keeps the job alive while tmux session exists
-            # When the session is closed/exited, the loop exits and the job terminates
-            tmux_cmd = f'unset LSB_QUEUE && /usr/bin/tmux new-session -d -s {safe_session_name} && while /usr/bin/tmux has-session -t {safe_session_name} 2>/dev/null; do sleep 5; done'
-            
-            # Check if a container is specified
-            if using_container:
-                self.logger.info(f"Wrapping tmux command with singularity container: {container_path}")
-                container_cmd = ['singularity', 'exec', '--cleanenv']
-                
-                # Always pass USER environment variable
-                if authenticated_user:
-                    container_cmd.extend(['--env', f'USER={authenticated_user}'])
-                    self.logger.info(f"Passing USER={authenticated_user} to container")
-                
-                # Pass XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS if available
-                # These are required for container sessions to work properly
-                if xdg_runtime_dir:
-                    container_cmd.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
-                    self.logger.info(f"Passing XDG_RUNTIME_DIR={xdg_runtime_dir} to container")
-                if dbus_session_bus_address:
-                    container_cmd.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
-                    self.logger.info(f"Passing DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address} to container")
-                
-                # Add cgroup resource limits to match LSF reservation
-                container_cmd.extend(['--cpus', str(num_cores)])
-                container_cmd.extend(['--memory-reservation', f'{memory_gb}G'])
-                container_cmd.extend(['--memory', f'{memory_gb + 2}G'])
-                container_cmd.extend(['--memory-swap', f'{memory_gb * 2}G'])
-                
-                # Get bind paths from configuration
-                bindpaths_name = lsf_config.get('bindpaths', '')
-                if bindpaths_name:
-                    self.logger.info(f"Using configured bindpaths set: {bindpaths_name}")
-                    bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
-                    
-                    if bindpaths:
-                        for path in bindpaths:
-                            path = path.strip()
-                            if path and os.path.exists(path):
-                                container_cmd.extend(['--bind', f'{path}:{path}'])
-                
-                # Add the container path and command
-                container_cmd.append(container_path)
-                container_cmd.extend(['/usr/bin/bash', '-c', tmux_cmd])
-                
-                bsub_cmd.extend(container_cmd)
-            else:
-                # No container, execute tmux directly with bash
-                bsub_cmd.extend(['/usr/bin/bash', '-c', tmux_cmd])
             
             # Convert command list to string for logging
             cmd_str = ' '.join(str(arg) for arg in bsub_cmd)
@@ -1074,6 +1218,7 @@ class LSFManager:
                 job_id = job_id_match.group(1) if job_id_match else 'unknown'
                 
                 self.logger.info(f"tmux job submitted successfully, ID: {job_id}")
+                self._record_submit(job_id, user, 'tmux', session_config, lsf_config)
                 
                 return job_id
                 
@@ -1100,6 +1245,221 @@ class LSFManager:
                 })
             raise
     
+    def _compile_tmux_submission(self, session_config: Dict, lsf_config: Dict, values: Dict[str, Optional[str]],
+                                 authenticated: bool) -> SubmissionPlan:
+        """Build the bsub command of a tmux job
+        
+        Args:
+            session_config: Session configuration (name, site, etc.)
+            lsf_config: LSF configuration (queue, cores, memory, etc.)
+            values: The per-launch fields (user, home, uid, name), real values or placeholders
+            authenticated: Whether the job is submitted for an authenticated user
+            
+        Returns:
+            SubmissionPlan of the bsub command
+        """
+        user_home = values['home']
+        user_uid = values['uid']
+        safe_session_name = values['name'] or ''
+        authenticated_user = values['user'] if authenticated else None
+        
+        # Extract parameters from config
+        job_name = 'myvnc_tmux'  # Fixed name for all tmux jobs
+        num_cores = int(lsf_config.get('num_cores', 2))
+        memory_gb = float(lsf_config.get('memory_gb', 2.0))
+        
+        # Get LSF group (queue) to use
+        queue = lsf_config.get('queue', 'interactive')
+        
+        # Format resource request string with span[hosts=1] and rusage[mem=XG]
+        resource_req = f"span[hosts=1] rusage[mem={memory_gb}G]"
+        
+        # Check if a container is specified
+        container_path = lsf_config.get('container', '')
+        using_container = container_path and container_path.strip()
+        
+        # Resolve symlinks in container path to document the actual version
+        if using_container:
+            original_container_path = container_path
+            container_path = os.path.realpath(container_path)
+            if original_container_path != container_path:
+                self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
+        
+        # Add OS selection if specified (but NOT when using a container)
+        os_select = lsf_config.get('os_select', '')
+        
+        # Add processor architecture selection if specified
+        arch_select = lsf_config.get('arch_select', '')
+        if arch_select and arch_select != "any":
+            self.logger.info(f"Adding architecture selection '{arch_select}' to resource requirements")
+            if resource_req:
+                resource_req = f"select[{arch_select}] {resource_req}"
+            else:
+                resource_req = f"select[{arch_select}]"
+        
+        # Modify resource string based on OS selection
+        if using_container:
+            self.logger.info(f"Using container - skipping OS selection constraint (container provides OS environment)")
+        elif os_select and os_select != "any":
+            self.logger.info(f"Adding OS selection '{os_select}' to resource requirements")
+            resource_req = f"select[{os_select}] {resource_req}"
+        
+        self.logger.info(f"Final resource requirements string: '{resource_req}'")
+        
+        # Calculate memory limit using multiplier from configuration
+        # The -M switch sets the memory limit, which can be different from rusage[mem=]
+        memlimit_multiplier = lsf_config.get('memlimit_multiplier', 1.0)
+        memory_limit_gb = int(memory_gb * memlimit_multiplier)
+        self.logger.info(f"Memory limit multiplier: {memlimit_multiplier}x, calculated limit: {memory_limit_gb}G (from {memory_gb}G base)")
+        
+        # Build LSF command
+        bsub_cmd = [
+            'bsub',
+            '-q', queue,
+            '-n', str(num_cores),
+            '-R', resource_req,
+            '-M', f'{memory_limit_gb}G',
+            '-J', job_name
+        ]
+        
+        # Add time limit if specified
+        time_limit = lsf_config.get('time_limit', '')
+        if time_limit and time_limit.strip():
+            bsub_cmd.extend(['-W', time_limit])
+        
+        # Add host filter only if specified
+        host_filter = lsf_config.get('host_filter', '')
+        if host_filter and host_filter.strip():
+            bsub_cmd.extend(['-m', host_filter])
+        
+        # Set the current working directory for the job to the user's home directory
+        bsub_cmd.extend(['-cwd', user_home])
+        self.logger.info(f"Setting LSF working directory: {user_home}")
+        
+        # Add LSF output and error log file paths
+        # Set LSF log paths
+        stdout_log_path = f'{user_home}/.tmux/myvnc.%J.lsf_stdout.log'
+        stderr_log_path = f'{user_home}/.tmux/myvnc.%J.lsf_stderr.log'
+        
+        bsub_cmd.extend(['-oo', stdout_log_path])
+        bsub_cmd.extend(['-eo', stderr_log_path])
+        
+        self.logger.info(f"Setting LSF stdout log file: {stdout_log_path}")
+        self.logger.info(f"Setting LSF stderr log file: {stderr_log_path}")
+        
+        # Add loginctl enable-linger command
+        if authenticated_user:
+            loginctl_cmd = f'/usr/bin/loginctl enable-linger {authenticated_user}'
+            bsub_cmd.extend(['-E', loginctl_cmd])
+            self.logger.info(f"Adding pre-execution command to enable user lingering: {loginctl_cmd}")
+        
+        # Get environment variables for container (XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS)
+        xdg_runtime_dir = None
+        dbus_session_bus_address = None
+        if using_container and user_uid:
+            xdg_runtime_dir = f'/run/user/{user_uid}'
+            dbus_session_bus_address = f'unix:path=/run/user/{user_uid}/bus'
+            self.logger.debug(f"XDG_RUNTIME_DIR={xdg_runtime_dir}")
+            self.logger.debug(f"DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}")
+        
+        # Add environment variables to bsub command for container sessions
+        if using_container:
+            env_vars = []
+            if xdg_runtime_dir:
+                env_vars.append(f'XDG_RUNTIME_DIR={xdg_runtime_dir}')
+            if dbus_session_bus_address:
+                env_vars.append(f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}')
+            
+            if env_vars:
+                env_string = ','.join(env_vars)
+                bsub_cmd.extend(['-env', env_string])
+                self.logger.info(f"Adding environment variables to bsub: {env_string}")
+        
+        # Build the tmux command
+        # Start a new tmux session in detached mode, then monitor it
+        # The while loop keeps the job alive while tmux session exists
+        # When the session is closed/exited, the loop exits and the job terminates
+        tmux_cmd = f'unset LSB_QUEUE && /usr/bin/tmux new-session -d -s {safe_session_name} && while /usr/bin/tmux has-session -t {safe_session_name} 2>/dev/null; do sleep 5; done'
+        
+        # Check if a container is specified
+        if using_container:
+            self.logger.info(f"Wrapping tmux command with singularity container: {container_path}")
+            container_cmd = ['singularity', 'exec', '--cleanenv']
+            
+            # Always pass USER environment variable
+            if authenticated_user:
+                container_cmd.extend(['--env', f'USER={authenticated_user}'])
+                self.logger.info(f"Passing USER={authenticated_user} to container")
+            
+            # Pass XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS if available
+            # These are required for container sessions to work properly
+            if xdg_runtime_dir:
+                container_cmd.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
+                self.logger.info(f"Passing XDG_RUNTIME_DIR={xdg_runtime_dir} to container")
+            if dbus_session_bus_address:
+                container_cmd.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
+                self.logger.info(f"Passing DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address} to container")
+            
+            # Add cgroup resource limits to match LSF reservation
+            container_cmd.extend(['--cpus', str(num_cores)])
+            container_cmd.extend(['--memory-reservation', f'{memory_gb}G'])
+            container_cmd.extend(['--memory', f'{memory_gb + 2}G'])
+            container_cmd.extend(['--memory-swap', f'{memory_gb * 2}G'])
+            
+            # Get bind paths from configuration
+            bindpaths_name = lsf_config.get('bindpaths', '')
+            if bindpaths_name:
+                self.logger.info(f"Using configured bindpaths set: {bindpaths_name}")
+                bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
+                
+                if bindpaths:
+                    for path in bindpaths:
+                        path = path.strip()
+                        if path and os.path.exists(path):
+                            container_cmd.extend(['--bind', f'{path}:{path}'])
+            
+            # Add the container path and command
+            container_cmd.append(container_path)
+            container_cmd.extend(['/usr/bin/bash', '-c', tmux_cmd])
+            
+            bsub_cmd.extend(container_cmd)
+        else:
+            # No container, execute tmux directly with bash
+            bsub_cmd.extend(['/usr/bin/bash', '-c', tmux_cmd])
+        
+        return SubmissionPlan(bsub_cmd)
+    
+    def submit_jobs(self, session_type: str, session_config: Dict, lsf_config: Dict, users: List[str],
+                    server_hostname: str = None) -> Dict[str, Dict]:
+        """Submit the same VNC or tmux session for several users, e.g. a manager launching a team's sessions
+        
+        The submissions share one compiled plan and run BATCH_SUBMIT_PARALLEL
+        at a time.
+        
+        Args:
+            session_type: 'vnc' or 'tmux'
+            session_config: Session configuration, as for submit_vnc_job / submit_tmux_job
+            lsf_config: LSF configuration
+            users: Users to submit a session for (duplicates are submitted once)
+            server_hostname: Server hostname for error messages
+            
+        Returns:
+            Dict mapping each user to {'job_id': ...} or {'error': ...}
+        """
+        submit = self.submit_tmux_job if session_type == 'tmux' else self.submit_vnc_job
+        users = list(dict.fromkeys(users))
+        results = {}
+        for start in range(0, len(users), BATCH_SUBMIT_PARALLEL):
+            futures = {user: self.call_async(submit, session_config, lsf_config, user, server_hostname=server_hostname)
+                       for user in users[start:start + BATCH_SUBMIT_PARALLEL]}
+            for user, future in futures.items():
+                try:
+                    results[user] = {'job_id': future.result()}
+                except Exception as e:
+                    self.logger.error(f"Batch {session_type} submission for {user} failed: {str(e)}")
+                    results[user] = {'error': str(e)}
+        return results
+    
     def get_job_owner(self, job_id: str, authenticated_user: str = None) -> Optional[str]:
         """
         Get the owner (user) of a specific job ID
@@ -1166,9 +1526,159 @@ class LSFManager:
         """
         Get active VNC jobs for the current user with job name matching the config
         
+        With 'job_snapshot' enabled the jobs come from the shared snapshot
+        instead of a bjobs run per call.
+        
+        Args:
+            authenticated_user: Optional authenticated username to run command as
+            all_users: Whether to include jobs from all users
+            
+        Returns:
+            List of jobs as dictionaries
+        """
+        if not self.job_snapshot:
+            return self._list_active_vnc_jobs(authenticated_user, all_users=all_users)
+        
+        try:
+            if all_users:
+                return self.job_snapshot.view()
+            return self.job_snapshot.view(authenticated_user if authenticated_user else os.environ.get('USER', ''))
+        except Exception as e:
+            self.logger.error(f"Error retrieving VNC jobs: {str(e)}")
+            return []
+    
+    def _with_placement_hint(self, bsub_cmd: List[str], lsf_config: Dict, slot: Optional[PoolSlot] = None) -> List[str]:
+        """
+        Add a -m preference for the host of a claimed warm pool slot, or else
+        for the least loaded hosts of the queue, unless the configuration picks hosts
+        """
+        if slot is not None:
+            hint = ['-m', f'{slot.host}+1 others']
+        elif not self.host_load or (lsf_config.get('host_filter') or '').strip():
+            return bsub_cmd
+        else:
+            hint = self.host_load.lsf_hint(lsf_config.get('queue', 'interactive'))
+        if hint:
+            self.logger.info(f"Placement hint: {' '.join(hint)}")
+        return bsub_cmd[:1] + hint + bsub_cmd[1:]
+    
+    def _record_submit(self, job_id: str, user: str, session_type: str, session_config: Dict, lsf_config: Dict,
+                       slot: Optional[PoolSlot] = None):
+        """Start a submitted session's timeline"""
+        if self.session_timeline:
+            self.session_timeline.record(job_id, 'submit', user=user, queue=lsf_config.get('queue', 'interactive'),
+                                         site=session_config.get('site'),
+                                         desktop=session_config.get('window_manager') if session_type == 'vnc' else 'tmux',
+                                         session_type=session_type, pooled=slot is not None)
+    
+    def _observe_listing(self, jobs: List[Dict]):
+        """Hand a job listing to the warm pool and session timeline, which time session starts from it"""
+        if self.warm_pool:
+            self.warm_pool.observe(jobs)
+        if self.session_timeline:
+            self.session_timeline.observe(jobs, self.display_collector)
+    
+    def _claim_pool_slot(self, vnc_config: Dict, lsf_config: Dict) -> Optional[PoolSlot]:
+        """A running warm pool holder for the request, unless the configuration picks hosts"""
+        if not self.warm_pool or (lsf_config.get('host_filter') or '').strip():
+            return None
+        return self.warm_pool.claim(vnc_config, lsf_config)
+    
+    def _list_pool_holders(self) -> List[PoolSlot]:
+        """The warm pool account's holder jobs"""
+        try:
+            with deadline_scope(None):
+                output = self._run_command(['bjobs', '-w', '-J', f'{HOLDER_PREFIX}*', '-noheader',
+                                            '-o', 'jobid stat exec_host job_name'], self.warm_pool_user)
+        except LSFError as e:
+            if 'not found' in str(e) or 'job found' in str(e):
+                return []
+            raise
+        holders = []
+        for line in output.splitlines():
+            fields = line.split()
+            if len(fields) < 4:
+                continue
+            # exec_host is '-' while pending, 'host' or 'slots*host' once running
+            host = fields[2].split(':')[0].split('*')[-1]
+            holders.append(PoolSlot(fields[0], fields[3], fields[1], host if host != '-' else None))
+        return holders
+    
+    def _submit_pool_holder(self, name: str, profile: Dict, seconds: int):
+        """Submit a warm pool holder with the profile's queue, cores, memory and OS selection"""
+        memory_gb = float(profile.get('memory_gb', 2.0))
+        resource_req = f"span[hosts=1] rusage[mem={memory_gb}G]"
+        os_select = profile.get('os_select')
+        if os_select and os_select != 'any':
+            resource_req = f"select[{os_select}] {resource_req}"
+        with deadline_scope(None):
+            self._run_command(['bsub', '-q', profile.get('queue', 'interactive'),
+                               '-n', str(int(profile.get('num_cores', 2))), '-R', resource_req, '-J', name,
+                               '-o', '/dev/null', '-e', '/dev/null', 'sleep', str(seconds)], self.warm_pool_user)
+    
+    def _release_pool_holder(self, slot: PoolSlot):
+        with deadline_scope(None):
+            self._run_command(['bkill', slot.job_id], self.warm_pool_user)
+    
+    def _fetch_host_load(self) -> List[HostLoad]:
+        """CPU utilisation and free memory of every host from lsload, against lshosts' maxmem"""
+        with deadline_scope(None):
+            load_out, hosts_out = self._run_commands([['lsload', '-w', '-I', 'ut:mem'], ['lshosts', '-w']])
+        if load_out is None:
+            raise LSFError("lsload failed")
+        
+        def rows(output):
+            lines = [line.split() for line in (output or '').splitlines() if line.strip()]
+            if not lines:
+                return []
+            header = lines[0]
+            return [dict(zip(header, fields)) for fields in lines[1:]]
+        
+        max_mem = {}
+        for row in rows(hosts_out):
+            size = parse_size_mb(row.get('maxmem', ''))
+            if row.get('HOST_NAME') and size:
+                max_mem[row['HOST_NAME']] = size
+        
+        hosts = []
+        for row in rows(load_out):
+            name = row.get('HOST_NAME')
+            if not name:
+                continue
+            ut = row.get('ut', '').rstrip('%')
+            try:
+                cpu = float(ut) / 100.0
+            except ValueError:
+                cpu = None
+            free = parse_size_mb(row.get('mem', ''))
+            total = max_mem.get(name)
+            mem_used = max(0.0, 1.0 - free / total) if free is not None and total else None
+            hosts.append(HostLoad(name, row.get('status', '').lower() == 'ok', cpu, mem_used))
+        return hosts
+    
+    def _fetch_host_sessions(self) -> List[Dict]:
+        """All users' sessions, from the snapshot when there is one"""
+        if self.job_snapshot:
+            return self.job_snapshot.view()
+        return self._fetch_job_snapshot()
+    
+    def _fetch_job_snapshot(self) -> List[Dict]:
+        """List all users' jobs for the shared snapshot, raising if bjobs fails"""
+        # Shared by every waiting request, so the deadline of the one that
+        # happened to start the refresh does not apply
+        with deadline_scope(None):
+            return self._list_active_vnc_jobs(self.job_snapshot_user, all_users=True, raise_errors=True)
+    
+    def _list_active_vnc_jobs(self, authenticated_user: str = None, all_users: bool = False,
+                              raise_errors: bool = False) -> List[Dict]:
+        """
+        Run bjobs and parse the active VNC/tmux jobs
+        
         Args:
             authenticated_user: Optional authenticated username to run command as
             all_users: Whether to include jobs from all users
+            raise_errors: Raise instead of returning an empty list when bjobs
+                fails for a reason other than there being no jobs
             
         Returns:
             List of jobs as dictionaries
@@ -1211,81 +1721,56 @@ class LSFManager:
             }
             self.command_history.append(cmd_entry)
             
-            try:
-                # Use _run_command which will handle sudo and full paths
-                output_str = self._run_command(cmd, authenticated_user)
-                cmd_entry['stdout'] = output_str
-                cmd_entry['success'] = True
-                
-                # Log success
-                if output_str:
-                    for line in output_str.splitlines():
-                        self.logger.info(f"  {line}")
-                        
-            except RuntimeError as e:
-                # Handle command failure
-                error_str = str(e)
-                cmd_entry['stderr'] = error_str
-                
-                # Check for delimiter error and fall back if needed
-                if "delimiter" in error_str and "Illegal job ID" in error_str:
-                    # Older LSF versions don't support the delimiter parameter
-                    # Fall back to standard bjobs command
-                    self.logger.warning(f"LSF version doesn't support delimiter: {error_str}")
-                    return self._get_active_vnc_jobs_standard(authenticated_user, all_users=all_users)
-                else:
-                    # For other errors, just fail
-                    self.logger.error(f"Error executing command: {error_str}")
-                    return []
-                
-            # Parse the output
-            output_lines = output_str.strip().split('\n')
-            for line in output_lines:
+            # Per-job details are only logged for the listings tracing samples
+            log_row = self.logger.info if tracer.verbose(f"{cmd[0]} rows") else (lambda message: None)
+            
+            # Parse the output as bjobs produces it (_stream_command handles
+            # sudo and full paths); a bjobs failure is raised from the loop
+            # once its exit status arrives. job_table skips empty lines and
+            # splits each row into 11 columns.
+            # Note: job_name is the LAST field and the command field (column 9)
+            # may contain semicolons, so the command absorbs any extra fields
+            output_chunks = self._stream_command(cmd, authenticated_user, raw=True)
+            for num_parts, parts in job_table.iter_rows(output_chunks, ';', 11, greedy_col=9):
                 try:
-                    # Skip empty lines
-                    if not line.strip():
-                        continue
-                    
-                    # Split by delimiter
-                    parts = line.split(';')
-                    
                     # Older LSF versions might not honor the delimiter
                     # Validate the output has at least a few fields
-                    if len(parts) < 5:
+                    if num_parts < 5:
                         self.logger.warning(f"Output format seems incorrect, falling back to standard format")
                         return self._get_active_vnc_jobs_standard(authenticated_user, all_users=all_users)
                     
                     # Extract fields
-                    # Note: job_name is the LAST field, so we extract it from the end
-                    # The command field may contain semicolons which interfere with delimiter parsing
                     job_id = parts[0]
                     status = parts[1]
                     job_user = parts[2] 
                     queue = parts[3]
                     first_host = parts[4]
-                    run_time = parts[5] if len(parts) > 5 else "0:0"
-                    slots = parts[6] if len(parts) > 6 else None
-                    max_req_proc = parts[7] if len(parts) > 7 else None
-                    combined_resreq = parts[8] if len(parts) > 8 else ""
+                    run_time = parts[5] if num_parts > 5 else "0:0"
+                    slots = parts[6] if num_parts > 6 else None
+                    max_req_proc = parts[7] if num_parts > 7 else None
+                    combined_resreq = parts[8]
                     
-                    # job_name is the last field (after command)
-                    job_name = parts[-1].strip() if len(parts) > 10 else ""
+                    # job_name is the last field (after command), empty if the row is short
+                    job_name = parts[10].strip()
                     
                     # command is everything between combined_resreq and job_name
-                    # Rejoin parts[9] through parts[-2] to reconstruct the command with any semicolons it contains
-                    command = ';'.join(parts[9:-1]) if len(parts) > 10 else (parts[9] if len(parts) > 9 else "")
+                    command = parts[9]
                     
-                    self.logger.info(f"Job {job_id}: status={status}, user={job_user}, host={first_host}")
-                    self.logger.info(f"Job {job_id}: EXTRACTED job_name='{job_name}' (from parts[-1]), num_parts={len(parts)}")
-                    self.logger.info(f"Job {job_id}: command preview: {command[:100] if command else 'N/A'}...")
+                    log_row(f"Job {job_id}: status={status}, user={job_user}, host={first_host}")
+                    log_row(f"Job {job_id}: EXTRACTED job_name='{job_name}' (from parts[-1]), num_parts={num_parts}")
+                    log_row(f"Job {job_id}: command preview: {command[:100] if command else 'N/A'}...")
                     
-                    # Format run time
-                    run_time_parts = run_time.split(':')
+                    # Format run time; bjobs (and the libbat backend) print
+                    # "N second(s)", older releases H:MM or H:MM:SS
                     run_time_seconds = 0
                     try:
-                        hours = int(run_time_parts[0])
-                        minutes = int(run_time_parts[1])
-                        run_time_seconds = hours * 3600 + minutes * 60
+                        if 'second' in run_time:
+                            run_time_seconds = int(run_time.split()[0])
+                        else:
+                            run_time_parts = [int(part) for part in run_time.split(':')]
+                            run_time_parts += [0] * (3 - len(run_time_parts))
+                            run_time_seconds = run_time_parts[0] * 3600 + run_time_parts[1] * 60 + run_time_parts[2]
+                        hours, minutes = run_time_seconds // 3600, run_time_seconds % 3600 // 60
                         
                         # Format for display
                         if hours > 24:
@@ -1348,7 +1833,7 @@ class LSFManager:
                     # First check if a container is being used (look for .sif in command)
                     container_used = False
                     if command and '.sif' in command:
-                        self.logger.info(f"[OS_EXTRACT] Job {job_id}: Container detected in command")
+                        log_row(f"[OS_EXTRACT] Job {job_id}: Container detected in command")
                         try:
                             os_options = self.config_manager.lsf_config.get('os_options', [])
                             
@@ -1366,7 +1851,7 @@ class LSFManager:
                                         os_name = f"{name} ({description})"
                                     else:
                                         os_name = name
-                                    self.logger.info(f"[OS_EXTRACT] Matched container: {container_path} -> {os_name}")
+                                    log_row(f"[OS_EXTRACT] Matched container: {container_path} -> {os_name}")
                                     container_used = True
                                     break
                             
@@ -1375,7 +1860,7 @@ class LSFManager:
                                 sif_match = re.search(r'([^/\s]+\.sif)', command)
                                 if sif_match:
                                     os_name = f"Container ({sif_match.group(1)})"
-                                    self.logger.info(f"[OS_EXTRACT] Unknown container: {os_name}")
+                                    log_row(f"[OS_EXTRACT] Unknown container: {os_name}")
                                     container_used = True
                         except Exception as e:
                             self.logger.warning(f"[OS_EXTRACT] Error extracting container info: {str(e)}")
@@ -1385,10 +1870,10 @@ class LSFManager:
                         # Look for OS selection patterns in combined_resreq
                         # The format can be: select[(rh810) && (type == any )] or select[rh810] etc.
                         # We need to extract just the OS identifier (rh810, rh96, c7, etc.)
-                        self.logger.info(f"[OS_EXTRACT] Job {job_id}: combined_resreq='{combined_resreq}'")
+                        log_row(f"[OS_EXTRACT] Job {job_id}: combined_resreq='{combined_resreq}'")
                         try:
                             os_options = self.config_manager.lsf_config.get('os_options', [])
-                            self.logger.info(f"[OS_EXTRACT] Available OS options: {[opt.get('select') for opt in os_options]}")
+                            log_row(f"[OS_EXTRACT] Available OS options: {[opt.get('select') for opt in os_options]}")
                             
                             # Try to match each known OS select value in the combined_resreq
                             for os_option in os_options:
@@ -1405,16 +1890,16 @@ class LSFManager:
                                         os_name = f"{name} ({description})"
                                     else:
                                         os_name = name
-                                    self.logger.info(f"[OS_EXTRACT] Matched OS: {os_select} -> {os_name}")
+                                    log_row(f"[OS_EXTRACT] Matched OS: {os_select} -> {os_name}")
                                     break
                             
                             if os_name == 'N/A':
-                                self.logger.info(f"[OS_EXTRACT] No OS match found in combined_resreq: '{combined_resreq}'")
+                                log_row(f"[OS_EXTRACT] No OS match found in combined_resreq: '{combined_resreq}'")
                         except Exception as e:
                             self.logger.warning(f"[OS_EXTRACT] Error mapping OS selection: {str(e)}")
                             os_name = 'N/A'
                     elif not container_used:
-                        self.logger.info(f"[OS_EXTRACT] Job {job_id}: combined_resreq is empty")
+                        log_row(f"[OS_EXTRACT] Job {job_id}: combined_resreq is empty")
                     
                     # Get VNC connection details
                     display = None
@@ -1436,16 +1921,16 @@ class LSFManager:
                     # Determine session type from job_name first
                     session_type = "Unknown"
                     job_name_clean = job_name.strip() if job_name else ""
-                    self.logger.info(f"Job {job_id} BEFORE SESSION TYPE CHECK: job_name_clean='{job_name_clean}', len={len(job_name_clean)}, repr={repr(job_name_clean)}")
+                    log_row(f"Job {job_id} BEFORE SESSION TYPE CHECK: job_name_clean='{job_name_clean}', len={len(job_name_clean)}, repr={repr(job_name_clean)}")
                     if job_name_clean == "myvnc_vncserver":
                         session_type = "VNC"
-                        self.logger.info(f"Job {job_id} matched VNC session")
+                        log_row(f"Job {job_id} matched VNC session")
                     elif job_name_clean == "myvnc_tmux":
                         session_type = "tmux"
-                        self.logger.info(f"Job {job_id} matched tmux session")
+                        log_row(f"Job {job_id} matched tmux session")
                     else:
                         self.logger.warning(f"Job {job_id} NO MATCH - job_name_clean='{job_name_clean}' (expected 'myvnc_vncserver' or 'myvnc_tmux')")
-                    self.logger.info(f"Job {job_id} FINAL session type: {session_type}")
+                    log_row(f"Job {job_id} FINAL session type: {session_type}")
                     
                     # Default display name
                     display_name = "VNC Session" if session_type == "VNC" else "tmux Session"
@@ -1471,12 +1956,12 @@ class LSFManager:
                     # actual display posted by vncserver_wrapper.
                     # bpost gives a low display number (e.g. :2) used directly.
                     if session_type == "VNC" and status == "RUN":
-                        bpost_display = self._get_bpost_display(job_id)
+                        bpost_display = self._get_bpost_display(job_id, job_user)
                         if bpost_display:
                             display_num = int(bpost_display)
                             display = display_num
                             port = display_num
-                            self.logger.info(f"Using bpost display for job {job_id}: :{display_num}")
+                            log_row(f"Using bpost display for job {job_id}: :{display_num}")
 
                     # Fallback: extract display from the command string (for older jobs
                     # that were submitted with an explicit :N display argument).
@@ -1489,7 +1974,7 @@ class LSFManager:
                             display_num = int(display_match.group(1))
                             display = display_num
                             port = 5900 + display_num
-                            self.logger.info(f"Found display number from command for job {job_id}: :{display_num}")
+                            log_row(f"Found display number from command for job {job_id}: :{display_num}")
 
                     # tmux: no execution host until dispatched — LSF may still fill first_host with
                     # placeholders or submission metadata; clear so clients don't enable SSH/Connect.
@@ -1514,7 +1999,7 @@ class LSFManager:
                         'os': os_name,  # Add the OS name
                         'session_type': session_type  # Add the session type
                     }
-                    self.logger.info(f"Job {job_id} CREATED JOB DICT with session_type='{session_type}'")
+                    log_row(f"Job {job_id} CREATED JOB DICT with session_type='{session_type}'")
                     
                     # Add resource information based on what we found
                     if resources_unknown:
@@ -1543,9 +2028,34 @@ class LSFManager:
                     
                 except Exception as e:
                     self.logger.error(f"Error processing job: {str(e)}")
+            
+            cmd_entry['success'] = True
+        except LSFError as e:
+            # Handle command failure
+            error_str = str(e)
+            cmd_entry['stderr'] = error_str
+            
+            # Check for delimiter error and fall back if needed
+            if "delimiter" in error_str and "Illegal job ID" in error_str:
+                # Older LSF versions don't support the delimiter parameter
+                # Fall back to standard bjobs command
+                self.logger.warning(f"LSF version doesn't support delimiter: {error_str}")
+                return self._get_active_vnc_jobs_standard(authenticated_user, all_users=all_users)
+            elif 'not found' in error_str or 'job found' in error_str:
+                # "Job <myvnc_*> is not found" / "No unfinished job found": there are no jobs
+                return []
+            else:
+                # For other errors, just fail
+                self.logger.error(f"Error executing command: {error_str}")
+                if raise_errors:
+                    raise
+                return []
         except Exception as e:
             self.logger.error(f"Error retrieving VNC jobs: {str(e)}")
+            if raise_errors:
+                raise
         
+        self._observe_listing(jobs)
         return jobs
     
     def _get_active_vnc_jobs_standard(self, authenticated_user: str = None, all_users: bool = False) -> List[Dict]:
@@ -1894,7 +2404,7 @@ class LSFManager:
                         job_status = fields[1].strip()
 
                         if job_status == "RUN":
-                            bpost_display = self._get_bpost_display(job_id)
+                            bpost_display = self._get_bpost_display(job_id, fields[2].strip())
                             if bpost_display:
                                 display = int(bpost_display)
                                 port = display
@@ -1920,6 +2430,15 @@ class LSFManager:
         
         return jobs
             
+    def _connection_details_cmd(self, job_id: str) -> List[str]:
+        """bjobs query used for a job's connection details"""
+        return [
+            'bjobs', 
+            '-o', "stat:6 user:8 exec_host:25 slots:5 max_req_proc:5 combined_resreq:50 command:100 job_name delimiter=';'", 
+            '-noheader', 
+            job_id
+        ]
+
     def get_vnc_connection_details(self, job_id: str, authenticated_user: str = None) -> Optional[Dict]:
         """
         Get connection details for a VNC job
@@ -1934,13 +2453,31 @@ class LSFManager:
         try:
             # Get all necessary information with a single comprehensive command
             self.logger.info(f"Getting connection details for job {job_id}")
-            comprehensive_output = self._run_command([
-                'bjobs', 
-                '-o', "stat:6 user:8 exec_host:25 slots:5 max_req_proc:5 combined_resreq:50 command:100 job_name delimiter=';'", 
-                '-noheader', 
-                job_id
-            ], authenticated_user)
+            comprehensive_output = self._run_command(self._connection_details_cmd(job_id), authenticated_user)
+        except Exception as e:
+            self.logger.error(f"Failed to get VNC connection details: {str(e)}")
+            return None
+        return self._parse_connection_details(job_id, comprehensive_output)
+
+    def get_vnc_connection_details_many(self, job_ids: List[str], authenticated_user: str = None) -> Dict[str, Optional[Dict]]:
+        """
+        Get connection details for several VNC jobs with one setuid_runner batch
+        
+        Args:
+            job_ids: Job IDs to look up
+            authenticated_user: Optional authenticated username to run commands as
             
+        Returns:
+            Dictionary mapping each job ID to its connection details, or None if not found
+        """
+        self.logger.info(f"Getting connection details for {len(job_ids)} jobs")
+        outputs = self._run_commands([self._connection_details_cmd(job_id) for job_id in job_ids], authenticated_user)
+        return {job_id: self._parse_connection_details(job_id, output) if output is not None else None
+                for job_id, output in zip(job_ids, outputs)}
+
+    def _parse_connection_details(self, job_id: str, comprehensive_output: str) -> Optional[Dict]:
+        """Build connection details for a job from its _connection_details_cmd output"""
+        try:
             # Initialize values
             host = None
             user = None
@@ -2061,7 +2598,7 @@ class LSFManager:
             # bpost gives a low display number (e.g. :2) used directly.
             from_bpost = False
             if status == "RUN":
-                bpost_display = self._get_bpost_display(job_id)
+                bpost_display = self._get_bpost_display(job_id, user)
                 if bpost_display:
                     display_num = bpost_display
                     from_bpost = True
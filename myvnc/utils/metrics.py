@@ -0,0 +1,273 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Server health counters and gauges, served on /metrics with the command histograms
+
+The web server, runner_client, the job snapshot and the database manager
+update the metrics defined at the bottom of this module; /metrics renders
+them after tracing's per-command histograms in the Prometheus text format.
+Gauges that read live state (worker queue depth, snapshot age) are given a
+function that is called at render time instead of being updated on every
+change, so they cost nothing between scrapes.
+
+utils/monitor_myvnc.py scrapes these to tell a server that is slow because
+the scheduler is slow from one that is hung.
+"""
+
+import contextlib
+import threading
+import time
+from typing import Callable, Dict, List, Optional, Tuple
+
+from myvnc.utils.tracing import LatencyHistogram, escape_label, render_histogram, tracer
+
+
+def _format_value(value: float) -> str:
+    value = float(value)
+    return str(int(value)) if value.is_integer() else repr(value)
+
+
+def _label_string(label_names: Tuple[str, ...], values: Tuple[str, ...]) -> str:
+    return ','.join(f'{name}="{escape_label(str(value))}"' for name, value in zip(label_names, values))
+
+
+class _Metric:
+    """A named metric with a fixed set of label names"""
+
+    kind = 'untyped'
+
+    def __init__(self, name: str, help: str, labels: Tuple[str, ...] = ()):
+        self.name = name
+        self.help = help
+        self.label_names = tuple(labels)
+        self._lock = threading.Lock()
+
+    def _key(self, labels: Dict[str, str]) -> Tuple[str, ...]:
+        return tuple(str(labels.get(name, '')) for name in self.label_names)
+
+    def _samples(self) -> List[Tuple[Tuple[str, ...], float]]:
+        raise NotImplementedError
+
+    def render(self) -> List[str]:
+        lines = [f'# HELP {self.name} {self.help}', f'# TYPE {self.name} {self.kind}']
+        for key, value in self._samples():
+            labels = _label_string(self.label_names, key)
+            value = _format_value(value)
+            lines.append(f'{self.name}{{{labels}}} {value}' if labels else f'{self.name} {value}')
+        return lines
+
+
+class Counter(_Metric):
+    """Monotonically increasing count, per combination of label values"""
+
+    kind = 'counter'
+
+    def __init__(self, name: str, help: str, labels: Tuple[str, ...] = ()):
+        super().__init__(name, help, labels)
+        self._values: Dict[Tuple[str, ...], float] = {}
+
+    def inc(self, amount: float = 1, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0) + amount
+
+    def value(self, **labels) -> float:
+        with self._lock:
+            return self._values.get(self._key(labels), 0)
+
+    def _samples(self):
+        with self._lock:
+            return sorted(self._values.items())
+
+
+class Gauge(_Metric):
+    """Current value, set directly or read from a function at render time"""
+
+    kind = 'gauge'
+
+    def __init__(self, name: str, help: str, labels: Tuple[str, ...] = ()):
+        super().__init__(name, help, labels)
+        self._values: Dict[Tuple[str, ...], float] = {}
+        self._functions: Dict[Tuple[str, ...], Callable[[], Optional[float]]] = {}
+
+    def set(self, value: float, **labels):
+        with self._lock:
+            self._values[self._key(labels)] = value
+
+    def inc(self, amount: float = 1, **labels):
+        key = self._key(labels)
+        with self._lock:
+            self._values[key] = self._values.get(key, 0) + amount
+
+    def dec(self, amount: float = 1, **labels):
+        self.inc(-amount, **labels)
+
+    def set_function(self, function: Optional[Callable[[], Optional[float]]], **labels):
+        """Report function() as the value; it may return None to leave the sample out. None unsets it."""
+        key = self._key(labels)
+        with self._lock:
+            if function is None:
+                self._functions.pop(key, None)
+            else:
+                self._functions[key] = function
+
+    def _samples(self):
+        with self._lock:
+            values = dict(self._values)
+            functions = list(self._functions.items())
+        for key, function in functions:
+            try:
+                value = function()
+            except Exception:
+                value = None
+            if value is None:
+                values.pop(key, None)
+            else:
+                values[key] = value
+        return sorted(values.items())
+
+
+class Histogram(_Metric):
+    """Durations in seconds per combination of label values, in tracing's LatencyHistogram"""
+
+    kind = 'histogram'
+
+    def __init__(self, name: str, help: str, labels: Tuple[str, ...] = ()):
+        super().__init__(name, help, labels)
+        self._histograms: Dict[Tuple[str, ...], LatencyHistogram] = {}
+
+    def observe(self, seconds: float, **labels):
+        key = self._key(labels)
+        histogram = self._histograms.get(key)
+        if histogram is None:
+            with self._lock:
+                histogram = self._histograms.setdefault(key, LatencyHistogram())
+        histogram.record(seconds)
+
+    @contextlib.contextmanager
+    def time(self, **labels):
+        """Observe the duration of the block"""
+        started = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.observe(time.perf_counter() - started, **labels)
+
+    def render(self) -> List[str]:
+        lines = [f'# HELP {self.name} {self.help}', f'# TYPE {self.name} {self.kind}']
+        with self._lock:
+            histograms = sorted(self._histograms.items())
+        for key, histogram in histograms:
+            lines.extend(render_histogram(self.name, _label_string(self.label_names, key), histogram)[0])
+        return lines
+
+
+class Registry:
+    """The metrics of this process, in the order they were defined"""
+
+    def __init__(self):
+        self._metrics: List[_Metric] = []
+
+    def _add(self, metric):
+        self._metrics.append(metric)
+        return metric
+
+    def counter(self, name: str, help: str, labels: Tuple[str, ...] = ()) -> Counter:
+        return self._add(Counter(name, help, labels))
+
+    def gauge(self, name: str, help: str, labels: Tuple[str, ...] = ()) -> Gauge:
+        return self._add(Gauge(name, help, labels))
+
+    def histogram(self, name: str, help: str, labels: Tuple[str, ...] = ()) -> Histogram:
+        return self._add(Histogram(name, help, labels))
+
+    def render(self) -> str:
+        lines = []
+        for metric in self._metrics:
+            lines.extend(metric.render())
+        return '\n'.join(lines) + '\n'
+
+
+registry = Registry()
+
+# Web server
+process_start_time = registry.gauge(
+    'myvnc_process_start_time_seconds', 'Start time of the server process since the epoch')
+process_start_time.set(time.time())
+http_requests = registry.counter(
+    'myvnc_http_requests_total', 'HTTP requests handled, by method and status class', ('method', 'status'))
+http_in_flight = registry.gauge(
+    'myvnc_http_requests_in_flight', 'HTTP requests being handled, by kind (scheduler, updates or other)', ('kind',))
+http_dropped = registry.counter(
+    'myvnc_http_connections_dropped_total', 'Connections closed unserved because the worker backlog was full')
+worker_queue_depth = registry.gauge(
+    'myvnc_http_worker_queue_depth', 'Accepted connections waiting for a worker thread')
+worker_count = registry.gauge(
+    'myvnc_http_workers', 'Worker threads serving requests')
+scheduler_lane_waiting = registry.gauge(
+    'myvnc_scheduler_lane_waiting', 'Scheduler-bound requests waiting for a scheduler lane slot')
+scheduler_lane_rejected = registry.counter(
+    'myvnc_scheduler_lane_rejected_total', 'Scheduler-bound requests answered with a 503 because the lane was full')
+
+# Scheduler commands
+commands_running = registry.gauge(
+    'myvnc_commands_running', 'Scheduler commands running')
+command_oldest_running = registry.gauge(
+    'myvnc_command_oldest_running_seconds', 'How long the oldest running scheduler command has been running')
+commands_running.set_function(lambda: tracer.running()[0])
+command_oldest_running.set_function(lambda: tracer.running()[1])
+
+# setuid_runner
+runner_spawns = registry.counter(
+    'myvnc_setuid_runner_spawns_total',
+    'Commands handed to setuid_runner, by how (exec of the binary or a request to the daemon)', ('mode',))
+runner_spawn_seconds = registry.histogram(
+    'myvnc_setuid_runner_spawn_seconds',
+    'Time to start setuid_runner or deliver a request to its daemon', ('mode',))
+runner_unavailable = registry.counter(
+    'myvnc_setuid_runner_daemon_unavailable_total', 'Requests the setuid_runner daemon could not be reached for')
+
+# Job snapshot
+snapshot_reads = registry.counter(
+    'myvnc_job_snapshot_reads_total',
+    'Job snapshot reads, by result: hit (served as is), shared (waited for a refresh '
+    'another request ran), refresh (ran the listing) or stale (the refresh failed; the previous listing is '
+    'served if there is one)', ('result',))
+snapshot_age = registry.gauge(
+    'myvnc_job_snapshot_age_seconds', 'Age of the job snapshot being served')
+snapshot_refresh_seconds = registry.histogram(
+    'myvnc_job_snapshot_refresh_seconds', 'Time to take a job snapshot')
+
+# Database
+db_seconds = registry.histogram(
+    'myvnc_db_operation_seconds', 'DatabaseManager call latency (cached override reads included)', ('operation',))
+
+# Warm pool
+warm_pool_holders = registry.gauge(
+    'myvnc_warm_pool_holders', 'Warm pool holder jobs ready to be claimed, by state (running or pending)', ('state',))
+warm_pool_claims = registry.counter(
+    'myvnc_warm_pool_claims_total',
+    'VNC requests matching a warm pool profile, by result: hit (a running holder was claimed) or miss', ('result',))
+session_start_seconds = registry.histogram(
+    'myvnc_session_start_seconds',
+    'Time from a VNC submission until a listing shows it running with a display, by whether a warm pool '
+    'slot was claimed', ('pooled',))
+desktop_startup_phase_seconds = registry.histogram(
+    'myvnc_desktop_startup_phase_seconds',
+    'Time each phase of xstartup.sh took, as reported with the display, by desktop and phase', ('desktop', 'phase'))
+
+# Logging
+log_lines_dropped = registry.counter(
+    'myvnc_log_lines_dropped_total', 'Log lines the log_buffer writer dropped because the log file could not keep up')
+log_buffer_pending = registry.gauge(
+    'myvnc_log_buffer_pending_lines', 'Log lines queued for the log_buffer writer, by log file', ('file',))
+
+# Federation
+federation_call_seconds = registry.histogram(
+    'myvnc_federation_call_seconds', 'Time a federated cluster took to answer a listing or lookup', ('cluster',))
+federation_cluster_errors = registry.counter(
+    'myvnc_federation_cluster_errors_total',
+    'Federated calls a cluster was left out of, by reason: timeout (no answer within list_timeout) or error',
+    ('cluster', 'reason'))
+federation_submissions = registry.counter(
+    'myvnc_federation_submissions_total', 'Submissions routed to each federated cluster by load', ('cluster',))
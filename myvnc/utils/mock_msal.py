@@ -62,6 +62,16 @@ class ConfidentialClientApplication:
                 'error_description': 'AADSTS70002: Invalid authorization code'
             }
     
+    def acquire_token_for_client(self, scopes, **kwargs):
+        """
+        Mock implementation of the client credentials flow
+        App-only tokens are not mocked, so callers fall back to user tokens
+        """
+        return {
+            'error': 'unauthorized_client',
+            'error_description': 'Mock MSAL: app-only tokens are not available'
+        }
+    
     def get_authorization_request_url(self, scopes, redirect_uri=None, response_type="code", prompt=None, **kwargs):
         """
         Mock implementation of authorization URL generation
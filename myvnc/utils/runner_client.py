@@ -0,0 +1,624 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Client for the resident setuid_runner broker (setuid_runner --daemon)
+
+The daemon keeps the privileged broker alive on a root-owned Unix socket so
+running a scheduler command as a user costs one socket round trip instead of
+an exec of the setuid binary. The wire format is documented at the top of
+src/setuid_runner.c.
+
+Every way of running a command takes a timeout, which the broker enforces
+on the command's process group (SIGTERM, then SIGKILL after KILL_GRACE
+seconds). submit() runs a call on a shared thread pool under a deadline, so
+request handlers can wait for scheduler calls with a bound and give up on
+them; commands started by the call are cut off at that deadline as well.
+"""
+
+import contextlib
+import os
+import signal
+import socket
+import struct
+import subprocess
+import threading
+import time
+from concurrent.futures import Future, ThreadPoolExecutor
+from typing import Callable, Dict, List, Optional
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils.tracing import tracer
+from myvnc.utils import metrics
+
+# u8 type | u16 tag | u32 payload length
+FRAME_HEADER = struct.Struct('!BHI')
+FRAME_REQUEST = ord('Q')
+FRAME_BATCH = ord('B')
+FRAME_STDOUT = ord('O')
+FRAME_STDERR = ord('E')
+FRAME_EXIT = ord('X')
+
+# How long to wait for an autostarted daemon to create its socket
+DAEMON_START_TIMEOUT = 5.0
+
+# Broker limits for one batch frame (MAX_BATCH_COMMANDS / MAX_BATCH_PARALLEL)
+MAX_BATCH_COMMANDS = 64
+MAX_BATCH_PARALLEL = 16
+
+# Broker deadline handling (KILL_GRACE_MS / DEADLINE_EXIT_CODE)
+KILL_GRACE = 2.0
+DEADLINE_EXIT_CODE = 124
+
+# Extra seconds the client waits past a deadline the broker enforces before
+# giving up on the broker itself
+BACKSTOP_MARGIN = 5.0
+
+# Threads available to submit()
+ASYNC_WORKERS = 16
+
+
+def deadline_ms(timeout: Optional[float]) -> int:
+    """Protocol deadline for a timeout in seconds; 0 (none) only when there is no timeout"""
+    return max(1, int(timeout * 1000)) if timeout else 0
+
+
+def backstop_timeout(timeout: Optional[float]) -> Optional[float]:
+    """How long to wait for a broker that enforces timeout itself"""
+    return timeout + KILL_GRACE + BACKSTOP_MARGIN if timeout else None
+
+
+_call_context = threading.local()
+
+
+@contextlib.contextmanager
+def deadline_scope(deadline: Optional[float]):
+    """Run the block under a time.monotonic() deadline, or none, instead of the thread's current one"""
+    previous = getattr(_call_context, 'deadline', None)
+    _call_context.deadline = deadline
+    try:
+        yield
+    finally:
+        _call_context.deadline = previous
+
+
+def current_deadline() -> Optional[float]:
+    """The time.monotonic() deadline of the submit() call or deadline_scope() running on this thread"""
+    return getattr(_call_context, 'deadline', None)
+
+
+def remaining_time(timeout: Optional[float]) -> Optional[float]:
+    """
+    Timeout for a command started now: timeout, capped by the deadline of
+    the submit() call or deadline_scope() running on this thread
+    """
+    deadline = getattr(_call_context, 'deadline', None)
+    if deadline is None:
+        return timeout
+    # Past the deadline commands still start, but are stopped straight away
+    remaining = max(0.001, deadline - time.monotonic())
+    return remaining if not timeout else min(timeout, remaining)
+
+
+_executor = None
+_executor_lock = threading.Lock()
+
+
+def submit(fn: Callable, *args, deadline: float = None, **kwargs) -> Future:
+    """
+    Run fn(*args, **kwargs) on the shared pool and return its Future
+
+    Commands the call runs through the managers are limited to the
+    time.monotonic() deadline, so a caller that stops waiting at the
+    deadline does not leave them running much longer.
+    """
+    global _executor
+    with _executor_lock:
+        if _executor is None:
+            _executor = ThreadPoolExecutor(max_workers=ASYNC_WORKERS, thread_name_prefix='scheduler-call')
+
+    # Time queued for a scheduler lane slot carries over to the call
+    queued = tracer.take_queue_wait()
+    submitted = time.perf_counter()
+
+    def call():
+        tracer.set_queue_wait(queued + time.perf_counter() - submitted)
+        try:
+            with deadline_scope(deadline):
+                return fn(*args, **kwargs)
+        finally:
+            tracer.set_queue_wait(None)
+
+    return _executor.submit(call)
+
+
+def _record_spawn(mode: str, started: float):
+    """Count a command handed to setuid_runner ('exec' or 'daemon') that took since started to start"""
+    metrics.runner_spawns.inc(mode=mode)
+    metrics.runner_spawn_seconds.observe(time.perf_counter() - started, mode=mode)
+
+
+def run_direct(argv: List[str], timeout: float = None, check: bool = False,
+               env: Dict[str, str] = None) -> subprocess.CompletedProcess:
+    """
+    Run argv as this process's user, like subprocess.run with pipes, in its
+    own process group; when timeout passes the group gets SIGTERM and, after
+    KILL_GRACE, SIGKILL, and the result has returncode DEADLINE_EXIT_CODE
+
+    env replaces this process's environment (a federated cluster's scheduler
+    environment); setuid_runner passes its scheduler variables on to the command.
+
+    For setuid_runner, which cannot be signalled once it switched users,
+    pass its own --deadline-ms and use backstop_timeout() here.
+    """
+    started = time.perf_counter()
+    with tracer.phase('spawn'):
+        proc = subprocess.Popen(argv, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                start_new_session=True, env=env)
+    if os.path.basename(argv[0]) == 'setuid_runner':
+        _record_spawn('exec', started)
+    try:
+        with tracer.phase('run'):
+            stdout, stderr = proc.communicate(timeout=timeout)
+        returncode = proc.returncode
+    except subprocess.TimeoutExpired:
+        for sig, wait in ((signal.SIGTERM, KILL_GRACE), (signal.SIGKILL, None)):
+            try:
+                os.killpg(proc.pid, sig)
+            except OSError:
+                pass
+            try:
+                stdout, stderr = proc.communicate(timeout=wait)
+                break
+            except subprocess.TimeoutExpired:
+                continue
+        stderr += f"Deadline of {int(timeout * 1000)} ms exceeded, terminated {argv[0]}\n".encode('utf-8')
+        returncode = DEADLINE_EXIT_CODE
+
+    result = subprocess.CompletedProcess(list(argv), returncode, stdout, stderr)
+    if check and returncode != 0:
+        raise subprocess.CalledProcessError(returncode, list(argv), output=stdout, stderr=stderr)
+    return result
+
+
+def setuid_argv(setuid_binary: str, username: str, argv: List[str], timeout: float = None,
+                framed: bool = False) -> List[str]:
+    """Command line running argv as username through setuid_runner, with its deadline"""
+    prefix = [setuid_binary]
+    if timeout:
+        prefix += ['--deadline-ms', str(deadline_ms(timeout))]
+    if framed:
+        prefix.append('--framed')
+    return prefix + [username] + list(argv)
+
+
+def _encode_strings(strings) -> bytes:
+    return b''.join(str(s).encode('utf-8') + b'\0' for s in strings)
+
+
+def encode_batch(username: str, commands: List[List[str]], deadline_ms: int = 0,
+                 max_parallel: int = 0, tag: int = 0) -> bytes:
+    """Build a batch ('B') frame; max_parallel 0 lets the broker pick its default"""
+    payload = struct.pack('!IHH', deadline_ms, min(max_parallel, MAX_BATCH_PARALLEL), len(commands))
+    payload += _encode_strings([username])
+    for argv in commands:
+        payload += struct.pack('!H', len(argv)) + _encode_strings(argv)
+    return FRAME_HEADER.pack(FRAME_BATCH, tag, len(payload)) + payload
+
+
+def iter_frames(data: bytes):
+    """Yield (type, tag, payload) for every complete frame in data"""
+    offset = 0
+    while offset + FRAME_HEADER.size <= len(data):
+        frame_type, tag, length = FRAME_HEADER.unpack_from(data, offset)
+        offset += FRAME_HEADER.size
+        if offset + length > len(data):
+            break
+        yield frame_type, tag, data[offset:offset + length]
+        offset += length
+
+
+class _BatchCollector:
+    """Accumulates per-command output from batch frames, which are tagged by index"""
+
+    def __init__(self, commands: List[List[str]]):
+        self.commands = commands
+        self.stdout = [[] for _ in commands]
+        self.stderr = [[] for _ in commands]
+        self.returncodes = [None] * len(commands)
+        self.pending = len(commands)
+
+    def add(self, frame_type: int, tag: int, payload: bytes):
+        if tag >= len(self.commands):
+            raise ConnectionError(f"Unexpected frame tag {tag} in batch of {len(self.commands)}")
+        if frame_type == FRAME_STDOUT:
+            self.stdout[tag].append(payload)
+        elif frame_type == FRAME_STDERR:
+            self.stderr[tag].append(payload)
+        elif frame_type == FRAME_EXIT and self.returncodes[tag] is None:
+            self.returncodes[tag] = struct.unpack('!i', payload[:4])[0]
+            self.pending -= 1
+
+    def results(self, failure: str = None) -> List[subprocess.CompletedProcess]:
+        results = []
+        for i, argv in enumerate(self.commands):
+            returncode = self.returncodes[i]
+            if returncode is None:
+                # Never answered - the broker went away mid-batch
+                self.stderr[i].append((failure or "No result from setuid_runner").encode('utf-8') + b'\n')
+                returncode = 1
+            results.append(subprocess.CompletedProcess(list(argv), returncode,
+                                                       b''.join(self.stdout[i]), b''.join(self.stderr[i])))
+        return results
+
+
+def run_batch_direct(setuid_binary: str, username: str, commands: List[List[str]],
+                     timeout: float = None, max_parallel: int = 0,
+                     env: Dict[str, str] = None) -> List[subprocess.CompletedProcess]:
+    """
+    Run a batch through one 'setuid_runner --batch' execution when no daemon is configured
+
+    Returns one subprocess.CompletedProcess per command, in order
+    """
+    results = []
+    for start in range(0, len(commands), MAX_BATCH_COMMANDS):
+        chunk = commands[start:start + MAX_BATCH_COMMANDS]
+        collector = _BatchCollector(chunk)
+        try:
+            # Starting the broker is not timed separately from the batch, so it is only counted
+            metrics.runner_spawns.inc(mode='exec')
+            with tracer.phase('run'):
+                proc = subprocess.run([setuid_binary, '--batch'],
+                                      input=encode_batch(username, chunk, deadline_ms(timeout), max_parallel),
+                                      stdout=subprocess.PIPE, stderr=subprocess.PIPE, timeout=backstop_timeout(timeout),
+                                      env=env)
+        except subprocess.TimeoutExpired:
+            results.extend(collector.results("setuid_runner --batch did not finish after its deadline"))
+            continue
+        for frame in iter_frames(proc.stdout):
+            collector.add(*frame)
+        results.extend(collector.results(proc.stderr.decode('utf-8', 'replace').strip() or None))
+    return results
+
+
+class FramedStream:
+    """
+    Output of one framed run ('setuid_runner --framed' or a daemon request),
+    read as it arrives
+
+    Iterating yields stdout lines (str, without the newline) as soon as they
+    are complete, so only one frame and one partial line are held at a time;
+    chunks() yields the raw stdout frames instead. Once iteration finishes,
+    returncode and stderr are set. Stopping early abandons the command.
+    """
+
+    def __init__(self, argv: List[str], read_exact, finish=None, abort=None, tag: int = 0):
+        self.argv = list(argv)
+        self.returncode = None
+        self.stderr = b''
+        self._read_exact = read_exact
+        self._finish = finish
+        self._abort = abort
+        self._tag = tag
+
+    def _frames(self):
+        while True:
+            header = self._read_exact(FRAME_HEADER.size)
+            if not header:
+                return
+            frame_type, tag, length = FRAME_HEADER.unpack(header)
+            if tag != self._tag:
+                raise ConnectionError(f"Unexpected frame tag {tag}, expected {self._tag}")
+            payload = self._read_exact(length) if length else b''
+            yield frame_type, payload
+
+    def chunks(self):
+        """Yield stdout as it arrives, one frame payload at a time"""
+        stderr = []
+        try:
+            try:
+                for frame_type, payload in self._frames():
+                    if frame_type == FRAME_STDOUT:
+                        yield payload
+                    elif frame_type == FRAME_STDERR:
+                        stderr.append(payload)
+                    elif frame_type == FRAME_EXIT:
+                        self.returncode = struct.unpack('!i', payload[:4])[0]
+                        break
+            except OSError as e:
+                stderr.append(f"Lost connection to setuid_runner: {e}\n".encode('utf-8'))
+        finally:
+            if self.returncode is None and self._abort:
+                # The consumer stopped early or the stream broke off
+                self._abort()
+            if self._finish:
+                returncode, broker_stderr = self._finish()
+                if broker_stderr:
+                    stderr.append(broker_stderr)
+                if self.returncode is None:
+                    self.returncode = returncode or 1
+            elif self.returncode is None:
+                self.returncode = 1
+            self.stderr = b''.join(stderr)
+
+    def __iter__(self):
+        pending = b''
+        for chunk in self.chunks():
+            lines = (pending + chunk).split(b'\n')
+            pending = lines.pop()
+            for line in lines:
+                yield line.decode('utf-8', 'replace')
+        if pending:
+            yield pending.decode('utf-8', 'replace')
+
+
+def stream_direct(setuid_binary: str, username: str, argv: List[str], timeout: float = None,
+                  env: Dict[str, str] = None) -> FramedStream:
+    """Run argv as username through 'setuid_runner --framed', reading its output incrementally"""
+    started = time.perf_counter()
+    proc = subprocess.Popen(setuid_argv(setuid_binary, username, argv, timeout, framed=True),
+                            stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.PIPE, env=env)
+    _record_spawn('exec', started)
+
+    def read_exact(size):
+        data = proc.stdout.read(size)
+        if data and len(data) < size:
+            raise ConnectionError("setuid_runner output ended mid-frame")
+        return data
+
+    def finish():
+        # Only broker-side messages go to stderr in framed mode, so this cannot block for long
+        broker_stderr = proc.stderr.read()
+        proc.stdout.close()
+        proc.stderr.close()
+        return proc.wait(), broker_stderr
+
+    def abort():
+        proc.kill()
+
+    return FramedStream(argv, read_exact, finish, abort)
+
+
+class RunnerUnavailable(Exception):
+    """The request could not be delivered to the daemon; running it another way is safe"""
+
+
+class RunnerClient:
+    """Sends run requests to the setuid_runner daemon, one persistent connection per thread"""
+
+    def __init__(self, socket_path: str, setuid_binary: str = None, autostart: bool = False,
+                 log_path: str = None, env: Dict[str, str] = None):
+        self.socket_path = socket_path
+        self.setuid_binary = setuid_binary
+        self.autostart = autostart
+        self.log_path = log_path
+        self.env = env
+        self.logger = get_logger()
+        self._local = threading.local()
+        self._tag_lock = threading.Lock()
+        self._tag = 0
+        self._start_lock = threading.Lock()
+        self._started_at = None
+
+    def _next_tag(self) -> int:
+        with self._tag_lock:
+            self._tag = (self._tag + 1) & 0xFFFF
+            return self._tag
+
+    def _start_daemon(self):
+        """Launch the daemon with this process's (scheduler-sourced) environment, or env"""
+        with self._start_lock:
+            # Another thread already launched it and is waiting for the socket
+            if self._started_at and time.monotonic() - self._started_at < DAEMON_START_TIMEOUT:
+                return
+            self._started_at = time.monotonic()
+            # Not created here: setuid_runner only binds in a root-owned directory nobody else can write
+            self.logger.info(f"Starting setuid_runner daemon on {self.socket_path}")
+            log = open(self.log_path, 'ab') if self.log_path else subprocess.DEVNULL
+            try:
+                subprocess.Popen([self.setuid_binary, '--daemon', self.socket_path],
+                                 stdin=subprocess.DEVNULL, stdout=log, stderr=log,
+                                 close_fds=True, start_new_session=True, env=self.env)
+            finally:
+                if log is not subprocess.DEVNULL:
+                    log.close()
+
+    def _connect(self) -> socket.socket:
+        deadline = None
+        while True:
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            try:
+                sock.connect(self.socket_path)
+                return sock
+            except OSError as e:
+                sock.close()
+                if not (self.autostart and self.setuid_binary):
+                    raise RunnerUnavailable(f"Cannot connect to {self.socket_path}: {e}")
+                if deadline is None:
+                    self._start_daemon()
+                    deadline = time.monotonic() + DAEMON_START_TIMEOUT
+                elif time.monotonic() > deadline:
+                    raise RunnerUnavailable(f"setuid_runner daemon did not come up on {self.socket_path}: {e}")
+                time.sleep(0.05)
+
+    def _socket(self) -> socket.socket:
+        sock = getattr(self._local, 'sock', None)
+        if sock is None:
+            sock = self._connect()
+            self._local.sock = sock
+        return sock
+
+    def _drop_socket(self):
+        sock = getattr(self._local, 'sock', None)
+        if sock is not None:
+            try:
+                sock.close()
+            except OSError:
+                pass
+            self._local.sock = None
+
+    @staticmethod
+    def _recv_exact(sock: socket.socket, size: int) -> bytes:
+        chunks = []
+        while size > 0:
+            chunk = sock.recv(size)
+            if not chunk:
+                raise ConnectionError("setuid_runner daemon closed the connection")
+            chunks.append(chunk)
+            size -= len(chunk)
+        return b''.join(chunks)
+
+    def _read_frame(self, sock: socket.socket):
+        frame_type, tag, length = FRAME_HEADER.unpack(self._recv_exact(sock, FRAME_HEADER.size))
+        payload = self._recv_exact(sock, length) if length else b''
+        return frame_type, tag, payload
+
+    def _send_frame(self, frame: bytes) -> socket.socket:
+        # A send on a connection the daemon already closed fails before the
+        # request is delivered, so one reconnect is safe even for bsub
+        started = time.perf_counter()
+        for attempt in range(2):
+            try:
+                sock = self._socket()
+            except RunnerUnavailable:
+                metrics.runner_unavailable.inc()
+                raise
+            try:
+                sock.sendall(frame)
+                _record_spawn('daemon', started)
+                return sock
+            except OSError as e:
+                self._drop_socket()
+                if attempt:
+                    metrics.runner_unavailable.inc()
+                    raise RunnerUnavailable(f"Cannot send request to setuid_runner daemon: {e}")
+
+    def run(self, username: str, argv: List[str], timeout: float = None,
+            check: bool = False) -> subprocess.CompletedProcess:
+        """
+        Run argv as username through the daemon
+
+        Args:
+            username: User to run the command as
+            argv: Command and arguments; argv[0] must be on the broker allowlist
+            timeout: Optional deadline in seconds, enforced by the daemon
+            check: Raise CalledProcessError on a non-zero exit, like subprocess.run
+
+        Returns:
+            subprocess.CompletedProcess with bytes stdout/stderr
+
+        Raises:
+            RunnerUnavailable: If the request could not be delivered
+        """
+        payload = struct.pack('!IH', deadline_ms(timeout), len(argv)) + _encode_strings([username] + list(argv))
+        tag = self._next_tag()
+        with tracer.phase('spawn'):
+            sock = self._send_frame(FRAME_HEADER.pack(FRAME_REQUEST, tag, len(payload)) + payload)
+        sock.settimeout(backstop_timeout(timeout))
+
+        stdout, stderr = [], []
+        returncode = None
+        try:
+            with tracer.phase('run'):
+                while returncode is None:
+                    frame_type, frame_tag, payload = self._read_frame(sock)
+                    if frame_tag != tag:
+                        raise ConnectionError(f"Unexpected frame tag {frame_tag}, expected {tag}")
+                    if frame_type == FRAME_STDOUT:
+                        stdout.append(payload)
+                    elif frame_type == FRAME_STDERR:
+                        stderr.append(payload)
+                    elif frame_type == FRAME_EXIT:
+                        returncode = struct.unpack('!i', payload[:4])[0]
+        except OSError as e:
+            # The request was delivered; report it as failed rather than retrying it
+            self._drop_socket()
+            stderr.append(f"Lost connection to setuid_runner daemon: {e}\n".encode('utf-8'))
+            returncode = 1
+
+        result = subprocess.CompletedProcess(list(argv), returncode, b''.join(stdout), b''.join(stderr))
+        if check and returncode != 0:
+            raise subprocess.CalledProcessError(returncode, list(argv), output=result.stdout, stderr=result.stderr)
+        return result
+
+    def stream(self, username: str, argv: List[str], timeout: float = None) -> FramedStream:
+        """
+        Run argv as username through the daemon and return its output as a
+        FramedStream; the stream must be consumed before this thread makes
+        another request
+
+        Raises:
+            RunnerUnavailable: If the request could not be delivered
+        """
+        payload = struct.pack('!IH', deadline_ms(timeout), len(argv)) + _encode_strings([username] + list(argv))
+        tag = self._next_tag()
+        sock = self._send_frame(FRAME_HEADER.pack(FRAME_REQUEST, tag, len(payload)) + payload)
+        sock.settimeout(backstop_timeout(timeout))
+
+        def read_exact(size):
+            return self._recv_exact(sock, size)
+
+        # Frames of an abandoned request would still be queued on the socket
+        return FramedStream(argv, read_exact, abort=self._drop_socket, tag=tag)
+
+    def run_batch(self, username: str, commands: List[List[str]], timeout: float = None,
+                  max_parallel: int = 0) -> List[subprocess.CompletedProcess]:
+        """
+        Run several commands as username in one broker round trip per
+        MAX_BATCH_COMMANDS commands; the broker switches credentials once and
+        runs up to max_parallel of them concurrently
+
+        Returns:
+            One subprocess.CompletedProcess per command, in order
+
+        Raises:
+            RunnerUnavailable: If the batch could not be delivered
+        """
+        results = []
+        for start in range(0, len(commands), MAX_BATCH_COMMANDS):
+            chunk = commands[start:start + MAX_BATCH_COMMANDS]
+            with tracer.phase('spawn'):
+                sock = self._send_frame(encode_batch(username, chunk, deadline_ms(timeout), max_parallel))
+            sock.settimeout(backstop_timeout(timeout))
+            collector = _BatchCollector(chunk)
+            failure = None
+            try:
+                with tracer.phase('run'):
+                    while collector.pending:
+                        collector.add(*self._read_frame(sock))
+            except OSError as e:
+                self._drop_socket()
+                failure = f"Lost connection to setuid_runner daemon: {e}"
+            results.extend(collector.results(failure))
+        return results
+
+
+_clients = {}
+_clients_lock = threading.Lock()
+
+
+def get_runner_client(server_config: Dict, setuid_binary: str,
+                      env: Dict[str, str] = None) -> Optional[RunnerClient]:
+    """
+    Return the shared RunnerClient for the configured daemon socket, or None
+    when 'setuid_runner_daemon' is not enabled in server_config.json
+
+    An autostarted daemon gets env as its environment when given; each
+    environment needs a socket of its own.
+    """
+    daemon_config = server_config.get('setuid_runner_daemon') or {}
+    if not daemon_config.get('enabled', False):
+        return None
+
+    socket_path = daemon_config.get('socket') or '/run/myvnc/setuid_runner.sock'
+    with _clients_lock:
+        client = _clients.get(socket_path)
+        if client is None:
+            logdir = server_config.get('logdir') or '/tmp'
+            log_name = os.path.splitext(os.path.basename(socket_path))[0] + '_daemon.log'
+            client = RunnerClient(socket_path,
+                                  setuid_binary=setuid_binary,
+                                  autostart=daemon_config.get('autostart', True),
+                                  log_path=os.path.join(logdir, log_name),
+                                  env=env)
+            _clients[socket_path] = client
+        return client
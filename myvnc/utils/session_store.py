@@ -0,0 +1,262 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+In-memory login session table with journaled persistence
+
+AuthManager keeps its sessions here, so looking one up on every
+authenticated request is a dict access with no file I/O. Changes are
+appended by a background writer to a journal next to sessions.json (one
+JSON record per line), and the journal is folded into sessions.json
+(written to a temporary file and renamed into place) once it holds
+COMPACT_RECORDS records, and on shutdown. At startup sessions.json is
+loaded and the journal replayed on top of it, so a crash loses at most the
+changes that were still queued for the writer.
+
+Expired sessions are dropped by a timer wheel: every session is filed
+under the WHEEL_TICK-second slot its expiry falls in, and each tick the
+writer drops the sessions of the slots that came due, so expiry never scans
+the whole table. Sessions that expired since the last tick are still
+returned by get(); AuthManager checks the expiry on every lookup.
+
+last_access is only updated in memory and written with the next compaction.
+"""
+
+import atexit
+import json
+import os
+import queue
+import threading
+import time
+from typing import Dict, Optional
+
+from myvnc.utils.log_manager import get_logger
+
+# Journal records that trigger writing a fresh sessions.json
+COMPACT_RECORDS = 1000
+
+# Seconds per timer wheel slot
+WHEEL_TICK = 60
+
+# Writer queue markers besides journal records
+_COMPACT = object()
+_STOP = object()
+
+
+class SessionStore:
+    """Sessions keyed by session id, persisted to a JSON file plus journal"""
+
+    def __init__(self, path: str):
+        """
+        Args:
+            path: sessions.json; the journal is path + '.journal'
+        """
+        self.path = path
+        self.journal_path = path + '.journal'
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        self._sessions: Dict[str, Dict] = {}
+        # tick -> session ids expiring in it, and session id -> its tick
+        self._wheel: Dict[int, set] = {}
+        self._ticks: Dict[str, int] = {}
+        self._swept_tick = int(time.time() // WHEEL_TICK)
+        self._records = queue.Queue()
+        self._journal = None
+        self._journal_records = 0
+        self._closed = False
+
+        self._load()
+        self._writer = threading.Thread(target=self._write_loop, name='session-store', daemon=True)
+        self._writer.start()
+
+    def __contains__(self, session_id: str) -> bool:
+        return session_id in self._sessions
+
+    def __len__(self) -> int:
+        return len(self._sessions)
+
+    def get(self, session_id: str) -> Optional[Dict]:
+        """Return the session, or None if there is none"""
+        return self._sessions.get(session_id)
+
+    def put(self, session_id: str, session: Dict):
+        """Add or replace a session (or record changes made to it, e.g. a new expiry)"""
+        with self._lock:
+            self._sessions[session_id] = session
+            self._file(session_id, session.get('expiry'))
+            self._records.put({'op': 'put', 'id': session_id, 'session': session.copy()})
+
+    def pop(self, session_id: str) -> Optional[Dict]:
+        """Remove a session, returning it (or None if there was none)"""
+        with self._lock:
+            session = self._remove(session_id)
+        return session
+
+    def _remove(self, session_id: str) -> Optional[Dict]:
+        session = self._sessions.pop(session_id, None)
+        tick = self._ticks.pop(session_id, None)
+        if tick is not None:
+            self._wheel.get(tick, set()).discard(session_id)
+        if session is not None:
+            self._records.put({'op': 'del', 'id': session_id})
+        return session
+
+    def _file(self, session_id: str, expiry: Optional[float]):
+        """File a session under the wheel slot of its expiry (called with the lock held)"""
+        old_tick = self._ticks.pop(session_id, None)
+        if old_tick is not None:
+            self._wheel.get(old_tick, set()).discard(session_id)
+        if expiry is None:
+            return
+        tick = int(expiry // WHEEL_TICK)
+        self._wheel.setdefault(tick, set()).add(session_id)
+        self._ticks[session_id] = tick
+
+    def _sweep(self):
+        """Drop the sessions of every wheel slot that came due since the last sweep"""
+        now_tick = int(time.time() // WHEEL_TICK)
+        expired = 0
+        with self._lock:
+            # The current slot is only due once it has passed
+            for tick in range(self._swept_tick, now_tick):
+                for session_id in self._wheel.pop(tick, ()):
+                    self._ticks.pop(session_id, None)
+                    if self._sessions.pop(session_id, None) is not None:
+                        self._records.put({'op': 'del', 'id': session_id})
+                        expired += 1
+            self._swept_tick = now_tick
+        if expired:
+            self.logger.info(f"Expired {expired} login sessions")
+
+    def _load(self):
+        """Load sessions.json and replay the journal onto it"""
+        sessions = {}
+        if os.path.exists(self.path):
+            try:
+                with open(self.path, 'r') as f:
+                    sessions = json.load(f)
+            except Exception as e:
+                self.logger.error(f"Error loading sessions: {str(e)}")
+        replayed = 0
+        if os.path.exists(self.journal_path):
+            try:
+                with open(self.journal_path, 'r') as f:
+                    for line in f:
+                        try:
+                            record = json.loads(line)
+                        except ValueError:
+                            # A torn last line from a crash mid-write
+                            continue
+                        if record.get('op') == 'put':
+                            sessions[record['id']] = record['session']
+                        elif record.get('op') == 'del':
+                            sessions.pop(record['id'], None)
+                        replayed += 1
+            except Exception as e:
+                self.logger.error(f"Error replaying session journal: {str(e)}")
+
+        now = time.time()
+        for session_id, session in sessions.items():
+            # Ensure session has the required fields
+            if not isinstance(session, dict) or 'username' not in session:
+                continue
+            if session.get('expiry', float('inf')) < now:
+                continue
+            self._sessions[session_id] = session
+            self._file(session_id, session.get('expiry'))
+        self.logger.info(f"Loaded {len(self._sessions)} sessions from {self.path} ({replayed} journal records)")
+        if replayed:
+            # Start from a compacted file so the journal only holds new changes
+            self._records.put(_COMPACT)
+
+    def request_compaction(self):
+        """Have the writer write sessions.json and empty the journal soon"""
+        self._records.put(_COMPACT)
+
+    def _write_loop(self):
+        """Append queued records to the journal, compact it and run the timer wheel"""
+        while True:
+            timeout = max(0.0, (self._swept_tick + 1) * WHEEL_TICK - time.time())
+            try:
+                items = [self._records.get(timeout=timeout)]
+            except queue.Empty:
+                self._sweep()
+                continue
+            # Write whatever else is queued in the same go
+            while True:
+                try:
+                    items.append(self._records.get_nowait())
+                except queue.Empty:
+                    break
+
+            records = [item for item in items if isinstance(item, dict)]
+            try:
+                if records:
+                    self._append(records)
+                if _COMPACT in items or self._journal_records >= COMPACT_RECORDS:
+                    self._compact()
+            except Exception as e:
+                self.logger.error(f"Error saving sessions: {str(e)}")
+            if _STOP in items:
+                return
+            if time.time() >= (self._swept_tick + 1) * WHEEL_TICK:
+                self._sweep()
+
+    def _append(self, records):
+        if self._journal is None:
+            fd = os.open(self.journal_path, os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o600)
+            self._journal = os.fdopen(fd, 'a')
+        self._journal.write(''.join(json.dumps(record) + '\n' for record in records))
+        self._journal.flush()
+        self._journal_records += len(records)
+
+    def _compact(self):
+        """Write all sessions to sessions.json and empty the journal (writer thread only)"""
+        stop = False
+        with self._lock:
+            sessions = {session_id: session.copy() for session_id, session in self._sessions.items()}
+            # Every record still queued is already part of this copy
+            while True:
+                try:
+                    stop = self._records.get_nowait() is _STOP or stop
+                except queue.Empty:
+                    break
+        if stop:
+            self._records.put(_STOP)
+        tmp_path = f"{self.path}.tmp.{os.getpid()}"
+        fd = os.open(tmp_path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o600)
+        with os.fdopen(fd, 'w') as f:
+            json.dump(sessions, f)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_path, self.path)
+        if self._journal is not None:
+            self._journal.close()
+            self._journal = None
+        # A crash right here replays records that are already in the new file, which is harmless
+        fd = os.open(self.journal_path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o600)
+        os.close(fd)
+        self._journal_records = 0
+
+    def close(self):
+        """Write everything to sessions.json and stop the writer"""
+        if self._closed:
+            return
+        self._closed = True
+        self._records.put(_COMPACT)
+        self._records.put(_STOP)
+        self._writer.join(timeout=10)
+
+
+_stores = {}
+_stores_lock = threading.Lock()
+
+
+def get_session_store(path: str) -> SessionStore:
+    """Return the shared SessionStore for a sessions file, so sessions outlive AuthManager rebuilds"""
+    with _stores_lock:
+        store = _stores.get(path)
+        if store is None:
+            store = SessionStore(path)
+            atexit.register(store.close)
+            _stores[path] = store
+        return store
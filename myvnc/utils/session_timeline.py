@@ -0,0 +1,256 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Lifecycle timestamps of every session, for startup latency reports
+
+Each session gets up to four events in the session_events table of the
+server's SQLite database (myvnc.db in 'datadir', next to DatabaseManager's
+tables):
+
+- submit: when bsub/sbatch returned, with the user, queue, site, desktop,
+  session type and whether a warm pool slot was claimed
+- dispatch: when the job started running, from its run time in the first
+  listing that shows it running, with the execution host
+- display: when vncserver_wrapper reported the display to the display
+  collector's spool (or, without the collector, the first listing that had
+  the display)
+- connect: when the wrapper saw the first viewer connection in the
+  vncserver log (display collector only)
+
+Rows are only ever inserted, one per job and event. Request threads queue
+them and a writer thread inserts them in batches of up to BATCH_ROWS in one
+transaction every FLUSH_INTERVAL seconds, so recording costs no database
+write on the request path. Rows older than 'retention_days' are deleted at
+startup.
+
+report() pairs the events of the sessions submitted in a time window into
+intervals (queue wait, desktop start, time to desktop, time to connect) and
+returns their percentiles, overall or per queue, site, desktop, host,
+session type or warm pool use.
+"""
+
+import math
+import os
+import queue
+import sqlite3
+import threading
+import time
+from collections import OrderedDict
+from typing import Dict, List, Optional
+
+from myvnc.utils.log_manager import get_logger
+
+EVENTS = ('submit', 'dispatch', 'display', 'connect')
+
+# Intervals reported, as (name, from event, to event)
+INTERVALS = (
+    ('queue_wait', 'submit', 'dispatch'),
+    ('desktop_start', 'dispatch', 'display'),
+    ('time_to_desktop', 'submit', 'display'),
+    ('time_to_connect', 'submit', 'connect'),
+)
+
+# Columns a report can be grouped by
+GROUP_COLUMNS = ('queue', 'site', 'desktop', 'host', 'session_type', 'pooled')
+
+PERCENTILES = (50, 90, 99)
+
+# Rows inserted per transaction, and seconds queued rows wait for one
+BATCH_ROWS = 500
+FLUSH_INTERVAL = 5.0
+
+# (job_id, event) pairs remembered so listings do not queue the same event again
+MAX_SEEN = 50000
+
+DEFAULT_RETENTION_DAYS = 180
+
+_STOP = object()
+
+
+def percentile(values: List[float], pct: float) -> float:
+    """Nearest-rank percentile of sorted values"""
+    return values[max(0, min(len(values), math.ceil(pct / 100.0 * len(values))) - 1)]
+
+
+class SessionTimeline:
+    """Batched, append-only store of session lifecycle events"""
+
+    def __init__(self, db_path: str, retention_days: float = DEFAULT_RETENTION_DAYS):
+        self.db_path = db_path
+        self.logger = get_logger()
+        self._queue = queue.Queue()
+        self._seen = OrderedDict()
+        self._seen_lock = threading.Lock()
+        conn = self._connect()
+        try:
+            conn.execute('''
+                CREATE TABLE IF NOT EXISTS session_events (
+                    job_id TEXT NOT NULL,
+                    event TEXT NOT NULL,
+                    at REAL NOT NULL,
+                    user TEXT,
+                    queue TEXT,
+                    site TEXT,
+                    desktop TEXT,
+                    host TEXT,
+                    session_type TEXT,
+                    pooled INTEGER,
+                    PRIMARY KEY (job_id, event)
+                )
+            ''')
+            conn.execute('CREATE INDEX IF NOT EXISTS session_events_at ON session_events (event, at)')
+            if retention_days:
+                conn.execute('DELETE FROM session_events WHERE at < ?', (time.time() - retention_days * 86400,))
+            conn.commit()
+        finally:
+            conn.close()
+        threading.Thread(target=self._write_loop, name='session-timeline', daemon=True).start()
+
+    def _connect(self) -> sqlite3.Connection:
+        conn = sqlite3.connect(self.db_path, timeout=10.0)
+        conn.execute("PRAGMA synchronous=NORMAL")
+        return conn
+
+    def record(self, job_id: str, event: str, at: Optional[float] = None, **attrs):
+        """Queue an event of a job; an event already recorded for the job is ignored"""
+        job_id = str(job_id or '').strip()
+        if not job_id or job_id == 'unknown':
+            return
+        key = (job_id, event)
+        with self._seen_lock:
+            if key in self._seen:
+                return
+            self._seen[key] = True
+            while len(self._seen) > MAX_SEEN:
+                self._seen.popitem(last=False)
+        self._queue.put((job_id, event, at if at is not None else time.time(), attrs.get('user'), attrs.get('queue'),
+                         attrs.get('site'), attrs.get('desktop'), attrs.get('host'), attrs.get('session_type'),
+                         None if attrs.get('pooled') is None else int(bool(attrs.get('pooled')))))
+
+    def observe(self, jobs: List[Dict], display_collector=None):
+        """Record dispatch, display and connect events of the jobs in a listing"""
+        now = time.time()
+        for job in jobs:
+            if job.get('status') != 'RUN':
+                continue
+            job_id = str(job.get('job_id'))
+            with self._seen_lock:
+                pending = [event for event in ('dispatch', 'display', 'connect') if (job_id, event) not in self._seen]
+            if not pending:
+                continue
+            host = job.get('host')
+            if 'dispatch' in pending:
+                # The scheduler's start time where the listing has it (SLURM),
+                # else the run time counted back from the listing
+                dispatched = job.get('start_time') or now - (job.get('run_time_seconds') or 0)
+                self.record(job_id, 'dispatch', dispatched, user=job.get('user'), queue=job.get('queue'),
+                            host=host, session_type=job.get('session_type'))
+            reported = {}
+            if display_collector is not None and job.get('user'):
+                reported = display_collector.events(job_id, job['user'])
+            if 'display' in pending and (reported.get('display') or job.get('display')):
+                self.record(job_id, 'display', reported.get('display') or now, host=host)
+            if 'connect' in pending and reported.get('connect'):
+                self.record(job_id, 'connect', reported['connect'], host=host)
+
+    def _write_loop(self):
+        conn = None
+        while True:
+            rows = [self._queue.get()]
+            deadline = time.monotonic() + FLUSH_INTERVAL
+            while rows[-1] is not _STOP and len(rows) < BATCH_ROWS:
+                try:
+                    rows.append(self._queue.get(timeout=max(0.0, deadline - time.monotonic())))
+                except queue.Empty:
+                    break
+            stop = rows[-1] is _STOP
+            rows = [row for row in rows if row is not _STOP]
+            if rows:
+                try:
+                    if conn is None:
+                        conn = self._connect()
+                    with conn:
+                        conn.executemany('INSERT OR IGNORE INTO session_events VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)', rows)
+                except sqlite3.Error as e:
+                    self.logger.error(f"Could not record {len(rows)} session events: {e}")
+                    conn = None
+            if stop:
+                return
+
+    def close(self):
+        self._queue.put(_STOP)
+
+    def report(self, since: float, group_by: Optional[str] = None) -> Dict:
+        """
+        Percentiles of the startup intervals of the sessions submitted since a time
+
+        Args:
+            since: Epoch seconds; sessions submitted before are left out
+            group_by: One of GROUP_COLUMNS, or None for one overall group
+
+        Returns:
+            {'since': ..., 'group_by': ..., 'groups': [{group_by: value, 'sessions': n,
+             interval: {'count', 'p50', 'p90', 'p99', 'max'}, ...}, ...]}
+        """
+        if group_by is not None and group_by not in GROUP_COLUMNS:
+            raise ValueError(f"Cannot group by {group_by}; one of: {', '.join(GROUP_COLUMNS)}")
+        conn = self._connect()
+        try:
+            rows = conn.execute('''
+                SELECT e.job_id, e.event, e.at, e.queue, e.site, e.desktop, e.host, e.session_type, e.pooled
+                FROM session_events e
+                JOIN session_events s ON s.job_id = e.job_id AND s.event = 'submit'
+                WHERE s.at >= ?
+            ''', (since,)).fetchall()
+        finally:
+            conn.close()
+
+        sessions: Dict[str, Dict] = {}
+        for job_id, event, at, queue_name, site, desktop, host, session_type, pooled in rows:
+            session = sessions.setdefault(job_id, {})
+            session[event] = at
+            if event == 'submit':
+                session.update(queue=queue_name, site=site, desktop=desktop, session_type=session_type,
+                               pooled='yes' if pooled else 'no')
+            if host and (event == 'dispatch' or 'host' not in session):
+                session['host'] = host
+
+        groups: Dict[str, List[Dict]] = {}
+        for session in sessions.values():
+            groups.setdefault(str(session.get(group_by)) if group_by else 'all', []).append(session)
+
+        result = []
+        for value, members in sorted(groups.items()):
+            group = {group_by or 'group': value, 'sessions': len(members)}
+            for name, start, end in INTERVALS:
+                values = sorted(s[end] - s[start] for s in members if start in s and end in s and s[end] >= s[start])
+                if not values:
+                    group[name] = {'count': 0}
+                    continue
+                group[name] = {'count': len(values), 'max': round(values[-1], 1),
+                               **{f'p{pct}': round(percentile(values, pct), 1) for pct in PERCENTILES}}
+            result.append(group)
+        return {'since': since, 'group_by': group_by, 'groups': result}
+
+
+_timelines: Dict[str, SessionTimeline] = {}
+_timelines_lock = threading.Lock()
+
+
+def get_session_timeline(server_config: Dict) -> Optional[SessionTimeline]:
+    """
+    Return the shared SessionTimeline of the data directory, or None when
+    'session_timeline' is not enabled in server_config.json
+    """
+    timeline_config = server_config.get('session_timeline') or {}
+    if not timeline_config.get('enabled', False):
+        return None
+    data_dir = server_config.get('datadir', '/localdev/myvnc/data')
+    db_path = os.path.join(data_dir, 'myvnc.db')
+    with _timelines_lock:
+        timeline = _timelines.get(db_path)
+        if timeline is None:
+            os.makedirs(data_dir, exist_ok=True)
+            timeline = SessionTimeline(db_path, float(timeline_config.get('retention_days', DEFAULT_RETENTION_DAYS)))
+            _timelines[db_path] = timeline
+        return timeline
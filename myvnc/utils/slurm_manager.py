@@ -7,6 +7,7 @@ SLURM Manager for submitting and monitoring SLURM jobs
 
 import subprocess
 import shlex
+import shutil
 import re
 import sys
 import time
@@ -16,11 +17,46 @@ from datetime import datetime
 import json
 from pathlib import Path
 import signal
+import threading
 
 
-from myvnc.utils.config_manager import ConfigManager
-from myvnc.utils.config_loader import load_server_config
-from myvnc.utils.log_manager import get_logger
+from myvnc.utils.config_loader import load_server_config, get_config_manager
+from myvnc.utils.log_manager import get_logger, redact
+from myvnc.utils import job_table
+from myvnc.utils.job_snapshot import create_job_snapshot
+from myvnc.utils.job_feed import create_job_feed
+from myvnc.utils.host_load import HostLoad, create_host_load
+from myvnc.utils.warm_pool import HOLDER_PREFIX, PoolSlot, create_warm_pool
+from myvnc.utils.display_collector import get_display_collector
+from myvnc.utils.session_timeline import get_session_timeline
+from myvnc.utils.federation import cluster_environment, cluster_server_config
+from myvnc.utils.runner_client import (get_runner_client, run_batch_direct, stream_direct, RunnerUnavailable,
+                                      run_direct, setuid_argv, backstop_timeout, remaining_time,
+                                      deadline_scope, submit as submit_call)
+from myvnc.utils.tracing import tracer, command_name
+from myvnc.utils.submission import (SubmissionPlan, SubmissionPlans, can_substitute, placeholders, plan_key,
+                                    user_credentials)
+from myvnc.utils.slurm_rest import get_slurm_rest, SlurmRestError
+
+# Streamed command output kept in the command history, which is only for debugging
+STREAM_HISTORY_LIMIT = 64 * 1024
+
+# Seconds a scheduler command may run unless 'scheduler_timeouts' says otherwise
+DEFAULT_COMMAND_TIMEOUT = 60
+
+# Submissions of a submit_jobs() batch in flight at once
+BATCH_SUBMIT_PARALLEL = 8
+
+# Job names of myvnc's sessions (squeue --name)
+VNC_JOB_NAMES = ('myvnc_vncserver', 'myvnc_tmux')
+
+# squeue format of a job's connection details: state, user, nodes, name, command
+CONNECTION_DETAILS_FORMAT = '%t|%u|%N|%j|%o'
+
+# Seconds a session placed on a warm pool node with --nodelist may pend before
+# the requirement is lifted, and how long such a session is watched at most
+DEFAULT_POOL_PIN_SECONDS = 30
+POOL_PIN_TTL = 3600.0
 
 
 class SLURMError(Exception):
@@ -35,31 +71,43 @@ class SLURMError(Exception):
 class SLURMManager:
     """Manages interactions with the SLURM job scheduler via command line"""
 
-    _instance = None
+    # One instance, or one per cluster of a federation (see federation.py)
+    _instances = {}
     _initialized = False
 
-    def __new__(cls):
-        """Ensure only one instance of SLURMManager is created"""
-        if cls._instance is None:
-            cls._instance = super(SLURMManager, cls).__new__(cls)
-        return cls._instance
+    def __new__(cls, cluster: Dict = None):
+        """Ensure only one instance of SLURMManager is created per cluster"""
+        name = cluster['name'] if cluster else None
+        if name not in cls._instances:
+            cls._instances[name] = super(SLURMManager, cls).__new__(cls)
+        return cls._instances[name]
 
-    def __init__(self):
+    def __init__(self, cluster: Dict = None):
         """
         Initialize the SLURM manager and check if SLURM is available
 
+        Args:
+            cluster: Federated cluster configuration (name, environment,
+                settings); None for the server's only scheduler
+
         Raises:
             RuntimeError: If SLURM is not available
         """
-        if SLURMManager._initialized:
+        if self._initialized:
             return
 
+        # Federated clusters' commands run with the cluster's scheduler environment
+        self.cluster = cluster['name'] if cluster else None
+        self.command_env = cluster_environment(cluster) if cluster else None
+
         self.command_history = []
-        self.config_manager = ConfigManager()
+        self.config_manager = get_config_manager()
         self.environment = os.environ.copy()
         self.logger = get_logger()
 
         server_config = load_server_config()
+        if cluster:
+            server_config = cluster_server_config(server_config, cluster)
         default_path = os.path.join(os.path.dirname(os.path.dirname(os.path.dirname(__file__))), 'setuid_runner')
         self.setuid_binary = server_config.get('setuid_runner', default_path)
 
@@ -68,13 +116,77 @@ class SLURMManager:
         else:
             self.logger.info(f"Using default setuid_runner path: {self.setuid_binary}")
 
+        self.runner_client = get_runner_client(server_config, self.setuid_binary, env=self.command_env)
+        if self.runner_client:
+            self.logger.info(f"Using setuid_runner daemon at: {self.runner_client.socket_path}")
+
+        # Job queries go to slurmrestd when configured, squeue if it fails
+        self.slurm_rest = get_slurm_rest(server_config, self._slurm_token)
+        if self.slurm_rest:
+            self.logger.info(f"Querying jobs through slurmrestd at: {self.slurm_rest.url}")
+
+        # Native bjobs/squeue tokenizer, looked for next to setuid_runner
+        job_table.load_library(server_config.get('job_table_library'), [os.path.dirname(self.setuid_binary)])
+
+        # Every scheduler command is stopped after this long (SIGTERM, then SIGKILL)
+        self.command_timeout = float((server_config.get('scheduler_timeouts') or {}).get('command', DEFAULT_COMMAND_TIMEOUT)) or None
+
+        # Shared listing of all users' jobs, refreshed at most once per ttl
+        self.job_snapshot = create_job_snapshot(server_config, self._fetch_job_snapshot)
+        self.job_snapshot_user = (server_config.get('job_snapshot') or {}).get('run_as') or None
+        if self.job_snapshot:
+            self.logger.info(f"Serving job listings from a shared snapshot (ttl {self.job_snapshot.ttl}s)")
+        # Versioned view of the snapshot for /api/vnc/updates (needs the snapshot)
+        self.job_feed = create_job_feed(server_config, self.job_snapshot)
+        if self.job_feed:
+            self.logger.info(f"Serving incremental job updates (refresh every {self.job_feed.interval}s)")
+        # Node load refreshed in the background, for --exclude of overloaded nodes on submissions
+        self.host_load = create_host_load(server_config, self._fetch_host_load, self._fetch_host_sessions)
+        if self.host_load:
+            self.logger.info(f"Keeping sessions off overloaded nodes (refresh every {self.host_load.interval}s)")
+
+        # Displays pushed by vncserver_wrapper, checked before the display files
+        self.display_collector = get_display_collector(server_config)
+        if self.display_collector:
+            self.logger.info(f"Collecting VNC displays from spool: {self.display_collector.spool_dir}")
+
+        # Submit, dispatch, display and connect times of every session, for startup reports
+        self.session_timeline = get_session_timeline(server_config)
+
+        # Batch scripts compiled per configuration, filled in with the user at launch
+        self.submission_plans = SubmissionPlans()
+
         try:
             self._check_slurm_available()
             self._check_setuid_binary()
         except Exception as e:
             print(f"Warning: SLURM initialization error: {str(e)}", file=sys.stderr)
 
-        SLURMManager._initialized = True
+        # Slots held by the pool account for VNC requests matching a profile; the
+        # refill thread starts right away, so it comes after the command checks
+        self.warm_pool_user = (server_config.get('warm_pool') or {}).get('run_as') or None
+        self.warm_pool = create_warm_pool(server_config, self._list_pool_holders, self._submit_pool_holder,
+                                          self._release_pool_holder)
+        if self.warm_pool:
+            self.logger.info(f"Keeping {self.warm_pool.size} warm pool slot(s) for each of {len(self.warm_pool.profiles)} profile(s)")
+        # --nodelist is a requirement: sessions sent to a held node that are still
+        # pending after this long get it lifted (job_id -> (monotonic time, user))
+        self.pool_pin_seconds = float((server_config.get('warm_pool') or {}).get('pin_seconds', DEFAULT_POOL_PIN_SECONDS))
+        self._pool_pins: Dict[str, Tuple[float, Optional[str]]] = {}
+        self._pool_pins_lock = threading.Lock()
+
+        self._initialized = True
+
+    def call_async(self, fn, *args, deadline: float = None, **kwargs):
+        """
+        Start fn(*args, **kwargs), usually one of this manager's methods, in
+        the background and return its concurrent.futures.Future
+        
+        Scheduler commands run by the call are stopped at the time.monotonic()
+        deadline, so a caller that waits with future.result(timeout=...) can
+        give up without leaving them running.
+        """
+        return submit_call(fn, *args, deadline=deadline, **kwargs)
 
     def get_command_history(self, limit=10):
         """Return the last N commands executed with their outputs"""
@@ -96,7 +208,7 @@ class SLURMManager:
         for cmd in slurm_commands:
             try:
                 self.logger.debug(f"Running 'which {cmd}' to find command path")
-                result = subprocess.run(['which', cmd], check=True,
+                result = subprocess.run(['which', cmd], check=True, env=self.command_env,
                                        stdout=subprocess.PIPE, stderr=subprocess.PIPE)
                 cmd_path = result.stdout.decode('utf-8').strip()
                 self.logger.info(f"Found {cmd} at: {cmd_path}")
@@ -114,6 +226,13 @@ class SLURMManager:
         else:
             self.logger.info(f"All SLURM commands found successfully: {', '.join(slurm_commands)}")
 
+        # Helper commands run through setuid_runner; with absolute paths the
+        # broker spawns them directly instead of searching PATH
+        for cmd in ['test', 'cat']:
+            cmd_path = shutil.which(cmd)
+            if cmd_path:
+                self.slurm_cmd_paths[cmd] = cmd_path
+
     def _check_setuid_binary(self):
         """
         Check if the setuid binary exists and has proper permissions
@@ -136,13 +255,15 @@ class SLURMManager:
 
         self.logger.info(f"Setuid binary found at: {self.setuid_binary}")
 
-    def _run_command(self, cmd: List[str], authenticated_user: str = None) -> str:
+    def _run_command(self, cmd: List[str], authenticated_user: str = None, record_output: bool = True) -> str:
         """
         Run a command and return its output
 
         Args:
             cmd: Command to run as a list of arguments
             authenticated_user: Optional authenticated username to run command as
+            record_output: False to keep stdout out of the log and the command
+                history (for credentials such as 'scontrol token')
 
         Returns:
             Command output as a string
@@ -168,18 +289,32 @@ class SLURMManager:
             self.logger.debug(f"DEBUG: Running as authenticated user: {authenticated_user}")
 
         try:
-            result = subprocess.run(modified_cmd, check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            result = None
+            timeout = remaining_time(self.command_timeout)
+            with tracer.span(cmd, sensitive=not record_output):
+                verbose = tracer.verbose(cmd)
+                if authenticated_user and self.runner_client:
+                    try:
+                        result = self.runner_client.run(authenticated_user, modified_cmd[2:], timeout=timeout, check=True)
+                    except RunnerUnavailable as e:
+                        self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} directly: {e}")
+                if result is None and authenticated_user:
+                    # setuid_runner enforces the deadline on the command itself
+                    result = run_direct(setuid_argv(self.setuid_binary, authenticated_user, modified_cmd[2:], timeout),
+                                        timeout=backstop_timeout(timeout), check=True, env=self.command_env)
+                elif result is None:
+                    result = run_direct(modified_cmd, timeout=timeout, check=True, env=self.command_env)
             stdout = result.stdout.decode('utf-8')
             stderr = result.stderr.decode('utf-8')
 
-            if stdout:
+            if stdout and verbose and record_output:
                 self.logger.info(f"Command output: {stdout}")
             if stderr:
                 self.logger.info(f"Command stderr: {stderr}")
 
             self.command_history.append({
                 'command': cmd_str,
-                'stdout': stdout,
+                'stdout': stdout if record_output else '(not recorded)',
                 'stderr': stderr,
                 'success': True,
                 'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
@@ -189,28 +324,183 @@ class SLURMManager:
         except subprocess.CalledProcessError as e:
             stderr = e.stderr.decode('utf-8')
             stdout = e.stdout.decode('utf-8') if e.stdout else ''
+            raise self._command_failed(cmd_str, stdout, stderr)
+        finally:
+            # Job state may have changed; the next listing must not come from the old snapshot
+            if self.job_snapshot and os.path.basename(slurm_command) in ('sbatch', 'scancel'):
+                self.job_snapshot.invalidate()
+
+    def _command_failed(self, cmd_str: str, stdout: str, stderr: str) -> SLURMError:
+        """Log a failed command, add it to the command history and return the SLURMError to raise"""
+        is_no_jobs = ('Invalid job id' in stderr or
+                      'slurm_load_jobs error' in stderr or
+                      'No jobs' in stderr)
+
+        if is_no_jobs:
+            self.logger.debug(f"Command completed with no results: {cmd_str}")
+            self.logger.debug(f"Command stderr: {stderr}")
+        else:
+            self.logger.error(f"Command failed: {cmd_str}")
+            self.logger.error(f"Command stdout: {redact(stdout)}")
+            self.logger.error(f"Command stderr: {stderr}")
 
-            is_no_jobs = ('Invalid job id' in stderr or
-                          'slurm_load_jobs error' in stderr or
-                          'No jobs' in stderr)
+        self.command_history.append({
+            'command': cmd_str,
+            'stdout': redact(stdout),
+            'stderr': stderr,
+            'success': False,
+            'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+        })
 
-            if is_no_jobs:
-                self.logger.debug(f"Command completed with no results: {cmd_str}")
-                self.logger.debug(f"Command stderr: {stderr}")
+        return SLURMError(stderr.strip(), stderr=stderr, stdout=stdout)
+
+    def _stream_command(self, cmd: List[str], authenticated_user: str = None, raw: bool = False):
+        """
+        Run a command and yield its stdout line by line as it is produced
+
+        Commands run as authenticated_user go through setuid_runner in framed
+        mode, so large listings (squeue for all users) are parsed as they
+        arrive instead of being buffered whole. Without an authenticated user
+        this is _run_command split into lines.
+
+        Args:
+            cmd: Command to run as a list of arguments
+            authenticated_user: Optional authenticated username to run command as
+            raw: Yield stdout as bytes chunks, exactly as they arrive
+
+        Yields:
+            Lines of stdout without the newline, or bytes chunks with raw
+
+        Raises:
+            SLURMError: After the last line, if the command failed
+        """
+        if not authenticated_user:
+            output = self._run_command(cmd, authenticated_user)
+            yield from tracer.iterate([output.encode('utf-8')] if raw else output.splitlines(),
+                                      command=command_name(cmd))
+            return
+
+        # Replace SLURM commands with their full paths, as _run_command does
+        modified_cmd = cmd.copy()
+        if cmd and cmd[0] in self.slurm_cmd_paths:
+            modified_cmd[0] = self.slurm_cmd_paths[cmd[0]]
+        cmd_str = ' '.join(str(arg) for arg in cmd)
+        self.logger.debug(f"DEBUG: Streaming command as authenticated user {authenticated_user}: {cmd_str}")
+
+        span = tracer.start(cmd)
+        verbose = not raw and tracer.verbose(cmd)
+        stream = None
+        timeout = remaining_time(self.command_timeout)
+        try:
+            with span.phase('spawn'):
+                if self.runner_client:
+                    try:
+                        stream = self.runner_client.stream(authenticated_user, modified_cmd, timeout=timeout)
+                    except RunnerUnavailable as e:
+                        self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} --framed directly: {e}")
+                if stream is None:
+                    stream = stream_direct(self.setuid_binary, authenticated_user, modified_cmd, timeout=timeout,
+                                           env=self.command_env)
+        except Exception:
+            # The command never started, so the span is not finished by iterate()
+            tracer.finish(span)
+            raise
+
+        # Only the start of the output is kept for the command history
+        head, head_len = [], 0
+        for item in tracer.iterate(stream.chunks() if raw else stream, span):
+            if head_len < STREAM_HISTORY_LIMIT:
+                head.append(item)
+                head_len += len(item) + 1
+            if verbose:
+                self.logger.info(f"  {item}")
+            yield item
+
+        stdout = b''.join(head).decode('utf-8', 'replace') if raw else '\n'.join(head)
+        stderr = stream.stderr.decode('utf-8', 'replace')
+        if stream.returncode != 0:
+            raise self._command_failed(cmd_str, stdout, stderr)
+        if stderr:
+            self.logger.info(f"Command stderr: {stderr}")
+        self.command_history.append({
+            'command': cmd_str,
+            'stdout': stdout,
+            'stderr': stderr,
+            'success': True,
+            'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+        })
+
+    def _run_commands(self, cmds: List[List[str]], authenticated_user: str = None) -> List[Optional[str]]:
+        """
+        Run several independent commands and return their outputs
+
+        Commands run as authenticated_user go to setuid_runner as one batch, so
+        the broker switches credentials once and runs them concurrently instead
+        of being launched once per command.
+
+        Args:
+            cmds: Commands to run, each a list of arguments
+            authenticated_user: Optional authenticated username to run commands as
+
+        Returns:
+            List with each command's stdout, or None where the command failed
+        """
+        if not authenticated_user or len(cmds) < 2:
+            outputs = []
+            for cmd in cmds:
+                try:
+                    outputs.append(self._run_command(cmd, authenticated_user))
+                except Exception:
+                    outputs.append(None)
+            return outputs
+
+        modified_cmds = []
+        for cmd in cmds:
+            modified_cmd = cmd.copy()
+            if cmd and cmd[0] in self.slurm_cmd_paths:
+                modified_cmd[0] = self.slurm_cmd_paths[cmd[0]]
+            modified_cmds.append(modified_cmd)
+
+        self.logger.debug(f"DEBUG: Running batch of {len(cmds)} commands as authenticated user: {authenticated_user}")
+        results = None
+        timeout = remaining_time(self.command_timeout)
+        with tracer.span(modified_cmds[0]):
+            verbose = tracer.verbose(modified_cmds[0])
+            if self.runner_client:
+                try:
+                    results = self.runner_client.run_batch(authenticated_user, modified_cmds, timeout=timeout)
+                except RunnerUnavailable as e:
+                    self.logger.warning(f"setuid_runner daemon unavailable, running {self.setuid_binary} --batch directly: {e}")
+            if results is None:
+                results = run_batch_direct(self.setuid_binary, authenticated_user, modified_cmds, timeout=timeout,
+                                           env=self.command_env)
+
+        outputs = []
+        for cmd, result in zip(cmds, results):
+            cmd_str = ' '.join(str(arg) for arg in cmd)
+            stdout = result.stdout.decode('utf-8')
+            stderr = result.stderr.decode('utf-8')
+            success = result.returncode == 0
+
+            if success:
+                if stdout and verbose:
+                    self.logger.info(f"Command output: {stdout}")
+                outputs.append(stdout)
             else:
-                self.logger.error(f"Command failed: {cmd_str}")
-                self.logger.error(f"Command stdout: {stdout}")
-                self.logger.error(f"Command stderr: {stderr}")
+                # Failures are expected here (e.g. display files not written yet)
+                self.logger.debug(f"Command failed in batch: {cmd_str}")
+                self.logger.debug(f"Command stderr: {stderr}")
+                outputs.append(None)
 
             self.command_history.append({
                 'command': cmd_str,
                 'stdout': stdout,
                 'stderr': stderr,
-                'success': False,
+                'success': success,
                 'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
             })
 
-            raise SLURMError(stderr.strip(), stderr=stderr, stdout=stdout)
+        return outputs
 
     def _write_batch_script(self, script_content: str, script_path: str) -> str:
         """Write a SLURM batch script to disk and return the path.
@@ -228,20 +518,29 @@ class SLURMManager:
         self.logger.info(f"Wrote SLURM batch script to: {script_path}")
         return script_path
 
-    def _get_display_from_file(self, job_id: str, user_home: str, authenticated_user: str = None) -> Optional[str]:
+    def _get_display_from_file(self, job_id: str, job_user: str, authenticated_user: str = None) -> Optional[str]:
         """Retrieve the VNC display number from the display file written by the batch script.
 
         The SLURM batch script captures vncserver output and writes the display
-        number to ~/.vnc/myvnc_slurm_display.<job_id>.
+        number to ~/.vnc/myvnc_slurm_display.<job_id>. A display already pushed
+        to the display collector is used without reading any file.
 
         Falls back to parsing VNC stdout log if the display file doesn't exist yet.
         If direct file reads fail (permissions), falls back to using cat via _run_command.
 
         Returns the display number as a string (e.g. "6") or None if not available.
         """
+        return self._get_displays_from_files([(job_id, job_user)], authenticated_user).get(job_id)
+
+    def _display_file_paths(self, job_id: str, user_home: str) -> Tuple[str, str]:
+        """Display file and SLURM stdout log written for a job by the batch script"""
         vnc_dir = os.path.join(user_home, '.vnc')
-        display_file = os.path.join(vnc_dir, f'myvnc_slurm_display.{job_id}')
-        stdout_log = os.path.join(vnc_dir, f'myvnc.{job_id}.slurm_stdout.log')
+        return (os.path.join(vnc_dir, f'myvnc_slurm_display.{job_id}'),
+                os.path.join(vnc_dir, f'myvnc.{job_id}.slurm_stdout.log'))
+
+    def _read_display_locally(self, job_id: str, user_home: str) -> Optional[str]:
+        """Read the display for a job directly, without setuid_runner (methods 1 and 2)"""
+        display_file, stdout_log = self._display_file_paths(job_id, user_home)
 
         # Method 1: Direct file read of display file
         try:
@@ -282,39 +581,101 @@ class SLURMManager:
         except Exception as e:
             self.logger.warning(f"Could not read stdout log for SLURM job {job_id}: {e}")
 
-        # Method 3: Use cat via _run_command (goes through setuid_runner if needed)
-        if authenticated_user:
-            try:
-                output = self._run_command(['cat', display_file], authenticated_user)
-                if output:
-                    content = output.strip()
-                    self.logger.info(f"Read display file via cat for job {job_id}, content: '{content}'")
-                    if content.isdigit():
-                        return content
-                    match = re.search(r'VNC_DISPLAY=:(\d+)', content)
-                    if match:
-                        return match.group(1)
-            except Exception as e:
-                self.logger.debug(f"cat display file via _run_command failed for job {job_id}: {e}")
+        return None
 
-            # Try reading stdout log via cat
-            try:
-                output = self._run_command(['cat', stdout_log], authenticated_user)
-                if output:
-                    for line in output.splitlines():
-                        match = re.search(r"New '[^:]*:(\d+)", line)
-                        if match:
-                            self.logger.info(f"Found VNC display from stdout log (via cat) for job {job_id}: :{match.group(1)}")
-                            return match.group(1)
-                        match = re.search(r"desktop is [^:]*:(\d+)", line)
-                        if match:
-                            self.logger.info(f"Found VNC display from stdout log (via cat) for job {job_id}: :{match.group(1)}")
-                            return match.group(1)
-            except Exception as e:
-                self.logger.debug(f"cat stdout log via _run_command failed for job {job_id}: {e}")
+    def _get_displays_from_files(self, jobs: List[Tuple[str, str]], authenticated_user: str = None) -> Dict[str, Optional[str]]:
+        """Batched _get_display_from_file for a list of (job_id, job_user) pairs.
+
+        Jobs whose files cannot be read directly are read with cat through a
+        single setuid_runner batch instead of separate launches per file.
+
+        Returns a dictionary mapping each job ID to its display number or None.
+        """
+        displays = {}
+        unresolved = []
+        for job_id, job_user in jobs:
+            # Method 0: Display pushed by vncserver_wrapper
+            if self.display_collector:
+                displays[job_id] = self.display_collector.get(job_id, job_user)
+                if displays[job_id] is not None:
+                    continue
+            user_home = os.path.expanduser(f'~{job_user}')
+            displays[job_id] = self._read_display_locally(job_id, user_home)
+            if displays[job_id] is None:
+                unresolved.append((job_id, user_home))
+
+        if not unresolved or not authenticated_user:
+            return displays
+
+        # Method 3: Use cat via setuid_runner for both files of every unresolved job
+        cmds = []
+        for job_id, user_home in unresolved:
+            display_file, stdout_log = self._display_file_paths(job_id, user_home)
+            cmds.append(['cat', display_file])
+            cmds.append(['cat', stdout_log])
+        outputs = self._run_commands(cmds, authenticated_user)
+
+        for i, (job_id, _) in enumerate(unresolved):
+            displays[job_id] = self._parse_display_outputs(job_id, outputs[2 * i], outputs[2 * i + 1])
+        return displays
+
+    def _parse_display_outputs(self, job_id: str, display_output: Optional[str], stdout_log_output: Optional[str]) -> Optional[str]:
+        """Extract the display from cat output of the display file and stdout log"""
+        if display_output:
+            content = display_output.strip()
+            self.logger.info(f"Read display file via cat for job {job_id}, content: '{content}'")
+            if content.isdigit():
+                return content
+            match = re.search(r'VNC_DISPLAY=:(\d+)', content)
+            if match:
+                return match.group(1)
+
+        if stdout_log_output:
+            for line in stdout_log_output.splitlines():
+                match = re.search(r"New '[^:]*:(\d+)", line)
+                if match:
+                    self.logger.info(f"Found VNC display from stdout log (via cat) for job {job_id}: :{match.group(1)}")
+                    return match.group(1)
+                match = re.search(r"desktop is [^:]*:(\d+)", line)
+                if match:
+                    self.logger.info(f"Found VNC display from stdout log (via cat) for job {job_id}: :{match.group(1)}")
+                    return match.group(1)
 
         return None
 
+    def _submission_values(self, user: str, user_home: str, authenticated_user: Optional[str],
+                           name: Optional[str]) -> Dict[str, Optional[str]]:
+        """The per-launch fields of a submission plan; name has its spaces replaced with underscores"""
+        user_uid = None
+        if authenticated_user:
+            # XDG_RUNTIME_DIR and DBUS_SESSION_BUS_ADDRESS are derived from the UID
+            user_uid = user_credentials(authenticated_user).uid
+            if user_uid:
+                self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
+            else:
+                self.logger.error(f"Failed to get UID for user {authenticated_user}")
+        return {
+            'user': user,
+            'home': user_home,
+            'uid': user_uid,
+            'name': name.replace(' ', '_') if name is not None else None,
+        }
+
+    def _submission_plan(self, kind: str, compile, session_config: Dict, slurm_config: Dict,
+                         values: Dict[str, Optional[str]], authenticated: bool) -> SubmissionPlan:
+        """
+        Return the plan compile(session_config, slurm_config, values, authenticated)
+        builds, compiled once per configuration with placeholders for values
+        unless they cannot be substituted safely
+        """
+        if not can_substitute(values):
+            return compile(session_config, slurm_config, values, authenticated)
+        present = {field: value is not None for field, value in values.items()}
+        key = plan_key(kind, self.config_manager.version,
+                       {k: v for k, v in session_config.items() if k != 'name'}, slurm_config, authenticated, present)
+        return self.submission_plans.get(
+            key, lambda: compile(session_config, slurm_config, placeholders(**present), authenticated))
+
     def submit_vnc_job(self, vnc_config: Dict, slurm_config: Dict, authenticated_user: str = None, fake_no_home: bool = False, server_hostname: str = None) -> str:
         """Submit a VNC job using sbatch
 
@@ -333,7 +694,7 @@ class SLURMManager:
         """
         try:
             user = authenticated_user if authenticated_user else os.environ.get('USER', '')
-            user_home = os.path.expanduser(f'~{user}')
+            user_home = user_credentials(user).home
 
             vnc_passwd_file = f'/home/{user}/.vnc/passwd'
             passwd_exists = False
@@ -376,187 +737,271 @@ class SLURMManager:
                 self.logger.error(error_msg)
                 raise SLURMError(error_msg)
 
-            job_name = 'myvnc_vncserver'
-            num_cores = int(slurm_config.get('cpus_per_task', slurm_config.get('num_cores', 2)))
-            memory_gb = int(slurm_config.get('memory_gb', 16))
+            # Ensure the .vnc directory exists for the batch script and log files
+            vnc_log_dir = os.path.join(user_home, '.vnc')
+            try:
+                os.makedirs(vnc_log_dir, mode=0o755, exist_ok=True)
+                self.logger.info(f"Ensured .vnc directory exists: {vnc_log_dir}")
+            except Exception as e:
+                self.logger.warning(f"Could not create .vnc directory {vnc_log_dir}: {e}")
 
+            # Only the user and the display name differ between launches of the same configuration
             display_name = vnc_config.get('name', 'MyVNC Session')
-            resolution = vnc_config.get('resolution', '1024x768')
-            color_depth = int(vnc_config.get('color_depth', 24))
-
-            partition = slurm_config.get('partition', slurm_config.get('queue', 'interactive'))
-
-            # Build sbatch command
-            sbatch_cmd = [
-                'sbatch',
-                '--partition', partition,
-                '--cpus-per-task', str(num_cores),
-                '--mem', f'{memory_gb}G',
-                '--job-name', job_name,
-                '--ntasks', '1',
-            ]
-
-            # Add constraint for OS selection (but NOT when using a container)
-            container_path = slurm_config.get('container', '')
-            using_container = container_path and container_path.strip()
+            values = self._submission_values(user, user_home, authenticated_user,
+                                             display_name if display_name and display_name.strip() else None)
+            plan = self._submission_plan('vnc', self._compile_vnc_submission, vnc_config, slurm_config, values,
+                                         bool(authenticated_user))
+            _, script_content = plan.render(values)
 
-            if using_container:
-                original_container_path = container_path
-                container_path = os.path.realpath(container_path)
-                if original_container_path != container_path:
-                    self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
-
-            os_constraint = slurm_config.get('constraint', slurm_config.get('os_select', ''))
+            # Write batch script to user's .vnc directory
+            script_path = os.path.join(vnc_log_dir, f'myvnc_vnc_submit.sh')
+            self._write_batch_script(script_content, script_path)
 
-            arch_constraint = slurm_config.get('arch_constraint', slurm_config.get('arch_select', ''))
-            constraints = []
-            if not using_container and os_constraint and os_constraint != "any":
-                constraints.append(os_constraint)
-            if arch_constraint and arch_constraint != "any":
-                constraints.append(arch_constraint)
+            # Use sbatch with --parsable to get just the job ID
+            slot = self._claim_pool_slot(vnc_config, slurm_config)
+            sbatch_cmd = ['sbatch', '--parsable'] + self._placement_hint(slurm_config, slot) + [script_path]
 
-            if constraints:
-                sbatch_cmd.extend(['--constraint', '&'.join(constraints)])
-                self.logger.info(f"Adding SLURM constraints: {constraints}")
+            cmd_str = ' '.join(str(arg) for arg in sbatch_cmd)
+            cmd_entry = {
+                'command': cmd_str,
+                'stdout': '',
+                'stderr': '',
+                'success': False,
+                'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+            }
+            self.command_history.append(cmd_entry)
 
-            # Add time limit if specified
-            time_limit = slurm_config.get('time_limit', '')
-            if time_limit and time_limit.strip():
-                sbatch_cmd.extend(['--time', time_limit])
+            try:
+                self.logger.info(f"Submitting VNC job with sbatch")
+                stdout = self._run_command(sbatch_cmd, authenticated_user)
 
-            # Add node/host filter if specified
-            host_filter = slurm_config.get('host_filter', slurm_config.get('nodelist', ''))
-            if host_filter and host_filter.strip():
-                sbatch_cmd.extend(['--nodelist', host_filter])
+                job_id = stdout.strip().split(';')[0].strip()
+                if not job_id.isdigit():
+                    job_id_match = re.search(r'(\d+)', stdout)
+                    job_id = job_id_match.group(1) if job_id_match else 'unknown'
 
-            # Set working directory
-            sbatch_cmd.extend(['--chdir', user_home])
-            self.logger.info(f"Setting SLURM working directory: {user_home}")
+                self.logger.info(f"Job submitted successfully, ID: {job_id}")
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, job_id)
+                if slot is not None and job_id != 'unknown':
+                    with self._pool_pins_lock:
+                        self._pool_pins[job_id] = (time.monotonic(), authenticated_user)
+                self._record_submit(job_id, user, 'vnc', vnc_config, slurm_config, slot)
+                return job_id
 
-            # Set output/error log paths
-            vnc_log_dir = os.path.join(user_home, '.vnc')
-            try:
-                os.makedirs(vnc_log_dir, mode=0o755, exist_ok=True)
-                self.logger.info(f"Ensured .vnc directory exists: {vnc_log_dir}")
+            except SLURMError as e:
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, None)
+                self.logger.error(f"Job submission failed: {str(e)}")
+                cmd_entry['stderr'] += f"\nException: {str(e)}"
+                raise e
             except Exception as e:
-                self.logger.warning(f"Could not create .vnc directory {vnc_log_dir}: {e}")
+                if self.warm_pool:
+                    self.warm_pool.finish(slot, None)
+                error_msg = f"Job submission error: {str(e)}"
+                self.logger.error(error_msg)
+                cmd_entry['stderr'] += f"\nException: {str(e)}"
+                raise Exception(error_msg)
 
-            stdout_log_path = f'{user_home}/.vnc/myvnc.%j.slurm_stdout.log'
-            stderr_log_path = f'{user_home}/.vnc/myvnc.%j.slurm_stderr.log'
-            sbatch_cmd.extend(['--output', stdout_log_path])
-            sbatch_cmd.extend(['--error', stderr_log_path])
-
-            self.logger.info(f"Setting SLURM stdout log file: {stdout_log_path}")
-            self.logger.info(f"Setting SLURM stderr log file: {stderr_log_path}")
-
-            # Build VNC server command
-            vncserver_path = vnc_config.get('vncserver_path', '/usr/bin/vncserver')
-            vncserver_wrapper_path = vnc_config.get('vncserver_wrapper_path')
-            vncserver_executable = vncserver_wrapper_path or vncserver_path
-            self.logger.info(f"Using VNC server executable: {vncserver_executable}")
-
-            vncserver_cmd = [
-                vncserver_executable,
-                '-geometry', resolution,
-                '-depth', str(color_depth),
-                '-localhost', 'no',
-            ]
+        except Exception as e:
+            if 'cmd_entry' in locals():
+                cmd_entry['stderr'] += f"\nException: {str(e)}"
+            else:
+                self.command_history.append({
+                    'command': 'Error preparing VNC job submission',
+                    'stdout': '',
+                    'stderr': str(e),
+                    'success': False,
+                    'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
+                })
+            raise
 
-            if display_name and display_name.strip():
-                safe_display_name = display_name.replace(' ', '_')
-                vncserver_cmd.extend(['-name', safe_display_name])
+    def _compile_vnc_submission(self, vnc_config: Dict, slurm_config: Dict, values: Dict[str, Optional[str]],
+                                authenticated: bool) -> SubmissionPlan:
+        """Build the batch script of a VNC job
 
-            vncserver_cmd.extend(['-PasswordFile', vnc_passwd_file])
-            self.logger.info(f"Using VNC password file: {vnc_passwd_file}")
+        Args:
+            vnc_config: VNC configuration
+            slurm_config: SLURM configuration
+            values: The per-launch fields (user, home, uid, name), real values or placeholders
+            authenticated: Whether the job is submitted for an authenticated user
 
-            # Get environment variables
-            window_manager = vnc_config.get('window_manager')
-            user_uid = None
-            xdg_runtime_dir = None
-            dbus_session_bus_address = None
+        Returns:
+            SubmissionPlan of the batch script (sbatch is run on the script once it is written)
+        """
+        user = values['user']
+        user_home = values['home']
+        user_uid = values['uid']
+        safe_display_name = values['name']
+        authenticated_user = user if authenticated else None
+        vnc_passwd_file = f'/home/{user}/.vnc/passwd'
+
+        job_name = 'myvnc_vncserver'
+        num_cores = int(slurm_config.get('cpus_per_task', slurm_config.get('num_cores', 2)))
+        memory_gb = int(slurm_config.get('memory_gb', 16))
+
+        resolution = vnc_config.get('resolution', '1024x768')
+        color_depth = int(vnc_config.get('color_depth', 24))
+
+        partition = slurm_config.get('partition', slurm_config.get('queue', 'interactive'))
+
+        # Build sbatch command
+        sbatch_cmd = [
+            'sbatch',
+            '--partition', partition,
+            '--cpus-per-task', str(num_cores),
+            '--mem', f'{memory_gb}G',
+            '--job-name', job_name,
+            '--ntasks', '1',
+        ]
+
+        # Add constraint for OS selection (but NOT when using a container)
+        container_path = slurm_config.get('container', '')
+        using_container = container_path and container_path.strip()
+
+        if using_container:
+            original_container_path = container_path
+            container_path = os.path.realpath(container_path)
+            if original_container_path != container_path:
+                self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
+
+        os_constraint = slurm_config.get('constraint', slurm_config.get('os_select', ''))
+
+        arch_constraint = slurm_config.get('arch_constraint', slurm_config.get('arch_select', ''))
+        constraints = []
+        if not using_container and os_constraint and os_constraint != "any":
+            constraints.append(os_constraint)
+        if arch_constraint and arch_constraint != "any":
+            constraints.append(arch_constraint)
+
+        if constraints:
+            sbatch_cmd.extend(['--constraint', '&'.join(constraints)])
+            self.logger.info(f"Adding SLURM constraints: {constraints}")
+
+        # Add time limit if specified
+        time_limit = slurm_config.get('time_limit', '')
+        if time_limit and time_limit.strip():
+            sbatch_cmd.extend(['--time', time_limit])
+
+        # Add node/host filter if specified
+        host_filter = slurm_config.get('host_filter', slurm_config.get('nodelist', ''))
+        if host_filter and host_filter.strip():
+            sbatch_cmd.extend(['--nodelist', host_filter])
+
+        # Set working directory
+        sbatch_cmd.extend(['--chdir', user_home])
+        self.logger.info(f"Setting SLURM working directory: {user_home}")
+
+        # Set output/error log paths
+        stdout_log_path = f'{user_home}/.vnc/myvnc.%j.slurm_stdout.log'
+        stderr_log_path = f'{user_home}/.vnc/myvnc.%j.slurm_stderr.log'
+        sbatch_cmd.extend(['--output', stdout_log_path])
+        sbatch_cmd.extend(['--error', stderr_log_path])
+
+        self.logger.info(f"Setting SLURM stdout log file: {stdout_log_path}")
+        self.logger.info(f"Setting SLURM stderr log file: {stderr_log_path}")
+
+        # Build VNC server command
+        vncserver_path = vnc_config.get('vncserver_path', '/usr/bin/vncserver')
+        vncserver_wrapper_path = vnc_config.get('vncserver_wrapper_path')
+        vncserver_executable = vncserver_wrapper_path or vncserver_path
+        self.logger.info(f"Using VNC server executable: {vncserver_executable}")
+
+        vncserver_cmd = [
+            vncserver_executable,
+            '-geometry', resolution,
+            '-depth', str(color_depth),
+            '-localhost', 'no',
+        ]
+
+        # Have the wrapper push the display it gets to the display collector
+        if vncserver_wrapper_path and self.display_collector:
+            vncserver_cmd[1:1] = ['--myvnc-display-spool', self.display_collector.spool_dir]
+
+        if safe_display_name:
+            vncserver_cmd.extend(['-name', safe_display_name])
+
+        vncserver_cmd.extend(['-PasswordFile', vnc_passwd_file])
+        self.logger.info(f"Using VNC password file: {vnc_passwd_file}")
+
+        # Get environment variables
+        window_manager = vnc_config.get('window_manager')
+        xdg_runtime_dir = None
+        dbus_session_bus_address = None
+
+        if user_uid:
+            xdg_runtime_dir = f"/run/user/{user_uid}"
+            dbus_session_bus_address = f"unix:path={xdg_runtime_dir}/bus"
+
+        # Add xstartup parameter if configured
+        use_custom_xstartup = vnc_config.get('use_custom_xstartup', False)
+        xstartup_path = vnc_config.get('xstartup_path', '')
+        if use_custom_xstartup and xstartup_path and xstartup_path.strip():
+            self.logger.info(f"Using custom xstartup script: {xstartup_path}")
+            vncserver_cmd.extend(['-xstartup', xstartup_path])
+
+        # Build export statements for environment variables in the batch script
+        env_exports = []
+        if window_manager and use_custom_xstartup:
+            env_exports.append(f'export WINDOW_MANAGER="{window_manager}"')
+        if xdg_runtime_dir:
+            env_exports.append(f'export XDG_RUNTIME_DIR="{xdg_runtime_dir}"')
+        if dbus_session_bus_address:
+            env_exports.append(f'export DBUS_SESSION_BUS_ADDRESS="{dbus_session_bus_address}"')
+
+        # Build the batch script
+        vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
+        display_file = f'{user_home}/.vnc/myvnc_slurm_display.$SLURM_JOB_ID'
+
+        if using_container:
+            self.logger.info(f"Wrapping vncserver command with singularity container: {container_path}")
+            container_cmd_parts = ['singularity', 'exec', '--cleanenv']
 
             if authenticated_user:
-                try:
-                    uid_result = subprocess.run(['id', '-u', authenticated_user],
-                                               check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                    user_uid = uid_result.stdout.decode('utf-8').strip()
-                    xdg_runtime_dir = f"/run/user/{user_uid}"
-                    dbus_session_bus_address = f"unix:path={xdg_runtime_dir}/bus"
-                    self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
-                except subprocess.CalledProcessError as e:
-                    self.logger.error(f"Failed to get UID for user {authenticated_user}: {e.stderr.decode('utf-8')}")
-                except Exception as e:
-                    self.logger.error(f"Error getting UID for user {authenticated_user}: {str(e)}")
-
-            # Add xstartup parameter if configured
-            use_custom_xstartup = vnc_config.get('use_custom_xstartup', False)
-            xstartup_path = vnc_config.get('xstartup_path', '')
-            if use_custom_xstartup and xstartup_path and xstartup_path.strip():
-                self.logger.info(f"Using custom xstartup script: {xstartup_path}")
-                vncserver_cmd.extend(['-xstartup', xstartup_path])
-
-            # Build export statements for environment variables in the batch script
-            env_exports = []
-            if window_manager and use_custom_xstartup:
-                env_exports.append(f'export WINDOW_MANAGER="{window_manager}"')
-            if xdg_runtime_dir:
-                env_exports.append(f'export XDG_RUNTIME_DIR="{xdg_runtime_dir}"')
-            if dbus_session_bus_address:
-                env_exports.append(f'export DBUS_SESSION_BUS_ADDRESS="{dbus_session_bus_address}"')
-
-            # Build the batch script
-            vncserver_cmd_str = ' '.join(str(arg) for arg in vncserver_cmd)
-            display_file = f'{user_home}/.vnc/myvnc_slurm_display.$SLURM_JOB_ID'
-
-            if using_container:
-                self.logger.info(f"Wrapping vncserver command with singularity container: {container_path}")
-                container_cmd_parts = ['singularity', 'exec', '--cleanenv']
-
-                if authenticated_user:
-                    container_cmd_parts.extend(['--env', f'USER={authenticated_user}'])
-
-                if use_custom_xstartup and xstartup_path:
-                    container_cmd_parts.extend(['--env', f'WINDOW_MANAGER={window_manager}'])
-                    if xdg_runtime_dir:
-                        container_cmd_parts.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
-                    if dbus_session_bus_address:
-                        container_cmd_parts.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
-
-                container_cmd_parts.extend(['--env', f'SLURM_JOB_ID=$SLURM_JOB_ID'])
-
-                # Add cgroup resource limits
-                container_cmd_parts.extend(['--cpus', str(num_cores)])
-                container_cmd_parts.extend(['--memory-reservation', f'{memory_gb}G'])
-                container_cmd_parts.extend(['--memory', f'{memory_gb + 2}G'])
-                container_cmd_parts.extend(['--memory-swap', f'{memory_gb * 2}G'])
-
-                # Get bind paths from configuration
-                bindpaths_name = slurm_config.get('bindpaths', '')
-                if bindpaths_name:
-                    bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
-                    if bindpaths:
-                        for path in bindpaths:
-                            path = path.strip()
-                            if path and os.path.exists(path):
-                                container_cmd_parts.extend(['--bind', f'{path}:{path}'])
-
-                container_cmd_parts.append(container_path)
-                inner_cmd = f'{vncserver_cmd_str} && sleep infinity'
-                container_cmd_parts.extend(['/usr/bin/bash', '-c', inner_cmd])
-                exec_command = ' '.join(shlex.quote(p) if ' ' in p else p for p in container_cmd_parts)
-                using_container_exec = True
-            else:
-                exec_command = vncserver_cmd_str
-                using_container_exec = False
+                container_cmd_parts.extend(['--env', f'USER={authenticated_user}'])
+
+            if use_custom_xstartup and xstartup_path:
+                container_cmd_parts.extend(['--env', f'WINDOW_MANAGER={window_manager}'])
+                if xdg_runtime_dir:
+                    container_cmd_parts.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
+                if dbus_session_bus_address:
+                    container_cmd_parts.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
+
+            container_cmd_parts.extend(['--env', f'SLURM_JOB_ID=$SLURM_JOB_ID'])
+
+            # Add cgroup resource limits
+            container_cmd_parts.extend(['--cpus', str(num_cores)])
+            container_cmd_parts.extend(['--memory-reservation', f'{memory_gb}G'])
+            container_cmd_parts.extend(['--memory', f'{memory_gb + 2}G'])
+            container_cmd_parts.extend(['--memory-swap', f'{memory_gb * 2}G'])
+
+            # Get bind paths from configuration
+            bindpaths_name = slurm_config.get('bindpaths', '')
+            if bindpaths_name:
+                bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
+                if bindpaths:
+                    for path in bindpaths:
+                        path = path.strip()
+                        if path and os.path.exists(path):
+                            container_cmd_parts.extend(['--bind', f'{path}:{path}'])
+
+            container_cmd_parts.append(container_path)
+            inner_cmd = f'{vncserver_cmd_str} && sleep infinity'
+            container_cmd_parts.extend(['/usr/bin/bash', '-c', inner_cmd])
+            exec_command = ' '.join(shlex.quote(p) if ' ' in p else p for p in container_cmd_parts)
+            using_container_exec = True
+        else:
+            exec_command = vncserver_cmd_str
+            using_container_exec = False
 
-            display_file_path = f'{user_home}/.vnc/myvnc_slurm_display.$SLURM_JOB_ID'
-            env_exports_str = '\n'.join(env_exports)
+        display_file_path = f'{user_home}/.vnc/myvnc_slurm_display.$SLURM_JOB_ID'
+        env_exports_str = '\n'.join(env_exports)
 
-            if using_container_exec:
-                # Container case: vncserver runs inside singularity, so we cannot easily
-                # capture its stdout. Instead, use a background loop that watches for
-                # the VNC log file to appear and extracts the display from it.
-                script_content = f"""#!/bin/bash
+        if using_container_exec:
+            # Container case: vncserver runs inside singularity, so we cannot easily
+            # capture its stdout. Instead, use a background loop that watches for
+            # the VNC log file to appear and extracts the display from it.
+            script_content = f"""#!/bin/bash
 #SBATCH --partition={partition}
 #SBATCH --cpus-per-task={num_cores}
 #SBATCH --mem={memory_gb}G
@@ -601,9 +1046,9 @@ echo "$SLURM_JOB_ID" > {user_home}/.vnc/myvnc_slurm_jobid.$$
 # Execute the containerized VNC server (includes sleep infinity inside)
 {exec_command}
 """
-            else:
-                # Non-container case: capture vncserver output directly
-                script_content = f"""#!/bin/bash
+        else:
+            # Non-container case: capture vncserver output directly
+            script_content = f"""#!/bin/bash
 #SBATCH --partition={partition}
 #SBATCH --cpus-per-task={num_cores}
 #SBATCH --mem={memory_gb}G
@@ -689,12 +1134,48 @@ fi
 # Keep the job alive (vncserver daemonizes immediately)
 sleep infinity
 """
-            # Write batch script to user's .vnc directory
-            script_path = os.path.join(vnc_log_dir, f'myvnc_vnc_submit.sh')
+
+        return SubmissionPlan([], script_content)
+
+    def submit_tmux_job(self, session_config: Dict, slurm_config: Dict, authenticated_user: str = None, server_hostname: str = None) -> str:
+        """Submit a tmux job using sbatch
+
+        Args:
+            session_config: Session configuration (name, site, etc.)
+            slurm_config: SLURM configuration (partition, cpus, memory, etc.)
+            authenticated_user: Optional authenticated username to run command as
+            server_hostname: Server hostname for error messages
+
+        Returns:
+            Job ID if successful
+
+        Raises:
+            SLURMError if submission fails
+        """
+        try:
+            user = authenticated_user if authenticated_user else os.environ.get('USER', '')
+            user_home = user_credentials(user).home
+
+            # Ensure the .tmux directory exists for the batch script and log files
+            tmux_log_dir = os.path.join(user_home, '.tmux')
+            try:
+                os.makedirs(tmux_log_dir, mode=0o755, exist_ok=True)
+                self.logger.info(f"Ensured .tmux directory exists: {tmux_log_dir}")
+            except Exception as e:
+                self.logger.warning(f"Could not create .tmux directory {tmux_log_dir}: {e}")
+
+            # Only the user and the session name differ between launches of the same configuration
+            values = self._submission_values(user, user_home, authenticated_user,
+                                             session_config.get('name', 'myvnc_tmux_session'))
+            plan = self._submission_plan('tmux', self._compile_tmux_submission, session_config, slurm_config, values,
+                                         bool(authenticated_user))
+            _, script_content = plan.render(values)
+
+
+            script_path = os.path.join(tmux_log_dir, f'myvnc_tmux_submit.sh')
             self._write_batch_script(script_content, script_path)
 
-            # Use sbatch with --parsable to get just the job ID
-            sbatch_cmd = ['sbatch', '--parsable', script_path]
+            sbatch_cmd = ['sbatch', '--parsable'] + self._placement_hint(slurm_config) + [script_path]
 
             cmd_str = ' '.join(str(arg) for arg in sbatch_cmd)
             cmd_entry = {
@@ -707,7 +1188,7 @@ sleep infinity
             self.command_history.append(cmd_entry)
 
             try:
-                self.logger.info(f"Submitting VNC job with sbatch")
+                self.logger.info(f"Submitting tmux job with sbatch")
                 stdout = self._run_command(sbatch_cmd, authenticated_user)
 
                 job_id = stdout.strip().split(';')[0].strip()
@@ -715,15 +1196,16 @@ sleep infinity
                     job_id_match = re.search(r'(\d+)', stdout)
                     job_id = job_id_match.group(1) if job_id_match else 'unknown'
 
-                self.logger.info(f"Job submitted successfully, ID: {job_id}")
+                self.logger.info(f"tmux job submitted successfully, ID: {job_id}")
+                self._record_submit(job_id, user, 'tmux', session_config, slurm_config)
                 return job_id
 
             except SLURMError as e:
-                self.logger.error(f"Job submission failed: {str(e)}")
+                self.logger.error(f"tmux job submission failed: {str(e)}")
                 cmd_entry['stderr'] += f"\nException: {str(e)}"
                 raise e
             except Exception as e:
-                error_msg = f"Job submission error: {str(e)}"
+                error_msg = f"tmux job submission error: {str(e)}"
                 self.logger.error(error_msg)
                 cmd_entry['stderr'] += f"\nException: {str(e)}"
                 raise Exception(error_msg)
@@ -733,7 +1215,7 @@ sleep infinity
                 cmd_entry['stderr'] += f"\nException: {str(e)}"
             else:
                 self.command_history.append({
-                    'command': 'Error preparing VNC job submission',
+                    'command': 'Error preparing tmux job submission',
                     'stdout': '',
                     'stderr': str(e),
                     'success': False,
@@ -741,118 +1223,98 @@ sleep infinity
                 })
             raise
 
-    def submit_tmux_job(self, session_config: Dict, slurm_config: Dict, authenticated_user: str = None, server_hostname: str = None) -> str:
-        """Submit a tmux job using sbatch
+    def _compile_tmux_submission(self, session_config: Dict, slurm_config: Dict, values: Dict[str, Optional[str]],
+                                 authenticated: bool) -> SubmissionPlan:
+        """Build the batch script of a tmux job
 
         Args:
             session_config: Session configuration (name, site, etc.)
             slurm_config: SLURM configuration (partition, cpus, memory, etc.)
-            authenticated_user: Optional authenticated username to run command as
-            server_hostname: Server hostname for error messages
+            values: The per-launch fields (user, home, uid, name), real values or placeholders
+            authenticated: Whether the job is submitted for an authenticated user
 
         Returns:
-            Job ID if successful
-
-        Raises:
-            SLURMError if submission fails
+            SubmissionPlan of the batch script (sbatch is run on the script once it is written)
         """
-        try:
-            user = authenticated_user if authenticated_user else os.environ.get('USER', '')
-            user_home = os.path.expanduser(f'~{user}')
+        user = values['user']
+        user_home = values['home']
+        user_uid = values['uid']
+        safe_session_name = values['name'] or ''
+        authenticated_user = user if authenticated else None
 
-            job_name = 'myvnc_tmux'
-            num_cores = int(slurm_config.get('cpus_per_task', slurm_config.get('num_cores', 2)))
-            memory_gb = int(slurm_config.get('memory_gb', 16))
+        job_name = 'myvnc_tmux'
+        num_cores = int(slurm_config.get('cpus_per_task', slurm_config.get('num_cores', 2)))
+        memory_gb = int(slurm_config.get('memory_gb', 16))
 
-            session_name = session_config.get('name', 'myvnc_tmux_session')
-            safe_session_name = session_name.replace(' ', '_')
+        partition = slurm_config.get('partition', slurm_config.get('queue', 'interactive'))
 
-            partition = slurm_config.get('partition', slurm_config.get('queue', 'interactive'))
+        container_path = slurm_config.get('container', '')
+        using_container = container_path and container_path.strip()
 
-            container_path = slurm_config.get('container', '')
-            using_container = container_path and container_path.strip()
+        if using_container:
+            original_container_path = container_path
+            container_path = os.path.realpath(container_path)
+            if original_container_path != container_path:
+                self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
 
-            if using_container:
-                original_container_path = container_path
-                container_path = os.path.realpath(container_path)
-                if original_container_path != container_path:
-                    self.logger.info(f"Resolved container path from '{original_container_path}' to '{container_path}'")
+        os_constraint = slurm_config.get('constraint', slurm_config.get('os_select', ''))
+        arch_constraint = slurm_config.get('arch_constraint', slurm_config.get('arch_select', ''))
+        constraints = []
+        if not using_container and os_constraint and os_constraint != "any":
+            constraints.append(os_constraint)
+        if arch_constraint and arch_constraint != "any":
+            constraints.append(arch_constraint)
 
-            os_constraint = slurm_config.get('constraint', slurm_config.get('os_select', ''))
-            arch_constraint = slurm_config.get('arch_constraint', slurm_config.get('arch_select', ''))
-            constraints = []
-            if not using_container and os_constraint and os_constraint != "any":
-                constraints.append(os_constraint)
-            if arch_constraint and arch_constraint != "any":
-                constraints.append(arch_constraint)
+        time_limit = slurm_config.get('time_limit', '')
+        host_filter = slurm_config.get('host_filter', slurm_config.get('nodelist', ''))
 
-            time_limit = slurm_config.get('time_limit', '')
-            host_filter = slurm_config.get('host_filter', slurm_config.get('nodelist', ''))
+        # Set output/error log paths
+        stdout_log_path = f'{user_home}/.tmux/myvnc.%j.slurm_stdout.log'
+        stderr_log_path = f'{user_home}/.tmux/myvnc.%j.slurm_stderr.log'
 
-            # Set output/error log paths
-            tmux_log_dir = os.path.join(user_home, '.tmux')
-            try:
-                os.makedirs(tmux_log_dir, mode=0o755, exist_ok=True)
-                self.logger.info(f"Ensured .tmux directory exists: {tmux_log_dir}")
-            except Exception as e:
-                self.logger.warning(f"Could not create .tmux directory {tmux_log_dir}: {e}")
+        # Get environment variables for container
+        xdg_runtime_dir = None
+        dbus_session_bus_address = None
 
-            stdout_log_path = f'{user_home}/.tmux/myvnc.%j.slurm_stdout.log'
-            stderr_log_path = f'{user_home}/.tmux/myvnc.%j.slurm_stderr.log'
+        if using_container and user_uid:
+            xdg_runtime_dir = f'/run/user/{user_uid}'
+            dbus_session_bus_address = f'unix:path=/run/user/{user_uid}/bus'
 
-            # Get environment variables for container
-            user_uid = None
-            xdg_runtime_dir = None
-            dbus_session_bus_address = None
+        # Build tmux command
+        tmux_cmd = f'/usr/bin/tmux new-session -d -s {safe_session_name} && while /usr/bin/tmux has-session -t {safe_session_name} 2>/dev/null; do sleep 5; done'
 
-            if using_container and authenticated_user:
-                try:
-                    uid_result = subprocess.run(['id', '-u', authenticated_user],
-                                               check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-                    user_uid = uid_result.stdout.decode('utf-8').strip()
-                    xdg_runtime_dir = f'/run/user/{user_uid}'
-                    dbus_session_bus_address = f'unix:path=/run/user/{user_uid}/bus'
-                    self.logger.info(f"Calculated environment for user {authenticated_user} (UID={user_uid})")
-                except subprocess.CalledProcessError as e:
-                    self.logger.error(f"Failed to get UID for user {authenticated_user}: {e.stderr.decode('utf-8')}")
-                except Exception as e:
-                    self.logger.error(f"Error getting UID for user {authenticated_user}: {str(e)}")
+        if using_container:
+            self.logger.info(f"Wrapping tmux command with singularity container: {container_path}")
+            container_cmd_parts = ['singularity', 'exec', '--cleanenv']
 
-            # Build tmux command
-            tmux_cmd = f'/usr/bin/tmux new-session -d -s {safe_session_name} && while /usr/bin/tmux has-session -t {safe_session_name} 2>/dev/null; do sleep 5; done'
-
-            if using_container:
-                self.logger.info(f"Wrapping tmux command with singularity container: {container_path}")
-                container_cmd_parts = ['singularity', 'exec', '--cleanenv']
-
-                if authenticated_user:
-                    container_cmd_parts.extend(['--env', f'USER={authenticated_user}'])
-                if xdg_runtime_dir:
-                    container_cmd_parts.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
-                if dbus_session_bus_address:
-                    container_cmd_parts.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
-
-                container_cmd_parts.extend(['--cpus', str(num_cores)])
-                container_cmd_parts.extend(['--memory-reservation', f'{memory_gb}G'])
-                container_cmd_parts.extend(['--memory', f'{memory_gb + 2}G'])
-                container_cmd_parts.extend(['--memory-swap', f'{memory_gb * 2}G'])
-
-                bindpaths_name = slurm_config.get('bindpaths', '')
-                if bindpaths_name:
-                    bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
-                    if bindpaths:
-                        for path in bindpaths:
-                            path = path.strip()
-                            if path and os.path.exists(path):
-                                container_cmd_parts.extend(['--bind', f'{path}:{path}'])
-
-                container_cmd_parts.append(container_path)
-                container_cmd_parts.extend(['/usr/bin/bash', '-c', tmux_cmd])
-                exec_command = ' '.join(shlex.quote(p) if ' ' in p else p for p in container_cmd_parts)
-            else:
-                exec_command = tmux_cmd
+            if authenticated_user:
+                container_cmd_parts.extend(['--env', f'USER={authenticated_user}'])
+            if xdg_runtime_dir:
+                container_cmd_parts.extend(['--env', f'XDG_RUNTIME_DIR={xdg_runtime_dir}'])
+            if dbus_session_bus_address:
+                container_cmd_parts.extend(['--env', f'DBUS_SESSION_BUS_ADDRESS={dbus_session_bus_address}'])
+
+            container_cmd_parts.extend(['--cpus', str(num_cores)])
+            container_cmd_parts.extend(['--memory-reservation', f'{memory_gb}G'])
+            container_cmd_parts.extend(['--memory', f'{memory_gb + 2}G'])
+            container_cmd_parts.extend(['--memory-swap', f'{memory_gb * 2}G'])
+
+            bindpaths_name = slurm_config.get('bindpaths', '')
+            if bindpaths_name:
+                bindpaths = self.config_manager.get_bindpaths_by_name(bindpaths_name)
+                if bindpaths:
+                    for path in bindpaths:
+                        path = path.strip()
+                        if path and os.path.exists(path):
+                            container_cmd_parts.extend(['--bind', f'{path}:{path}'])
+
+            container_cmd_parts.append(container_path)
+            container_cmd_parts.extend(['/usr/bin/bash', '-c', tmux_cmd])
+            exec_command = ' '.join(shlex.quote(p) if ' ' in p else p for p in container_cmd_parts)
+        else:
+            exec_command = tmux_cmd
 
-            script_content = f"""#!/bin/bash
+        script_content = f"""#!/bin/bash
 #SBATCH --partition={partition}
 #SBATCH --cpus-per-task={num_cores}
 #SBATCH --mem={memory_gb}G
@@ -871,55 +1333,43 @@ sleep infinity
 # Execute tmux session
 {exec_command}
 """
-            script_path = os.path.join(tmux_log_dir, f'myvnc_tmux_submit.sh')
-            self._write_batch_script(script_content, script_path)
 
-            sbatch_cmd = ['sbatch', '--parsable', script_path]
+        return SubmissionPlan([], script_content)
 
-            cmd_str = ' '.join(str(arg) for arg in sbatch_cmd)
-            cmd_entry = {
-                'command': cmd_str,
-                'stdout': '',
-                'stderr': '',
-                'success': False,
-                'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
-            }
-            self.command_history.append(cmd_entry)
+    def submit_jobs(self, session_type: str, session_config: Dict, slurm_config: Dict, users: List[str],
+                    server_hostname: str = None) -> Dict[str, Dict]:
+        """Submit the same VNC or tmux session for several users, e.g. a manager launching a team's sessions
 
-            try:
-                self.logger.info(f"Submitting tmux job with sbatch")
-                stdout = self._run_command(sbatch_cmd, authenticated_user)
+        The submissions share one compiled plan and run BATCH_SUBMIT_PARALLEL
+        at a time.
 
-                job_id = stdout.strip().split(';')[0].strip()
-                if not job_id.isdigit():
-                    job_id_match = re.search(r'(\d+)', stdout)
-                    job_id = job_id_match.group(1) if job_id_match else 'unknown'
-
-                self.logger.info(f"tmux job submitted successfully, ID: {job_id}")
-                return job_id
+        Args:
+            session_type: 'vnc' or 'tmux'
+            session_config: Session configuration, as for submit_vnc_job / submit_tmux_job
+            slurm_config: SLURM configuration
+            users: Users to submit a session for (duplicates are submitted once)
+            server_hostname: Server hostname for error messages
 
-            except SLURMError as e:
-                self.logger.error(f"tmux job submission failed: {str(e)}")
-                cmd_entry['stderr'] += f"\nException: {str(e)}"
-                raise e
-            except Exception as e:
-                error_msg = f"tmux job submission error: {str(e)}"
-                self.logger.error(error_msg)
-                cmd_entry['stderr'] += f"\nException: {str(e)}"
-                raise Exception(error_msg)
+        Returns:
+            Dict mapping each user to {'job_id': ...} or {'error': ...}
+        """
+        submit = self.submit_tmux_job if session_type == 'tmux' else self.submit_vnc_job
+        users = list(dict.fromkeys(users))
+        results = {}
+        for start in range(0, len(users), BATCH_SUBMIT_PARALLEL):
+            futures = {user: self.call_async(submit, session_config, slurm_config, user, server_hostname=server_hostname)
+                       for user in users[start:start + BATCH_SUBMIT_PARALLEL]}
+            for user, future in futures.items():
+                try:
+                    results[user] = {'job_id': future.result()}
+                except Exception as e:
+                    self.logger.error(f"Batch {session_type} submission for {user} failed: {str(e)}")
+                    results[user] = {'error': str(e)}
+        return results
 
-        except Exception as e:
-            if 'cmd_entry' in locals():
-                cmd_entry['stderr'] += f"\nException: {str(e)}"
-            else:
-                self.command_history.append({
-                    'command': 'Error preparing tmux job submission',
-                    'stdout': '',
-                    'stderr': str(e),
-                    'success': False,
-                    'timestamp': datetime.now().strftime("%Y-%m-%d %H:%M:%S")
-                })
-            raise
+    def _slurm_token(self, user: Optional[str], lifespan: int) -> str:
+        """A JWT for slurmrestd from 'scontrol token', run as user (None for the server account)"""
+        return self._run_command(['scontrol', 'token', f'lifespan={lifespan}'], user, record_output=False)
 
     def get_job_owner(self, job_id: str, authenticated_user: str = None) -> Optional[str]:
         """
@@ -933,8 +1383,12 @@ sleep infinity
             Username of the job owner, or None if not found
         """
         try:
-            cmd = ['squeue', '--job', job_id, '--noheader', '--format', '%u']
-            output = self._run_command(cmd, authenticated_user)
+            output = self._rest_job_rows('%u', [job_id], authenticated_user)
+            if output is not None:
+                output = output[0]
+            else:
+                cmd = ['squeue', '--job', job_id, '--noheader', '--format', '%u']
+                output = self._run_command(cmd, authenticated_user)
 
             if output and output.strip():
                 job_owner = output.strip()
@@ -981,9 +1435,186 @@ sleep infinity
         """
         Get active VNC/tmux jobs for the current user with job name matching myvnc_*
 
+        With 'job_snapshot' enabled the jobs come from the shared snapshot
+        instead of an squeue run per call.
+
+        Args:
+            authenticated_user: Optional authenticated username to run command as
+            all_users: Whether to include jobs from all users
+
+        Returns:
+            List of jobs as dictionaries
+        """
+        if not self.job_snapshot:
+            return self._list_active_vnc_jobs(authenticated_user, all_users=all_users)
+
+        try:
+            if all_users:
+                return self.job_snapshot.view()
+            jobs = self.job_snapshot.view(authenticated_user if authenticated_user else os.environ.get('USER', ''))
+            # The snapshot lists all users, so displays are looked up per view
+            self._fill_vnc_displays(jobs, authenticated_user)
+            self._observe_listing(jobs)
+            return jobs
+        except Exception as e:
+            self.logger.error(f"Error retrieving SLURM jobs: {str(e)}")
+            return []
+
+    def _placement_hint(self, slurm_config: Dict, slot: Optional[PoolSlot] = None) -> List[str]:
+        """
+        --nodelist for the node of a claimed warm pool slot, or else --exclude
+        for the partition's overloaded nodes, unless the configuration picks nodes
+        """
+        if slot is not None:
+            hint = ['--nodelist', slot.host]
+        elif not self.host_load or (slurm_config.get('host_filter', slurm_config.get('nodelist', '')) or '').strip():
+            return []
+        else:
+            hint = self.host_load.slurm_hint(slurm_config.get('partition', slurm_config.get('queue', 'interactive')))
+        if hint:
+            self.logger.info(f"Placement hint: {' '.join(hint)}")
+        return hint
+
+    def _record_submit(self, job_id: str, user: str, session_type: str, session_config: Dict, slurm_config: Dict,
+                       slot: Optional[PoolSlot] = None):
+        """Start a submitted session's timeline"""
+        if self.session_timeline:
+            self.session_timeline.record(job_id, 'submit', user=user, queue=slurm_config.get('partition', slurm_config.get('queue', 'interactive')),
+                                         site=session_config.get('site'),
+                                         desktop=session_config.get('window_manager') if session_type == 'vnc' else 'tmux',
+                                         session_type=session_type, pooled=slot is not None)
+
+    def _observe_listing(self, jobs: List[Dict]):
+        """Hand a job listing to the warm pool and session timeline, which time session starts from it"""
+        if self.warm_pool:
+            self.warm_pool.observe(jobs)
+            if self._pool_pins:
+                self._release_pool_pins(jobs)
+        if self.session_timeline:
+            self.session_timeline.observe(jobs, self.display_collector)
+
+    def _release_pool_pins(self, jobs: List[Dict]):
+        """
+        Clear the --nodelist of sessions placed on a warm pool node that are
+        still pending pool_pin_seconds after submission, e.g. because another
+        job took the freed slot, so they can start anywhere in the partition
+        """
+        now = time.monotonic()
+        due = []
+        listed = {str(job.get('job_id')): job for job in jobs}
+        with self._pool_pins_lock:
+            for job_id, (pinned_at, user) in list(self._pool_pins.items()):
+                job = listed.get(job_id)
+                if now - pinned_at > POOL_PIN_TTL or (job is not None and job.get('status') != 'PEND'):
+                    del self._pool_pins[job_id]
+                elif job is not None and now - pinned_at >= self.pool_pin_seconds:
+                    del self._pool_pins[job_id]
+                    due.append((job_id, user))
+        for job_id, user in due:
+            try:
+                self._run_command(['scontrol', 'update', f'JobId={job_id}', 'ReqNodeList='], user)
+                self.logger.info(f"Job {job_id} still pending on its warm pool node; lifted its --nodelist")
+            except Exception as e:
+                self.logger.warning(f"Could not lift the --nodelist of job {job_id}: {e}")
+
+    def _claim_pool_slot(self, vnc_config: Dict, slurm_config: Dict) -> Optional[PoolSlot]:
+        """A running warm pool holder for the request, unless the configuration picks nodes"""
+        if not self.warm_pool or (slurm_config.get('host_filter', slurm_config.get('nodelist', '')) or '').strip():
+            return None
+        return self.warm_pool.claim(vnc_config, slurm_config)
+
+    def _list_pool_holders(self) -> List[PoolSlot]:
+        """The warm pool account's holder jobs"""
+        pool_user = self.warm_pool_user or os.environ.get('USER', '')
+        with deadline_scope(None):
+            output = self._run_command(['squeue', '-h', '-u', pool_user, '-o', '%i|%T|%N|%j'], self.warm_pool_user)
+        holders = []
+        for line in output.splitlines():
+            parts = line.strip().split('|')
+            if len(parts) < 4 or not parts[3].startswith(HOLDER_PREFIX):
+                continue
+            status = {'RUNNING': 'RUN', 'PENDING': 'PEND'}.get(parts[1], parts[1])
+            holders.append(PoolSlot(parts[0], parts[3], status, parts[2] if parts[2] not in ('', '(null)') else None))
+        return holders
+
+    def _submit_pool_holder(self, name: str, profile: Dict, seconds: int):
+        """Submit a warm pool holder with the profile's partition, cpus, memory and constraint"""
+        cmd = ['sbatch', '--parsable',
+               '--partition', profile.get('partition', profile.get('queue', 'interactive')),
+               '--cpus-per-task', str(int(profile.get('cpus_per_task', profile.get('num_cores', 2)))),
+               '--mem', f"{int(profile.get('memory_gb', 16))}G",
+               '--job-name', name, '--output', '/dev/null', '--error', '/dev/null']
+        if profile.get('constraint'):
+            cmd.extend(['--constraint', profile['constraint']])
+        cmd.extend(['--wrap', f'sleep {seconds}'])
+        with deadline_scope(None):
+            self._run_command(cmd, self.warm_pool_user)
+
+    def _release_pool_holder(self, slot: PoolSlot):
+        with deadline_scope(None):
+            self._run_command(['scancel', slot.job_id], self.warm_pool_user)
+
+    def _fetch_host_load(self) -> List[HostLoad]:
+        """CPU load and free memory of every node from sinfo, one row per node and partition"""
+        with deadline_scope(None):
+            output = self._run_command(['sinfo', '-N', '-h', '-o', '%N|%P|%T|%O|%c|%e|%m'])
+        nodes = {}
+        for line in output.splitlines():
+            parts = line.strip().split('|')
+            if len(parts) < 7:
+                continue
+            # A flag after the state (not responding, powered down, maintenance...) makes the node unavailable
+            name, partition, state = parts[0], parts[1].rstrip('*'), parts[2].lower()
+            groups = nodes[name].groups if name in nodes else frozenset()
+            try:
+                cpu = float(parts[3]) / max(1, int(parts[4]))
+            except ValueError:
+                cpu = None
+            try:
+                mem_used = max(0.0, 1.0 - float(parts[5]) / float(parts[6]))
+            except (ValueError, ZeroDivisionError):
+                mem_used = None
+            nodes[name] = HostLoad(name, state in ('idle', 'mixed', 'allocated', 'completing'), cpu, mem_used,
+                                   groups | {partition})
+        return list(nodes.values())
+
+    def _fetch_host_sessions(self) -> List[Dict]:
+        """All users' sessions, from the snapshot when there is one"""
+        if self.job_snapshot:
+            return self.job_snapshot.view()
+        return self._fetch_job_snapshot()
+
+    def _fetch_job_snapshot(self) -> List[Dict]:
+        """List all users' jobs for the shared snapshot, raising if squeue fails"""
+        # Shared by every waiting request, so the deadline of the one that
+        # happened to start the refresh does not apply
+        with deadline_scope(None):
+            return self._list_active_vnc_jobs(self.job_snapshot_user, all_users=True, raise_errors=True)
+
+    def _fill_vnc_displays(self, jobs: List[Dict], authenticated_user: str = None):
+        """Set display and port of the running VNC jobs, looked up for all jobs at once"""
+        display_lookups = [(job['job_id'], job['user'])
+                           for job in jobs if job.get('session_type') == "VNC" and job.get('status') == "RUN"]
+        if not display_lookups:
+            return
+
+        displays = self._get_displays_from_files(display_lookups, authenticated_user)
+        for job in jobs:
+            display_str = displays.get(job['job_id'])
+            if display_str:
+                job['display'] = int(display_str)
+                job['port'] = job['display']
+
+    def _list_active_vnc_jobs(self, authenticated_user: str = None, all_users: bool = False,
+                              raise_errors: bool = False) -> List[Dict]:
+        """
+        Run squeue and parse the active VNC/tmux jobs
+
         Args:
             authenticated_user: Optional authenticated username to run command as
             all_users: Whether to include jobs from all users
+            raise_errors: Raise instead of returning an empty list when squeue
+                fails for a reason other than there being no jobs
 
         Returns:
             List of jobs as dictionaries
@@ -996,13 +1627,13 @@ sleep infinity
             else:
                 user = authenticated_user if authenticated_user else os.environ.get('USER', '')
 
-            # squeue format: JobID, State, User, Partition, NodeList, TimeUsed, NumCPUs, MinMemory, Name, Command
-            format_str = '%i|%t|%u|%P|%N|%M|%C|%m|%j|%o'
+            # squeue format: JobID, State, User, Partition, NodeList, TimeUsed, NumCPUs, MinMemory, StartTime, Name, Command
+            format_str = '%i|%t|%u|%P|%N|%M|%C|%m|%S|%j|%o'
             cmd = [
                 'squeue',
                 '--noheader',
                 '--format', format_str,
-                '--name', 'myvnc_vncserver,myvnc_tmux',
+                '--name', ','.join(VNC_JOB_NAMES),
             ]
 
             if user:
@@ -1018,28 +1649,30 @@ sleep infinity
             }
             self.command_history.append(cmd_entry)
 
-            try:
-                output_str = self._run_command(cmd, authenticated_user)
-                cmd_entry['stdout'] = output_str
-                cmd_entry['success'] = True
-            except SLURMError as e:
-                error_str = str(e)
-                cmd_entry['stderr'] = error_str
-                # No jobs is not a real error
-                if 'No jobs' in error_str or 'slurm_load_jobs' in error_str:
-                    return []
-                self.logger.error(f"Error executing squeue: {error_str}")
-                return []
+            # Per-job details are only logged for the listings tracing samples
+            log_row = self.logger.info if tracer.verbose(f"{cmd[0]} rows") else (lambda message: None)
 
-            output_lines = output_str.strip().split('\n')
-            for line in output_lines:
+            # slurmrestd answers with the same columns, already split
+            rows = None
+            if self.slurm_rest:
                 try:
-                    if not line.strip():
-                        continue
-
-                    parts = line.split('|')
-                    if len(parts) < 9:
-                        self.logger.warning(f"Incomplete squeue output line: {line}")
+                    rows = [(len(parts), parts) for parts in self.slurm_rest.squeue_rows(
+                        format_str, names=VNC_JOB_NAMES, users=[user] if user else None,
+                        as_user=authenticated_user, timeout=remaining_time(self.command_timeout)).values()]
+                    cmd_entry['command'] = f"slurmrestd jobs (for {base_cmd})"
+                except SlurmRestError as e:
+                    self.logger.warning(f"slurmrestd listing failed, running squeue: {e}")
+
+            # Otherwise parse the output as squeue produces it; an squeue
+            # failure is raised from the loop once its exit status arrives.
+            # job_table skips empty lines and splits each row into the 11
+            # format columns
+            if rows is None:
+                rows = job_table.iter_rows(self._stream_command(cmd, authenticated_user, raw=True), '|', 11)
+            for num_parts, parts in rows:
+                try:
+                    if num_parts < 10:
+                        self.logger.warning(f"Incomplete squeue output line: {'|'.join(parts[:num_parts])}")
                         continue
 
                     job_id = parts[0].strip()
@@ -1050,8 +1683,9 @@ sleep infinity
                     time_used = parts[5].strip()
                     num_cpus = parts[6].strip()
                     min_memory = parts[7].strip()
-                    job_name = parts[8].strip()
-                    command = parts[9].strip() if len(parts) > 9 else ""
+                    start_field = parts[8].strip()
+                    job_name = parts[9].strip()
+                    command = parts[10].strip()
 
                     # Map SLURM state codes to display states
                     state_map = {
@@ -1070,7 +1704,7 @@ sleep infinity
                     }
                     status = state_map.get(state_code, state_code)
 
-                    self.logger.info(f"Job {job_id}: state={state_code}({status}), user={job_user}, node={nodelist}")
+                    log_row(f"Job {job_id}: state={state_code}({status}), user={job_user}, node={nodelist}")
 
                     # Parse time_used (format: D-HH:MM:SS or HH:MM:SS or MM:SS)
                     run_time_seconds = 0
@@ -1103,6 +1737,15 @@ sleep infinity
                     except Exception:
                         runtime_display = time_used
 
+                    # %S is the actual start once the job runs (the expected
+                    # start, or N/A, while it pends), as local time
+                    start_time = None
+                    if status != 'PEND':
+                        try:
+                            start_time = time.mktime(time.strptime(start_field, '%Y-%m-%dT%H:%M:%S'))
+                        except (ValueError, OverflowError):
+                            start_time = None
+
                     # Parse resources
                     num_cores_val = None
                     memory_gb_val = None
@@ -1193,16 +1836,6 @@ sleep infinity
                         host = None
                         exec_host = None
 
-                    # Get VNC display for running VNC jobs
-                    display = None
-                    port = None
-                    if session_type == "VNC" and status == "RUN" and user:
-                        user_home_for_display = os.path.expanduser(f'~{job_user}')
-                        display_str = self._get_display_from_file(job_id, user_home_for_display, authenticated_user)
-                        if display_str:
-                            display = int(display_str)
-                            port = display
-
                     job = {
                         'job_id': job_id,
                         'name': display_name,
@@ -1215,6 +1848,7 @@ sleep infinity
                         'runtime': runtime_display,
                         'runtime_display': runtime_display,
                         'run_time_seconds': run_time_seconds,
+                        'start_time': start_time,
                         'resource_req': f'cpus={num_cpus} mem={min_memory}',
                         'os': os_name,
                         'session_type': session_type,
@@ -1232,18 +1866,31 @@ sleep infinity
                         job['mem_gb'] = memory_gb_val
                         job['memory_gb'] = memory_gb_val
 
-                    if display is not None:
-                        job['display'] = display
-                    if port is not None:
-                        job['port'] = port
-
                     jobs.append(job)
 
                 except Exception as e:
                     self.logger.error(f"Error processing SLURM job: {str(e)}")
+            cmd_entry['success'] = True
+
+            # VNC display for running VNC jobs is looked up for all jobs at once
+            if user:
+                self._fill_vnc_displays(jobs, authenticated_user)
+        except SLURMError as e:
+            error_str = str(e)
+            cmd_entry['stderr'] = error_str
+            # No jobs is not a real error
+            if 'No jobs' in error_str or 'slurm_load_jobs' in error_str:
+                return []
+            self.logger.error(f"Error executing squeue: {error_str}")
+            if raise_errors:
+                raise
+            return []
         except Exception as e:
             self.logger.error(f"Error retrieving SLURM jobs: {str(e)}")
+            if raise_errors:
+                raise
 
+        self._observe_listing(jobs)
         return jobs
 
     def get_vnc_connection_details(self, job_id: str, authenticated_user: str = None) -> Optional[Dict]:
@@ -1257,14 +1904,86 @@ sleep infinity
         Returns:
             Dictionary with connection details or None if not found
         """
-        try:
-            self.logger.info(f"Getting connection details for SLURM job {job_id}")
+        self.logger.info(f"Getting connection details for SLURM job {job_id}")
+        output = self._rest_job_rows(CONNECTION_DETAILS_FORMAT, [job_id], authenticated_user)
+        if output is not None:
+            output = output[0]
+        else:
+            try:
+                output = self._run_command(self._connection_details_cmd(job_id), authenticated_user)
+            except Exception as e:
+                self.logger.error(f"Failed to get VNC connection details: {str(e)}")
+                return None
 
-            format_str = '%t|%u|%N|%j|%o'
-            cmd = ['squeue', '--job', job_id, '--noheader', '--format', format_str]
+        details = self._parse_connection_details(job_id, output)
+        if details and details.get('display_home'):
+            self._add_display_details([details], authenticated_user)
+        if details:
+            details.pop('display_home', None)
+        return details
 
-            output = self._run_command(cmd, authenticated_user)
+    def get_vnc_connection_details_many(self, job_ids: List[str], authenticated_user: str = None) -> Dict[str, Optional[Dict]]:
+        """
+        Get connection details for several VNC jobs with one setuid_runner batch
+        for the squeue lookups and one for any display files
 
+        Args:
+            job_ids: Job IDs to look up
+            authenticated_user: Optional authenticated username to run commands as
+
+        Returns:
+            Dictionary mapping each job ID to its connection details, or None if not found
+        """
+        self.logger.info(f"Getting connection details for {len(job_ids)} SLURM jobs")
+        outputs = self._rest_job_rows(CONNECTION_DETAILS_FORMAT, job_ids, authenticated_user)
+        if outputs is None:
+            outputs = self._run_commands([self._connection_details_cmd(job_id) for job_id in job_ids], authenticated_user)
+        details = {job_id: self._parse_connection_details(job_id, output) if output is not None else None
+                   for job_id, output in zip(job_ids, outputs)}
+        needs_display = [d for d in details.values() if d and d.get('display_home')]
+        if needs_display:
+            self._add_display_details(needs_display, authenticated_user)
+        for d in details.values():
+            if d:
+                d.pop('display_home', None)
+        return details
+
+    def _connection_details_cmd(self, job_id: str) -> List[str]:
+        """squeue query used for a job's connection details"""
+        return ['squeue', '--job', job_id, '--noheader', '--format', CONNECTION_DETAILS_FORMAT]
+
+    def _rest_job_rows(self, format_str: str, job_ids: List[str],
+                       authenticated_user: str = None) -> Optional[List[Optional[str]]]:
+        """
+        What 'squeue --job <id> --noheader --format format_str' prints for each
+        job, from one slurmrestd query (None for jobs slurmctld does not know),
+        or None when slurmrestd is not configured or failed and squeue has to
+        be run
+        """
+        if not self.slurm_rest:
+            return None
+        try:
+            rows = self.slurm_rest.squeue_rows(format_str, job_ids=job_ids, as_user=authenticated_user,
+                                               timeout=remaining_time(self.command_timeout))
+        except SlurmRestError as e:
+            self.logger.warning(f"slurmrestd job lookup failed, running squeue: {e}")
+            return None
+        return ['|'.join(rows[job_id]) if job_id in rows else None for job_id in job_ids]
+
+    def _add_display_details(self, details: List[Dict], authenticated_user: str = None):
+        """Fill in display and port for connection details marked with 'display_home'"""
+        displays = self._get_displays_from_files([(d['job_id'], d['user']) for d in details], authenticated_user)
+        for d in details:
+            display_num = displays.get(d['job_id']) or d['display']
+            d['display'] = display_num
+            d['port'] = int(display_num) if display_num else None
+
+    def _parse_connection_details(self, job_id: str, output: str) -> Optional[Dict]:
+        """
+        Build connection details for a job from its _connection_details_cmd output.
+        Running jobs get 'display_home' set so the display can be read from file.
+        """
+        try:
             if not output or not output.strip():
                 self.logger.warning(f"No output from squeue for job {job_id}")
                 return None
@@ -1298,14 +2017,9 @@ sleep infinity
                 self.logger.warning(f"Could not determine execution host for job {job_id}")
                 return None
 
-            # Get display from file
+            # Fallback display from the command; the display file takes precedence
             display_num = None
-            if status == "RUN" and user:
-                user_home = os.path.expanduser(f'~{user}')
-                display_num = self._get_display_from_file(job_id, user_home, authenticated_user)
-
-            # Fallback: extract from command
-            if not display_num and command and status == "RUN":
+            if command and status == "RUN":
                 display_match = re.search(r':(\d+)', command)
                 if display_match:
                     display_num = display_match.group(1)
@@ -1320,7 +2034,8 @@ sleep infinity
                 'display': display_num,
                 'port': port,
                 'user': user,
-                'status': status
+                'status': status,
+                'display_home': os.path.expanduser(f'~{user}') if status == "RUN" and user else None
             }
 
         except Exception as e:
@@ -0,0 +1,384 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+slurmrestd client for SLURMManager's job queries
+
+One GET /slurm/<api_version>/jobs returns the state of every job slurmctld
+holds as JSON, so a listing (or the connection details of many sessions)
+costs one request on a kept-alive connection instead of an squeue process
+run through setuid_runner. The jobs are rendered into the columns of the
+squeue format the listing would have run, so SLURMManager parses them with
+the same code either way and the result feeds the same job snapshot.
+
+Over TCP each query carries the JWT of the user it runs as (the header
+authentication of slurmrestd's rest_auth/jwt). The token is obtained with
+'scontrol token' run as that user, through the callable the manager hands
+in, and reused until TOKEN_RENEW of its lifespan has passed. Over a Unix
+socket slurmrestd authenticates the connecting process (rest_auth/local),
+so every query runs as the server account.
+
+Any failure raises SlurmRestError and the manager runs squeue instead.
+"""
+
+import http.client
+import json
+import socket
+import threading
+import time
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+from urllib.parse import urlsplit
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils.tracing import tracer
+
+DEFAULT_API_VERSION = 'v0.0.40'
+DEFAULT_TOKEN_LIFESPAN = 1800
+DEFAULT_POOL_SIZE = 4
+DEFAULT_TIMEOUT = 10.0
+
+# Share of a token's lifespan after which a new one is requested
+TOKEN_RENEW = 0.8
+
+# squeue's compact state codes (%t)
+_STATE_CODES = {
+    'PENDING': 'PD', 'RUNNING': 'R', 'SUSPENDED': 'S', 'COMPLETED': 'CD', 'CANCELLED': 'CA',
+    'FAILED': 'F', 'TIMEOUT': 'TO', 'NODE_FAIL': 'NF', 'PREEMPTED': 'PR', 'BOOT_FAIL': 'BF',
+    'DEADLINE': 'DL', 'OUT_OF_MEMORY': 'OOM', 'COMPLETING': 'CG', 'CONFIGURING': 'CF',
+    'RESIZING': 'RS', 'REQUEUED': 'RQ', 'REQUEUE_FED': 'RF', 'REQUEUE_HOLD': 'RH',
+    'RESV_DEL_HOLD': 'RD', 'REVOKED': 'RV', 'SIGNALING': 'SI', 'SPECIAL_EXIT': 'SE',
+    'STAGE_OUT': 'SO', 'STOPPED': 'ST',
+}
+
+# State flags squeue shows instead of the base state, most significant first
+_STATE_FLAGS = ('COMPLETING', 'CONFIGURING', 'RESIZING', 'REQUEUED', 'REQUEUE_FED', 'REQUEUE_HOLD',
+                'RESV_DEL_HOLD', 'SPECIAL_EXIT', 'REVOKED', 'SIGNALING', 'STAGE_OUT', 'STOPPED')
+
+# Base states of finished jobs, which squeue leaves out unless asked for a job ID
+_FINISHED = {'COMPLETED', 'CANCELLED', 'FAILED', 'TIMEOUT', 'NODE_FAIL', 'PREEMPTED', 'BOOT_FAIL',
+             'DEADLINE', 'OUT_OF_MEMORY'}
+
+
+class SlurmRestError(Exception):
+    """A slurmrestd query failed; the caller falls back to squeue"""
+
+
+class _UnixHTTPConnection(http.client.HTTPConnection):
+    """HTTPConnection to slurmrestd's Unix socket"""
+
+    def __init__(self, path: str, timeout: float):
+        super().__init__('localhost', timeout=timeout)
+        self.socket_path = path
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(self.timeout)
+        try:
+            sock.connect(self.socket_path)
+        except OSError:
+            sock.close()
+            raise
+        self.sock = sock
+
+
+def _number(value) -> Optional[int]:
+    """A number as slurmrestd writes it: plain, or {'set', 'infinite', 'number'} since v0.0.40"""
+    if isinstance(value, dict):
+        if not value.get('set', True) or value.get('infinite'):
+            return None
+        value = value.get('number')
+    if isinstance(value, bool) or value is None:
+        return None
+    try:
+        return int(value)
+    except (TypeError, ValueError):
+        return None
+
+
+def _states(job: Dict) -> List[str]:
+    """Base state and flags; job_state is a string before v0.0.40 and a list after"""
+    state = job.get('job_state') or []
+    if isinstance(state, str):
+        state = [state]
+    return [str(s).upper() for s in state]
+
+
+def state_code(job: Dict) -> str:
+    states = _states(job)
+    for flag in _STATE_FLAGS:
+        if flag in states:
+            return _STATE_CODES[flag]
+    return _STATE_CODES.get(states[0], states[0]) if states else ''
+
+
+def _format_elapsed(seconds: int) -> str:
+    """Elapsed time as squeue prints it: M:SS, H:MM:SS or D-HH:MM:SS"""
+    seconds = max(0, int(seconds))
+    days, rest = divmod(seconds, 86400)
+    hours, rest = divmod(rest, 3600)
+    minutes, seconds = divmod(rest, 60)
+    if days:
+        return f"{days}-{hours:02d}:{minutes:02d}:{seconds:02d}"
+    if hours:
+        return f"{hours}:{minutes:02d}:{seconds:02d}"
+    return f"{minutes}:{seconds:02d}"
+
+
+def _format_memory(megabytes: Optional[int]) -> str:
+    """Memory in MB as squeue's %m prints it (16G, 4000M)"""
+    if not megabytes:
+        return '0'
+    for suffix, size in (('T', 1024 * 1024), ('G', 1024)):
+        if megabytes % size == 0:
+            return f"{megabytes // size}{suffix}"
+    return f"{megabytes}M"
+
+
+def _time_used(job: Dict, now: float) -> int:
+    """Seconds run so far, not counting time suspended, as squeue's %M"""
+    start = _number(job.get('start_time')) or 0
+    if start <= 0 or start > now:
+        return 0
+    states = _states(job)
+    pre_suspend = _number(job.get('pre_sus_time')) or 0
+    # suspend_time is when the job was last suspended or resumed
+    resumed = _number(job.get('suspend_time')) or 0
+    if states and states[0] == 'SUSPENDED':
+        return pre_suspend
+    if (states and states[0] == 'RUNNING') or 'COMPLETING' in states:
+        return int(now - resumed) + pre_suspend if resumed else int(now - start)
+    end = _number(job.get('end_time')) or 0
+    return int(end - start) if end > start else 0
+
+
+def format_field(job: Dict, field: str, now: float) -> str:
+    """The value squeue prints for a % format letter"""
+    if field == 'i':
+        array_id = _number(job.get('array_job_id'))
+        task_id = _number(job.get('array_task_id'))
+        if array_id and task_id is not None:
+            return f"{array_id}_{task_id}"
+        return str(_number(job.get('job_id')) or '')
+    if field == 't':
+        return state_code(job)
+    if field == 'u':
+        return job.get('user_name') or ''
+    if field == 'P':
+        return job.get('partition') or ''
+    if field == 'N':
+        return job.get('nodes') or ''
+    if field == 'M':
+        return _format_elapsed(_time_used(job, now))
+    if field == 'S':
+        start = _number(job.get('start_time')) or 0
+        if start <= 0:
+            return 'N/A'
+        return time.strftime('%Y-%m-%dT%H:%M:%S', time.localtime(start))
+    if field == 'C':
+        return str(_number(job.get('cpus')) or 0)
+    if field == 'm':
+        memory = _number(job.get('memory_per_node'))
+        if memory is None:
+            memory = _number(job.get('memory_per_cpu'))
+        return _format_memory(memory)
+    if field == 'j':
+        return job.get('name') or ''
+    if field == 'o':
+        return job.get('command') or ''
+    raise SlurmRestError(f"squeue format field %{field} is not rendered from slurmrestd")
+
+
+def format_fields(format_str: str) -> List[str]:
+    """The letters of an squeue --format made only of %x fields separated by '|'"""
+    fields = []
+    for item in format_str.split('|'):
+        if len(item) != 2 or item[0] != '%':
+            raise SlurmRestError(f"squeue format {format_str!r} is not rendered from slurmrestd")
+        fields.append(item[1])
+    return fields
+
+
+class SlurmRestClient:
+    """slurmrestd queries on a small pool of kept-alive connections"""
+
+    def __init__(self, url: str, api_version: str = DEFAULT_API_VERSION,
+                 token_source: Callable[[Optional[str], int], str] = None,
+                 token_lifespan: int = DEFAULT_TOKEN_LIFESPAN, pool_size: int = DEFAULT_POOL_SIZE,
+                 timeout: float = DEFAULT_TIMEOUT):
+        """
+        Args:
+            url: http://host:port of slurmrestd, or unix:/path/to/socket
+            api_version: OpenAPI plugin version in the request paths
+            token_source: Called with a user (None for the server account) and
+                a lifespan in seconds; returns that user's JWT ('scontrol token')
+            token_lifespan: Lifespan requested for each token
+            pool_size: Idle connections kept open
+            timeout: Seconds a request may take when the caller has no deadline
+        """
+        parts = urlsplit(url)
+        self.url = url
+        self.unix_path = parts.path if parts.scheme == 'unix' else None
+        if self.unix_path is None and parts.scheme != 'http':
+            raise ValueError(f"slurm_rest url must be http:// or unix: (got {url})")
+        self.host = parts.hostname
+        self.port = parts.port or 6820
+        self.api_version = api_version
+        self.token_source = token_source
+        self.token_lifespan = token_lifespan
+        self.pool_size = pool_size
+        self.timeout = timeout
+        self.logger = get_logger()
+        self._idle: List[http.client.HTTPConnection] = []
+        self._lock = threading.Lock()
+        self._tokens: Dict[Optional[str], Tuple[str, float]] = {}
+        self._token_lock = threading.Lock()
+
+    def _token(self, user: Optional[str]) -> Optional[str]:
+        """The JWT to send for user, requesting a new one once the cached one is due"""
+        if self.unix_path is not None:
+            return None
+        now = time.monotonic()
+        with self._token_lock:
+            cached = self._tokens.get(user)
+            if cached and cached[1] > now:
+                return cached[0]
+        if self.token_source is None:
+            raise SlurmRestError("No token source for slurmrestd")
+        try:
+            output = self.token_source(user, self.token_lifespan) or ''
+        except Exception as e:
+            raise SlurmRestError(f"scontrol token failed for {user or 'server account'}: {e}")
+        token = output.strip().rpartition('SLURM_JWT=')[2].strip()
+        if not token:
+            raise SlurmRestError(f"scontrol token returned no token for {user or 'server account'}")
+        with self._token_lock:
+            self._tokens[user] = (token, now + self.token_lifespan * TOKEN_RENEW)
+        return token
+
+    def _connection(self, timeout: float) -> http.client.HTTPConnection:
+        with self._lock:
+            connection = self._idle.pop() if self._idle else None
+        if connection is None:
+            if self.unix_path is not None:
+                connection = _UnixHTTPConnection(self.unix_path, timeout)
+            else:
+                connection = http.client.HTTPConnection(self.host, self.port, timeout=timeout)
+        connection.timeout = timeout
+        if connection.sock is not None:
+            connection.sock.settimeout(timeout)
+        return connection
+
+    def _release(self, connection: http.client.HTTPConnection):
+        with self._lock:
+            if len(self._idle) < self.pool_size:
+                self._idle.append(connection)
+                return
+        connection.close()
+
+    def get(self, path: str, user: Optional[str] = None, timeout: float = None) -> Dict:
+        """GET /slurm/<api_version>/<path> as user and return the decoded body"""
+        headers = {'Accept': 'application/json'}
+        token = self._token(user)
+        if token is not None:
+            headers['X-SLURM-USER-TOKEN'] = token
+            if user:
+                headers['X-SLURM-USER-NAME'] = user
+        url = f"/slurm/{self.api_version}/{path}"
+        timeout = timeout or self.timeout
+
+        with tracer.span(f"slurmrestd {path.split('/')[0]}"):
+            # A kept-alive connection the server has since closed fails on
+            # first use; that is retried once on a new connection
+            for attempt in range(2):
+                connection = self._connection(timeout)
+                reused = connection.sock is not None
+                try:
+                    connection.request('GET', url, headers=headers)
+                    response = connection.getresponse()
+                    body = response.read()
+                except (http.client.HTTPException, OSError) as e:
+                    connection.close()
+                    if reused and attempt == 0 and not isinstance(e, socket.timeout):
+                        continue
+                    raise SlurmRestError(f"slurmrestd request {url} failed: {e}")
+                if response.will_close:
+                    connection.close()
+                else:
+                    self._release(connection)
+                break
+
+        if response.status in (401, 403):
+            with self._token_lock:
+                self._tokens.pop(user, None)
+        try:
+            data = json.loads(body or b'{}')
+        except ValueError as e:
+            raise SlurmRestError(f"slurmrestd returned invalid JSON for {url} (HTTP {response.status}): {e}")
+        errors = [e for e in data.get('errors') or [] if isinstance(e, dict) and e.get('error_number', 1)]
+        if response.status != 200 or errors:
+            detail = '; '.join(str(e.get('description') or e.get('error') or e) for e in errors)
+            raise SlurmRestError(f"slurmrestd {url}: HTTP {response.status} {detail or response.reason}")
+        return data
+
+    def jobs(self, user: Optional[str] = None, timeout: float = None) -> List[Dict]:
+        """Every job slurmctld holds, as the user the query runs as may see them"""
+        return self.get('jobs', user=user, timeout=timeout).get('jobs') or []
+
+    def squeue_rows(self, format_str: str, names: Iterable[str] = None, users: Iterable[str] = None,
+                    job_ids: Iterable[str] = None, as_user: Optional[str] = None,
+                    timeout: float = None) -> Dict[str, List[str]]:
+        """
+        The rows 'squeue --noheader --format format_str' would print, by job ID
+
+        Args:
+            format_str: '|'-separated %x fields (see format_field)
+            names: Only jobs with these names (--name)
+            users: Only these users' jobs (--user); all users when None
+            job_ids: Only these jobs, in any state (--job); otherwise only
+                jobs that have not finished, as squeue shows by default
+            as_user: User to query as; None for the server account
+        """
+        fields = format_fields(format_str)
+        names = set(names) if names else None
+        users = set(users) if users else None
+        job_ids = set(job_ids) if job_ids else None
+        now = time.time()
+        rows = {}
+        for job in self.jobs(user=as_user, timeout=timeout):
+            job_id = format_field(job, 'i', now)
+            if job_ids is not None:
+                if job_id not in job_ids:
+                    continue
+            elif (_states(job) or [''])[0] in _FINISHED and 'COMPLETING' not in _states(job):
+                continue
+            if names is not None and job.get('name') not in names:
+                continue
+            if users is not None and job.get('user_name') not in users:
+                continue
+            rows[job_id] = [format_field(job, field, now) for field in fields]
+        return rows
+
+
+_clients: Dict[str, SlurmRestClient] = {}
+_clients_lock = threading.Lock()
+
+
+def get_slurm_rest(server_config: Dict,
+                   token_source: Callable[[Optional[str], int], str] = None) -> Optional[SlurmRestClient]:
+    """
+    Return the shared SlurmRestClient when 'slurm_rest' is enabled in
+    server_config.json, otherwise None
+    """
+    rest_config = server_config.get('slurm_rest') or {}
+    if not rest_config.get('enabled', False) or not rest_config.get('url'):
+        return None
+    url = rest_config['url']
+    with _clients_lock:
+        client = _clients.get(url)
+        if client is None:
+            client = SlurmRestClient(url, api_version=rest_config.get('api_version', DEFAULT_API_VERSION),
+                                     token_source=token_source,
+                                     token_lifespan=int(rest_config.get('token_lifespan', DEFAULT_TOKEN_LIFESPAN)),
+                                     pool_size=int(rest_config.get('pool_size', DEFAULT_POOL_SIZE)),
+                                     timeout=float(rest_config.get('timeout', DEFAULT_TIMEOUT)))
+            _clients[url] = client
+        return client
@@ -0,0 +1,220 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Cache of the web UI's static files (HTML, JavaScript, CSS, images)
+
+Every file under the static directory is read once at startup and given an
+ETag from its content hash, so browsers revalidate with If-None-Match and
+get a 304 instead of downloading app.js and friends on every visit. Text
+files are also compressed once (gzip, and brotli when the module is
+installed) into a cache directory; requests get the smallest variant their
+Accept-Encoding allows. Bodies are sent with sendfile() from the original
+file or the compressed copy, so serving them costs no reads into Python.
+
+Each lookup stats the file; one that changed on disk (a deploy without a
+restart) is hashed and compressed again before it is served. Files added
+after startup are not cached and are served by SimpleHTTPRequestHandler.
+"""
+
+import atexit
+import gzip
+import hashlib
+import mimetypes
+import os
+import posixpath
+import shutil
+import tempfile
+import threading
+from typing import Dict, NamedTuple, Optional
+from urllib.parse import unquote
+
+from myvnc.utils.log_manager import get_logger
+
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
+# Smallest file worth compressing, and the share of the size a variant must save to be kept
+MIN_COMPRESS_SIZE = 512
+MIN_SAVING = 0.1
+
+_COMPRESSIBLE = ('text/', 'application/javascript', 'application/json', 'image/svg+xml')
+
+# Sent for types mimetypes does not know or that differ between platforms
+_TYPES = {
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.html': 'text/html',
+    '.sh': 'text/plain',
+}
+
+
+class Variant(NamedTuple):
+    path: str
+    size: int
+
+
+class Asset(NamedTuple):
+    """A cached file: its identity and the file each Content-Encoding is sent from"""
+    path: str
+    stamp: tuple
+    etag: str
+    content_type: str
+    mtime: float
+    variants: Dict[str, Variant]
+
+
+def _content_type(path: str) -> str:
+    content_type = _TYPES.get(os.path.splitext(path)[1].lower()) or mimetypes.guess_type(path)[0] \
+        or 'application/octet-stream'
+    if content_type.startswith('text/') or content_type == 'application/javascript':
+        content_type += '; charset=utf-8'
+    return content_type
+
+
+def accepted_encodings(accept_encoding: Optional[str]) -> set:
+    """Content codings an Accept-Encoding header allows (those not given q=0)"""
+    encodings = set()
+    for item in (accept_encoding or '').split(','):
+        name, _, params = item.strip().partition(';')
+        name = name.strip().lower()
+        quality = 1.0
+        for param in params.split(';'):
+            key, _, value = param.strip().partition('=')
+            if key == 'q':
+                try:
+                    quality = float(value)
+                except ValueError:
+                    quality = 0.0
+        if name and quality > 0:
+            encodings.add(name)
+    return encodings
+
+
+class StaticAssets:
+    """The files of a static directory with their ETags and precompressed variants"""
+
+    def __init__(self, directory: str, max_age: int = 0, cache_dir: Optional[str] = None):
+        """
+        Args:
+            directory: Static directory served at /
+            max_age: Cache-Control max-age for everything but HTML; 0 has browsers revalidate every time
+            cache_dir: Where the compressed variants are written; a temporary directory if not given
+        """
+        self.directory = os.path.realpath(directory)
+        self.max_age = max_age
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        if cache_dir:
+            os.makedirs(cache_dir, mode=0o755, exist_ok=True)
+            self.cache_dir = cache_dir
+        else:
+            self.cache_dir = tempfile.mkdtemp(prefix='myvnc-static-')
+            atexit.register(shutil.rmtree, self.cache_dir, True)
+        self._assets: Dict[str, Asset] = {}
+
+        compressed = 0
+        total = 0
+        for root, _, files in os.walk(self.directory):
+            for name in files:
+                path = os.path.join(root, name)
+                asset = self._load(path)
+                if asset is not None:
+                    self._assets[os.path.relpath(path, self.directory)] = asset
+                    total += asset.variants['identity'].size
+                    compressed += len(asset.variants) - 1
+        self.logger.info(f"Cached {len(self._assets)} static files from {self.directory} "
+                         f"({total} bytes, {compressed} compressed variants in {self.cache_dir})")
+
+    def _load(self, path: str) -> Optional[Asset]:
+        """Hash a file and write its compressed variants"""
+        try:
+            st = os.stat(path)
+            with open(path, 'rb') as f:
+                content = f.read()
+        except OSError as e:
+            self.logger.warning(f"Could not cache static file {path}: {e}")
+            return None
+        digest = hashlib.sha256(content).hexdigest()[:20]
+        content_type = _content_type(path)
+        variants = {'identity': Variant(path, len(content))}
+        if content_type.startswith(_COMPRESSIBLE) and len(content) >= MIN_COMPRESS_SIZE:
+            compressors = [('gzip', 'gz', lambda data: gzip.compress(data, 9, mtime=0))]
+            if brotli is not None:
+                compressors.append(('br', 'br', brotli.compress))
+            for encoding, suffix, compress in compressors:
+                encoded = compress(content)
+                if len(encoded) > len(content) * (1 - MIN_SAVING):
+                    continue
+                variant_path = os.path.join(self.cache_dir, f'{digest}.{suffix}')
+                try:
+                    with open(variant_path, 'wb') as f:
+                        f.write(encoded)
+                except OSError as e:
+                    self.logger.warning(f"Could not write {encoding} copy of {path}: {e}")
+                    continue
+                variants[encoding] = Variant(variant_path, len(encoded))
+        return Asset(path, (st.st_mtime_ns, st.st_size), f'"{digest}"', content_type, st.st_mtime, variants)
+
+    def get(self, url_path: str) -> Optional[Asset]:
+        """Return the asset for a URL path (or a path relative to the directory), or None if it is not cached"""
+        relative = posixpath.normpath(unquote(url_path)).lstrip('/')
+        if not relative or relative.startswith('..') or '\x00' in relative:
+            return None
+        asset = self._assets.get(relative)
+        if asset is None:
+            return None
+        try:
+            st = os.stat(asset.path)
+        except OSError:
+            with self._lock:
+                self._assets.pop(relative, None)
+            return None
+        if (st.st_mtime_ns, st.st_size) != asset.stamp:
+            self.logger.info(f"Static file changed on disk, caching it again: {asset.path}")
+            asset = self._load(asset.path)
+            with self._lock:
+                if asset is None:
+                    self._assets.pop(relative, None)
+                else:
+                    self._assets[relative] = asset
+        return asset
+
+    def cache_control(self, asset: Asset) -> str:
+        # HTML names the other files, so it is always revalidated to pick up a deploy
+        if self.max_age and not asset.content_type.startswith('text/html'):
+            return f'max-age={self.max_age}'
+        return 'no-cache'
+
+    @staticmethod
+    def choose(asset: Asset, accept_encoding: Optional[str]) -> str:
+        """The Content-Encoding to send: the smallest variant the client accepts"""
+        accepted = accepted_encodings(accept_encoding)
+        choices = [encoding for encoding in asset.variants if encoding in accepted]
+        if not choices:
+            return 'identity'
+        return min(choices, key=lambda encoding: asset.variants[encoding].size)
+
+
+_assets: Dict[str, StaticAssets] = {}
+_assets_lock = threading.Lock()
+
+
+def get_static_assets(server_config: Dict, directory: str) -> Optional[StaticAssets]:
+    """
+    Return the shared StaticAssets for directory, or None when
+    'static_assets' is not enabled in server_config.json
+    """
+    assets_config = server_config.get('static_assets') or {}
+    if not assets_config.get('enabled', False):
+        return None
+    with _assets_lock:
+        assets = _assets.get(directory)
+        if assets is None:
+            assets = StaticAssets(directory, max_age=int(assets_config.get('max_age', 0)),
+                                  cache_dir=assets_config.get('cache_dir') or None)
+            _assets[directory] = assets
+        else:
+            assets.max_age = int(assets_config.get('max_age', 0))
+        return assets
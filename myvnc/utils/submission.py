@@ -0,0 +1,169 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Compiled bsub/sbatch submission plans
+
+Most of what goes into a submission command does not depend on the user:
+the resource strings, the container image (resolved through its symlinks),
+the bind mounts (each checked on disk), the wrapper and xstartup paths.
+The managers compile a SubmissionPlan once per combination of configuration
+version, session type, site, desktop and resource choices, with
+placeholders for the per-launch fields (FIELDS), and only substitute those
+when a session is launched. Plans are recompiled after PLAN_TTL seconds, so
+a container symlink pointed at a new image or a bind path that appeared is
+picked up without a restart.
+
+A substituted value must produce the same command as compiling with it.
+That holds for values made of shell-safe characters only (see
+can_substitute), which also keeps a value from looking like a placeholder;
+for anything else the managers compile a one-off plan with the real values
+instead.
+
+The uid and home directory of a user come from user_credentials(), an
+in-process getpwnam cache with the TTLs of setuid_runner's daemon cache,
+instead of an 'id -u' process per launch.
+"""
+
+import json
+import os
+import pwd
+import re
+import threading
+import time
+from collections import OrderedDict
+from typing import Callable, Dict, List, NamedTuple, Optional, Tuple
+
+# Per-launch fields a plan has placeholders for
+FIELDS = ('user', 'home', 'uid', 'name')
+
+# Seconds a compiled plan is used before it is compiled again
+PLAN_TTL = 300.0
+
+# Plans kept before the least recently used are dropped
+MAX_PLANS = 256
+
+# Seconds a user's credentials (or their absence) are cached, as in setuid_runner
+CREDENTIAL_TTL = 300.0
+CREDENTIAL_NEGATIVE_TTL = 60.0
+
+# Characters shlex.quote() leaves alone, so substituting them is the same as compiling with them
+_SAFE_VALUE = re.compile(r'[\w@%+=:,./-]*', re.ASCII)
+
+
+def placeholder(field: str) -> str:
+    """The text standing for a per-launch field in a compiled plan"""
+    return f'<myvnc:{field}>'
+
+
+def placeholders(**present) -> Dict[str, Optional[str]]:
+    """Placeholders for the fields that will have a value at launch, None for the others"""
+    return {field: placeholder(field) if present.get(field, True) else None for field in FIELDS}
+
+
+def can_substitute(values: Dict[str, Optional[str]]) -> bool:
+    """Whether a cached plan can be filled in with these values"""
+    return all(value is None or _SAFE_VALUE.fullmatch(value) for value in values.values())
+
+
+class SubmissionPlan:
+    """A submission command, and optionally a batch script, with placeholders for the per-launch fields"""
+
+    def __init__(self, argv: List[str], script: Optional[str] = None):
+        self.argv = list(argv)
+        self.script = script
+        self.compiled_at = time.monotonic()
+
+    @staticmethod
+    def _fill(text: str, values: Dict[str, Optional[str]]) -> str:
+        if '<myvnc:' not in text:
+            return text
+        for field, value in values.items():
+            if value is not None:
+                text = text.replace(placeholder(field), value)
+        return text
+
+    def render(self, values: Dict[str, Optional[str]]) -> Tuple[List[str], Optional[str]]:
+        """Return the argv and script with the fields substituted"""
+        argv = [self._fill(arg, values) for arg in self.argv]
+        return argv, self._fill(self.script, values) if self.script is not None else None
+
+
+def plan_key(*parts) -> str:
+    """Cache key of a plan compiled from parts (configuration dicts and flags)"""
+    return json.dumps(parts, sort_keys=True, default=str)
+
+
+class SubmissionPlans:
+    """Compiled plans by key, least recently used dropped first"""
+
+    def __init__(self, ttl: float = PLAN_TTL, max_plans: int = MAX_PLANS):
+        self.ttl = ttl
+        self.max_plans = max_plans
+        self._lock = threading.Lock()
+        self._compile_lock = threading.Lock()
+        self._plans = OrderedDict()
+        self.compiled = 0
+
+    def get(self, key: str, compile: Callable[[], SubmissionPlan]) -> SubmissionPlan:
+        """Return the plan for key, compiling it if there is none or it expired"""
+        plan = self._lookup(key)
+        if plan is not None:
+            return plan
+        # One compile at a time, so the sessions of a batch submission wait for the first one's plan
+        with self._compile_lock:
+            plan = self._lookup(key)
+            if plan is not None:
+                return plan
+            plan = compile()
+            with self._lock:
+                self._plans[key] = plan
+                self._plans.move_to_end(key)
+                self.compiled += 1
+                while len(self._plans) > self.max_plans:
+                    self._plans.popitem(last=False)
+        return plan
+
+    def _lookup(self, key: str) -> Optional[SubmissionPlan]:
+        with self._lock:
+            plan = self._plans.get(key)
+            if plan is None or time.monotonic() - plan.compiled_at >= self.ttl:
+                return None
+            self._plans.move_to_end(key)
+            return plan
+
+    def clear(self):
+        with self._lock:
+            self._plans.clear()
+
+
+class Credentials(NamedTuple):
+    uid: Optional[str]
+    home: str
+
+
+_credentials: Dict[str, Tuple[Credentials, float]] = {}
+_credentials_lock = threading.Lock()
+
+
+def user_credentials(username: str) -> Credentials:
+    """
+    Return a user's uid and home directory, cached for CREDENTIAL_TTL seconds
+
+    For an unknown user uid is None and home is what os.path.expanduser()
+    makes of ~username, as it was before the cache.
+    """
+    now = time.monotonic()
+    with _credentials_lock:
+        entry = _credentials.get(username)
+        if entry is not None and entry[1] > now:
+            return entry[0]
+    try:
+        entry = pwd.getpwnam(username)
+        credentials = Credentials(str(entry.pw_uid), entry.pw_dir)
+        expires = now + CREDENTIAL_TTL
+    except KeyError:
+        credentials = Credentials(None, os.path.expanduser(f'~{username}'))
+        expires = now + CREDENTIAL_NEGATIVE_TTL
+    with _credentials_lock:
+        _credentials[username] = (credentials, expires)
+    return credentials
@@ -0,0 +1,377 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Per-command spans and latency histograms for scheduler commands
+
+Every command the managers run is traced as a span named after the command
+(bjobs, bsub, squeue, ...) with the time spent in each phase:
+
+    queue   waiting for a scheduler lane slot and a submit() worker before
+            the first command of the call started
+    spawn   starting the process, or delivering the request to the
+            setuid_runner daemon
+    run     from then until the command's output was read and it exited
+    parse   turning the output into jobs
+    total   the whole span; for listings streamed through setuid_runner,
+            whose rows are parsed as they arrive, this includes parse
+
+Each (command, phase) pair has a LatencyHistogram: log-linear buckets in
+the style of HdrHistogram (SUB_BUCKETS per power of two microseconds, so any
+recorded value is known to within 1/SUB_BUCKETS), recorded with a lock and
+a few integer operations, so tracing is cheap enough to stay on. The
+histograms are served on /metrics in the Prometheus text format.
+
+The verbose text logging of commands and their output (log_manager's
+subprocess logging and the managers' per-job lines) is controlled by the
+'tracing' settings: 'all' logs every command as before, 'sampled' only every
+'sample_every'th command of each kind, 'off' none. Failures are always logged.
+"""
+
+import contextlib
+import os
+import threading
+import time
+from typing import Dict, List, Optional, Tuple
+
+# Linear sub-buckets per power of two (a power of two itself)
+SUB_BUCKETS = 16
+_SUB_BITS = SUB_BUCKETS.bit_length() - 1
+
+# Values are clamped to 2**36 microseconds (about 19 hours)
+_MAX_EXPONENT = 36 - _SUB_BITS
+BUCKET_COUNT = SUB_BUCKETS + (_MAX_EXPONENT + 1) * SUB_BUCKETS
+
+# Bucket boundaries of the exported Prometheus histograms, in seconds
+EXPORT_BUCKETS = (0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0)
+
+# Quantiles exported alongside them
+EXPORT_QUANTILES = (0.5, 0.9, 0.99)
+
+PHASES = ('queue', 'spawn', 'run', 'parse', 'total')
+
+VERBOSE_MODES = ('all', 'sampled', 'off')
+DEFAULT_VERBOSE_MODE = 'sampled'
+DEFAULT_SAMPLE_EVERY = 100
+
+
+def _bucket_index(micros: int) -> int:
+    if micros < SUB_BUCKETS:
+        return max(0, micros)
+    exponent = micros.bit_length() - _SUB_BITS - 1
+    if exponent > _MAX_EXPONENT:
+        return BUCKET_COUNT - 1
+    return SUB_BUCKETS + exponent * SUB_BUCKETS + (micros >> exponent) - SUB_BUCKETS
+
+
+def _bucket_upper(index: int) -> int:
+    """Smallest value in microseconds above the bucket"""
+    if index < SUB_BUCKETS:
+        return index + 1
+    exponent, sub = divmod(index - SUB_BUCKETS, SUB_BUCKETS)
+    return (SUB_BUCKETS + sub + 1) << exponent
+
+
+class LatencyHistogram:
+    """Log-linear histogram of durations, recorded in microseconds"""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._counts = [0] * BUCKET_COUNT
+        self.count = 0
+        self.sum = 0.0
+        self.max = 0.0
+
+    def record(self, seconds: float):
+        index = _bucket_index(int(seconds * 1e6))
+        with self._lock:
+            self._counts[index] += 1
+            self.count += 1
+            self.sum += seconds
+            if seconds > self.max:
+                self.max = seconds
+
+    def snapshot(self) -> Tuple[List[int], int, float, float]:
+        """Return (bucket counts, count, sum, max)"""
+        with self._lock:
+            return list(self._counts), self.count, self.sum, self.max
+
+    @staticmethod
+    def quantile(counts: List[int], count: int, q: float) -> float:
+        """Upper bound in seconds of the bucket holding the q quantile of a snapshot"""
+        if not count:
+            return 0.0
+        rank = max(1, int(q * count + 0.5))
+        seen = 0
+        for index, bucket in enumerate(counts):
+            seen += bucket
+            if seen >= rank:
+                return _bucket_upper(index) / 1e6
+        return _bucket_upper(BUCKET_COUNT - 1) / 1e6
+
+
+class Span:
+    """Phase durations of one command; recorded into the histograms when the span ends"""
+
+    def __init__(self, command: str):
+        self.command = command
+        self.started = time.perf_counter()
+        self.phases: Dict[str, float] = {}
+        # Sampling decision for verbose logging, made when first asked
+        self.verbose: Optional[bool] = None
+        # Output carries credentials and is never logged, whatever the verbose mode
+        self.sensitive = False
+
+    def add(self, phase: str, seconds: float):
+        self.phases[phase] = self.phases.get(phase, 0.0) + seconds
+
+    @contextlib.contextmanager
+    def phase(self, phase: str):
+        started = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.add(phase, time.perf_counter() - started)
+
+
+class Tracer:
+    """The histograms of all commands and the verbose logging sampler"""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._histograms: Dict[Tuple[str, str], LatencyHistogram] = {}
+        self._seen: Dict[str, int] = {}
+        # id(span) -> span of every command that is running
+        self._running: Dict[int, Span] = {}
+        self._local = threading.local()
+        self.verbose_mode = DEFAULT_VERBOSE_MODE
+        self.sample_every = DEFAULT_SAMPLE_EVERY
+
+    def configure(self, server_config: Dict):
+        """Apply the 'tracing' settings of server_config.json"""
+        tracing_config = server_config.get('tracing') or {}
+        mode = str(tracing_config.get('verbose_logging', DEFAULT_VERBOSE_MODE)).lower()
+        self.verbose_mode = mode if mode in VERBOSE_MODES else DEFAULT_VERBOSE_MODE
+        self.sample_every = max(1, int(tracing_config.get('sample_every', DEFAULT_SAMPLE_EVERY)))
+
+    def histogram(self, command: str, phase: str) -> LatencyHistogram:
+        key = (command, phase)
+        histogram = self._histograms.get(key)
+        if histogram is None:
+            with self._lock:
+                histogram = self._histograms.setdefault(key, LatencyHistogram())
+        return histogram
+
+    def record(self, command: str, phase: str, seconds: float):
+        self.histogram(command, phase).record(seconds)
+
+    @contextlib.contextmanager
+    def timed(self, command: str, phase: str):
+        """Record the duration of the block as one phase of command, outside of its span"""
+        started = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.record(command, phase, time.perf_counter() - started)
+
+    def start(self, argv_or_name) -> Span:
+        """Start a span for a command, attributing the queue wait set on this thread to it"""
+        span = Span(command_name(argv_or_name))
+        queued = getattr(self._local, 'queue_wait', None)
+        if queued is not None:
+            self._local.queue_wait = None
+            span.add('queue', queued)
+        with self._lock:
+            self._running[id(span)] = span
+        return span
+
+    def finish(self, span: Span):
+        """Record a span's phases into the histograms"""
+        total = time.perf_counter() - span.started
+        with self._lock:
+            if self._running.pop(id(span), None) is None:
+                # Already finished
+                return
+        span.add('total', total)
+        for phase, seconds in span.phases.items():
+            self.record(span.command, phase, seconds)
+        self._local.command_time = self._command_time() + total
+
+    def _command_time(self) -> float:
+        """Seconds this thread spent in finished spans so far"""
+        return getattr(self._local, 'command_time', 0.0)
+
+    @contextlib.contextmanager
+    def span(self, argv_or_name, sensitive: bool = False):
+        """
+        Trace the block as one command; the span is current on this thread
+        until it ends. A sensitive span's command is never logged verbosely.
+        """
+        span = self.start(argv_or_name)
+        span.sensitive = sensitive
+        previous = getattr(self._local, 'span', None)
+        self._local.span = span
+        try:
+            yield span
+        finally:
+            self._local.span = previous
+            self.finish(span)
+
+    def iterate(self, iterable, span: Optional[Span] = None, command: Optional[str] = None):
+        """
+        Yield the items of a command's output, counting the time spent
+        producing them as the span's run phase and the time the caller spends
+        between items as parse, less any commands the caller runs meanwhile.
+        The span is finished at the end; without one only parse is recorded,
+        for command.
+        """
+        parse = 0.0
+        iterator = iter(iterable)
+        try:
+            while True:
+                started = time.perf_counter()
+                try:
+                    item = next(iterator)
+                except StopIteration:
+                    return
+                finally:
+                    if span is not None:
+                        span.add('run', time.perf_counter() - started)
+                handed_out = time.perf_counter()
+                command_time = self._command_time()
+                yield item
+                parse += time.perf_counter() - handed_out - (self._command_time() - command_time)
+        finally:
+            if span is not None:
+                span.add('parse', parse)
+                self.finish(span)
+            elif command is not None:
+                self.record(command, 'parse', parse)
+
+    def current(self) -> Optional[Span]:
+        return getattr(self._local, 'span', None)
+
+    @contextlib.contextmanager
+    def phase(self, phase: str):
+        """Count the block towards a phase of the current span, if there is one"""
+        span = self.current()
+        if span is None:
+            yield
+            return
+        with span.phase(phase):
+            yield
+
+    def set_queue_wait(self, seconds: Optional[float]):
+        """Note time spent queueing on this thread, for the next span it starts"""
+        self._local.queue_wait = seconds
+
+    def take_queue_wait(self) -> float:
+        """Return and clear the queue wait noted on this thread"""
+        seconds = getattr(self._local, 'queue_wait', None) or 0.0
+        self._local.queue_wait = None
+        return seconds
+
+    def verbose(self, argv_or_name) -> bool:
+        """
+        Whether this run of a command should have its command line and output
+        logged in full; inside a span the decision is the span's, so the
+        command line and the output of one run are logged together or not at all
+        """
+        span = self.current()
+        if span is not None and span.sensitive:
+            return False
+        if self.verbose_mode == 'all':
+            return True
+        if self.verbose_mode == 'off':
+            return False
+        if span is not None:
+            if span.verbose is None:
+                span.verbose = self._sample(span.command)
+            return span.verbose
+        return self._sample(command_name(argv_or_name))
+
+    def _sample(self, name: str) -> bool:
+        with self._lock:
+            seen = self._seen.get(name, 0)
+            self._seen[name] = seen + 1
+        return seen % self.sample_every == 0
+
+    def running(self) -> Tuple[int, float]:
+        """The number of commands running and how long the oldest of them has been"""
+        now = time.perf_counter()
+        with self._lock:
+            started = [span.started for span in self._running.values()]
+        return len(started), (now - min(started)) if started else 0.0
+
+    def histograms(self) -> List[Tuple[str, str, LatencyHistogram]]:
+        with self._lock:
+            return [(command, phase, histogram) for (command, phase), histogram in sorted(self._histograms.items())]
+
+    def render_prometheus(self) -> str:
+        """The histograms in the Prometheus text exposition format"""
+        lines = [
+            '# HELP myvnc_command_duration_seconds Scheduler command latency by command and phase',
+            '# TYPE myvnc_command_duration_seconds histogram',
+        ]
+        quantile_lines = [
+            '# HELP myvnc_command_duration_quantile_seconds Scheduler command latency quantiles '
+            f'(to within 1/{SUB_BUCKETS})',
+            '# TYPE myvnc_command_duration_quantile_seconds gauge',
+        ]
+        for command, phase, histogram in self.histograms():
+            labels = f'command="{escape_label(command)}",phase="{phase}"'
+            histogram_lines, quantiles = render_histogram('myvnc_command_duration_seconds', labels, histogram,
+                                                          'myvnc_command_duration_quantile_seconds')
+            lines.extend(histogram_lines)
+            quantile_lines.extend(quantiles)
+        return '\n'.join(lines + quantile_lines) + '\n'
+
+
+def command_name(argv_or_name) -> str:
+    """Span name of a command: the basename of argv[0], skipping a setuid_runner prefix"""
+    if isinstance(argv_or_name, str):
+        return argv_or_name
+    argv = [str(arg) for arg in argv_or_name]
+    if argv and os.path.basename(argv[0]) == 'setuid_runner':
+        # setuid_runner [--deadline-ms N] [--framed] <user> <command> ...; batches have no command
+        rest = argv[1:]
+        while rest and rest[0].startswith('--'):
+            rest = rest[2:] if rest[0] == '--deadline-ms' else rest[1:]
+        return os.path.basename(rest[1]) if len(rest) > 1 else 'setuid_runner'
+    return os.path.basename(argv[0]) if argv else 'unknown'
+
+
+def render_histogram(name: str, labels: str, histogram: LatencyHistogram,
+                     quantile_name: Optional[str] = None) -> Tuple[List[str], List[str]]:
+    """
+    Prometheus lines of one histogram (EXPORT_BUCKETS, sum and count) and,
+    with quantile_name, of its EXPORT_QUANTILES as a gauge
+    """
+    counts, count, total, _ = histogram.snapshot()
+    prefix = labels + ',' if labels else ''
+    lines = []
+    index = 0
+    cumulative = 0
+    for bound in EXPORT_BUCKETS:
+        limit = int(bound * 1e6)
+        while index < BUCKET_COUNT and _bucket_upper(index) <= limit:
+            cumulative += counts[index]
+            index += 1
+        lines.append(f'{name}_bucket{{{prefix}le="{bound}"}} {cumulative}')
+    lines.append(f'{name}_bucket{{{prefix}le="+Inf"}} {count}')
+    braced = f'{{{labels}}}' if labels else ''
+    lines.append(f'{name}_sum{braced} {total:.6f}')
+    lines.append(f'{name}_count{braced} {count}')
+    quantile_lines = []
+    if quantile_name:
+        for q in EXPORT_QUANTILES:
+            value = LatencyHistogram.quantile(counts, count, q)
+            quantile_lines.append(f'{quantile_name}{{{prefix}quantile="{q}"}} {value:.6f}')
+    return lines, quantile_lines
+
+
+def escape_label(value: str) -> str:
+    return value.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+
+# One tracer per process, shared by the managers, runner_client and the web server
+tracer = Tracer()
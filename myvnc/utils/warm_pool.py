@@ -0,0 +1,208 @@
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+Warm pool of reserved execution slots for near-instant VNC session starts
+
+Most of the time from "Create" to a desktop is spent pending in the queue.
+A VNC session runs under its user's uid, so it cannot be started before the
+user asks for it; what the pool keeps ready instead is the slot it will run
+in. For every configured profile (the queue, cores, memory and OS of a
+common request, optionally its site and desktop) a refill thread keeps
+'size' holder jobs submitted as the pool account ('run_as', the server
+account by default). A holder is a 'sleep' of 'hold_minutes' with the
+profile's resources, named myvncpool_<profile hash> so no session listing
+shows it.
+
+When a VNC request matches a profile with a running holder, the manager
+claims it: the user's own job is submitted through setuid_runner as before,
+placed on the holder's host (LSF: -m "host+1 others", SLURM: --nodelist),
+and the holder is killed right after, so the scheduler dispatches the
+user's job into the slot it frees. A request with no running holder is
+submitted as usual. The refill thread replaces claimed and expired holders
+at once.
+
+To measure what matters, every VNC submission is timed until its job is
+seen running with a display in a listing, and the time is recorded by
+whether a slot was claimed (myvnc_session_start_seconds on /metrics).
+"""
+
+import hashlib
+import json
+import threading
+import time
+from typing import Callable, Dict, List, NamedTuple, Optional
+
+from myvnc.utils.log_manager import get_logger
+from myvnc.utils import metrics
+
+DEFAULT_SIZE = 1
+DEFAULT_REFILL_INTERVAL = 30.0
+DEFAULT_HOLD_MINUTES = 120
+
+# Name prefix of the holder jobs
+HOLDER_PREFIX = 'myvncpool_'
+
+# Seconds a submission is tracked for its start time
+TRACK_TTL = 3600.0
+
+
+class PoolSlot(NamedTuple):
+    """A holder job of a profile"""
+    job_id: str
+    name: str
+    status: str
+    host: Optional[str]
+
+
+def holder_name(profile: Dict) -> str:
+    """Job name of a profile's holders, stable across restarts and configuration reorders"""
+    digest = hashlib.sha1(json.dumps(profile, sort_keys=True, default=str).encode('utf-8')).hexdigest()[:10]
+    return f'{HOLDER_PREFIX}{digest}'
+
+
+def _matches(profile: Dict, session_config: Dict, scheduler_config: Dict) -> bool:
+    for key, value in profile.items():
+        actual = scheduler_config.get(key, session_config.get(key))
+        if actual is None or str(actual).lower() != str(value).lower():
+            return False
+    return True
+
+
+class WarmPool:
+    """Holder jobs per profile, refilled by a background thread"""
+
+    def __init__(self, profiles: List[Dict], list_holders: Callable[[], List[PoolSlot]],
+                 submit_holder: Callable[[str, Dict, int], None], release_holder: Callable[[PoolSlot], None],
+                 size: int = DEFAULT_SIZE, refill_interval: float = DEFAULT_REFILL_INTERVAL,
+                 hold_minutes: int = DEFAULT_HOLD_MINUTES):
+        """
+        Args:
+            profiles: Request settings each profile matches (keys of the
+                scheduler or session configuration and their values)
+            list_holders: Returns the pool account's holder jobs; raises on failure
+            submit_holder: Submits one holder (name, profile, seconds to hold)
+            release_holder: Kills a holder
+            size: Holders kept per profile, running or pending
+            refill_interval: Seconds between refills
+            hold_minutes: How long a holder keeps its slot before it exits
+        """
+        self.profiles = {holder_name(profile): profile for profile in profiles}
+        self.list_holders = list_holders
+        self.submit_holder = submit_holder
+        self.release_holder = release_holder
+        self.size = size
+        self.refill_interval = refill_interval
+        self.hold_minutes = hold_minutes
+        self.logger = get_logger()
+        self._lock = threading.Lock()
+        self._wake = threading.Event()
+        self._holders: Dict[str, PoolSlot] = {}
+        # Holders handed to a request that may still be listed until they are killed
+        self._claimed = set()
+        # job_id -> (monotonic submission time, whether a slot was claimed)
+        self._starts: Dict[str, tuple] = {}
+        for state in ('running', 'pending'):
+            metrics.warm_pool_holders.set_function(lambda state=state: self._count(state), state=state)
+        threading.Thread(target=self._refill_loop, name='warm-pool', daemon=True).start()
+
+    def _count(self, state: str) -> int:
+        with self._lock:
+            return sum(1 for slot in self._holders.values()
+                       if slot.job_id not in self._claimed and (slot.status == 'RUN') == (state == 'running'))
+
+    def refill(self):
+        """List the holders and submit the missing ones"""
+        holders = {slot.job_id: slot for slot in self.list_holders() if slot.name in self.profiles}
+        with self._lock:
+            self._holders = holders
+            self._claimed &= set(holders)
+            counts = {name: 0 for name in self.profiles}
+            for slot in holders.values():
+                if slot.job_id not in self._claimed:
+                    counts[slot.name] += 1
+        for name, count in counts.items():
+            for _ in range(self.size - count):
+                try:
+                    self.submit_holder(name, self.profiles[name], self.hold_minutes * 60)
+                except Exception as e:
+                    self.logger.warning(f"Could not submit warm pool holder {name}: {e}")
+                    break
+
+    def _refill_loop(self):
+        while True:
+            try:
+                self.refill()
+            except Exception as e:
+                self.logger.warning(f"Warm pool refill failed: {e}")
+            self._wake.wait(self.refill_interval)
+            self._wake.clear()
+
+    def claim(self, session_config: Dict, scheduler_config: Dict) -> Optional[PoolSlot]:
+        """A running holder of the profile the request matches, or None to submit as usual"""
+        names = [name for name, profile in self.profiles.items()
+                 if _matches(profile, session_config, scheduler_config)]
+        if not names:
+            return None
+        with self._lock:
+            for slot in self._holders.values():
+                if slot.name in names and slot.status == 'RUN' and slot.host and slot.job_id not in self._claimed:
+                    self._claimed.add(slot.job_id)
+                    metrics.warm_pool_claims.inc(result='hit')
+                    self.logger.info(f"Claimed warm pool slot {slot.job_id} on {slot.host}")
+                    return slot
+        metrics.warm_pool_claims.inc(result='miss')
+        return None
+
+    def finish(self, slot: Optional[PoolSlot], job_id: Optional[str]):
+        """
+        After the request's submission: kill the claimed holder if the job was
+        submitted (job_id), or give it back to the pool if it was not, and
+        start timing the job
+        """
+        if job_id:
+            with self._lock:
+                now = time.monotonic()
+                self._starts = {k: v for k, v in self._starts.items() if now - v[0] < TRACK_TTL}
+                self._starts[job_id] = (now, slot is not None)
+        if slot is None:
+            return
+        if not job_id:
+            with self._lock:
+                self._claimed.discard(slot.job_id)
+            return
+        try:
+            self.release_holder(slot)
+        except Exception as e:
+            # It exits when its hold runs out; the user's job waits for the slot until then
+            self.logger.warning(f"Could not release warm pool holder {slot.job_id}: {e}")
+        self._wake.set()
+
+    def observe(self, jobs: List[Dict]):
+        """Record the start time of tracked jobs a listing shows running with a display"""
+        if not self._starts:
+            return
+        now = time.monotonic()
+        for job in jobs:
+            job_id = str(job.get('job_id'))
+            if job.get('status') != 'RUN' or not (job.get('display') or job.get('port')):
+                continue
+            with self._lock:
+                start = self._starts.pop(job_id, None)
+            if start is not None:
+                metrics.session_start_seconds.observe(now - start[0], pooled='yes' if start[1] else 'no')
+
+
+def create_warm_pool(server_config: Dict, list_holders: Callable[[], List[PoolSlot]],
+                     submit_holder: Callable[[str, Dict, int], None],
+                     release_holder: Callable[[PoolSlot], None]) -> Optional[WarmPool]:
+    """
+    Return a WarmPool for the manager when 'warm_pool' is enabled in
+    server_config.json and has profiles, otherwise None
+    """
+    pool_config = server_config.get('warm_pool') or {}
+    if not pool_config.get('enabled', False) or not pool_config.get('profiles'):
+        return None
+    return WarmPool(pool_config['profiles'], list_holders, submit_holder, release_holder,
+                    size=int(pool_config.get('size', DEFAULT_SIZE)),
+                    refill_interval=float(pool_config.get('refill_interval', DEFAULT_REFILL_INTERVAL)),
+                    hold_minutes=int(pool_config.get('hold_minutes', DEFAULT_HOLD_MINUTES)))
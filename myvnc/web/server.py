@@ -27,6 +27,9 @@ import socket
 import logging
 import ssl
 import importlib
+import queue
+import threading
+import concurrent.futures
 
 # Import custom exceptions
 from myvnc.utils.lsf_manager import LSFError
@@ -40,8 +43,13 @@ from myvnc.utils.slurm_manager import SLURMManager, SLURMError
 from myvnc.utils.config_manager import ConfigManager
 from myvnc.utils.vnc_manager import VNCManager
 from myvnc.utils.db_manager import DatabaseManager
+from myvnc.utils.static_assets import get_static_assets
+from myvnc.utils.federation import get_federated_manager
+from myvnc.utils.job_feed import FeedUnavailable
+from myvnc.utils.tracing import tracer
+from myvnc.utils import metrics
 from myvnc.utils.log_manager import setup_logging, get_logger, get_current_log_file
-from myvnc.utils.config_loader import load_server_config, load_lsf_config, load_vnc_config, get_logger, get_scheduler_type
+from myvnc.utils.config_loader import load_server_config, load_lsf_config, load_vnc_config, get_logger, get_scheduler_type, get_config_manager
 
 def setup_logger():
     """Set up detailed logging configuration"""
@@ -107,6 +115,90 @@ def get_fully_qualified_hostname(host):
     # Return the original host if no FQDN could be determined
     return host
 
+# Seconds a worker waits for a client to complete the TLS handshake
+TLS_HANDSHAKE_TIMEOUT = 10
+
+# API paths whose handlers call the scheduler (bjobs/bsub/bkill or squeue/sbatch/scancel)
+SCHEDULER_PATH_PREFIXES = ('/api/vnc/',)
+
+# Served from the shared job feed, which refreshes at most once per interval for all clients
+SCHEDULER_EXEMPT_PATHS = ('/api/vnc/updates',)
+
+# Defaults for the 'job_updates' settings
+DEFAULT_UPDATE_STREAMS = 4
+DEFAULT_LONG_POLL_WAIT = 25
+DEFAULT_STREAM_KEEPALIVE = 25
+DEFAULT_STREAM_DURATION = 300
+
+# Milliseconds an EventSource waits before reconnecting to /api/vnc/updates
+STREAM_RETRY_MS = 3000
+
+# Seconds a job listing request waits for the scheduler unless 'scheduler_timeouts' says otherwise
+DEFAULT_LISTING_TIMEOUT = 30
+
+
+class SchedulerTimeout(Exception):
+    """A scheduler call did not finish before the request's deadline"""
+
+
+class UpdateWaiters:
+    """Count of /api/vnc/updates streams and long polls, each of which holds a worker thread"""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self.active = 0
+
+    def acquire(self, limit):
+        with self._lock:
+            if self.active >= limit:
+                return False
+            self.active += 1
+            return True
+
+    def release(self):
+        with self._lock:
+            self.active -= 1
+
+
+update_waiters = UpdateWaiters()
+
+
+class SchedulerLane:
+    """Caps the number of requests running scheduler commands at once
+    
+    A request past the cap waits for a slot, but only up to queue_limit
+    requests wait at a time and none longer than wait_timeout seconds; the
+    rest are turned away with a 503. This keeps slow scheduler calls from
+    occupying every worker, so static files and /api/server/status are still
+    served while bjobs (squeue) is stuck.
+    """
+    
+    def __init__(self, slots, queue_limit, wait_timeout):
+        self.slots = slots
+        self.queue_limit = queue_limit
+        self.wait_timeout = wait_timeout
+        self._semaphore = threading.BoundedSemaphore(slots)
+        self._lock = threading.Lock()
+        self._waiting = 0
+    
+    def acquire(self):
+        """Take a slot; returns False if the request should be turned away"""
+        if self._semaphore.acquire(blocking=False):
+            return True
+        with self._lock:
+            if self._waiting >= self.queue_limit:
+                return False
+            self._waiting += 1
+        try:
+            return self._semaphore.acquire(timeout=self.wait_timeout)
+        finally:
+            with self._lock:
+                self._waiting -= 1
+    
+    def release(self):
+        self._semaphore.release()
+
+
 class LoggingHTTPServer(http.server.HTTPServer):
     """HTTP Server that logs all requests"""
     
@@ -117,6 +209,66 @@ class LoggingHTTPServer(http.server.HTTPServer):
         self._ssl_cert_fingerprint = {}
         self._ssl_last_check = 0
         self._ssl_reload_interval = 3600
+        # Set by configure_workers(); without it requests are handled in serve_forever()'s thread
+        self._request_queue = None
+        self._workers = []
+        self.scheduler_lane = None
+    
+    def configure_workers(self, workers, scheduler_slots, scheduler_queue, scheduler_wait, backlog, update_streams=0):
+        """Hand accepted connections to a fixed pool of worker threads.
+        
+        serve_forever() then only accepts connections: each is queued for a
+        worker, or closed with a warning when backlog connections are already
+        waiting. Scheduler-bound requests are additionally limited by a
+        SchedulerLane, which together with the update_streams /api/vnc/updates
+        streams (outside the lane) must leave workers free for everything else.
+        """
+        if scheduler_slots + scheduler_queue + update_streams >= workers:
+            raise ValueError(f"http_server: scheduler_slots + scheduler_queue"
+                             f"{' + job_updates.max_streams' if update_streams else ''} "
+                             f"({scheduler_slots + scheduler_queue + update_streams}) must be less than workers ({workers})")
+        self.scheduler_lane = SchedulerLane(scheduler_slots, scheduler_queue, scheduler_wait)
+        self._request_queue = queue.Queue(maxsize=backlog)
+        metrics.worker_count.set(workers)
+        metrics.worker_queue_depth.set_function(self._request_queue.qsize)
+        metrics.scheduler_lane_waiting.set_function(lambda lane=self.scheduler_lane: lane._waiting)
+        for i in range(workers):
+            worker = threading.Thread(target=self._serve_queued_requests, name=f'http-worker-{i}', daemon=True)
+            worker.start()
+            self._workers.append(worker)
+        self.logger.info(
+            f"Serving requests with {workers} worker threads (scheduler requests: {scheduler_slots} running, "
+            f"{scheduler_queue} waiting up to {scheduler_wait}s; backlog {backlog})"
+        )
+    
+    def _serve_queued_requests(self):
+        """Worker thread: handle queued connections until server_close()"""
+        while True:
+            item = self._request_queue.get()
+            if item is None:
+                return
+            request, client_address = item
+            try:
+                if isinstance(request, ssl.SSLSocket):
+                    # Done here rather than in accept() so that a slow or
+                    # stalled client cannot hold up the accept loop
+                    try:
+                        request.settimeout(TLS_HANDSHAKE_TIMEOUT)
+                        request.do_handshake()
+                        request.settimeout(None)
+                    except OSError as e:
+                        self.logger.debug(f"TLS handshake with {client_address[0]}:{client_address[1]} failed: {e}")
+                        continue
+                self.finish_request(request, client_address)
+            except Exception:
+                self.handle_error(request, client_address)
+            finally:
+                self.shutdown_request(request)
+    
+    def wrap_ssl_socket(self, ctx, raw_socket):
+        """Wrap the listening socket; with workers, handshakes happen in the worker threads"""
+        return ctx.wrap_socket(raw_socket, server_side=True,
+                               do_handshake_on_connect=self._request_queue is None)
     
     def configure_ssl_reload(self, ssl_cert, ssl_key, ssl_ca_chain=None, reload_interval=3600):
         """Enable automatic SSL certificate reload when cert files change on disk.
@@ -183,7 +335,7 @@ class LoggingHTTPServer(http.server.HTTPServer):
         # then build a plain socket from the fd so we can re-wrap it.
         fd = self.socket.detach()
         raw_socket = socket.socket(fileno=fd)
-        self.socket = ctx.wrap_socket(raw_socket, server_side=True)
+        self.socket = self.wrap_ssl_socket(ctx, raw_socket)
         self._ssl_cert_fingerprint = self._get_cert_fingerprint()
         self.logger.info("SSL certificates reloaded successfully")
 
@@ -223,9 +375,27 @@ class LoggingHTTPServer(http.server.HTTPServer):
             self.logger.error(f"SSL reload check failed unexpectedly: {e}")
     
     def process_request(self, request, client_address):
-        """Log each incoming request"""
+        """Log each incoming request and queue it for a worker when workers are configured"""
         self.logger.debug(f"New connection from {client_address[0]}:{client_address[1]}")
-        super().process_request(request, client_address)
+        if self._request_queue is None:
+            super().process_request(request, client_address)
+            return
+        try:
+            self._request_queue.put_nowait((request, client_address))
+        except queue.Full:
+            metrics.http_dropped.inc()
+            self.logger.warning(f"All workers busy and {self._request_queue.maxsize} connections waiting; "
+                                f"dropping connection from {client_address[0]}:{client_address[1]}")
+            self.shutdown_request(request)
+    
+    def server_close(self):
+        """Stop the worker threads along with the listening socket"""
+        super().server_close()
+        for _ in self._workers:
+            try:
+                self._request_queue.put_nowait(None)
+            except queue.Full:
+                break
     
     def handle_error(self, request, client_address):
         """Log server errors"""
@@ -247,38 +417,146 @@ class LoggingHTTPServer(http.server.HTTPServer):
         self.logger.error(traceback.format_exc())
         super().handle_error(request, client_address)
 
-class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
-    """Handler for VNC manager CGI requests"""
+class SharedHandlerState:
+    """Managers built from one version of server_config.json, shared by all requests"""
     
-    def __init__(self, *args, **kwargs):
-        self.config_manager = ConfigManager()
-        self.scheduler_type = self.config_manager.get_scheduler_type()
-
-        if self.scheduler_type == 'slurm':
-            self.lsf_manager = SLURMManager()
-        else:
-            self.lsf_manager = LSFManager()
-
+    def __init__(self, server_config, previous=None):
+        self.server_config = server_config
+        tracer.configure(server_config)
         self.auth_manager = AuthManager()
         self.vnc_manager = VNCManager()
         
-        # Get data directory from configuration
-        server_config = load_server_config()
-        data_dir = server_config.get("datadir", "/localdev/myvnc/data")
-        
         # Initialize database manager with the correct data directory
-        self.db_manager = DatabaseManager(data_dir=data_dir)
+        data_dir = server_config.get("datadir", "/localdev/myvnc/data")
+        if previous is not None and previous.db_manager.data_dir == data_dir:
+            self.db_manager = previous.db_manager
+        else:
+            self.db_manager = DatabaseManager(data_dir=data_dir)
+
+
+_shared_state = None
+_shared_state_lock = threading.Lock()
+
+
+def get_shared_handler_state():
+    """
+    Return the SharedHandlerState for the current server_config.json
+    
+    load_server_config() only re-reads the file after it changed, so this is
+    a dict comparison per request; the managers are rebuilt when it differs.
+    """
+    global _shared_state
+    server_config = load_server_config()
+    state = _shared_state
+    if state is not None and state.server_config == server_config:
+        return state
+    with _shared_state_lock:
+        if _shared_state is None or _shared_state.server_config != server_config:
+            if _shared_state is not None:
+                get_logger().info("Server configuration changed, rebuilding shared request handler state")
+            _shared_state = SharedHandlerState(server_config, _shared_state)
+        return _shared_state
+
+
+class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
+    """Handler for VNC manager CGI requests"""
+    
+    def __init__(self, *args, **kwargs):
+        # Configuration and managers are shared between requests and only
+        # reloaded when the config files change
+        self.config_manager = get_config_manager()
+        state = get_shared_handler_state()
+        self.scheduler_type = state.server_config.get('scheduler', 'lsf').lower()
+
+        # With 'federation' enabled every cluster is served through one manager
+        self.lsf_manager = get_federated_manager(state.server_config)
+        if self.lsf_manager is None:
+            if self.scheduler_type == 'slurm':
+                self.lsf_manager = SLURMManager()
+            else:
+                self.lsf_manager = LSFManager()
+
+        self.auth_manager = state.auth_manager
+        self.vnc_manager = state.vnc_manager
+        self.db_manager = state.db_manager
         
         self.directory = os.path.join(os.path.dirname(__file__), "static")
         self.logger = get_logger()
         
-        # Load server configuration
-        self.server_config = load_server_config()
+        self.server_config = state.server_config
+        # ETags and precompressed copies of the static files, when enabled
+        self.static_assets = get_static_assets(self.server_config, self.directory)
         # Get authentication setting
         self.authentication_enabled = self.server_config.get("authentication", "")
         
         super().__init__(*args, **kwargs)
     
+    def handle_one_request(self):
+        """Handle one request, releasing its scheduler slot afterwards if it took one"""
+        self._scheduler_slot = None
+        self._request_kind = None
+        self._status = None
+        tracer.set_queue_wait(None)
+        try:
+            super().handle_one_request()
+        finally:
+            if self._scheduler_slot:
+                self._scheduler_slot.release()
+                self._scheduler_slot = None
+            if self._request_kind:
+                metrics.http_in_flight.dec(kind=self._request_kind)
+                status = f"{self._status // 100}xx" if self._status else 'none'
+                metrics.http_requests.inc(method=self.command, status=status)
+                self._request_kind = None
+    
+    def send_response_only(self, code, message=None):
+        """Send the status line, noting the status for the request metrics"""
+        self._status = code
+        super().send_response_only(code, message)
+    
+    def parse_request(self):
+        """Parse the request line and headers, then take a scheduler slot for scheduler-bound paths
+        
+        Static files and the other API endpoints never wait here. When the
+        server's SchedulerLane is full the request is answered with a 503
+        and never reaches do_GET/do_POST.
+        """
+        if not super().parse_request():
+            return False
+        lane = getattr(self.server, 'scheduler_lane', None)
+        path = urlparse(self.path).path
+        scheduler_bound = path.startswith(SCHEDULER_PATH_PREFIXES) and path not in SCHEDULER_EXEMPT_PATHS
+        if scheduler_bound:
+            self._request_kind = 'scheduler'
+        else:
+            # Update streams and long polls stay in flight for minutes by design
+            self._request_kind = 'updates' if path in SCHEDULER_EXEMPT_PATHS else 'other'
+        metrics.http_in_flight.inc(kind=self._request_kind)
+        if lane is None or not scheduler_bound:
+            return True
+        waited_from = time.perf_counter()
+        if lane.acquire():
+            self._scheduler_slot = lane
+            # Counted as the queue phase of the first scheduler command the request runs
+            tracer.set_queue_wait(time.perf_counter() - waited_from)
+            return True
+        
+        metrics.scheduler_lane_rejected.inc()
+        self.logger.warning(f"Scheduler requests at capacity ({lane.slots} running, {lane.queue_limit} waiting); "
+                            f"rejecting {self.command} {self.path} from {self.client_address[0]}")
+        body = json.dumps({'error': 'Server busy waiting on the scheduler, please retry shortly'}).encode('utf-8')
+        self.send_response(503)
+        self.send_header('Content-type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.send_header('Retry-After', '5')
+        self.end_headers()
+        try:
+            self.wfile.write(body)
+        except (BrokenPipeError, ConnectionResetError, ConnectionAbortedError):
+            pass
+        self.close_connection = True
+        return False
+    
     def is_auth_enabled(self):
         """Check if authentication is enabled and available"""
         auth_method = self.authentication_enabled.lower() if self.authentication_enabled else ""
@@ -352,6 +630,13 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.handle_server_status()
             return
         
+        # Command latency histograms and server health metrics for Prometheus
+        # and monitor_myvnc.py; like the status endpoint they carry no user
+        # data and are scraped without a session
+        if path == "/metrics":
+            self.handle_metrics()
+            return
+        
         # Allow access to login error page without authentication
         if path == "/login_error" or path == "/login_error.html":
             self.logger.info(f"Serving login error page")
@@ -445,6 +730,8 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.handle_vnc_sessions()
         elif path == "/api/vnc/list_all" or path == "/api/vnc/manager":
             self.handle_vnc_manager_mode()
+        elif path == "/api/vnc/updates":
+            self.handle_vnc_updates()
         elif path == "/api/lsf/config" or path == "/api/config/lsf":
             self.handle_lsf_config()
         elif path == "/api/config/vnc":
@@ -463,12 +750,19 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
         # Manager Overrides API endpoint
         elif path == "/api/manager/overrides":
             self.handle_manager_overrides()
+        # Session startup latency percentiles for managers
+        elif path == "/api/manager/startup_report":
+            self.handle_startup_report()
         # Debug mode endpoint for server config
         elif path == "/api/server/config":
             self.handle_server_config()
         else:
             # Try to serve static file
-            super().do_GET()
+            asset = self.static_assets.get(path) if self.static_assets else None
+            if asset:
+                self.send_asset(asset)
+            else:
+                super().do_GET()
     
     def do_DELETE(self):
         """Handle DELETE requests"""
@@ -546,6 +840,8 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.handle_vnc_stop()
         elif path == "/api/vnc/copy":
             self.handle_vnc_copy()
+        elif path == "/api/vnc/start_batch":
+            self.handle_vnc_start_batch()
         # New User Settings API endpoint
         elif path == "/api/user/settings":
             self.handle_user_settings()
@@ -558,13 +854,56 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
         else:
             self.send_error_response(f"Unknown endpoint: {path}", 404)
     
+    def send_asset(self, asset):
+        """Send a cached static file: 304 if the client has it, else the variant its Accept-Encoding prefers"""
+        conditional = self.command in ('GET', 'HEAD')
+        if conditional and asset.etag in [tag.strip() for tag in self.headers.get('If-None-Match', '').split(',')]:
+            self.send_response(304)
+            self.send_header('ETag', asset.etag)
+            self.send_header('Cache-Control', self.static_assets.cache_control(asset))
+            self.end_headers()
+            return
+        
+        encoding = self.static_assets.choose(asset, self.headers.get('Accept-Encoding'))
+        variant = asset.variants[encoding]
+        try:
+            f = open(variant.path, 'rb')
+        except OSError as e:
+            self.logger.error(f"Error opening static file {variant.path}: {str(e)}")
+            self.send_error(404)
+            return
+        with f:
+            self.send_response(200)
+            self.send_header('Content-Type', asset.content_type)
+            self.send_header('Content-Length', str(variant.size))
+            self.send_header('ETag', asset.etag)
+            self.send_header('Last-Modified', self.date_time_string(asset.mtime))
+            self.send_header('Cache-Control', self.static_assets.cache_control(asset))
+            if len(asset.variants) > 1:
+                self.send_header('Vary', 'Accept-Encoding')
+            if encoding != 'identity':
+                self.send_header('Content-Encoding', encoding)
+            self.end_headers()
+            if self.command == 'HEAD':
+                return
+            try:
+                self.connection.sendfile(f, count=variant.size)
+            except (BrokenPipeError, ConnectionResetError, ConnectionAbortedError) as e:
+                self.logger.info(f"Client disconnected while serving {asset.path}: {str(e)}")
+                self.close_connection = True
+    
     def serve_file(self, filename):
         """Serve a file from the static directory"""
+        asset = self.static_assets.get(filename) if self.static_assets else None
+        if asset:
+            self.logger.debug(f"Serving file: {filename}")
+            self.send_asset(asset)
+            return
         try:
             with open(os.path.join(self.directory, filename), 'rb') as f:
                 content = f.read()
             
-            self.logger.info(f"Serving file: {filename}")    
+            self.logger.debug(f"Serving file: {filename}")
             self.send_response(200)
             self.send_header('Content-type', 'text/html')
             self.end_headers()
@@ -963,16 +1302,21 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             authenticated_user = self.get_authenticated_user() if self.is_auth_enabled() else None
             self.logger.info(f"Handling VNC sessions request for user: {authenticated_user}")
             
-            # Get VNC sessions
+            # Get VNC sessions; the listing and the connection details share one deadline
+            deadline = self._listing_deadline()
             try:
                 self.logger.info("Calling get_active_vnc_jobs")
-                jobs = self.lsf_manager.get_active_vnc_jobs(authenticated_user)
+                jobs = self._wait_for_scheduler(self.lsf_manager.get_active_vnc_jobs, authenticated_user, deadline=deadline)
                 self.logger.info(f"Retrieved {len(jobs)} VNC sessions")
                 
                 # Log job details for debugging
                 for i, job in enumerate(jobs):
                     job_id = job.get('job_id', 'unknown')
                     self.logger.debug(f"Job {i+1}/{len(jobs)}: id={job_id}, status={job.get('status')}, host={job.get('host')}")
+            except SchedulerTimeout as e:
+                self.logger.error(f"Error getting VNC sessions: {str(e)}")
+                self.send_json_response({"error": f"Error getting VNC sessions: {str(e)}"}, status=504)
+                return
             except Exception as e:
                 self.logger.error(f"Error getting VNC sessions: {str(e)}")
                 self.logger.error(f"Exception type: {type(e).__name__}")
@@ -980,73 +1324,7 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
                 self.send_json_response({"error": f"Error getting VNC sessions: {str(e)}"}, status=500)
                 return
                 
-            # Analyze job permissions
-            user_jobs = []
-            for job in jobs:
-                # Process job information
-                try:
-                    if 'job_id' in job:
-                        job_id = job['job_id']
-                        self.logger.debug(f"Processing job {job_id} with resource requirements: {job.get('resource_req', 'None')}")
-                        
-                        # Log original resources for debugging
-                        self.logger.debug(f"Job {job_id} original resources - cores: {job.get('cores', 'None')}, num_cores: {job.get('num_cores', 'None')}, mem_gb: {job.get('mem_gb', 'None')}")
-                        
-                        # Map 'cores' to 'num_cores' for consistency with the frontend
-                        if 'cores' in job and 'num_cores' not in job:
-                            job['num_cores'] = job['cores']
-                            self.logger.debug(f"Job {job_id} - mapped cores to num_cores: {job['num_cores']}")
-                        
-                        # Map 'mem_gb' to 'memory_gb' for consistency with the frontend
-                        if 'mem_gb' in job and 'memory_gb' not in job:
-                            job['memory_gb'] = job['mem_gb']
-                            self.logger.debug(f"Job {job_id} - mapped mem_gb to memory_gb: {job['memory_gb']}")
-                        
-                        # Add default resource values if not present and resources_unknown is not True
-                        if 'resources_unknown' not in job or job['resources_unknown'] is not True:
-                            if 'num_cores' not in job:
-                                job['num_cores'] = 2  # Default value
-                                self.logger.debug(f"Job {job_id} - using default num_cores: {job['num_cores']}")
-                            if 'memory_gb' not in job:
-                                job['memory_gb'] = 16  # Default value
-                                self.logger.debug(f"Job {job_id} - using default memory_gb: {job['memory_gb']}")
-                        else:
-                            self.logger.debug(f"Job {job_id} - not applying default resources because resources_unknown is True")
-                        
-                        # Ensure runtime_display is set (for compatibility)
-                        if 'runtime' in job and 'runtime_display' not in job:
-                            job['runtime_display'] = job['runtime']
-                        
-                        # Add the name property if not present
-                        if 'name' not in job:
-                            job['name'] = 'VNC Session'
-                        
-                        # Ensure host is present
-                        if 'exec_host' not in job or not job['exec_host'] or job['exec_host'] == 'N/A':
-                            self.logger.warning(f"Job {job_id} has no exec_host specified")
-                        else:
-                            job['host'] = job['exec_host']  # Duplicate for backward compatibility
-
-                        # tmux: execution host is unknown until the job leaves PEND; do not expose SSH host yet.
-                        if job.get('session_type') == 'tmux' and job.get('status') == 'PEND':
-                            job['host'] = None
-                            job['exec_host'] = None
-                                                
-                        # Get connection details if needed
-                        if ('display' not in job or 'port' not in job) and job.get('host') and job.get('host') != 'N/A':
-                            conn_details = self.lsf_manager.get_vnc_connection_details(job_id, authenticated_user)
-                            if conn_details:
-                                if 'port' in conn_details and 'port' not in job:
-                                    job['port'] = conn_details['port']
-                                if 'display' in conn_details and 'display' not in job:
-                                    job['display'] = conn_details['display']
-                                    
-                        # Log final resources for debugging
-                        self.logger.debug(f"Job {job_id} final resources - num_cores: {job.get('num_cores', 'None')}, memory_gb: {job.get('memory_gb', 'None')}")
-                        self.logger.debug(f"Job {job_id} OS field: {job.get('os', 'NOT SET')}")
-                        user_jobs.append(job)
-                except Exception as e:
-                    self.logger.error(f"Error processing job {job.get('job_id', 'unknown')}: {str(e)}")
+            user_jobs = self._process_session_jobs(jobs, authenticated_user, deadline)
             
             self.logger.info(f"Sending {len(user_jobs)} processed jobs to client")
             # Log a sample job to see what's being sent
@@ -1058,6 +1336,171 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.logger.error(traceback.format_exc())
             self.send_json_response({"error": str(e)}, status=500)
     
+    def handle_vnc_updates(self):
+        """
+        Handle incremental VNC session updates (/api/vnc/updates?since=VERSION)
+        
+        Answers with the user's jobs added or changed since the version and
+        the ids of removed ones, or the full list with 'full' set when there
+        is no version or it is too old. With 'Accept: text/event-stream' the
+        changes are pushed as Server-Sent Events: a 'jobs' event per change,
+        whose id is the version so a reconnecting EventSource resumes from
+        Last-Event-ID. Otherwise the request is a long poll that returns as
+        soon as there are changes, or empty after 'wait' seconds.
+        """
+        feed = self.lsf_manager.job_feed
+        if feed is None:
+            self.send_json_response({"error": "Incremental job updates are not enabled"}, status=404)
+            return
+        
+        updates_config = self.server_config.get('job_updates') or {}
+        authenticated_user = self.get_authenticated_user() if self.is_auth_enabled() else None
+        # Same owner the session list filters the snapshot on
+        user = authenticated_user if authenticated_user else os.environ.get('USER', '')
+        query = parse_qs(urlparse(self.path).query)
+        since = query.get('since', [None])[0] or self.headers.get('Last-Event-ID')
+        try:
+            since = int(since) if since else None
+        except ValueError:
+            since = None
+        
+        def process(jobs):
+            # Rows are shared by all clients, so details are looked up as the snapshot's user
+            return self._process_session_jobs(jobs, self.lsf_manager.job_snapshot_user, self._listing_deadline())
+        
+        stream = 'text/event-stream' in self.headers.get('Accept', '')
+        max_wait = float(updates_config.get('long_poll_wait', DEFAULT_LONG_POLL_WAIT))
+        try:
+            wait = min(max(float(query.get('wait', [max_wait])[0]), 0), max_wait)
+        except ValueError:
+            wait = max_wait
+        
+        # A delta fetch that does not wait gives its worker back at once and takes no waiter slot
+        waiting = stream or wait > 0
+        if waiting and not update_waiters.acquire(int(updates_config.get('max_streams', DEFAULT_UPDATE_STREAMS))):
+            # The client falls back to polling for deltas with wait=0
+            self.logger.warning(f"Too many job update waiters ({update_waiters.active}); rejecting {self.client_address[0]}")
+            self.send_response(503)
+            self.send_header('Content-Type', 'application/json')
+            self.send_header('Retry-After', '30')
+            self.end_headers()
+            self.wfile.write(json.dumps({"error": "Too many update streams, poll with wait=0 instead"}).encode())
+            return
+        
+        try:
+            if stream:
+                self._stream_vnc_updates(feed, since, user, process, updates_config)
+                return
+            self.send_json_response(feed.wait(since, wait, process, user))
+        except FeedUnavailable as e:
+            self.logger.error(f"Error getting VNC session updates: {str(e)}")
+            self.send_json_response({"error": str(e)}, status=503)
+        finally:
+            if waiting:
+                update_waiters.release()
+    
+    def _stream_vnc_updates(self, feed, since, user, process, updates_config):
+        """Push job feed changes as Server-Sent Events until the client goes away or stream_duration passes"""
+        keepalive = float(updates_config.get('keepalive', DEFAULT_STREAM_KEEPALIVE))
+        ends_at = time.monotonic() + float(updates_config.get('stream_duration', DEFAULT_STREAM_DURATION))
+        
+        self.send_response(200)
+        self.send_header('Content-Type', 'text/event-stream')
+        self.send_header('Cache-Control', 'no-cache')
+        # Stop reverse proxies from buffering the stream
+        self.send_header('X-Accel-Buffering', 'no')
+        self.end_headers()
+        self.close_connection = True
+        
+        try:
+            self.wfile.write(f"retry: {STREAM_RETRY_MS}\n\n".encode())
+            while True:
+                remaining = ends_at - time.monotonic()
+                if remaining <= 0:
+                    # Ending the response makes the EventSource reconnect with Last-Event-ID
+                    return
+                try:
+                    update = feed.wait(since, min(keepalive, remaining), process, user)
+                except FeedUnavailable as e:
+                    self.wfile.write(f"event: unavailable\ndata: {json.dumps({'error': str(e)})}\n\n".encode())
+                    return
+                if update['full'] or update['jobs'] or update['removed']:
+                    self.wfile.write(f"id: {update['version']}\nevent: jobs\ndata: {json.dumps(update)}\n\n".encode())
+                else:
+                    self.wfile.write(b": keepalive\n\n")
+                # Nothing changed for this user up to this version either way
+                since = update['version']
+        except (BrokenPipeError, ConnectionResetError, ConnectionAbortedError, socket.timeout):
+            self.logger.debug(f"Job update stream to {self.client_address[0]} closed by the client")
+    
+    def _process_session_jobs(self, jobs, authenticated_user, deadline=None):
+        """Turn the user's jobs into the session list rows the UI shows, with connection details"""
+        user_jobs = []
+        needs_details = []
+        for job in jobs:
+            # Process job information
+            try:
+                if 'job_id' in job:
+                    job_id = job['job_id']
+                    self.logger.debug(f"Processing job {job_id} with resource requirements: {job.get('resource_req', 'None')}")
+                    
+                    # Log original resources for debugging
+                    self.logger.debug(f"Job {job_id} original resources - cores: {job.get('cores', 'None')}, num_cores: {job.get('num_cores', 'None')}, mem_gb: {job.get('mem_gb', 'None')}")
+                    
+                    # Map 'cores' to 'num_cores' for consistency with the frontend
+                    if 'cores' in job and 'num_cores' not in job:
+                        job['num_cores'] = job['cores']
+                        self.logger.debug(f"Job {job_id} - mapped cores to num_cores: {job['num_cores']}")
+                    
+                    # Map 'mem_gb' to 'memory_gb' for consistency with the frontend
+                    if 'mem_gb' in job and 'memory_gb' not in job:
+                        job['memory_gb'] = job['mem_gb']
+                        self.logger.debug(f"Job {job_id} - mapped mem_gb to memory_gb: {job['memory_gb']}")
+                    
+                    # Add default resource values if not present and resources_unknown is not True
+                    if 'resources_unknown' not in job or job['resources_unknown'] is not True:
+                        if 'num_cores' not in job:
+                            job['num_cores'] = 2  # Default value
+                            self.logger.debug(f"Job {job_id} - using default num_cores: {job['num_cores']}")
+                        if 'memory_gb' not in job:
+                            job['memory_gb'] = 16  # Default value
+                            self.logger.debug(f"Job {job_id} - using default memory_gb: {job['memory_gb']}")
+                    else:
+                        self.logger.debug(f"Job {job_id} - not applying default resources because resources_unknown is True")
+                    
+                    # Ensure runtime_display is set (for compatibility)
+                    if 'runtime' in job and 'runtime_display' not in job:
+                        job['runtime_display'] = job['runtime']
+                    
+                    # Add the name property if not present
+                    if 'name' not in job:
+                        job['name'] = 'VNC Session'
+                    
+                    # Ensure host is present
+                    if 'exec_host' not in job or not job['exec_host'] or job['exec_host'] == 'N/A':
+                        self.logger.warning(f"Job {job_id} has no exec_host specified")
+                    else:
+                        job['host'] = job['exec_host']  # Duplicate for backward compatibility
+
+                    # tmux: execution host is unknown until the job leaves PEND; do not expose SSH host yet.
+                    if job.get('session_type') == 'tmux' and job.get('status') == 'PEND':
+                        job['host'] = None
+                        job['exec_host'] = None
+                                            
+                    # Get connection details if needed (looked up for all jobs at once below)
+                    if ('display' not in job or 'port' not in job) and job.get('host') and job.get('host') != 'N/A':
+                        needs_details.append(job)
+                                
+                    # Log final resources for debugging
+                    self.logger.debug(f"Job {job_id} final resources - num_cores: {job.get('num_cores', 'None')}, memory_gb: {job.get('memory_gb', 'None')}")
+                    self.logger.debug(f"Job {job_id} OS field: {job.get('os', 'NOT SET')}")
+                    user_jobs.append(job)
+            except Exception as e:
+                self.logger.error(f"Error processing job {job.get('job_id', 'unknown')}: {str(e)}")
+        
+        self._fill_connection_details(needs_details, authenticated_user, deadline)
+        return user_jobs
+    
     def handle_lsf_config(self):
         """Handle scheduler configuration request (LSF or SLURM)"""
         try:
@@ -1536,6 +1979,90 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.logger.error(f"Error handling VNC config request: {str(e)}")
             self.send_error_response(str(e))
 
+    def _session_start_settings(self, data, session_type):
+        """Build the session and scheduler settings of a start request from its data and the configured defaults
+        
+        Returns:
+            (session_settings, lsf_settings)
+        """
+        # Get default settings from config
+        vnc_defaults = self.config_manager.get_vnc_defaults()
+        lsf_defaults = self.config_manager.get_scheduler_defaults()
+        
+        # Extract session settings based on type
+        if session_type == "tmux":
+            # For tmux, we don't need VNC-specific settings
+            session_settings = {
+                "name": data.get("name", "tmux_session"),
+                "site": data.get("site", vnc_defaults.get("site"))
+            }
+        else:
+            # For VNC, extract all VNC-specific settings
+            session_settings = {
+                "resolution": data.get("resolution", vnc_defaults.get("resolution")),
+                "window_manager": data.get("window_manager", vnc_defaults.get("window_manager")),
+                "color_depth": vnc_defaults.get("color_depth", 24),
+                "site": data.get("site", vnc_defaults.get("site")),
+                "vncserver_path": vnc_defaults.get("vncserver_path", "/usr/bin/vncserver"),
+                "vncserver_wrapper_path": vnc_defaults.get("vncserver_wrapper_path"),
+                "name": data.get("name", vnc_defaults.get("name_prefix", "vnc_session")),
+                "xstartup_path": vnc_defaults.get("xstartup_path", ""),
+                "use_custom_xstartup": vnc_defaults.get("use_custom_xstartup", False)
+            }
+        
+        # Extract scheduler settings from request (works for both LSF and SLURM)
+        lsf_settings = {
+            "queue": data.get("queue", lsf_defaults.get("queue")),
+            "partition": data.get("queue", lsf_defaults.get("queue", lsf_defaults.get("partition"))),
+            "num_cores": int(data.get("num_cores", lsf_defaults.get("num_cores", 2))),
+            "cpus_per_task": int(data.get("num_cores", lsf_defaults.get("num_cores", lsf_defaults.get("cpus_per_task", 2)))),
+            "memory_gb": int(data.get("memory_gb", lsf_defaults.get("memory_gb"))),
+            "job_name": lsf_defaults.get("job_name", "myvnc_vncserver"),
+            "memlimit_multiplier": lsf_defaults.get("memlimit_multiplier", 1.0)
+        }
+        
+        # A federated server submits to the cluster asked for, or else to the least loaded one
+        if data.get("cluster"):
+            lsf_settings["cluster"] = data.get("cluster")
+        
+        # Add host filter if provided
+        host_filter = data.get("host_filter", "").strip()
+        if host_filter:
+            lsf_settings["host_filter"] = host_filter
+            lsf_settings["nodelist"] = host_filter
+            self.logger.info(f"Using host filter: {host_filter}")
+        
+        # Convert OS name to os_select/constraint and get container path if applicable
+        os_name = data.get("os", lsf_defaults.get("os", "Any"))
+        if self.scheduler_type == 'slurm':
+            os_config = self.config_manager.get_slurm_os_config_by_name(os_name)
+            if os_config:
+                lsf_settings["constraint"] = os_config.get("constraint", "")
+                if "container" in os_config:
+                    lsf_settings["container"] = os_config.get("container")
+                    self.logger.info(f"Using container for OS '{os_name}': {os_config.get('container')}")
+                if "bindpaths" in os_config:
+                    lsf_settings["bindpaths"] = os_config.get("bindpaths")
+                    self.logger.info(f"Using bindpaths for OS '{os_name}': {os_config.get('bindpaths')}")
+            else:
+                self.logger.warning(f"OS '{os_name}' not found in SLURM configuration, using default")
+                lsf_settings["constraint"] = ""
+        else:
+            os_config = self.config_manager.get_os_config_by_name(os_name)
+            if os_config:
+                lsf_settings["os_select"] = os_config.get("select", "any")
+                if "container" in os_config:
+                    lsf_settings["container"] = os_config.get("container")
+                    self.logger.info(f"Using container for OS '{os_name}': {os_config.get('container')}")
+                if "bindpaths" in os_config:
+                    lsf_settings["bindpaths"] = os_config.get("bindpaths")
+                    self.logger.info(f"Using bindpaths for OS '{os_name}': {os_config.get('bindpaths')}")
+            else:
+                self.logger.warning(f"OS '{os_name}' not found in configuration, using default")
+                lsf_settings["os_select"] = "any"
+        
+        return session_settings, lsf_settings
+    
     def handle_vnc_start(self):
         """Handle VNC/tmux session start request"""
         try:
@@ -1551,77 +2078,7 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             # Log all incoming data for debugging
             self.logger.info(f"Session start request data: {json.dumps(data)}")
             
-            # Get default settings from config
-            vnc_defaults = self.config_manager.get_vnc_defaults()
-            lsf_defaults = self.config_manager.get_scheduler_defaults()
-            
-            # Extract session settings based on type
-            if session_type == "tmux":
-                # For tmux, we don't need VNC-specific settings
-                session_settings = {
-                    "name": data.get("name", "tmux_session"),
-                    "site": data.get("site", vnc_defaults.get("site"))
-                }
-            else:
-                # For VNC, extract all VNC-specific settings
-                session_settings = {
-                    "resolution": data.get("resolution", vnc_defaults.get("resolution")),
-                    "window_manager": data.get("window_manager", vnc_defaults.get("window_manager")),
-                    "color_depth": vnc_defaults.get("color_depth", 24),
-                    "site": data.get("site", vnc_defaults.get("site")),
-                    "vncserver_path": vnc_defaults.get("vncserver_path", "/usr/bin/vncserver"),
-                    "vncserver_wrapper_path": vnc_defaults.get("vncserver_wrapper_path"),
-                    "name": data.get("name", vnc_defaults.get("name_prefix", "vnc_session")),
-                    "xstartup_path": vnc_defaults.get("xstartup_path", ""),
-                    "use_custom_xstartup": vnc_defaults.get("use_custom_xstartup", False)
-                }
-            
-            # Extract scheduler settings from request (works for both LSF and SLURM)
-            lsf_settings = {
-                "queue": data.get("queue", lsf_defaults.get("queue")),
-                "partition": data.get("queue", lsf_defaults.get("queue", lsf_defaults.get("partition"))),
-                "num_cores": int(data.get("num_cores", lsf_defaults.get("num_cores", 2))),
-                "cpus_per_task": int(data.get("num_cores", lsf_defaults.get("num_cores", lsf_defaults.get("cpus_per_task", 2)))),
-                "memory_gb": int(data.get("memory_gb", lsf_defaults.get("memory_gb"))),
-                "job_name": lsf_defaults.get("job_name", "myvnc_vncserver"),
-                "memlimit_multiplier": lsf_defaults.get("memlimit_multiplier", 1.0)
-            }
-            
-            # Add host filter if provided
-            host_filter = data.get("host_filter", "").strip()
-            if host_filter:
-                lsf_settings["host_filter"] = host_filter
-                lsf_settings["nodelist"] = host_filter
-                self.logger.info(f"Using host filter: {host_filter}")
-            
-            # Convert OS name to os_select/constraint and get container path if applicable
-            os_name = data.get("os", lsf_defaults.get("os", "Any"))
-            if self.scheduler_type == 'slurm':
-                os_config = self.config_manager.get_slurm_os_config_by_name(os_name)
-                if os_config:
-                    lsf_settings["constraint"] = os_config.get("constraint", "")
-                    if "container" in os_config:
-                        lsf_settings["container"] = os_config.get("container")
-                        self.logger.info(f"Using container for OS '{os_name}': {os_config.get('container')}")
-                    if "bindpaths" in os_config:
-                        lsf_settings["bindpaths"] = os_config.get("bindpaths")
-                        self.logger.info(f"Using bindpaths for OS '{os_name}': {os_config.get('bindpaths')}")
-                else:
-                    self.logger.warning(f"OS '{os_name}' not found in SLURM configuration, using default")
-                    lsf_settings["constraint"] = ""
-            else:
-                os_config = self.config_manager.get_os_config_by_name(os_name)
-                if os_config:
-                    lsf_settings["os_select"] = os_config.get("select", "any")
-                    if "container" in os_config:
-                        lsf_settings["container"] = os_config.get("container")
-                        self.logger.info(f"Using container for OS '{os_name}': {os_config.get('container')}")
-                    if "bindpaths" in os_config:
-                        lsf_settings["bindpaths"] = os_config.get("bindpaths")
-                        self.logger.info(f"Using bindpaths for OS '{os_name}': {os_config.get('bindpaths')}")
-                else:
-                    self.logger.warning(f"OS '{os_name}' not found in configuration, using default")
-                    lsf_settings["os_select"] = "any"
+            session_settings, lsf_settings = self._session_start_settings(data, session_type)
             
             # Log the settings that will be used
             self.logger.info(f"Using session settings: {json.dumps(session_settings)}")
@@ -1679,6 +2136,55 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
                 "message": error_msg
             }, 500)
     
+    def handle_vnc_start_batch(self):
+        """Handle a manager's request to start the same VNC/tmux session for several users"""
+        if self.is_auth_enabled():
+            is_authenticated, message, session = self.check_auth()
+            if not is_authenticated:
+                self.send_error_response("Authentication required", 401)
+                return
+            manager_username = session.get("username", "unknown")
+        else:
+            # If authentication is disabled, use system username
+            manager_username = os.environ.get("USER", "unknown")
+        
+        # Verify manager permission
+        managers = self.server_config.get('managers', [])
+        if manager_username not in managers:
+            self.logger.warning(f"Unauthorized batch session start by user {manager_username}")
+            self.send_error_response("Forbidden: Manager access required", 403)
+            return
+        
+        try:
+            content_length = int(self.headers.get("Content-Length", 0))
+            data = json.loads(self.rfile.read(content_length).decode("utf-8"))
+            
+            users = [user.strip() for user in data.get("users", []) if isinstance(user, str) and user.strip()]
+            if not users:
+                raise ValueError("No users provided")
+            session_type = data.get("session_type", "vnc")
+            self.logger.info(f"Manager {manager_username} starting {session_type} sessions for: {', '.join(users)}")
+            
+            session_settings, lsf_settings = self._session_start_settings(data, session_type)
+            login_hostname = self.server_config.get("login_host") or self.server_config.get("host", "localhost")
+            
+            # The sessions are submitted as their users; the manager only picks the settings
+            results = self.lsf_manager.submit_jobs(session_type, session_settings, lsf_settings, users,
+                                                   server_hostname=login_hostname)
+            failed = sum(1 for result in results.values() if 'error' in result)
+            self.send_json_response({
+                "success": failed == 0,
+                "message": f"Started {len(results) - failed} of {len(results)} {session_type} sessions",
+                "results": results
+            })
+        except Exception as e:
+            error_msg = f"Error starting sessions: {str(e)}"
+            self.logger.error(error_msg)
+            self.send_json_response({
+                "success": False,
+                "message": error_msg
+            }, 500)
+    
     def handle_vnc_stop(self):
         """Handle VNC stop request"""
         try:
@@ -1815,6 +2321,9 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
                 "job_name": lsf_defaults.get("job_name", "myvnc_vncserver"),
                 "memlimit_multiplier": lsf_defaults.get("memlimit_multiplier", 1.0)
             }
+            # A federated copy runs on the original's cluster
+            if session_to_copy.get("cluster"):
+                lsf_settings["cluster"] = session_to_copy["cluster"]
             
             # Submit new VNC job with the authenticated user
             job_id = self.lsf_manager.submit_vnc_job(vnc_settings, lsf_settings, authenticated_user)
@@ -1982,6 +2491,41 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
         elif self.command == "DELETE":
             self.handle_delete_manager_override()
     
+    def handle_startup_report(self):
+        """Handle GET request for session startup percentiles (?days=7&by=queue)"""
+        if self.is_auth_enabled():
+            is_authenticated, message, session = self.check_auth()
+            if not is_authenticated:
+                self.send_error_response("Authentication required", 401)
+                return
+            manager_username = session.get("username", "unknown")
+        else:
+            manager_username = os.environ.get("USER", "unknown")
+        if manager_username not in self.server_config.get('managers', []):
+            self.logger.warning(f"Unauthorized access to startup report by user {manager_username}")
+            self.send_error_response("Forbidden: Manager access required", 403)
+            return
+        
+        timeline = getattr(self.lsf_manager, 'session_timeline', None)
+        if timeline is None:
+            self.send_error_response("Session timeline is not enabled in server_config.json", 404)
+            return
+        
+        query_params = parse_qs(urlparse(self.path).query)
+        try:
+            days = float(query_params.get('days', ['7'])[0])
+            group_by = query_params.get('by', [None])[0] or None
+            report = timeline.report(time.time() - days * 86400, group_by)
+        except ValueError as e:
+            self.send_error_response(f"Invalid startup report request: {e}", 400)
+            return
+        except Exception as e:
+            self.logger.error(f"Error building startup report: {e}")
+            self.send_error_response(f"Error building startup report: {e}", 500)
+            return
+        report['days'] = days
+        self.send_json_response(report)
+    
     def handle_get_manager_overrides(self):
         """Handle GET request for all manager overrides"""
         try:
@@ -2425,6 +2969,20 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.logger.error(f"Error handling server status request: {str(e)}")
             self.send_error_response(f"Error getting server status: {str(e)}", 500)
 
+    def handle_metrics(self):
+        """Serve the command latency histograms and server metrics in the Prometheus text format"""
+        try:
+            body = (tracer.render_prometheus() + metrics.registry.render()).encode('utf-8')
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/plain; version=0.0.4; charset=utf-8')
+            self.send_header('Content-Length', str(len(body)))
+            self.send_header('Cache-Control', 'no-cache, no-store, must-revalidate')
+            self.end_headers()
+            self.wfile.write(body)
+        except Exception as e:
+            self.logger.error(f"Error handling metrics request: {str(e)}")
+            self.send_error_response(f"Error getting metrics: {str(e)}", 500)
+
     def get_authenticated_user(self):
         """Get the authenticated username from the session"""
         auth_enabled = self.is_auth_enabled()
@@ -2437,14 +2995,62 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
         
         return None
 
-    def _process_vnc_jobs(self, jobs, authenticated_user):
+    def _listing_deadline(self):
+        """time.monotonic() deadline for the scheduler calls of a job listing request, or None"""
+        timeout = float((self.server_config.get('scheduler_timeouts') or {}).get('listing', DEFAULT_LISTING_TIMEOUT))
+        return time.monotonic() + timeout if timeout > 0 else None
+
+    def _wait_for_scheduler(self, fn, *args, deadline=None, **kwargs):
+        """
+        Run a scheduler manager call in the background and wait for it until deadline
+        
+        Raises:
+            SchedulerTimeout: If the call did not finish in time; the scheduler
+                commands it started are stopped at the deadline
+        """
+        future = self.lsf_manager.call_async(fn, *args, deadline=deadline, **kwargs)
+        timeout = None if deadline is None else max(0, deadline - time.monotonic())
+        try:
+            result = future.result(timeout=timeout)
+        except concurrent.futures.TimeoutError:
+            raise SchedulerTimeout("Timed out waiting for the scheduler")
+        if deadline is not None and time.monotonic() >= deadline:
+            # Finished only because its commands were cut off, so the result is likely incomplete
+            raise SchedulerTimeout("Scheduler commands were stopped at the request deadline")
+        return result
+
+    def _fill_connection_details(self, jobs, authenticated_user, deadline=None):
+        """
+        Fill in missing port/display for jobs with one batched connection-details lookup.
+        
+        Jobs are sent without them if the lookup does not finish by deadline.
+        """
+        if not jobs:
+            return
+        try:
+            details = self._wait_for_scheduler(self.lsf_manager.get_vnc_connection_details_many,
+                                               [job['job_id'] for job in jobs], authenticated_user, deadline=deadline)
+        except SchedulerTimeout as e:
+            self.logger.warning(f"Sending {len(jobs)} jobs without connection details: {str(e)}")
+            return
+        except Exception as e:
+            self.logger.error(f"Error getting connection details: {str(e)}")
+            return
+        for job in jobs:
+            conn_details = details.get(job['job_id'])
+            if conn_details:
+                if 'port' in conn_details and 'port' not in job:
+                    job['port'] = conn_details['port']
+                if 'display' in conn_details and 'display' not in job:
+                    job['display'] = conn_details['display']
+
+    def _process_vnc_jobs(self, jobs, authenticated_user, deadline=None):
         """Internal helper to process job dictionaries to the format expected by UI."""
         user_jobs = []
+        needs_details = []
         for job in jobs:
             try:
                 if 'job_id' in job:
-                    job_id = job['job_id']
-
                     # Map cores/memory for consistency
                     if 'cores' in job and 'num_cores' not in job:
                         job['num_cores'] = job['cores']
@@ -2467,17 +3073,15 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
                     if 'exec_host' in job and job.get('exec_host') and job.get('exec_host') != 'N/A':
                         job['host'] = job['exec_host']
 
-                    # Get connection details if missing
+                    # Get connection details if missing (looked up for all jobs at once below)
                     if ('display' not in job or 'port' not in job) and job.get('host') and job.get('host') != 'N/A':
-                        conn_details = self.lsf_manager.get_vnc_connection_details(job_id, authenticated_user)
-                        if conn_details:
-                            job.setdefault('port', conn_details.get('port'))
-                            job.setdefault('display', conn_details.get('display'))
+                        needs_details.append(job)
 
                     user_jobs.append(job)
             except Exception as e:
                 self.logger.error(f"Error processing job {job.get('job_id', 'unknown')}: {str(e)}")
 
+        self._fill_connection_details(needs_details, authenticated_user, deadline)
         return user_jobs
 
     def handle_vnc_manager_mode(self):
@@ -2495,11 +3099,16 @@ class VNCRequestHandler(http.server.CGIHTTPRequestHandler):
             self.logger.info(f"Manager mode request by {authenticated_user}")
 
             # Get all jobs (no user filter) but run under the requesting user's credentials
-            jobs = self.lsf_manager.get_active_vnc_jobs(authenticated_user=authenticated_user, all_users=True)
+            deadline = self._listing_deadline()
+            jobs = self._wait_for_scheduler(self.lsf_manager.get_active_vnc_jobs, authenticated_user=authenticated_user,
+                                            all_users=True, deadline=deadline)
 
-            processed_jobs = self._process_vnc_jobs(jobs, authenticated_user)
+            processed_jobs = self._process_vnc_jobs(jobs, authenticated_user, deadline)
 
             self.send_json_response(processed_jobs)
+        except SchedulerTimeout as e:
+            self.logger.error(f"Error handling manager mode VNC sessions: {str(e)}")
+            self.send_json_response({"error": str(e)}, status=504)
         except Exception as e:
             self.logger.error(f"Error handling manager mode VNC sessions: {str(e)}")
             self.logger.error(traceback.format_exc())
@@ -2729,6 +3338,32 @@ def run_server(host=None, port=None, directory=None, config=None):
             httpd.timeout = config["timeout"]
             logger.info(f"Server timeout set to {config['timeout']} seconds")
         
+        # Serve requests concurrently from a bounded worker pool if configured
+        http_server_config = config.get("http_server") or {}
+        if http_server_config.get("workers", 0) > 0:
+            workers = int(http_server_config["workers"])
+            if http_server_config.get("request_timeout"):
+                # Per-connection socket timeout, so idle or slow clients give their worker back
+                VNCRequestHandler.timeout = float(http_server_config["request_timeout"])
+            # Create the scheduler manager (or the federated clusters' managers)
+            # up front so its one-time setup does not run in several workers at once
+            if get_federated_manager(config) is None:
+                if get_scheduler_type() == 'slurm':
+                    SLURMManager()
+                else:
+                    LSFManager()
+            # Update streams hold a worker each, outside the scheduler lane
+            updates_config = config.get("job_updates") or {}
+            httpd.configure_workers(
+                workers=workers,
+                scheduler_slots=int(http_server_config.get("scheduler_slots", max(1, workers // 4))),
+                scheduler_queue=int(http_server_config.get("scheduler_queue", max(1, workers // 4))),
+                scheduler_wait=float(http_server_config.get("scheduler_wait", 30)),
+                backlog=int(http_server_config.get("backlog", workers * 4)),
+                update_streams=(int(updates_config.get("max_streams", DEFAULT_UPDATE_STREAMS))
+                                if updates_config.get("enabled", False) else 0),
+            )
+        
         # Wrap the socket with SSL if HTTPS is enabled
         if use_https:
             # Verify cert files are readable before attempting to load them
@@ -2794,7 +3429,7 @@ def run_server(host=None, port=None, directory=None, config=None):
             ssl_context.verify_mode = ssl.CERT_NONE  # Don't verify client certificates
             
             # Wrap the socket with SSL
-            httpd.socket = ssl_context.wrap_socket(httpd.socket, server_side=True)
+            httpd.socket = httpd.wrap_ssl_socket(ssl_context, httpd.socket)
             
             # Enable automatic cert reload so renewed certs are picked up without restart
             ssl_reload_interval = config.get("ssl_reload_interval", 3600)
@@ -232,9 +232,17 @@ async function initializeApplication() {
         // Register interval to periodically refresh lists
         console.log('Setting up periodic refresh interval');
         setInterval(() => {
-            refreshVNCList();
+            // Not needed while session updates are pushed; only changes are polled for otherwise
+            if (vncDeltaPolling) {
+                pollVNCUpdates().then(ok => {
+                    vncDeltaPolling = ok;
+                });
+            } else if (!vncUpdates) {
+                refreshVNCList();
+            }
             // Note: Manager Mode auto-refresh disabled to preserve filter state
         }, 30000);
+        startVNCUpdates();
         
         console.log('==== APPLICATION INITIALIZATION COMPLETE ====');
     } catch (error) {
@@ -1285,120 +1293,7 @@ async function refreshVNCList(withRetries = false) {
         // The table already has a loading indicator from HTML
         const jobs = await apiRequest('vnc/list');
         
-        // Always clear table (removes loading indicator too)
-        vncTableBody.innerHTML = '';
-        
-        if (jobs.length === 0) {
-            noVNCMessage.style.display = 'block';
-            document.querySelector('.table-container').style.display = 'none';
-            return;
-        }
-        
-        noVNCMessage.style.display = 'none';
-        document.querySelector('.table-container').style.display = 'block';
-        
-        // Populate table
-        jobs.forEach(job => {
-            const row = document.createElement('tr');
-            
-            // Status badge class based on status
-            let statusClass = 'status-pending';
-            if (job.status === 'DONE') statusClass = 'status-done';
-            if (job.status === 'RUN') statusClass = 'status-running';
-            if (job.status === 'EXIT') statusClass = 'status-error';
-            
-            // Connection information (display port if available)
-            const connectionInfo = job.port ? 
-                `${job.host}:${job.port}` : 
-                (job.host || 'N/A');
-            
-            // Format runtime for display
-            const formattedRuntime = formatRuntime(job.runtime_display || job.runtime || 'N/A');
-            
-            // Determine if this is a tmux session
-            const isTmux = job.session_type === 'tmux';
-            const connectReady = isTmux
-                ? isConnectHostReady(job.host)
-                : (isConnectHostReady(job.host) &&
-                    job.port != null &&
-                    job.port !== '');
-            const connectDisabledAttr = connectReady ? '' : ' disabled';
-            const connectTitle = isTmux
-                ? (connectReady
-                    ? 'tmux connection instructions'
-                    : 'Host not available yet — connection details unavailable')
-                : (connectReady
-                    ? 'VNC connection instructions'
-                    : 'Host and port required — connection details unavailable');
-            
-            // Create cells
-            row.innerHTML = `
-                <td>${job.job_id}</td>
-                <td>${job.name === "VNC Session" ? "" : job.name}</td>
-                <td>${job.user}</td>
-                <td>${job.status === "RUN" ? 
-                    `<span class="status-badge ${statusClass}">${job.status}</span>` : 
-                    `<span class="status-badge ${statusClass}">${job.status}</span>`}
-                </td>
-                <td>${job.session_type || 'Unknown'}</td>
-                <td>${job.queue}</td>
-                <td>${job.resources_unknown ? 'Unknown' : `${job.num_cores || '-'} cores, ${job.memory_gb || '-'} GB`}</td>
-                <td>${job.os || 'N/A'}</td>
-                <td title="${isTmux ? 'Host: ' + (job.host || 'N/A') : 'VNC Connection: ' + connectionInfo}">${job.host || 'N/A'}</td>
-                <td>${isTmux ? 'N/A' : (job.port != null ? ':' + job.port : 'N/A')}</td>
-                <td>${formattedRuntime}</td>
-                <td class="actions-cell">
-                    ${isTmux ? `
-                        <button class="button secondary tmux-connect-button" data-job-id="${job.job_id}" title="${connectTitle}"${connectDisabledAttr}>
-                            <i class="fas fa-terminal"></i> Connect
-                        </button>
-                    ` : `
-                        <button class="button secondary vnc-viewer-button" data-job-id="${job.job_id}" title="${connectTitle}"${connectDisabledAttr}>
-                            <i class="fas fa-desktop"></i> Connect
-                        </button>
-                    `}
-                    <button class="button danger kill-button" data-job-id="${job.job_id}" title="Kill ${isTmux ? 'tmux' : 'VNC'} Session">
-                        <i class="fas fa-times"></i> Kill
-                    </button>
-                </td>
-            `;
-            
-            // Add to table
-            vncTableBody.appendChild(row);
-        });
-        
-        // Ensure sorting functionality attached (re-attaching safe)
-        enableTableSorting('vnc-table');
-        
-        // Add event listeners to buttons
-        document.querySelectorAll('.kill-button').forEach(button => {
-            button.addEventListener('click', () => {
-                const jobId = button.getAttribute('data-job-id');
-                killVNCSession(jobId);
-            });
-        });
-        
-        document.querySelectorAll('.vnc-viewer-button').forEach(button => {
-            button.addEventListener('click', () => {
-                const jobId = button.getAttribute('data-job-id');
-                // Find job info
-                const job = jobs.find(j => j.job_id === jobId);
-                if (job) {
-                    showVNCViewerInstructions(job);
-                }
-            });
-        });
-
-        document.querySelectorAll('.tmux-connect-button').forEach(button => {
-            button.addEventListener('click', () => {
-                const jobId = button.getAttribute('data-job-id');
-                // Find job info
-                const job = jobs.find(j => j.job_id === jobId);
-                if (job) {
-                    showTmuxConnectionInstructions(job);
-                }
-            });
-        });
+        renderVNCList(jobs);
     } catch (error) {
         console.error('Failed to refresh VNC list:', error);
         // Show no VNC message and hide table on error
@@ -1421,6 +1316,188 @@ async function refreshVNCList(withRetries = false) {
     }
 }
 
+// Render the session list table
+function renderVNCList(jobs) {
+    // Always clear table (removes loading indicator too)
+    vncTableBody.innerHTML = '';
+    
+    if (jobs.length === 0) {
+        noVNCMessage.style.display = 'block';
+        document.querySelector('.table-container').style.display = 'none';
+        return;
+    }
+    
+    noVNCMessage.style.display = 'none';
+    document.querySelector('.table-container').style.display = 'block';
+    
+    // Populate table
+    jobs.forEach(job => {
+        const row = document.createElement('tr');
+        
+        // Status badge class based on status
+        let statusClass = 'status-pending';
+        if (job.status === 'DONE') statusClass = 'status-done';
+        if (job.status === 'RUN') statusClass = 'status-running';
+        if (job.status === 'EXIT') statusClass = 'status-error';
+        
+        // Connection information (display port if available)
+        const connectionInfo = job.port ? 
+            `${job.host}:${job.port}` : 
+            (job.host || 'N/A');
+        
+        // Format runtime for display
+        const formattedRuntime = formatRuntime(job.runtime_display || job.runtime || 'N/A');
+        
+        // Determine if this is a tmux session
+        const isTmux = job.session_type === 'tmux';
+        const connectReady = isTmux
+            ? isConnectHostReady(job.host)
+            : (isConnectHostReady(job.host) &&
+                job.port != null &&
+                job.port !== '');
+        const connectDisabledAttr = connectReady ? '' : ' disabled';
+        const connectTitle = isTmux
+            ? (connectReady
+                ? 'tmux connection instructions'
+                : 'Host not available yet — connection details unavailable')
+            : (connectReady
+                ? 'VNC connection instructions'
+                : 'Host and port required — connection details unavailable');
+        
+        // Create cells
+        row.innerHTML = `
+            <td>${job.job_id}</td>
+            <td>${job.name === "VNC Session" ? "" : job.name}</td>
+            <td>${job.user}</td>
+            <td>${job.status === "RUN" ? 
+                `<span class="status-badge ${statusClass}">${job.status}</span>` : 
+                `<span class="status-badge ${statusClass}">${job.status}</span>`}
+            </td>
+            <td>${job.session_type || 'Unknown'}</td>
+            <td>${job.queue}</td>
+            <td>${job.resources_unknown ? 'Unknown' : `${job.num_cores || '-'} cores, ${job.memory_gb || '-'} GB`}</td>
+            <td>${job.os || 'N/A'}</td>
+            <td title="${isTmux ? 'Host: ' + (job.host || 'N/A') : 'VNC Connection: ' + connectionInfo}">${job.host || 'N/A'}</td>
+            <td>${isTmux ? 'N/A' : (job.port != null ? ':' + job.port : 'N/A')}</td>
+            <td>${formattedRuntime}</td>
+            <td class="actions-cell">
+                ${isTmux ? `
+                    <button class="button secondary tmux-connect-button" data-job-id="${job.job_id}" title="${connectTitle}"${connectDisabledAttr}>
+                        <i class="fas fa-terminal"></i> Connect
+                    </button>
+                ` : `
+                    <button class="button secondary vnc-viewer-button" data-job-id="${job.job_id}" title="${connectTitle}"${connectDisabledAttr}>
+                        <i class="fas fa-desktop"></i> Connect
+                    </button>
+                `}
+                <button class="button danger kill-button" data-job-id="${job.job_id}" title="Kill ${isTmux ? 'tmux' : 'VNC'} Session">
+                    <i class="fas fa-times"></i> Kill
+                </button>
+            </td>
+        `;
+        
+        // Add to table
+        vncTableBody.appendChild(row);
+    });
+    
+    // Ensure sorting functionality attached (re-attaching safe)
+    enableTableSorting('vnc-table');
+    
+    // Add event listeners to buttons
+    document.querySelectorAll('.kill-button').forEach(button => {
+        button.addEventListener('click', () => {
+            const jobId = button.getAttribute('data-job-id');
+            killVNCSession(jobId);
+        });
+    });
+    
+    document.querySelectorAll('.vnc-viewer-button').forEach(button => {
+        button.addEventListener('click', () => {
+            const jobId = button.getAttribute('data-job-id');
+            // Find job info
+            const job = jobs.find(j => j.job_id === jobId);
+            if (job) {
+                showVNCViewerInstructions(job);
+            }
+        });
+    });
+
+    document.querySelectorAll('.tmux-connect-button').forEach(button => {
+        button.addEventListener('click', () => {
+            const jobId = button.getAttribute('data-job-id');
+            // Find job info
+            const job = jobs.find(j => j.job_id === jobId);
+            if (job) {
+                showTmuxConnectionInstructions(job);
+            }
+        });
+    });
+}
+
+// Session list kept up to date from /api/vnc/updates (job_id -> job), its EventSource,
+// the version of the last update applied, and whether changes are polled for instead
+let vncJobs = null;
+let vncUpdates = null;
+let vncVersion = null;
+let vncDeltaPolling = false;
+
+// Apply one update from /api/vnc/updates: the full list, or the changed jobs and removed ids
+function applyVNCUpdate(update) {
+    if (update.full || !vncJobs) {
+        vncJobs = new Map();
+    }
+    update.jobs.forEach(job => vncJobs.set(job.job_id, job));
+    update.removed.forEach(jobId => vncJobs.delete(jobId));
+    vncVersion = update.version;
+    renderVNCList(Array.from(vncJobs.values()));
+}
+
+// Fetch the changes since the last update without waiting for new ones; this
+// is what the periodic refresh does while the server has no stream to spare.
+// Returns false when the server does not offer updates.
+async function pollVNCUpdates() {
+    const since = vncJobs && vncVersion !== null ? `since=${vncVersion}&` : '';
+    try {
+        applyVNCUpdate(await apiRequest(`vnc/updates?${since}wait=0`));
+        return true;
+    } catch (error) {
+        console.warn('Polling session updates failed:', error);
+        vncVersion = null;
+        return false;
+    }
+}
+
+// Receive session list changes as Server-Sent Events instead of polling.
+// Polling resumes when the server does not offer updates or the stream is closed.
+function startVNCUpdates() {
+    if (!window.EventSource || vncUpdates) {
+        return;
+    }
+    let received = false;
+    const source = new EventSource('/api/vnc/updates');
+    source.addEventListener('jobs', event => {
+        received = true;
+        vncDeltaPolling = false;
+        applyVNCUpdate(JSON.parse(event.data));
+    });
+    source.addEventListener('unavailable', event => {
+        console.warn('Session updates unavailable:', event.data);
+    });
+    source.onerror = async () => {
+        // EventSource reconnects by itself unless the server refused the stream
+        // (all streams taken, or updates not enabled): poll for changes then,
+        // and only reload the full list when there are no updates at all
+        if (source.readyState === EventSource.CLOSED) {
+            vncUpdates = null;
+            vncDeltaPolling = await pollVNCUpdates();
+            if (received || vncDeltaPolling) {
+                setTimeout(startVNCUpdates, 60000);
+            }
+        }
+    };
+    vncUpdates = source;
+}
+
 // Function to copy text to clipboard
 function copyToClipboard(text) {
     // Create a temporary input element
@@ -0,0 +1,606 @@
+/*
+ * SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Early-OOM watchdog for LSF cgroup-v2 jobs (MyVNC VNC and tmux sessions)
+ *
+ * Compiled replacement for utils/cgroup_earlyoom.sh with the same flags,
+ * environment variables, log lines and protection rules: before the job's
+ * cgroup reaches its memory.max and LSF's OOM killer takes down the whole
+ * job, the largest process that is neither in the watchdog's ancestor chain
+ * (up to Xvnc) nor a session guardian (Xvnc/Xtigervnc/Xvfb, "tmux: server")
+ * is killed.
+ *
+ * Usage: cgroup_watchdog [--pretend|--no-pretend] [--slack|--no-slack]
+ *
+ * Instead of forking cat/ps/awk on a timer, it sleeps in poll() on the
+ * limit cgroup's memory.events (which the kernel signals when reclaim hits
+ * memory.high/memory.max) and on a PSI trigger registered on its
+ * memory.pressure, waking up within milliseconds of memory pressure. The
+ * EARLYOOM_INTERVAL timeout is kept as a fallback for when neither file can
+ * be watched; a check is only two reads of already open cgroup files.
+ * Targets are chosen by reading /proc/<pid>/statm directly.
+ *
+ * Environment (defaults, overridden by the flags):
+ *   EARLYOOM_THRESHOLD  default 70    percent of cgroup memory.max
+ *   EARLYOOM_INTERVAL   default 5     seconds between fallback checks
+ *   EARLYOOM_PRETEND    default 0     1 = log what would be killed, don't kill
+ *   EARLYOOM_SLACK      default 1     1 = DM the owning user via slackme on each kill
+ *   EARLYOOM_SLACK_BIN  default /tools_risc/common/bin/slackme
+ */
+
+#define _GNU_SOURCE  /* For pipe2() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define MAX_PATH_LEN 4096
+#define MAX_ANCESTORS 64
+#define MAX_CMDLINE_LEN 4096
+#define SLACK_CMDLINE_LEN 200
+#define SLACK_TIMEOUT_MS 5000
+/* Wake up when tasks stall on memory for 150ms within a 1s window */
+#define PSI_TRIGGER "some 150000 1000000"
+/* How long to wait for a killed target to release its memory */
+#define KILL_SETTLE_MS 1000
+
+extern char** environ;
+
+struct watchdog_config {
+    int threshold;
+    int interval;
+    int pretend;
+    int slack;
+    const char* slack_bin;
+};
+
+struct proc_info {
+    pid_t pid;
+    unsigned long long rss_kb;
+};
+
+static struct watchdog_config config;
+static char cgroup_path[MAX_PATH_LEN];
+static char job_id[128];
+static pid_t ancestors[MAX_ANCESTORS];
+static int num_ancestors = 0;
+static volatile sig_atomic_t stop_signal = 0;
+
+static void on_stop_signal(int sig) {
+    stop_signal = sig;
+}
+
+static void log_msg(const char* fmt, ...) {
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%F %T", &tm);
+
+    printf("%s [cgroup_earlyoom %d] ", stamp, (int)getpid());
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    putchar('\n');
+    fflush(stdout);
+}
+
+/* Log and send to syslog (user.warning) for central collection of interventions */
+static void alert(const char* fmt, ...) {
+    char msg[MAX_CMDLINE_LEN + 256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    log_msg("%s", msg);
+    syslog(LOG_WARNING, "%s", msg);
+}
+
+static long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR && !stop_signal) {
+    }
+}
+
+/* Read a small file into buf (NUL-terminated); returns the length or -1 */
+static ssize_t read_file(const char* path, char* buf, size_t len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+/* Re-read an open cgroup file from the start; returns the length or -1 */
+static ssize_t pread_file(int fd, char* buf, size_t len) {
+    ssize_t n = pread(fd, buf, len - 1, 0);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+static void read_comm(pid_t pid, char* comm, size_t len) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/comm", (int)pid);
+    if (read_file(path, comm, len) < 0) {
+        comm[0] = '\0';
+        return;
+    }
+    comm[strcspn(comm, "\n")] = '\0';
+}
+
+/* Session keepers that must never be killed; the tmux server renames itself "tmux: server" */
+static int is_guardian(const char* comm) {
+    static const char* guardians[] = { "Xvnc", "Xvnc4", "Xtigervnc", "Xvfb", "tmux: server", "tmux" };
+    for (size_t i = 0; i < sizeof(guardians) / sizeof(guardians[0]); i++) {
+        if (strcmp(comm, guardians[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int is_x_server(const char* comm) {
+    return strcmp(comm, "Xvnc") == 0 || strcmp(comm, "Xvnc4") == 0 ||
+           strcmp(comm, "Xtigervnc") == 0 || strcmp(comm, "Xvfb") == 0;
+}
+
+/*
+ * Walk up from our own cgroup until memory.max is a real number (the leaf
+ * of an LSF v2 job has memory.max "max"; the limit lives on the parent)
+ */
+static int find_limit_cgroup(void) {
+    char buf[MAX_PATH_LEN];
+    if (read_file("/proc/self/cgroup", buf, sizeof(buf)) < 0) return -1;
+
+    char* line = strstr(buf, "0::");
+    if (!line || (line != buf && line[-1] != '\n')) return -1;
+    line += 3;
+    line[strcspn(line, "\n")] = '\0';
+    if (strcmp(line, "/") == 0) line++;
+    snprintf(cgroup_path, sizeof(cgroup_path), "%s%s", CGROUP_ROOT, line);
+
+    while (strlen(cgroup_path) > strlen(CGROUP_ROOT)) {
+        char path[MAX_PATH_LEN + 16];
+        char value[64];
+        snprintf(path, sizeof(path), "%s/memory.max", cgroup_path);
+        if (read_file(path, value, sizeof(value)) > 0 && strncmp(value, "max", 3) != 0 &&
+            value[0] >= '0' && value[0] <= '9') {
+            return 0;
+        }
+        char* slash = strrchr(cgroup_path, '/');
+        if (!slash) break;
+        *slash = '\0';
+    }
+    return -1;
+}
+
+/* Pull the LSF job id (e.g. job.557129800.18902.1778467099) out of the cgroup path */
+static void find_job_id(void) {
+    const char* p = strstr(cgroup_path, "job.");
+    size_t n = 0;
+    if (p) {
+        n = 4 + strspn(p + 4, "0123456789.");
+    }
+    if (n > 4 && n < sizeof(job_id)) {
+        memcpy(job_id, p, n);
+        job_id[n] = '\0';
+    } else {
+        snprintf(job_id, sizeof(job_id), "unknown-job");
+    }
+}
+
+static pid_t parent_of(pid_t pid) {
+    char path[64];
+    char buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) < 0) return 0;
+    /* comm may contain spaces and parentheses; the fields after it start past the last ')' */
+    char* p = strrchr(buf, ')');
+    int ppid = 0;
+    if (!p || sscanf(p + 1, " %*c %d", &ppid) != 1) return 0;
+    return (pid_t)ppid;
+}
+
+/*
+ * Protect our ppid chain up to (and including) Xvnc. For tmux jobs the
+ * chain ends at the heartbeat wrapper; the daemonized tmux server is found
+ * as a guardian instead.
+ */
+static void find_ancestors(void) {
+    pid_t pid = getpid();
+    while (pid > 1 && num_ancestors < MAX_ANCESTORS) {
+        char comm[64];
+        read_comm(pid, comm, sizeof(comm));
+        if (!comm[0]) break;
+        ancestors[num_ancestors++] = pid;
+        if (is_x_server(comm)) break;
+        pid = parent_of(pid);
+    }
+}
+
+static int is_protected(pid_t pid) {
+    for (int i = 0; i < num_ancestors; i++) {
+        if (ancestors[i] == pid) return 1;
+    }
+    char comm[64];
+    read_comm(pid, comm, sizeof(comm));
+    return is_guardian(comm);
+}
+
+static unsigned long long rss_kb(pid_t pid) {
+    char path[64];
+    char buf[256];
+    unsigned long long size = 0, resident = 0;
+    snprintf(path, sizeof(path), "/proc/%d/statm", (int)pid);
+    if (read_file(path, buf, sizeof(buf)) < 0 || sscanf(buf, "%llu %llu", &size, &resident) != 2) {
+        return 0;
+    }
+    return resident * (unsigned long long)(sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Find the largest non-protected process in the cgroup subtree at dir */
+static void scan_cgroup(const char* dir, struct proc_info* best, int* found) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/cgroup.procs", dir);
+    FILE* procs = fopen(path, "re");
+    if (procs) {
+        int pid;
+        while (fscanf(procs, "%d", &pid) == 1) {
+            if (pid <= 0 || is_protected(pid)) continue;
+            unsigned long long rss = rss_kb(pid);
+            /* Gone, a zombie or a kernel thread: nothing to free */
+            if (rss == 0) continue;
+            if (!*found || rss > best->rss_kb) {
+                best->pid = pid;
+                best->rss_kb = rss;
+                *found = 1;
+            }
+        }
+        fclose(procs);
+    }
+
+    DIR* d = opendir(dir);
+    if (!d) return;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        struct stat st;
+        if (entry->d_type == DT_UNKNOWN && (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))) continue;
+        scan_cgroup(path, best, found);
+    }
+    closedir(d);
+}
+
+static void read_cmdline(pid_t pid, char* buf, size_t len) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+    ssize_t n = read_file(path, buf, len);
+    if (n <= 0) {
+        read_comm(pid, buf, len);
+        return;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+        if (buf[i] == '\0') buf[i] = ' ';
+    }
+    while (n > 0 && buf[n - 1] == ' ') buf[--n] = '\0';
+}
+
+static void owner_of(pid_t pid, char* buf, size_t len) {
+    char path[64];
+    struct stat st;
+    snprintf(path, sizeof(path), "/proc/%d", (int)pid);
+    struct passwd* pwd = stat(path, &st) == 0 ? getpwuid(st.st_uid) : NULL;
+    snprintf(buf, len, "%s", pwd ? pwd->pw_name : "?");
+}
+
+/*
+ * DM the owning user via slackme on a kill event. Time-boxed so a hung
+ * slack hook cannot stall the watchdog; failures are only logged.
+ */
+static void slack_notify(const char* verb, pid_t pid, unsigned long long rss_mb,
+                         unsigned long long limit_gb, const char* cmdline) {
+    if (!config.slack) return;
+    if (access(config.slack_bin, X_OK) != 0) {
+        log_msg("WARN: slack disabled: %s not executable", config.slack_bin);
+        return;
+    }
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    size_t cmd_len = strlen(cmdline);
+    char msg[SLACK_CMDLINE_LEN + 512];
+    int len = snprintf(msg, sizeof(msg), "%s%s PID %d on %s consuming %llu MB out of %llu GB reserved. Cmdline: %.*s%s\n",
+                       config.pretend ? "[PRETEND] " : "", verb, (int)pid, host, rss_mb, limit_gb,
+                       SLACK_CMDLINE_LEN, cmdline, cmd_len > SLACK_CMDLINE_LEN ? "..." : "");
+    if (len < 0) return;
+    if ((size_t)len >= sizeof(msg)) len = sizeof(msg) - 1;
+
+    int in_pipe[2];
+    if (pipe2(in_pipe, O_CLOEXEC) != 0) {
+        log_msg("WARN: slack notification failed (%s)", strerror(errno));
+        return;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    char* argv[] = { (char*)config.slack_bin, NULL };
+    pid_t child;
+    int err = posix_spawn(&child, config.slack_bin, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(in_pipe[0]);
+    if (err != 0) {
+        close(in_pipe[1]);
+        log_msg("WARN: slack notification failed (%s)", strerror(err));
+        return;
+    }
+    if (write(in_pipe[1], msg, (size_t)len) < 0) {
+        /* Reported through the exit status below */
+    }
+    close(in_pipe[1]);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = 0;
+    while (waitpid(child, &status, WNOHANG) == 0) {
+        if (elapsed_ms(&start) >= SLACK_TIMEOUT_MS) {
+            kill(child, SIGKILL);
+            waitpid(child, &status, 0);
+            log_msg("WARN: slack notification failed (rc=124)");
+            return;
+        }
+        sleep_ms(50);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        log_msg("WARN: slack notification failed (rc=%d)", WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    }
+}
+
+/*
+ * Kill (or, pretending, report) the largest non-protected process. Returns
+ * the pid killed, 0 if nothing was killed.
+ */
+static pid_t intervene(unsigned long long current, unsigned long long limit) {
+    struct proc_info target = { 0, 0 };
+    int found = 0;
+    scan_cgroup(cgroup_path, &target, &found);
+    unsigned long long usage_pct = 100 * current / limit;
+    if (!found) {
+        log_msg("usage %llu%% over threshold but no non-protected target found", usage_pct);
+        return 0;
+    }
+
+    char cmdline[MAX_CMDLINE_LEN];
+    char user[64];
+    read_cmdline(target.pid, cmdline, sizeof(cmdline));
+    owner_of(target.pid, user, sizeof(user));
+    unsigned long long limit_gb = limit / 1024 / 1024 / 1024;
+    unsigned long long limit_kb = limit / 1024;
+    const char* verb = config.pretend ? "would kill" : "killing";
+
+    alert("--- LSF OOM INTERVENTION%s ---", config.pretend ? " (PRETEND)" : "");
+    alert("job=%s user=%s cgroup usage %llu%% of %llu GB limit", job_id, user, usage_pct, limit_gb);
+    alert("%s PID %d (user=%s): %llu MB (%llu%% of limit)", verb, (int)target.pid, user,
+          target.rss_kb / 1024, limit_kb ? 100 * target.rss_kb / limit_kb : 0);
+    alert("cmdline: %s", cmdline);
+    int killed = !config.pretend && kill(target.pid, SIGKILL) == 0;
+    slack_notify("Killed", target.pid, target.rss_kb / 1024, limit_gb, cmdline);
+    alert("----------------------------");
+    return killed ? target.pid : 0;
+}
+
+/* Register the PSI trigger; returns the fd to poll for POLLPRI or -1 */
+static int open_psi_trigger(void) {
+    char path[MAX_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/memory.pressure", cgroup_path);
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        log_msg("PSI trigger unavailable: %s: %s", path, strerror(errno));
+        return -1;
+    }
+    if (write(fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0) {
+        log_msg("PSI trigger unavailable: %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int parse_flag(const char* value) {
+    return value && strcmp(value, "1") == 0;
+}
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [-n|--pretend|--dry-run] [--no-pretend] [--slack] [--no-slack]\n\n", prog);
+    printf("Kills the largest non-protected process in this job's cgroup when its\n");
+    printf("memory usage exceeds EARLYOOM_THRESHOLD percent of memory.max.\n\n");
+    printf("  EARLYOOM_THRESHOLD  default 70    percent of cgroup memory.max\n");
+    printf("  EARLYOOM_INTERVAL   default 5     seconds between fallback checks\n");
+    printf("  EARLYOOM_PRETEND    default 0     1 = log what would be killed, don't kill\n");
+    printf("  EARLYOOM_SLACK      default 1     1 = DM the owning user via slackme on each kill\n");
+    printf("  EARLYOOM_SLACK_BIN  default /tools_risc/common/bin/slackme\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* env;
+    config.threshold = (env = getenv("EARLYOOM_THRESHOLD")) ? atoi(env) : 70;
+    config.interval = (env = getenv("EARLYOOM_INTERVAL")) ? atoi(env) : 5;
+    config.pretend = parse_flag(getenv("EARLYOOM_PRETEND"));
+    config.slack = (env = getenv("EARLYOOM_SLACK")) ? parse_flag(env) : 1;
+    config.slack_bin = (env = getenv("EARLYOOM_SLACK_BIN")) ? env : "/tools_risc/common/bin/slackme";
+    if (config.interval < 1) config.interval = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--pretend") == 0 || strcmp(arg, "--dry-run") == 0) {
+            config.pretend = 1;
+        } else if (strcmp(arg, "--no-pretend") == 0) {
+            config.pretend = 0;
+        } else if (strcmp(arg, "--slack") == 0) {
+            config.slack = 1;
+        } else if (strcmp(arg, "--no-slack") == 0) {
+            config.slack = 0;
+        } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "unknown arg: %s\n", arg);
+            return 2;
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    openlog("cgroup_earlyoom", LOG_PID, LOG_USER);
+
+    if (find_limit_cgroup() != 0) {
+        log_msg("ERROR: no ancestor cgroup has a numeric memory.max; nothing to monitor");
+        return 1;
+    }
+    find_job_id();
+    find_ancestors();
+
+    char path[MAX_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/memory.max", cgroup_path);
+    int max_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/memory.current", cgroup_path);
+    int current_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/memory.events", cgroup_path);
+    int events_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (max_fd < 0 || current_fd < 0) {
+        log_msg("ERROR: cannot open memory.max/memory.current in %s: %s", cgroup_path, strerror(errno));
+        return 1;
+    }
+    int psi_fd = open_psi_trigger();
+
+    char buf[512];
+    unsigned long long limit = 0, current = 0;
+    if (pread_file(max_fd, buf, sizeof(buf)) > 0) limit = strtoull(buf, NULL, 10);
+    if (pread_file(current_fd, buf, sizeof(buf)) > 0) current = strtoull(buf, NULL, 10);
+    if (events_fd >= 0) pread_file(events_fd, buf, sizeof(buf));  /* Arm the change notification */
+
+    double gib = 1024.0 * 1024.0 * 1024.0;
+    log_msg("watching %s", cgroup_path);
+    log_msg("job=%s  memory limit: %.2f GB  current usage: %.2f GB (%llu%%)", job_id,
+            limit / gib, current / gib, limit ? 100 * current / limit : 0);
+    log_msg("intervention threshold: %d%% = %.2f GB used", config.threshold, limit * config.threshold / 100.0 / gib);
+    log_msg("poll interval: %ds, woken by%s%s%s", config.interval,
+            events_fd >= 0 ? " memory.events" : "", psi_fd >= 0 ? " memory.pressure" : "",
+            config.pretend ? "  [PRETEND MODE -- no kills]" : "");
+    if (config.slack) {
+        log_msg("slack notify: ON  (%s)", config.slack_bin);
+    } else {
+        log_msg("slack notify: OFF");
+    }
+    char protected_list[MAX_ANCESTORS * 12] = "";
+    size_t used = 0;
+    for (int i = 0; i < num_ancestors && used < sizeof(protected_list); i++) {
+        used += snprintf(protected_list + used, sizeof(protected_list) - used, "%s%d", i ? " " : "", (int)ancestors[i]);
+    }
+    log_msg("protected ancestors: %s", protected_list);
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    syslog(LOG_INFO, "watcher started job=%s pid=%d host=%s -- syslog self-test", job_id, (int)getpid(), host);
+    log_msg("syslog self-test: sent user.info (grep /var/log/messages for tag=cgroup_earlyoom)");
+
+    /* An intervention without a kill is not repeated before the next interval, as in the script */
+    struct timespec holdoff_start;
+    int holdoff = 0;
+    int recheck = 0;
+
+    while (!stop_signal) {
+        struct pollfd fds[2];
+        int nfds = 0;
+        if (events_fd >= 0) fds[nfds++] = (struct pollfd){ .fd = events_fd, .events = POLLPRI };
+        if (psi_fd >= 0) fds[nfds++] = (struct pollfd){ .fd = psi_fd, .events = POLLPRI };
+
+        long timeout = config.interval * 1000L;
+        int polled = 0;
+        if (holdoff) {
+            long left = timeout - elapsed_ms(&holdoff_start);
+            if (left > 0) {
+                /* Ignore pressure events until the hold-off expires */
+                sleep_ms(left);
+                if (stop_signal) break;
+            }
+            holdoff = 0;
+        } else if (recheck) {
+            recheck = 0;
+        } else if (poll(fds, nfds, (int)timeout) >= 0) {
+            polled = 1;
+        } else if (errno != EINTR) {
+            log_msg("ERROR: poll: %s", strerror(errno));
+            return 1;
+        }
+        if (stop_signal) break;
+        for (int i = 0; polled && i < nfds; i++) {
+            if (fds[i].fd == events_fd && (fds[i].revents & (POLLPRI | POLLERR))) {
+                pread_file(events_fd, buf, sizeof(buf));
+            } else if (fds[i].fd == psi_fd && (fds[i].revents & POLLERR)) {
+                log_msg("PSI trigger removed (cgroup gone?)");
+                close(psi_fd);
+                psi_fd = -1;
+            }
+        }
+
+        if (pread_file(max_fd, buf, sizeof(buf)) < 0) {
+            log_msg("cgroup files vanished (job ended?); exiting");
+            return 0;
+        }
+        if (strncmp(buf, "max", 3) == 0) continue;
+        limit = strtoull(buf, NULL, 10);
+        if (pread_file(current_fd, buf, sizeof(buf)) < 0) {
+            log_msg("cgroup files vanished (job ended?); exiting");
+            return 0;
+        }
+        current = strtoull(buf, NULL, 10);
+        if (limit == 0 || 100 * current / limit <= (unsigned long long)config.threshold) continue;
+
+        pid_t target = intervene(current, limit);
+        if (target > 0) {
+            /* Recheck as soon as the target's memory is released */
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (kill(target, 0) == 0 && elapsed_ms(&start) < KILL_SETTLE_MS && !stop_signal) {
+                sleep_ms(10);
+            }
+            recheck = 1;
+        } else {
+            clock_gettime(CLOCK_MONOTONIC, &holdoff_start);
+            holdoff = 1;
+        }
+    }
+
+    log_msg("exiting on signal");
+    return 0;
+}
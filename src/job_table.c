@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Tokenizer for delimited scheduler listings (libjobtable.so)
+ *
+ * Splits the output of "bjobs -o '... delimiter=;'" and "squeue --format
+ * '%i|%t|...'" into a table in one pass over the bytes, without allocating:
+ * the caller provides the output buffers. Rows come back normalized - the
+ * free-text column rejoined, short rows padded, and fields separated by a
+ * byte that cannot occur in them - so the Python side
+ * (myvnc/utils/job_table.py, loaded with ctypes) turns a whole chunk into
+ * rows with two C-level str.split() calls instead of splitting and
+ * rejoining every line in the interpreter. It has a pure Python fallback
+ * with the same semantics.
+ *
+ * Field semantics match str.split(delimiter) on each line:
+ *   - nfields is the number of fields the line splits into
+ *   - missing fields are returned empty
+ *   - with greedy_col >= 0 and more fields than columns, column greedy_col
+ *     takes everything between the fields before it (counted from the left)
+ *     and the fields after it (counted from the right), delimiters
+ *     included. This is how bjobs' command column, which may itself
+ *     contain the delimiter, is recovered
+ *   - without a greedy column, fields past the last column are ignored
+ * Blank lines are skipped. A field separator byte inside a field is
+ * replaced by a space.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define JOB_TABLE_MAX_COLS 32
+#define JOB_TABLE_FIELD_SEP '\x1f'   /* ASCII unit separator */
+
+/* One field: byte offset into the buffer and length */
+struct job_field {
+    uint32_t offset;
+    uint32_t length;
+};
+
+static void set_field(struct job_field* field, size_t begin, size_t end) {
+    field->offset = (uint32_t)begin;
+    field->length = (uint32_t)(end - begin);
+}
+
+static int is_blank(const char* buf, size_t start, size_t end) {
+    for (size_t p = start; p < end; p++) {
+        if (buf[p] != ' ' && buf[p] != '\t' && buf[p] != '\r') return 0;
+    }
+    return 1;
+}
+
+/* Split buf[start, end) into a row of ncols fields; returns the field count */
+static int parse_line(const char* buf, size_t start, size_t end, char delimiter,
+                      int ncols, int greedy_col, struct job_field* row) {
+    size_t head[JOB_TABLE_MAX_COLS];   /* first ncols delimiter positions */
+    size_t tail[JOB_TABLE_MAX_COLS];   /* ring of the last ntail positions */
+    int ntail = greedy_col >= 0 ? ncols - 1 - greedy_col : 0;
+    int count = 0;
+
+    for (const char* p = buf + start; ; p++) {
+        p = memchr(p, delimiter, end - (size_t)(p - buf));
+        if (!p) break;
+        size_t pos = (size_t)(p - buf);
+        if (count < ncols) head[count] = pos;
+        if (ntail > 0) tail[count % ntail] = pos;
+        count++;
+    }
+    int nfields = count + 1;
+
+    if (greedy_col >= 0 && nfields > ncols) {
+        for (int k = 0; k < greedy_col; k++) {
+            set_field(&row[k], k == 0 ? start : head[k - 1] + 1, head[k]);
+        }
+        /* Delimiter index (count - ntail) separates the greedy column from the tail */
+        size_t greedy_begin = greedy_col == 0 ? start : head[greedy_col - 1] + 1;
+        size_t greedy_end = ntail > 0 ? tail[(count - ntail) % ntail] : end;
+        set_field(&row[greedy_col], greedy_begin, greedy_end);
+        for (int j = 0; j < ntail; j++) {
+            int k = count - ntail + j;
+            size_t begin = tail[k % ntail] + 1;
+            size_t field_end = j + 1 < ntail ? tail[(k + 1) % ntail] : end;
+            set_field(&row[greedy_col + 1 + j], begin, field_end);
+        }
+        return nfields;
+    }
+
+    for (int k = 0; k < ncols; k++) {
+        if (k >= nfields) {
+            set_field(&row[k], end, end);
+        } else {
+            set_field(&row[k], k == 0 ? start : head[k - 1] + 1, k < count ? head[k] : end);
+        }
+    }
+    return nfields;
+}
+
+/*
+ * Tokenize the lines of buf starting at offset start. Only lines ending in
+ * a newline are parsed unless final is set, in which case a trailing
+ * unterminated line is parsed too. Each row is written to out as its ncols
+ * fields joined by JOB_TABLE_FIELD_SEP and terminated by a newline, with
+ * nfields[row] set, for at most max_rows rows or until out is full. out
+ * needs room for JOB_TABLE_FIELD_SEP between columns on top of the input,
+ * so len + max_rows * ncols bytes always suffices. Stores in *next
+ * the offset parsing stopped at (call again from there, or keep the rest
+ * for the next chunk) and in *out_used the bytes written. Returns the
+ * number of rows, or -1 for invalid arguments.
+ */
+int job_table_parse(const char* buf, size_t len, size_t start, int final,
+                    char delimiter, int ncols, int greedy_col,
+                    char* out, size_t out_len, int* nfields, int max_rows,
+                    size_t* next, size_t* out_used) {
+    struct job_field row[JOB_TABLE_MAX_COLS];
+    size_t used = 0;
+    int rows = 0;
+
+    if (ncols < 1 || ncols > JOB_TABLE_MAX_COLS || greedy_col >= ncols ||
+        len > UINT32_MAX || start > len) {
+        return -1;
+    }
+
+    size_t pos = start;
+    while (pos < len && rows < max_rows) {
+        const char* nl = memchr(buf + pos, '\n', len - pos);
+        size_t line_end;
+        if (nl) {
+            line_end = (size_t)(nl - buf);
+        } else if (final) {
+            line_end = len;
+        } else {
+            break;
+        }
+
+        if (!is_blank(buf, pos, line_end)) {
+            /* A row never grows by more than its separators */
+            if (used + (line_end - pos) + (size_t)ncols > out_len) break;
+            nfields[rows] = parse_line(buf, pos, line_end, delimiter, ncols, greedy_col, row);
+            for (int k = 0; k < ncols; k++) {
+                char* dst = out + used;
+                memcpy(dst, buf + row[k].offset, row[k].length);
+                /* Keep the separator unambiguous */
+                for (uint32_t i = 0; i < row[k].length; i++) {
+                    if (dst[i] == JOB_TABLE_FIELD_SEP) dst[i] = ' ';
+                }
+                used += row[k].length;
+                out[used++] = k + 1 < ncols ? JOB_TABLE_FIELD_SEP : '\n';
+            }
+            rows++;
+        }
+        pos = nl ? line_end + 1 : len;
+    }
+
+    *next = pos;
+    *out_used = used;
+    return rows;
+}
@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Micro-benchmark for the setuid_runner command path ("make bench")
+ *
+ * Times each step setuid_runner takes per command, using the broker's own
+ * functions (setuid_runner.c is compiled into this file with its main()
+ * renamed), and the end-to-end cost of running a command through the
+ * setuid_runner binary:
+ *
+ *   getpwnam        passwd lookup (NSS, so sssd/LDAP on the login nodes)
+ *   getgrouplist    supplementary group lookup done by initgroups()
+ *   initgroups      the real call; needs root, skipped otherwise
+ *   env setup       setup_user_environment() on the environment captured at startup
+ *   fork+exec+wait  fork()/execve()/waitpid() of "test", for comparison
+ *   spawn+wait      spawn_user_command() (posix_spawn) + waitpid() of "test"
+ *   exec runner     "setuid_runner <user> test -n x", exec to exit
+ *
+ * Usage: runner_bench [-n iterations] [-r setuid_runner] [username]
+ *
+ * Runs as whoever starts it; without root, initgroups is skipped, and the
+ * runner step only works against a setuid-root installed binary (otherwise
+ * it reports the failure and is skipped).
+ */
+
+#define main setuid_runner_main
+#include "setuid_runner.c"
+#undef main
+
+#define DEFAULT_ITERATIONS 1000
+
+struct bench_result {
+    const char* name;
+    double* samples_us;
+    int count;
+    const char* skipped;
+};
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double p) {
+    int index = (int)(p / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static void report(struct bench_result* result) {
+    if (result->skipped) {
+        printf("  %-16s %s\n", result->name, result->skipped);
+        return;
+    }
+    double total = 0;
+    for (int i = 0; i < result->count; i++) total += result->samples_us[i];
+    qsort(result->samples_us, (size_t)result->count, sizeof(double), compare_doubles);
+    printf("  %-16s %10.1f %10.1f %10.1f %10.1f\n", result->name, total / result->count,
+           percentile(result->samples_us, result->count, 50),
+           percentile(result->samples_us, result->count, 99),
+           result->samples_us[result->count - 1]);
+}
+
+static int wait_for(pid_t pid) {
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return exit_code_from_status(status);
+}
+
+static double* alloc_samples(int iterations) {
+    double* samples = calloc((size_t)iterations, sizeof(double));
+    if (!samples) {
+        perror("calloc");
+        exit(1);
+    }
+    return samples;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = DEFAULT_ITERATIONS;
+    const char* runner = "./setuid_runner";
+    const char* username = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'r':
+            runner = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-r setuid_runner] [username]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind < argc) username = argv[optind];
+    if (iterations < 1) iterations = 1;
+
+    struct passwd* self = getpwuid(geteuid());
+    if (!username) username = self ? self->pw_name : "root";
+    struct passwd* pwd = getpwnam(username);
+    if (!pwd) {
+        fprintf(stderr, "User not found: %s\n", username);
+        return 1;
+    }
+    struct passwd pwd_copy = *pwd;
+    pwd_copy.pw_name = strdup(pwd->pw_name);
+    pwd_copy.pw_dir = strdup(pwd->pw_dir);
+    pwd_copy.pw_shell = strdup(pwd->pw_shell);
+
+    char test_path[MAX_PATH_LEN];
+    const char* test_cmd = resolve_command("test", getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin",
+                                           test_path, sizeof(test_path));
+    char* test_argv[] = { (char*)test_cmd, "-n", "x", NULL };
+    char* runner_argv[] = { (char*)runner, (char*)username, "test", "-n", "x", NULL };
+
+    struct bench_result results[7] = {
+        { "getpwnam", alloc_samples(iterations), 0, NULL },
+        { "getgrouplist", alloc_samples(iterations), 0, NULL },
+        { "initgroups", alloc_samples(iterations), 0, geteuid() == 0 ? NULL : "skipped (needs root)" },
+        { "env setup", alloc_samples(iterations), 0, NULL },
+        { "fork+exec+wait", alloc_samples(iterations), 0, NULL },
+        { "spawn+wait", alloc_samples(iterations), 0, NULL },
+        { "exec runner", alloc_samples(iterations), 0, NULL },
+    };
+
+    gid_t groups[MAX_CACHED_GROUPS];
+    char cwd[MAX_PATH_LEN];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        perror("getcwd");
+        return 1;
+    }
+
+    /* Captured once, as the daemon does at startup */
+    capture_scheduler_environment(&sched_env);
+
+    /* The runner check happens up front so a non-setuid build is reported once */
+    pid_t pid;
+    if (posix_spawn(&pid, runner, NULL, NULL, runner_argv, environ) != 0 || wait_for(pid) != 0) {
+        results[6].skipped = "skipped (runner failed; is it installed setuid root?)";
+    }
+
+    for (int i = 0; i < iterations; i++) {
+        double t = now_us();
+        if (!getpwnam(username)) {
+            fprintf(stderr, "getpwnam failed for %s\n", username);
+            return 1;
+        }
+        results[0].samples_us[results[0].count++] = now_us() - t;
+
+        int ngroups = MAX_CACHED_GROUPS;
+        t = now_us();
+        getgrouplist(username, pwd_copy.pw_gid, groups, &ngroups);
+        results[1].samples_us[results[1].count++] = now_us() - t;
+
+        if (!results[2].skipped) {
+            t = now_us();
+            if (initgroups(username, pwd_copy.pw_gid) == -1) {
+                results[2].skipped = "skipped (initgroups failed)";
+            } else {
+                results[2].samples_us[results[2].count++] = now_us() - t;
+            }
+        }
+
+        t = now_us();
+        setup_user_environment(&user_env, username, &pwd_copy, &sched_env);
+        results[3].samples_us[results[3].count++] = now_us() - t;
+        /* setup_user_environment() enters the home directory */
+        if (chdir(cwd) != 0) {
+            perror("chdir");
+            return 1;
+        }
+
+        t = now_us();
+        pid = fork();
+        if (pid == 0) {
+            execve(test_cmd, test_argv, user_env.envp);
+            _exit(127);
+        }
+        if (pid < 0 || wait_for(pid) != 0) {
+            fprintf(stderr, "fork/exec of %s failed\n", test_cmd);
+            return 1;
+        }
+        results[4].samples_us[results[4].count++] = now_us() - t;
+
+        t = now_us();
+        int rc = spawn_user_command(&pid, test_argv, &user_env, -1, -1);
+        if (rc != 0 || wait_for(pid) != 0) {
+            fprintf(stderr, "spawn of %s failed: %s\n", test_cmd, strerror(rc));
+            return 1;
+        }
+        results[5].samples_us[results[5].count++] = now_us() - t;
+
+        if (!results[6].skipped) {
+            t = now_us();
+            if (posix_spawn(&pid, runner, NULL, NULL, runner_argv, environ) != 0 || wait_for(pid) != 0) {
+                fprintf(stderr, "%s failed\n", runner);
+                return 1;
+            }
+            results[6].samples_us[results[6].count++] = now_us() - t;
+        }
+    }
+
+    printf("setuid_runner command path, %d iterations as %s (user %s), microseconds:\n",
+           iterations, self ? self->pw_name : "?", username);
+    printf("  %-16s %10s %10s %10s %10s\n", "step", "mean", "p50", "p99", "max");
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        report(&results[i]);
+    }
+    return 0;
+}
@@ -7,10 +7,64 @@
  * This binary is designed to be run as setuid root to allow the myvnc server
  * (running as non-root) to execute LSF commands as authenticated users.
  *
- * Usage: setuid_runner <username> <command> [args...]
+ * Usage: setuid_runner [--deadline-ms N] <username> <command> [args...]
+ *        setuid_runner --daemon <socket_path> [client_user]
+ *        setuid_runner --batch < batch_frame
+ *        setuid_runner [--deadline-ms N] --framed <username> <command> [args...]
+ *
+ * Daemon mode keeps the broker resident on a root-owned Unix socket so the
+ * server does not pay for an exec of this binary on every scheduler call.
+ * It can only be started by root or, when built with DAEMON_SERVICE_USER
+ * (make DAEMON_USER=<account>), by that account for itself. The socket's
+ * directory must be owned by root and writable by nobody else; the socket is
+ * created there with mode 0660 and the client user's group, and only the
+ * client user (default: the real uid that started the daemon) and root may
+ * connect. Every frame on the socket is
+ *
+ *     u8 type | u16 tag | u32 payload length | payload     (network order)
+ *
+ * A run request ('Q') carries u32 deadline_ms (0 = none), u16 argc and then
+ * NUL-terminated username and argv strings. The daemon answers with any
+ * number of stdout ('O') and stderr ('E') frames followed by one exit ('X')
+ * frame holding the same i32 status the command-line mode would return.
+ * Responses echo the request tag. The allowlist and environment scrubbing
+ * are identical to the command-line mode.
+ *
+ * A batch request ('B') runs several commands for one user, switching
+ * credentials once and running at most max_parallel of them at a time (see
+ * parse_batch_request). It is answered with one exit frame per command, each
+ * command's frames tagged with its index. "setuid_runner --batch" reads one
+ * batch frame from stdin and writes the answer frames to stdout, which gives
+ * the same round trip without the daemon.
+ *
+ * "setuid_runner --framed" runs a single command and writes its output to
+ * stdout as frames tagged 0, ending with the exit frame, so large outputs
+ * can be consumed incrementally without the daemon.
+ *
+ * The daemon caches passwd entries and supplementary group lists so repeat
+ * requests for a user skip NSS (sssd/LDAP). Entries expire after
+ * CRED_CACHE_TTL seconds, unknown users after CRED_NEGATIVE_TTL seconds,
+ * and SIGHUP flushes the cache. The poll loop only reads the cache: a user
+ * that is not cached is looked up by the request's worker, which sends the
+ * result back over a pipe for the cache, so a slow NSS lookup never holds
+ * up the other clients.
+ *
+ * Every mode switches credentials in the broker process (for the daemon, in
+ * the per-request worker) and starts commands with posix_spawn(). An
+ * absolute command path is executed as given; only bare names are searched
+ * for in the user's PATH.
+ *
+ * Each command runs in its own process group. When a request's deadline
+ * (or --deadline-ms) passes, the group gets SIGTERM and, KILL_GRACE_MS later,
+ * SIGKILL; the command is then reported with a stderr message and exit
+ * status DEADLINE_EXIT_CODE, like timeout(1).
+ *
+ * Built against LSF's batch library (WITH_LIBBAT), bjobs listings in the
+ * form the server sends are answered through lsb_readjobinfo() in a child
+ * running as the user instead of by executing bjobs (see spawn_jobinfo).
  */
 
-#define _GNU_SOURCE  /* For clearenv() and setenv() */
+#define _GNU_SOURCE  /* For pipe2() and getgrouplist() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,9 +73,23 @@
 #include <grp.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <errno.h>
 #include <limits.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <arpa/inet.h>
+#ifdef WITH_LIBBAT
+#include <lsf/lsbatch.h>
+#endif
 
 #define MAX_ARGS 256
 #define MAX_USERNAME_LEN 32
@@ -29,6 +97,32 @@
 #define MAX_ENV_VARS 100
 #define MAX_ENV_VAR_LEN 1024
 
+/* Daemon protocol */
+#define FRAME_HEADER_LEN 7
+#define FRAME_REQUEST 'Q'
+#define FRAME_BATCH   'B'
+#define FRAME_STDOUT  'O'
+#define FRAME_STDERR  'E'
+#define FRAME_EXIT    'X'
+#define MAX_REQUEST_LEN (256 * 1024)
+#define MAX_CLIENTS 256
+#define RELAY_CHUNK 65536
+#define MAX_BATCH_COMMANDS 64
+#define MAX_BATCH_ARGV 4096
+#define MAX_BATCH_PARALLEL 16
+#define DEFAULT_BATCH_PARALLEL 4
+
+/* Deadline enforcement */
+#define KILL_GRACE_MS 2000
+#define DEADLINE_EXIT_CODE 124
+
+/* Daemon credential cache */
+#define CRED_CACHE_SIZE 512
+#define CRED_CACHE_PROBE 8
+#define CRED_CACHE_TTL 300
+#define CRED_NEGATIVE_TTL 30
+#define MAX_CACHED_GROUPS 1024
+
 /* List of allowed commands - security whitelist (LSF + SLURM) */
 static const char* allowed_commands[] = {
     "bjobs", "bsub", "bkill", "bpost", "bread",
@@ -72,12 +166,25 @@ static const char* lsf_env_vars[] = {
 };
 static const int num_lsf_env_vars = sizeof(lsf_env_vars) / sizeof(lsf_env_vars[0]);
 
-/* Structure to hold environment variable */
-struct env_var {
-    char name[MAX_ENV_VAR_LEN];
-    char value[MAX_ENV_VAR_LEN];
+/*
+ * Scheduler environment of whoever started the broker, as NAME=value strings
+ * with each name once. It is captured once per process (for the daemon, at
+ * startup) and every request's envp points at these strings, so setting up
+ * a request only adds the user's own variables.
+ */
+struct sched_env {
+    char* entries[MAX_ENV_VARS + 1];
+    int count;
+    const char* path;
+    size_t used;
+    char strings[MAX_ENV_VARS * 2 * MAX_ENV_VAR_LEN];
 };
 
+static struct sched_env sched_env;
+
+/* PATH for users when the broker was started without one */
+static char default_path_env[] = "PATH=/usr/local/lsf/bin:/usr/bin:/bin:/usr/local/bin";
+
 /* Function to validate username - basic null check only */
 int is_valid_username(const char* username) {
     return (username != NULL && strlen(username) > 0);
@@ -103,182 +210,1834 @@ int is_allowed_command(const char* command) {
     return 0;
 }
 
-/* Function to preserve LSF environment variables */
-int preserve_lsf_environment(struct env_var* preserved_vars, int* num_preserved) {
-    *num_preserved = 0;
+/* Record NAME=value (truncated to MAX_ENV_VAR_LEN - 1) unless NAME was seen already */
+static void add_sched_env(struct sched_env* env, const char* name, const char* value) {
+    size_t name_len = strlen(name);
+    for (int i = 0; i < env->count; i++) {
+        if (strncmp(env->entries[i], name, name_len) == 0 && env->entries[i][name_len] == '=') {
+            return;
+        }
+    }
+    if (env->count >= MAX_ENV_VARS || name_len >= MAX_ENV_VAR_LEN) return;
+    
+    char* entry = env->strings + env->used;
+    int n = snprintf(entry, sizeof(env->strings) - env->used, "%s=%.*s", name, MAX_ENV_VAR_LEN - 1, value);
+    if (n < 0 || (size_t)n >= sizeof(env->strings) - env->used) return;
+    if (strcmp(name, "PATH") == 0) {
+        env->path = entry + name_len + 1;
+    }
+    env->entries[env->count++] = entry;
+    env->entries[env->count] = NULL;
+    env->used += (size_t)n + 1;
+}
+
+/* Capture the scheduler variables from lsf_env_vars[] and PATH from our environment */
+int capture_scheduler_environment(struct sched_env* env) {
+    env->count = 0;
+    env->used = 0;
+    env->path = NULL;
+    env->entries[0] = NULL;
     
-    /* Preserve LSF environment variables */
-    for (int i = 0; i < num_lsf_env_vars && *num_preserved < MAX_ENV_VARS; i++) {
+    for (int i = 0; i < num_lsf_env_vars; i++) {
         const char* value = getenv(lsf_env_vars[i]);
         if (value) {
-            strncpy(preserved_vars[*num_preserved].name, lsf_env_vars[i], MAX_ENV_VAR_LEN - 1);
-            strncpy(preserved_vars[*num_preserved].value, value, MAX_ENV_VAR_LEN - 1);
-            preserved_vars[*num_preserved].name[MAX_ENV_VAR_LEN - 1] = '\0';
-            preserved_vars[*num_preserved].value[MAX_ENV_VAR_LEN - 1] = '\0';
-            (*num_preserved)++;
+            add_sched_env(env, lsf_env_vars[i], value);
         }
     }
     
-    /* Also preserve PATH */
     const char* path_value = getenv("PATH");
-    if (path_value && *num_preserved < MAX_ENV_VARS) {
-        strncpy(preserved_vars[*num_preserved].name, "PATH", MAX_ENV_VAR_LEN - 1);
-        strncpy(preserved_vars[*num_preserved].value, path_value, MAX_ENV_VAR_LEN - 1);
-        preserved_vars[*num_preserved].name[MAX_ENV_VAR_LEN - 1] = '\0';
-        preserved_vars[*num_preserved].value[MAX_ENV_VAR_LEN - 1] = '\0';
-        (*num_preserved)++;
+    if (path_value) {
+        add_sched_env(env, "PATH", path_value);
     }
     
     return 0;
 }
 
-/* Function to safely set environment for the target user */
-int setup_user_environment(const char* username, struct passwd* pwd, 
-                          struct env_var* preserved_vars, int num_preserved) {
-    /* Clear environment */
-    if (clearenv() != 0) {
-        fprintf(stderr, "Failed to clear environment\n");
-        return -1;
-    }
+/*
+ * Environment and start directory for commands run as the target user: the
+ * user's own variables followed by the captured scheduler environment. The
+ * envp block is handed straight to posix_spawn(), so nothing is rebuilt with
+ * clearenv()/setenv() between fork and exec.
+ */
+struct user_env {
+    char* envp[MAX_ENV_VARS + 6];
+    int count;
+    const char* path;
+    char home_warning[MAX_PATH_LEN + 64];
+    char strings[4 * (MAX_PATH_LEN + 16)];
+};
+
+static struct user_env user_env;
+
+/*
+ * Function to set up the environment for the target user. Must run after
+ * switch_to_user(): the home directory is entered once here and inherited by
+ * every command, and a failure to enter it is recorded as a warning rather
+ * than treated as fatal. The scheduler strings are shared, not copied.
+ */
+int setup_user_environment(struct user_env* env, const char* username, struct passwd* pwd,
+                           const struct sched_env* sched) {
+    const char* names[] = { "USER", "LOGNAME", "HOME", "SHELL" };
+    const char* values[] = { username, username, pwd->pw_dir, pwd->pw_shell };
+    size_t used = 0;
     
-    /* Set essential environment variables */
-    if (setenv("USER", username, 1) != 0 ||
-        setenv("LOGNAME", username, 1) != 0 ||
-        setenv("HOME", pwd->pw_dir, 1) != 0 ||
-        setenv("SHELL", pwd->pw_shell, 1) != 0) {
-        fprintf(stderr, "Failed to set environment variables\n");
-        return -1;
-    }
+    env->count = 0;
+    env->home_warning[0] = '\0';
     
-    /* Restore preserved environment variables */
-    for (int i = 0; i < num_preserved; i++) {
-        if (setenv(preserved_vars[i].name, preserved_vars[i].value, 1) != 0) {
-            fprintf(stderr, "Failed to restore environment variable %s\n", preserved_vars[i].name);
+    /* Set essential environment variables; lsf_env_vars[] names none of them */
+    for (int i = 0; i < 4; i++) {
+        size_t room = sizeof(env->strings) - used;
+        int n = snprintf(env->strings + used, room, "%s=%s", names[i], values[i]);
+        if (n < 0 || (size_t)n >= room) {
+            fprintf(stderr, "Failed to set environment variable %s\n", names[i]);
             return -1;
         }
+        env->envp[env->count++] = env->strings + used;
+        used += (size_t)n + 1;
     }
     
+    memcpy(&env->envp[env->count], sched->entries, (size_t)sched->count * sizeof(char*));
+    env->count += sched->count;
+    env->path = sched->path;
+    
     /* If PATH wasn't preserved, set a default */
-    if (getenv("PATH") == NULL) {
-        if (setenv("PATH", "/usr/local/lsf/bin:/usr/bin:/bin:/usr/local/bin", 1) != 0) {
-            fprintf(stderr, "Failed to set default PATH\n");
-            return -1;
-        }
+    if (env->path == NULL) {
+        env->envp[env->count++] = default_path_env;
+        env->path = default_path_env + strlen("PATH=");
     }
+    env->envp[env->count] = NULL;
     
+    if (chdir(pwd->pw_dir) == -1) {
+        snprintf(env->home_warning, sizeof(env->home_warning),
+                 "Warning: Could not change to home directory %s\n", pwd->pw_dir);
+    }
     return 0;
 }
 
-int main(int argc, char* argv[]) {
-    struct passwd* pwd;
-    pid_t pid;
-    int status;
-    struct env_var preserved_vars[MAX_ENV_VARS];
-    int num_preserved = 0;
+/*
+ * Resolve a command to the file posix_spawn() executes. Anything containing
+ * a '/' is used as given - the server passes absolute scheduler paths, so the
+ * common case does no PATH search at all. Bare names are searched for in the
+ * user's PATH the way execvp() would.
+ */
+static const char* resolve_command(const char* command, const char* path, char* buf, size_t len) {
+    if (strchr(command, '/')) {
+        return command;
+    }
     
-    /* Validate arguments */
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <username> <command> [args...]\n", argv[0]);
-        return 1;
+    for (const char* dir = path; dir; ) {
+        const char* colon = strchr(dir, ':');
+        size_t dir_len = colon ? (size_t)(colon - dir) : strlen(dir);
+        /* An empty PATH entry means the current directory */
+        int n = dir_len ? snprintf(buf, len, "%.*s/%s", (int)dir_len, dir, command)
+                        : snprintf(buf, len, "%s", command);
+        if (n > 0 && (size_t)n < len && access(buf, X_OK) == 0) {
+            return buf;
+        }
+        dir = colon ? colon + 1 : NULL;
     }
+    return NULL;
+}
+
+#ifdef WITH_LIBBAT
+/*
+ * LSF batch library backend for bjobs listings. A bjobs command of the
+ * shape the server sends (-o with plain field names and a delimiter, or a
+ * single field, -noheader, and any of -u, -J and one job ID) is answered by
+ * the broker itself. A child process running as the user queries mbatchd
+ * through lsb_openjobinfo()/lsb_readjobinfo() and prints the rows as bjobs
+ * would. That saves loading and initialising the bjobs binary for every
+ * listing, which matters most for the "-u all" snapshot. The child behaves
+ * like a spawned command (its own process group, output on the run's pipes,
+ * the same deadline), and it execs the real bjobs when the library cannot
+ * be initialised or the command uses anything the backend does not
+ * implement. Built with "make LSF_INCDIR=... LSF_LIBDIR=..." only.
+ */
+#define JOBINFO_MAX_FIELDS 16
+#define JOBINFO_BUFFER 65536
+#define JOBINFO_EXIT_FAILED 255  /* what bjobs exits with */
+
+enum jobinfo_field {
+    FIELD_JOBID, FIELD_STAT, FIELD_USER, FIELD_QUEUE, FIELD_FROM_HOST, FIELD_FIRST_HOST,
+    FIELD_EXEC_HOST, FIELD_RUN_TIME, FIELD_SLOTS, FIELD_MAX_REQ_PROC, FIELD_COMBINED_RESREQ,
+    FIELD_COMMAND, FIELD_JOB_NAME
+};
+
+/* bjobs -o names, indexed by enum jobinfo_field */
+static const char* jobinfo_field_names[] = {
+    "jobid", "stat", "user", "queue", "from_host", "first_host",
+    "exec_host", "run_time", "slots", "max_req_proc", "combined_resreq",
+    "command", "job_name"
+};
+static const int num_jobinfo_fields = sizeof(jobinfo_field_names) / sizeof(jobinfo_field_names[0]);
+
+struct jobinfo_query {
+    int fields[JOBINFO_MAX_FIELDS];
+    int num_fields;
+    char delimiter;
+    char* user;
+    char* job_name;
+    LS_LONG_INT job_id;
+    char job_id_arg[32];
+};
+
+struct jobinfo_output {
+    char data[JOBINFO_BUFFER];
+    size_t used;
+    int failed;
+};
+
+static int write_all(int fd, const void* data, size_t len);
+
+/* Parse the -o specification; 0 if every field is one the backend prints */
+static int parse_jobinfo_format(const char* spec, struct jobinfo_query* query) {
+    char copy[1024];
+    char* saveptr = NULL;
+    int has_delimiter = 0;
     
-    const char* username = argv[1];
-    const char* command = argv[2];
+    if (strlen(spec) >= sizeof(copy)) return -1;
+    strcpy(copy, spec);
+    query->num_fields = 0;
+    query->delimiter = ' ';
     
-    /* Basic username check */
-    if (!is_valid_username(username)) {
-        fprintf(stderr, "Username cannot be empty\n");
-        return 1;
+    for (char* token = strtok_r(copy, " ", &saveptr); token; token = strtok_r(NULL, " ", &saveptr)) {
+        if (strncmp(token, "delimiter=", 10) == 0) {
+            const char* value = token + 10;
+            size_t len = strlen(value);
+            if (len == 3 && (value[0] == '\'' || value[0] == '"') && value[2] == value[0]) {
+                query->delimiter = value[1];
+            } else if (len == 1) {
+                query->delimiter = value[0];
+            } else {
+                return -1;
+            }
+            has_delimiter = 1;
+            continue;
+        }
+        
+        /* Widths (name:N) and anything unknown are left to bjobs */
+        int field = -1;
+        for (int i = 0; i < num_jobinfo_fields; i++) {
+            if (strcmp(token, jobinfo_field_names[i]) == 0) {
+                field = i;
+                break;
+            }
+        }
+        if (field < 0 || query->num_fields >= JOBINFO_MAX_FIELDS) return -1;
+        query->fields[query->num_fields++] = field;
     }
     
-    /* Validate command is in allowed list */
-    if (!is_allowed_command(command)) {
-        fprintf(stderr, "Command not allowed: %s\n", command);
-        return 1;
+    /* Without a delimiter bjobs pads columns to its default widths */
+    if (query->num_fields == 0 || (!has_delimiter && query->num_fields > 1)) return -1;
+    return 0;
+}
+
+/* Whether argv is a bjobs listing the backend answers, filling query if so */
+static int parse_jobinfo_query(char** argv, struct jobinfo_query* query) {
+    const char* base = strrchr(argv[0], '/');
+    int has_format = 0, has_noheader = 0;
+    
+    if (strcmp(base ? base + 1 : argv[0], "bjobs") != 0) return -1;
+    memset(query, 0, sizeof(*query));
+    
+    for (int i = 1; argv[i]; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && argv[i + 1]) {
+            if (parse_jobinfo_format(argv[++i], query) != 0) return -1;
+            has_format = 1;
+        } else if (strcmp(arg, "-noheader") == 0) {
+            has_noheader = 1;
+        } else if (strcmp(arg, "-u") == 0 && argv[i + 1]) {
+            query->user = argv[++i];
+        } else if (strcmp(arg, "-J") == 0 && argv[i + 1]) {
+            query->job_name = argv[++i];
+        } else if (arg[0] != '-' && query->job_id == 0 && strlen(arg) < sizeof(query->job_id_arg)) {
+            /* One plain job ID; array elements (id[index]) go to bjobs */
+            char* end;
+            errno = 0;
+            long long value = strtoll(arg, &end, 10);
+            if (errno != 0 || *end != '\0' || value <= 0) return -1;
+            query->job_id = (LS_LONG_INT)value;
+            strcpy(query->job_id_arg, arg);
+        } else {
+            return -1;
+        }
+    }
+    return has_format && has_noheader ? 0 : -1;
+}
+
+static void jobinfo_flush(struct jobinfo_output* out) {
+    if (out->used > 0 && !out->failed && write_all(STDOUT_FILENO, out->data, out->used) != 0) {
+        out->failed = 1;
+    }
+    out->used = 0;
+}
+
+static void jobinfo_put(struct jobinfo_output* out, const char* text, size_t len) {
+    while (len > 0) {
+        if (out->used == sizeof(out->data)) jobinfo_flush(out);
+        size_t n = sizeof(out->data) - out->used;
+        if (n > len) n = len;
+        memcpy(out->data + out->used, text, n);
+        out->used += n;
+        text += n;
+        len -= n;
     }
+}
+
+/* A value on one row: newlines become spaces, and empty values are "-" like bjobs prints them */
+static void jobinfo_put_value(struct jobinfo_output* out, const char* value) {
+    if (!value || *value == '\0') {
+        jobinfo_put(out, "-", 1);
+        return;
+    }
+    for (const char* p = value; *p; ) {
+        size_t n = strcspn(p, "\r\n");
+        jobinfo_put(out, p, n);
+        p += n;
+        if (*p) {
+            jobinfo_put(out, " ", 1);
+            p++;
+        }
+    }
+}
+
+static const char* jobinfo_status(int status) {
+    if (status & JOB_STAT_UNKWN) return "UNKWN";
+    if (status & JOB_STAT_PEND) return "PEND";
+    if (status & JOB_STAT_PSUSP) return "PSUSP";
+    if (status & JOB_STAT_RUN) return "RUN";
+    if (status & JOB_STAT_SSUSP) return "SSUSP";
+    if (status & JOB_STAT_USUSP) return "USUSP";
+    if (status & JOB_STAT_EXIT) return "EXIT";
+    if (status & JOB_STAT_DONE) return "DONE";
+    if (status & JOB_STAT_WAIT) return "WAIT";
+    return "-";
+}
+
+/* Execution hosts as bjobs shows them: one entry per slot, runs folded into N*host */
+static void jobinfo_put_exec_hosts(struct jobinfo_output* out, const struct jobInfoEnt* job) {
+    char item[MAXHOSTNAMELEN + 16];
     
-    /* Preserve LSF environment variables before clearing */
-    if (preserve_lsf_environment(preserved_vars, &num_preserved) != 0) {
-        fprintf(stderr, "Failed to preserve environment variables\n");
-        return 1;
+    if (job->numExHosts <= 0) {
+        jobinfo_put(out, "-", 1);
+        return;
     }
+    for (int i = 0; i < job->numExHosts; ) {
+        int run = 1;
+        while (i + run < job->numExHosts && strcmp(job->exHosts[i + run], job->exHosts[i]) == 0) run++;
+        int n = run > 1 ? snprintf(item, sizeof(item), "%s%d*%s", i ? ":" : "", run, job->exHosts[i])
+                        : snprintf(item, sizeof(item), "%s%s", i ? ":" : "", job->exHosts[i]);
+        if (n > 0) jobinfo_put(out, item, (size_t)n < sizeof(item) ? (size_t)n : sizeof(item) - 1);
+        i += run;
+    }
+}
+
+static void jobinfo_put_row(struct jobinfo_output* out, const struct jobinfo_query* query,
+                            const struct jobInfoEnt* job) {
+    char number[64];
+    int n;
     
-    /* Get user information */
-    pwd = getpwnam(username);
-    if (!pwd) {
-        fprintf(stderr, "User not found: %s\n", username);
-        return 1;
+    for (int i = 0; i < query->num_fields; i++) {
+        if (i > 0) jobinfo_put(out, &query->delimiter, 1);
+        switch (query->fields[i]) {
+        case FIELD_JOBID:
+            n = snprintf(number, sizeof(number), "%lld", (long long)LSB_ARRAY_JOBID(job->jobId));
+            jobinfo_put(out, number, (size_t)n);
+            break;
+        case FIELD_STAT:
+            jobinfo_put_value(out, jobinfo_status(job->status));
+            break;
+        case FIELD_USER:
+            jobinfo_put_value(out, job->user);
+            break;
+        case FIELD_QUEUE:
+            jobinfo_put_value(out, job->submit.queue);
+            break;
+        case FIELD_FROM_HOST:
+            jobinfo_put_value(out, job->fromHost);
+            break;
+        case FIELD_FIRST_HOST:
+            jobinfo_put_value(out, job->numExHosts > 0 ? job->exHosts[0] : NULL);
+            break;
+        case FIELD_EXEC_HOST:
+            jobinfo_put_exec_hosts(out, job);
+            break;
+        case FIELD_RUN_TIME:
+            n = snprintf(number, sizeof(number), "%d second(s)", job->runTime);
+            jobinfo_put(out, number, (size_t)n);
+            break;
+        case FIELD_SLOTS:
+            if (job->numExHosts > 0) {
+                n = snprintf(number, sizeof(number), "%d", job->numExHosts);
+                jobinfo_put(out, number, (size_t)n);
+            } else {
+                jobinfo_put(out, "-", 1);
+            }
+            break;
+        case FIELD_MAX_REQ_PROC:
+            n = snprintf(number, sizeof(number), "%d", job->submit.maxNumProcessors);
+            jobinfo_put(out, number, (size_t)n);
+            break;
+        case FIELD_COMBINED_RESREQ:
+            /* The requested resource string; myvnc's rusage[mem=...] is always in it */
+            jobinfo_put_value(out, job->submit.resReq);
+            break;
+        case FIELD_COMMAND:
+            jobinfo_put_value(out, job->submit.command);
+            break;
+        case FIELD_JOB_NAME:
+            jobinfo_put_value(out, job->submit.jobName);
+            break;
+        }
     }
+    jobinfo_put(out, "\n", 1);
+}
+
+/*
+ * Body of the query child (already the target user, output on stdout and
+ * stderr). Returns the exit status bjobs would, or -1 when the library could
+ * not be initialised and the caller should exec bjobs instead.
+ */
+static int run_jobinfo_query(const struct jobinfo_query* query) {
+    static struct jobinfo_output out;
+    static char app_name[] = "myvnc";
+    int more = 0, failed = 0;
     
-    /* Fork to create child process */
-    pid = fork();
-    if (pid == -1) {
-        perror("fork failed");
-        return 1;
+    if (lsb_init(app_name) < 0) return -1;
+    
+    /* An explicit job ID also shows recently finished jobs, as bjobs does */
+    int options = query->job_id ? ALL_JOB : CUR_JOB;
+    int count = lsb_openjobinfo(query->job_id, query->job_name, query->user, NULL, NULL, options);
+    if (count < 0) {
+        if (lsberrno == LSBE_NO_JOB) {
+            if (query->job_id) {
+                fprintf(stderr, "Job <%s> is not found\n", query->job_id_arg);
+            } else if (query->job_name) {
+                fprintf(stderr, "Job <%s> is not found\n", query->job_name);
+            } else {
+                fprintf(stderr, "No unfinished job found\n");
+            }
+        } else {
+            fprintf(stderr, "bjobs: %s\n", lsb_sysmsg());
+        }
+        return JOBINFO_EXIT_FAILED;
     }
     
-    if (pid == 0) {
-        /* Child process - change user and execute command */
-        
-        /* Set supplementary groups */
-        if (initgroups(username, pwd->pw_gid) == -1) {
-            perror("initgroups failed");
-            exit(1);
+    for (int i = 0; i < count; i++) {
+        struct jobInfoEnt* job = lsb_readjobinfo(&more);
+        if (!job) {
+            failed = 1;
+            break;
         }
+        jobinfo_put_row(&out, query, job);
+    }
+    lsb_closejobinfo();
+    jobinfo_flush(&out);
+    
+    if (failed) {
+        fprintf(stderr, "bjobs: %s\n", lsb_sysmsg());
+        return JOBINFO_EXIT_FAILED;
+    }
+    return out.failed ? 1 : 0;
+}
+
+/*
+ * Start a query child in place of posix_spawn() of bjobs: same process
+ * group, descriptors and signal state as spawn_user_command() sets up.
+ */
+static int spawn_jobinfo(pid_t* pid, const char* file, char** argv, const struct jobinfo_query* query,
+                         const struct user_env* env, int out_fd, int err_fd) {
+    pid_t child = fork();
+    if (child == -1) return errno;
+    
+    if (child == 0) {
+        extern char** environ;
+        sigset_t mask;
+        int null_fd;
         
-        /* Set group ID */
-        if (setgid(pwd->pw_gid) == -1) {
-            perror("setgid failed");
-            exit(1);
+        setpgid(0, 0);
+        signal(SIGPIPE, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGHUP, SIG_DFL);
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+        if (out_fd >= 0) {
+            null_fd = open("/dev/null", O_RDONLY);
+            if (null_fd >= 0 && null_fd != STDIN_FILENO) {
+                dup2(null_fd, STDIN_FILENO);
+                close(null_fd);
+            }
+            dup2(out_fd, STDOUT_FILENO);
+            dup2(err_fd, STDERR_FILENO);
         }
+        /* The library reads LSF_ENVDIR and friends from the environment */
+        environ = (char**)env->envp;
         
-        /* Set user ID */
-        if (setuid(pwd->pw_uid) == -1) {
-            perror("setuid failed");
-            exit(1);
+        int code = run_jobinfo_query(query);
+        if (code >= 0) {
+            _exit(code);
         }
-        
-        /* Verify we're running as the correct user */
-        if (getuid() != pwd->pw_uid || geteuid() != pwd->pw_uid) {
-            fprintf(stderr, "Failed to change to user %s\n", username);
-            exit(1);
+        execve(file, argv, env->envp);
+        fprintf(stderr, "Failed to execute %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    
+    /* Also set here so a deadline cannot signal the group before it exists */
+    setpgid(child, child);
+    *pid = child;
+    return 0;
+}
+#endif
+
+/*
+ * Start argv as the current (already switched) user with posix_spawn(),
+ * which glibc implements with a CLONE_VM|CLONE_VFORK child so the broker's
+ * address space is never copied. stdout/stderr are redirected to out_fd and
+ * err_fd, and stdin to /dev/null, when those are >= 0; otherwise the broker's
+ * own descriptors are inherited. The command leads a new process group, so a
+ * deadline reaches anything it forks. Returns 0 or an errno value.
+ */
+static int spawn_user_command(pid_t* pid, char** argv, const struct user_env* env, int out_fd, int err_fd) {
+    char path_buf[MAX_PATH_LEN];
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t mask, defaults;
+    
+    const char* file = resolve_command(argv[0], env->path, path_buf, sizeof(path_buf));
+    if (!file) {
+        return ENOENT;
+    }
+    
+#ifdef WITH_LIBBAT
+    struct jobinfo_query query;
+    if (parse_jobinfo_query(argv, &query) == 0) {
+        return spawn_jobinfo(pid, file, argv, &query, env, out_fd, err_fd);
+    }
+#endif
+    
+    posix_spawn_file_actions_init(&actions);
+    if (out_fd >= 0) {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        /* dup2 clears close-on-exec on the new descriptors only */
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+    }
+    
+    /* The relay ignores SIGPIPE; commands get the default disposition back */
+    posix_spawnattr_init(&attr);
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    
+    int rc = posix_spawn(pid, file, &actions, &attr, argv, env->envp);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return rc;
+}
+
+/*
+ * Function to drop root privileges and become the target user. Supplementary
+ * groups come from groups[] when the caller already resolved them, otherwise
+ * from initgroups().
+ */
+int switch_to_user(const char* username, struct passwd* pwd, const gid_t* groups, int ngroups) {
+    /* Set supplementary groups */
+    if (groups && ngroups >= 0) {
+        if (setgroups((size_t)ngroups, groups) == -1) {
+            perror("setgroups failed");
+            return -1;
         }
-        
-        /* Setup environment with preserved LSF variables */
-        if (setup_user_environment(username, pwd, preserved_vars, num_preserved) != 0) {
-            exit(1);
+    } else if (initgroups(username, pwd->pw_gid) == -1) {
+        perror("initgroups failed");
+        return -1;
+    }
+    
+    /* Set group ID */
+    if (setgid(pwd->pw_gid) == -1) {
+        perror("setgid failed");
+        return -1;
+    }
+    
+    /* Set user ID */
+    if (setuid(pwd->pw_uid) == -1) {
+        perror("setuid failed");
+        return -1;
+    }
+    
+    /* Verify we're running as the correct user */
+    if (getuid() != pwd->pw_uid || geteuid() != pwd->pw_uid) {
+        fprintf(stderr, "Failed to change to user %s\n", username);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Function to convert a waitpid() status into the exit code we report */
+int exit_code_from_status(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        /* Child was killed by signal */
+        return 128 + WTERMSIG(status);
+    }
+    /* Unexpected termination */
+    return 1;
+}
+
+/*
+ * Framed protocol (daemon and batch modes)
+ */
+
+/*
+ * One command of a request; out_fd/err_fd are -1 once drained, and
+ * terminated is set once the deadline signalled its process group
+ */
+enum { RUN_PENDING, RUN_ACTIVE, RUN_DONE };
+struct command_run {
+    char** argv;
+    uint16_t tag;
+    int state;
+    pid_t pid;
+    int out_fd;
+    int err_fd;
+    int terminated;
+};
+
+/*
+ * Connected client; worker is the pid currently answering on fd, 0 if idle.
+ * cred_fd is the pipe a worker looking up an uncached user sends the result
+ * on (-1 if none), cred_generation the cache generation it was started in.
+ */
+struct client {
+    int fd;
+    pid_t worker;
+    size_t len;
+    unsigned char* buf;
+    int cred_fd;
+    unsigned int cred_generation;
+};
+
+/*
+ * Cached user resolution. ngroups is -1 when the group list did not fit and
+ * the worker has to fall back to initgroups(). expires == 0 marks an entry
+ * that is used for one request but never served from the cache.
+ */
+struct cred_entry {
+    char name[MAX_USERNAME_LEN + 1];
+    int found;
+    time_t expires;
+    struct passwd pwd;
+    char dir[MAX_PATH_LEN];
+    char shell[MAX_PATH_LEN];
+    int ngroups;
+    gid_t groups[MAX_CACHED_GROUPS];
+};
+
+static struct client clients[MAX_CLIENTS];
+static struct cred_entry cred_cache[CRED_CACHE_SIZE];
+static struct cred_entry cred_scratch;
+/* Bumped by every flush, so lookups started before one are not cached */
+static unsigned int cred_generation = 0;
+static volatile sig_atomic_t flush_requested = 0;
+static int wakeup_pipe[2] = { -1, -1 };
+
+static time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+/* Fill entry from NSS; this is the slow path the cache exists to avoid */
+static void fill_cred_entry(struct cred_entry* entry, const char* username, time_t now) {
+    struct passwd* pwd = getpwnam(username);
+    int cacheable = strlen(username) <= MAX_USERNAME_LEN;
+    
+    memset(entry, 0, offsetof(struct cred_entry, groups));
+    if (cacheable) {
+        strcpy(entry->name, username);
+    }
+    
+    if (!pwd) {
+        entry->found = 0;
+        entry->expires = cacheable ? now + CRED_NEGATIVE_TTL : 0;
+        return;
+    }
+    
+    if (strlen(pwd->pw_dir) >= MAX_PATH_LEN || strlen(pwd->pw_shell) >= MAX_PATH_LEN) {
+        cacheable = 0;
+    }
+    strncpy(entry->dir, pwd->pw_dir, MAX_PATH_LEN - 1);
+    strncpy(entry->shell, pwd->pw_shell, MAX_PATH_LEN - 1);
+    entry->pwd.pw_name = cacheable ? entry->name : (char*)username;
+    entry->pwd.pw_passwd = "x";
+    entry->pwd.pw_uid = pwd->pw_uid;
+    entry->pwd.pw_gid = pwd->pw_gid;
+    entry->pwd.pw_gecos = "";
+    entry->pwd.pw_dir = entry->dir;
+    entry->pwd.pw_shell = entry->shell;
+    entry->found = 1;
+    
+    entry->ngroups = MAX_CACHED_GROUPS;
+    if (getgrouplist(username, pwd->pw_gid, entry->groups, &entry->ngroups) == -1) {
+        entry->ngroups = -1;
+    }
+    entry->expires = cacheable ? now + CRED_CACHE_TTL : 0;
+}
+
+static unsigned int hash_username(const char* username) {
+    unsigned int h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)username; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Find username's cache entry; *slot is set to it, or to the slot a new
+ * entry for username goes in when there is none
+ */
+static struct cred_entry* find_cred_entry(const char* username, struct cred_entry** slot) {
+    struct cred_entry* victim = NULL;
+    unsigned int h = hash_username(username);
+    
+    for (int i = 0; i < CRED_CACHE_PROBE; i++) {
+        struct cred_entry* entry = &cred_cache[(h + (unsigned int)i) % CRED_CACHE_SIZE];
+        if (entry->name[0] != '\0' && strcmp(entry->name, username) == 0) {
+            *slot = entry;
+            return entry;
         }
-        
-        /* Change to user's home directory */
-        if (chdir(pwd->pw_dir) == -1) {
-            /* Not fatal - just warn and continue */
-            fprintf(stderr, "Warning: Could not change to home directory %s\n", pwd->pw_dir);
+        /* Prefer an empty slot, otherwise the entry closest to expiry */
+        if (!victim || entry->name[0] == '\0' ||
+            (victim->name[0] != '\0' && entry->expires < victim->expires)) {
+            victim = entry;
         }
-        
-        /* Execute the command */
-        /* argv[2] onwards contains the command and its arguments */
-        char** exec_args = &argv[2];
-        execvp(command, exec_args);
-        
-        /* If we get here, execvp failed */
-        perror("execvp failed");
-        exit(1);
-    } else {
-        /* Parent process - wait for child */
-        if (waitpid(pid, &status, 0) == -1) {
-            perror("waitpid failed");
-            return 1;
+    }
+    *slot = victim;
+    return NULL;
+}
+
+/*
+ * Look username up in the cache only; returns its entry if it is current
+ * (found or not), NULL when the user has to be resolved through NSS
+ */
+static struct cred_entry* cached_user(const char* username) {
+    struct cred_entry* slot;
+    
+    if (strlen(username) > MAX_USERNAME_LEN) return NULL;
+    struct cred_entry* entry = find_cred_entry(username, &slot);
+    return entry && entry->expires > monotonic_seconds() ? entry : NULL;
+}
+
+/* Cache the lookup a worker sent back, unless it is not cacheable */
+static void store_cred_entry(const struct cred_entry* result) {
+    struct cred_entry* slot;
+    
+    if (result->expires == 0 || memchr(result->name, '\0', sizeof(result->name)) == NULL ||
+        result->name[0] == '\0') {
+        return;
+    }
+    find_cred_entry(result->name, &slot);
+    *slot = *result;
+    slot->dir[MAX_PATH_LEN - 1] = '\0';
+    slot->shell[MAX_PATH_LEN - 1] = '\0';
+    /* The worker's pointers refer to its own copy */
+    slot->pwd.pw_name = slot->name;
+    slot->pwd.pw_passwd = "x";
+    slot->pwd.pw_gecos = "";
+    slot->pwd.pw_dir = slot->dir;
+    slot->pwd.pw_shell = slot->shell;
+}
+
+/* Read the lookup a finished worker sent back, if it made one, into the cache */
+static void collect_cred_entry(struct client* c) {
+    static struct cred_entry result;
+    size_t got = 0;
+    
+    if (c->cred_fd < 0) return;
+    while (got < sizeof(result)) {
+        ssize_t n = read(c->cred_fd, (char*)&result + got, sizeof(result) - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(c->cred_fd);
+    c->cred_fd = -1;
+    if (got == sizeof(result) && c->cred_generation == cred_generation) {
+        store_cred_entry(&result);
+    }
+}
+
+static void on_sighup(int sig) {
+    int saved_errno = errno;
+    (void)sig;
+    flush_requested = 1;
+    ssize_t ignored = write(wakeup_pipe[1], "h", 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+static void on_sigchld(int sig) {
+    int saved_errno = errno;
+    (void)sig;
+    /* A full pipe already means a wakeup is pending, so errors are ignored */
+    ssize_t ignored = write(wakeup_pipe[1], "c", 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint16_t get_u16(const unsigned char* p) {
+    return (uint16_t)(((uint16_t)p[0] << 8) | (uint16_t)p[1]);
+}
+
+/* Write the whole buffer, retrying on short writes and EINTR */
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
-        
-        /* Return the exit status of the child process */
-        if (WIFEXITED(status)) {
-            return WEXITSTATUS(status);
-        } else if (WIFSIGNALED(status)) {
-            /* Child was killed by signal */
-            return 128 + WTERMSIG(status);
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Send one protocol frame */
+static int send_frame(int fd, unsigned char type, uint16_t tag, const void* data, uint32_t len) {
+    unsigned char header[FRAME_HEADER_LEN];
+    header[0] = type;
+    header[1] = (unsigned char)(tag >> 8);
+    header[2] = (unsigned char)tag;
+    header[3] = (unsigned char)(len >> 24);
+    header[4] = (unsigned char)(len >> 16);
+    header[5] = (unsigned char)(len >> 8);
+    header[6] = (unsigned char)len;
+    if (write_all(fd, header, sizeof(header)) != 0) return -1;
+    if (len > 0 && write_all(fd, data, len) != 0) return -1;
+    return 0;
+}
+
+static int send_exit(int fd, uint16_t tag, int code) {
+    uint32_t be = htonl((uint32_t)code);
+    return send_frame(fd, FRAME_EXIT, tag, &be, sizeof(be));
+}
+
+/* Report a broker-side failure the same way the command-line mode does */
+static int reply_error(int fd, uint16_t tag, const char* fmt, const char* arg) {
+    char msg[512];
+    int len = snprintf(msg, sizeof(msg), fmt, arg ? arg : "");
+    if (len < 0) len = 0;
+    if ((size_t)len >= sizeof(msg)) len = sizeof(msg) - 1;
+    if (send_frame(fd, FRAME_STDERR, tag, msg, (uint32_t)len) != 0) return -1;
+    return send_exit(fd, tag, 1);
+}
+
+/*
+ * Parse a run request payload. The strings are left in place inside the
+ * payload; cmd_argv is NULL terminated.
+ */
+static int parse_run_request(unsigned char* payload, uint32_t len, uint32_t* deadline_ms,
+                             char** username, char** cmd_argv) {
+    if (len < 6) return -1;
+    *deadline_ms = get_u32(payload);
+    uint16_t argc = get_u16(payload + 4);
+    if (argc < 1 || argc >= MAX_ARGS) return -1;
+    
+    char* p = (char*)payload + 6;
+    char* end = (char*)payload + len;
+    for (int i = 0; i <= argc; i++) {
+        char* nul = memchr(p, '\0', (size_t)(end - p));
+        if (!nul) return -1;
+        if (i == 0) {
+            *username = p;
         } else {
-            /* Unexpected termination */
-            return 1;
+            cmd_argv[i - 1] = p;
         }
+        p = nul + 1;
     }
+    cmd_argv[argc] = NULL;
+    return 0;
+}
+
+static long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+/*
+ * Batch payload: u32 deadline_ms | u16 max_parallel | u16 ncommands |
+ * username\0 | ncommands x (u16 argc | argv strings). Each command's frames
+ * are tagged with its index in the batch.
+ */
+static int parse_batch_request(unsigned char* payload, uint32_t len, uint32_t* deadline_ms,
+                               int* max_parallel, char** username,
+                               struct command_run* runs, int* num_runs) {
+    static char* argv_pool[MAX_BATCH_ARGV];
+    int used = 0;
+    
+    if (len < 8) return -1;
+    *deadline_ms = get_u32(payload);
+    int parallel = get_u16(payload + 4);
+    int count = get_u16(payload + 6);
+    if (count < 1 || count > MAX_BATCH_COMMANDS) return -1;
+    if (parallel == 0) parallel = DEFAULT_BATCH_PARALLEL;
+    *max_parallel = parallel > MAX_BATCH_PARALLEL ? MAX_BATCH_PARALLEL : parallel;
+    
+    char* p = (char*)payload + 8;
+    char* end = (char*)payload + len;
+    char* nul = memchr(p, '\0', (size_t)(end - p));
+    if (!nul) return -1;
+    *username = p;
+    p = nul + 1;
+    
+    for (int i = 0; i < count; i++) {
+        if (end - p < 2) return -1;
+        int argc = get_u16((unsigned char*)p);
+        p += 2;
+        if (argc < 1 || argc >= MAX_ARGS || used + argc + 1 > MAX_BATCH_ARGV) return -1;
+        
+        memset(&runs[i], 0, sizeof(runs[i]));
+        runs[i].argv = &argv_pool[used];
+        runs[i].tag = (uint16_t)i;
+        for (int j = 0; j < argc; j++) {
+            nul = memchr(p, '\0', (size_t)(end - p));
+            if (!nul) return -1;
+            argv_pool[used++] = p;
+            p = nul + 1;
+        }
+        argv_pool[used++] = NULL;
+    }
+    
+    *num_runs = count;
+    return 0;
+}
+
+/*
+ * Start one command as the current (already switched) user with stdin on
+ * /dev/null and its output on close-on-exec pipes
+ */
+static int spawn_command(struct command_run* run, const struct user_env* env) {
+    int out_pipe[2], err_pipe[2];
+    
+    if (pipe2(out_pipe, O_CLOEXEC) == -1) return -1;
+    if (pipe2(err_pipe, O_CLOEXEC) == -1) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return -1;
+    }
+    
+    int rc = spawn_user_command(&run->pid, run->argv, env, out_pipe[1], err_pipe[1]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    if (rc != 0) {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        errno = rc;
+        return -1;
+    }
+    
+    run->out_fd = out_pipe[0];
+    run->err_fd = err_pipe[0];
+    run->state = RUN_ACTIVE;
+    return 0;
+}
+
+static void close_run_pipes(struct command_run* run) {
+    if (run->out_fd >= 0) close(run->out_fd);
+    if (run->err_fd >= 0) close(run->err_fd);
+    run->out_fd = -1;
+    run->err_fd = -1;
+}
+
+/* Ask every running command's process group to stop; their output is still relayed */
+static void terminate_active_runs(struct command_run* runs, int num_runs) {
+    for (int i = 0; i < num_runs; i++) {
+        if (runs[i].state == RUN_ACTIVE) {
+            killpg(runs[i].pid, SIGTERM);
+            runs[i].terminated = 1;
+        }
+    }
+}
+
+static void kill_active_runs(struct command_run* runs, int num_runs) {
+    for (int i = 0; i < num_runs; i++) {
+        if (runs[i].state == RUN_ACTIVE) {
+            killpg(runs[i].pid, SIGKILL);
+            close_run_pipes(&runs[i]);
+        }
+    }
+}
+
+static int send_exit_for_run(int out_fd, const struct command_run* run, uint32_t deadline_ms, int code) {
+    if (!run->terminated) return send_exit(out_fd, run->tag, code);
+    char msg[256];
+    int len = snprintf(msg, sizeof(msg), "Deadline of %u ms exceeded, terminated %s\n", deadline_ms, run->argv[0]);
+    if (len < 0) len = 0;
+    if ((size_t)len >= sizeof(msg)) len = sizeof(msg) - 1;
+    if (send_frame(out_fd, FRAME_STDERR, run->tag, msg, (uint32_t)len) != 0) return -1;
+    return send_exit(out_fd, run->tag, DEADLINE_EXIT_CODE);
+}
+
+/*
+ * Run the commands as the current (already switched) user, at most
+ * max_parallel at a time, relaying their output to out_fd as frames tagged
+ * with each command's tag. Every command gets exactly one exit frame.
+ * At the deadline running commands are terminated (SIGTERM, then SIGKILL
+ * after KILL_GRACE_MS) and pending ones are not started.
+ * Returns -1 if out_fd stopped accepting frames.
+ */
+static int relay_commands(int out_fd, struct command_run* runs, int num_runs, int max_parallel,
+                          uint32_t deadline_ms, const struct user_env* env) {
+    struct pollfd pfds[2 * MAX_BATCH_PARALLEL];
+    struct command_run* owners[2 * MAX_BATCH_PARALLEL];
+    char chunk[RELAY_CHUNK];
+    struct timespec start;
+    int next = 0, active = 0, done = 0, expired = 0, killed = 0;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    signal(SIGPIPE, SIG_IGN);
+    
+    for (int i = 0; i < num_runs; i++) {
+        runs[i].state = RUN_PENDING;
+        runs[i].out_fd = -1;
+        runs[i].err_fd = -1;
+        runs[i].terminated = 0;
+    }
+    
+    while (done < num_runs) {
+        /* Top up the running set; after the deadline nothing new starts */
+        while (next < num_runs && (expired || active < max_parallel)) {
+            struct command_run* run = &runs[next++];
+            int rc = 0;
+            if (expired) {
+                rc = reply_error(out_fd, run->tag, "Deadline exceeded before %s started\n", run->argv[0]);
+            } else if (!is_allowed_command(run->argv[0])) {
+                rc = reply_error(out_fd, run->tag, "Command not allowed: %s\n", run->argv[0]);
+            } else if (spawn_command(run, env) != 0) {
+                rc = reply_error(out_fd, run->tag, "Failed to start command: %s\n", strerror(errno));
+            } else {
+                active++;
+                if (env->home_warning[0] != '\0' &&
+                    send_frame(out_fd, FRAME_STDERR, run->tag, env->home_warning,
+                               (uint32_t)strlen(env->home_warning)) != 0) {
+                    kill_active_runs(runs, num_runs);
+                    return -1;
+                }
+                continue;
+            }
+            run->state = RUN_DONE;
+            done++;
+            if (rc != 0) {
+                kill_active_runs(runs, num_runs);
+                return -1;
+            }
+        }
+        
+        /* Reap commands whose output is fully drained */
+        int nfds = 0, draining = 0, reaped = 0;
+        for (int i = 0; i < num_runs; i++) {
+            struct command_run* run = &runs[i];
+            if (run->state != RUN_ACTIVE) continue;
+            if (run->out_fd < 0 && run->err_fd < 0) {
+                int status;
+                pid_t pid = waitpid(run->pid, &status, WNOHANG);
+                if (pid == run->pid || (pid == -1 && errno != EINTR)) {
+                    run->state = RUN_DONE;
+                    active--;
+                    done++;
+                    reaped = 1;
+                    if (send_exit_for_run(out_fd, run, deadline_ms,
+                                          pid == -1 ? 1 : exit_code_from_status(status)) != 0) {
+                        kill_active_runs(runs, num_runs);
+                        return -1;
+                    }
+                } else {
+                    draining = 1;
+                }
+                continue;
+            }
+            if (run->out_fd >= 0) {
+                pfds[nfds].fd = run->out_fd;
+                pfds[nfds].events = POLLIN;
+                owners[nfds++] = run;
+            }
+            if (run->err_fd >= 0) {
+                pfds[nfds].fd = run->err_fd;
+                pfds[nfds].events = POLLIN;
+                owners[nfds++] = run;
+            }
+        }
+        if (reaped || done == num_runs) continue;
+        
+        /* Commands that closed their output but have not exited are polled for */
+        int timeout = draining ? 10 : -1;
+        if (deadline_ms > 0 && !killed) {
+            /* Next escalation: SIGTERM at the deadline, SIGKILL after the grace period */
+            long remaining = (long)deadline_ms + (expired ? KILL_GRACE_MS : 0) - elapsed_ms(&start);
+            if (remaining <= 0) {
+                if (!expired) {
+                    terminate_active_runs(runs, num_runs);
+                    expired = 1;
+                } else {
+                    /* Drop anything still buffered */
+                    kill_active_runs(runs, num_runs);
+                    killed = 1;
+                }
+                continue;
+            }
+            if (timeout == -1 || remaining < timeout) {
+                timeout = remaining > INT_MAX ? INT_MAX : (int)remaining;
+            }
+        }
+        
+        if (poll(pfds, (nfds_t)nfds, timeout) < 0) {
+            if (errno == EINTR) continue;
+            kill_active_runs(runs, num_runs);
+            expired = killed = 1;
+            continue;
+        }
+        
+        for (int i = 0; i < nfds; i++) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            struct command_run* run = owners[i];
+            int is_stdout = pfds[i].fd == run->out_fd;
+            ssize_t n = read(pfds[i].fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(pfds[i].fd);
+                if (is_stdout) {
+                    run->out_fd = -1;
+                } else {
+                    run->err_fd = -1;
+                }
+                continue;
+            }
+            if (send_frame(out_fd, is_stdout ? FRAME_STDOUT : FRAME_STDERR, run->tag, chunk, (uint32_t)n) != 0) {
+                /* Nobody is left to read the results */
+                kill_active_runs(runs, num_runs);
+                return -1;
+            }
+        }
+    }
+    
+    return 0;
+}
+
+/*
+ * Worker process: become the user once, then run the request's commands
+ * and relay their output to the client. Never returns.
+ */
+static void run_worker(int fd, const char* username, struct cred_entry* cred,
+                       struct command_run* runs, int num_runs, int max_parallel, uint32_t deadline_ms) {
+    if (switch_to_user(username, &cred->pwd, cred->groups, cred->ngroups) != 0) {
+        for (int i = 0; i < num_runs; i++) {
+            if (reply_error(fd, runs[i].tag, "Failed to change to user %s\n", username) != 0) _exit(1);
+        }
+        _exit(0);
+    }
+    
+    if (setup_user_environment(&user_env, username, &cred->pwd, &sched_env) != 0) {
+        for (int i = 0; i < num_runs; i++) {
+            if (reply_error(fd, runs[i].tag, "Failed to set up environment for %s\n", username) != 0) _exit(1);
+        }
+        _exit(0);
+    }
+    
+    _exit(relay_commands(fd, runs, num_runs, max_parallel, deadline_ms, &user_env) == 0 ? 0 : 1);
+}
+
+static void close_client(int i) {
+    close(clients[i].fd);
+    if (clients[i].cred_fd >= 0) {
+        close(clients[i].cred_fd);
+        clients[i].cred_fd = -1;
+    }
+    free(clients[i].buf);
+    clients[i].fd = -1;
+    clients[i].worker = 0;
+    clients[i].len = 0;
+    clients[i].buf = NULL;
+}
+
+/* Answer every command of a request with the same error */
+static int reply_error_all(int fd, struct command_run* runs, int num_runs, const char* fmt, const char* arg) {
+    for (int i = 0; i < num_runs; i++) {
+        if (reply_error(fd, runs[i].tag, fmt, arg) != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Validate a complete request frame and hand it to a worker process.
+ * Returns -1 when the connection has to be dropped.
+ */
+static int dispatch_request(int slot, int listen_fd, unsigned char type, uint16_t tag,
+                            unsigned char* payload, uint32_t len) {
+    int fd = clients[slot].fd;
+    char* cmd_argv[MAX_ARGS];
+    struct command_run runs[MAX_BATCH_COMMANDS];
+    char* username = NULL;
+    uint32_t deadline_ms = 0;
+    int num_runs = 1;
+    int max_parallel = 1;
+    
+    if (type == FRAME_REQUEST) {
+        if (parse_run_request(payload, len, &deadline_ms, &username, cmd_argv) != 0) {
+            return reply_error(fd, tag, "Malformed request\n", NULL);
+        }
+        memset(&runs[0], 0, sizeof(runs[0]));
+        runs[0].argv = cmd_argv;
+        runs[0].tag = tag;
+    } else if (type == FRAME_BATCH) {
+        /* Without a parsable command count the client cannot be answered */
+        if (parse_batch_request(payload, len, &deadline_ms, &max_parallel, &username, runs, &num_runs) != 0) {
+            return -1;
+        }
+    } else {
+        return reply_error(fd, tag, "Unknown request type\n", NULL);
+    }
+    
+    if (!is_valid_username(username)) {
+        return reply_error_all(fd, runs, num_runs, "Username cannot be empty\n", NULL);
+    }
+    if (type == FRAME_REQUEST && !is_allowed_command(cmd_argv[0])) {
+        return reply_error(fd, tag, "Command not allowed: %s\n", cmd_argv[0]);
+    }
+    
+    /* A cache miss is resolved by the worker, never in this loop */
+    int cred_pipe[2] = { -1, -1 };
+    struct cred_entry* cred = cached_user(username);
+    if (cred && !cred->found) {
+        return reply_error_all(fd, runs, num_runs, "User not found: %s\n", username);
+    }
+    if (!cred && pipe2(cred_pipe, O_CLOEXEC) == -1) {
+        return reply_error_all(fd, runs, num_runs, "pipe failed: %s\n", strerror(errno));
+    }
+    
+    pid_t pid = fork();
+    if (pid == -1) {
+        int fork_errno = errno;
+        if (cred_pipe[0] >= 0) {
+            close(cred_pipe[0]);
+            close(cred_pipe[1]);
+        }
+        return reply_error_all(fd, runs, num_runs, "fork failed: %s\n", strerror(fork_errno));
+    }
+    
+    if (pid == 0) {
+        /* Worker keeps only its own client connection */
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGHUP, SIG_DFL);
+        close(listen_fd);
+        close(wakeup_pipe[0]);
+        close(wakeup_pipe[1]);
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (i != slot && clients[i].fd >= 0) close(clients[i].fd);
+            if (clients[i].cred_fd >= 0) close(clients[i].cred_fd);
+        }
+        if (!cred) {
+            /* The whole entry fits in the pipe buffer, so this does not wait for the daemon */
+            close(cred_pipe[0]);
+            fill_cred_entry(&cred_scratch, username, monotonic_seconds());
+            write_all(cred_pipe[1], &cred_scratch, sizeof(cred_scratch));
+            close(cred_pipe[1]);
+            if (!cred_scratch.found) {
+                _exit(reply_error_all(fd, runs, num_runs, "User not found: %s\n", username) == 0 ? 0 : 1);
+            }
+            cred = &cred_scratch;
+        }
+        run_worker(fd, username, cred, runs, num_runs, max_parallel, deadline_ms);
+    }
+    
+    clients[slot].worker = pid;
+    if (cred_pipe[0] >= 0) {
+        close(cred_pipe[1]);
+        clients[slot].cred_fd = cred_pipe[0];
+        clients[slot].cred_generation = cred_generation;
+    }
+    return 0;
+}
+
+/* Dispatch the next buffered request for an idle client, if one is complete */
+static int process_client_buffer(int slot, int listen_fd) {
+    struct client* c = &clients[slot];
+    if (c->worker != 0 || c->len < FRAME_HEADER_LEN) return 0;
+    
+    uint32_t payload_len = get_u32(c->buf + 3);
+    if (payload_len > MAX_REQUEST_LEN) return -1;
+    if (c->len < FRAME_HEADER_LEN + payload_len) return 0;
+    
+    if (dispatch_request(slot, listen_fd, c->buf[0], get_u16(c->buf + 1),
+                         c->buf + FRAME_HEADER_LEN, payload_len) != 0) {
+        return -1;
+    }
+    
+    size_t used = FRAME_HEADER_LEN + payload_len;
+    memmove(c->buf, c->buf + used, c->len - used);
+    c->len -= used;
+    return 0;
+}
+
+/* Whether a real uid may start the daemon: root, or the compiled-in service account */
+static int may_start_daemon(uid_t uid) {
+    if (uid == 0) return 1;
+#ifdef DAEMON_SERVICE_USER
+    struct passwd* pwd = getpwnam(DAEMON_SERVICE_USER);
+    return pwd != NULL && pwd->pw_uid == uid;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Make the socket's directory the working directory, so the socket is
+ * replaced and created by name inside a directory that nobody but root can
+ * change between those steps. The directory must not be a symlink, must be
+ * owned by root and must not be group or world writable or setgid (the
+ * socket's group is set through the effective gid at bind time). Returns the
+ * socket's name within the directory, or NULL.
+ */
+static const char* enter_socket_dir(const char* socket_path) {
+    char dir[MAX_PATH_LEN];
+    const char* slash = strrchr(socket_path, '/');
+    struct stat st;
+    
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == socket_path) {
+        strcpy(dir, "/");
+    } else if ((size_t)(slash - socket_path) < sizeof(dir)) {
+        memcpy(dir, socket_path, (size_t)(slash - socket_path));
+        dir[slash - socket_path] = '\0';
+    } else {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return NULL;
+    }
+    const char* name = slash ? slash + 1 : socket_path;
+    if (name[0] == '\0') {
+        fprintf(stderr, "Socket path names a directory: %s\n", socket_path);
+        return NULL;
+    }
+    
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dir_fd == -1) {
+        fprintf(stderr, "Cannot open socket directory %s: %s\n", dir, strerror(errno));
+        return NULL;
+    }
+    if (fstat(dir_fd, &st) == -1 || st.st_uid != 0 || (st.st_mode & (S_IWGRP | S_IWOTH | S_ISGID))) {
+        fprintf(stderr, "Socket directory %s must be owned by root and not group or world writable\n", dir);
+        close(dir_fd);
+        return NULL;
+    }
+    if (fchdir(dir_fd) == -1) {
+        perror("fchdir failed");
+        close(dir_fd);
+        return NULL;
+    }
+    close(dir_fd);
+    return name;
+}
+
+static int run_daemon(const char* socket_path, const char* client_user) {
+    uid_t client_uid = getuid();
+    gid_t client_gid = getgid();
+    struct sockaddr_un addr;
+    struct stat st;
+    
+    if (geteuid() != 0) {
+        fprintf(stderr, "Daemon mode requires root (install setuid root or start as root)\n");
+        return 1;
+    }
+    
+    /* Otherwise anyone able to run the binary could start a root daemon for any client */
+    if (!may_start_daemon(getuid())) {
+        fprintf(stderr, "Daemon mode may only be started by root%s\n",
+#ifdef DAEMON_SERVICE_USER
+                " or " DAEMON_SERVICE_USER
+#else
+                ""
+#endif
+                );
+        return 1;
+    }
+    if (client_user && getuid() != 0) {
+        fprintf(stderr, "Only root may name the client user\n");
+        return 1;
+    }
+    
+    if (client_user) {
+        struct passwd* client_pwd = getpwnam(client_user);
+        if (!client_pwd) {
+            fprintf(stderr, "User not found: %s\n", client_user);
+            return 1;
+        }
+        client_uid = client_pwd->pw_uid;
+        client_gid = client_pwd->pw_gid;
+    }
+    
+    /* The scheduler environment is captured once from whoever started us */
+    if (capture_scheduler_environment(&sched_env) != 0) {
+        fprintf(stderr, "Failed to preserve environment variables\n");
+        return 1;
+    }
+    
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].cred_fd = -1;
+    }
+    
+    if (pipe(wakeup_pipe) == -1) {
+        perror("pipe failed");
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(wakeup_pipe[i], F_SETFL, fcntl(wakeup_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(wakeup_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigchld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    sa.sa_handler = on_sighup;
+    sigaction(SIGHUP, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    
+    /* The socket is made by name relative to its directory, then we go back */
+    int cwd_fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cwd_fd == -1) {
+        perror("Cannot open working directory");
+        return 1;
+    }
+    const char* socket_name = enter_socket_dir(socket_path);
+    if (!socket_name) {
+        return 1;
+    }
+    
+    /* Replace a stale socket, but never anything else */
+    if (lstat(socket_name, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Refusing to replace non-socket %s\n", socket_path);
+            return 1;
+        }
+        unlink(socket_name);
+    }
+    
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        perror("socket failed");
+        return 1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_name, sizeof(addr.sun_path) - 1);
+    
+    /*
+     * root-owned, connectable by the client user's group: mode and group
+     * are given to the socket as bind() creates it, never set by path after
+     */
+    gid_t old_egid = getegid();
+    if (setegid(client_gid) == -1) {
+        perror("setegid failed");
+        return 1;
+    }
+    mode_t old_umask = umask(0117);
+    int bound = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
+    int bind_errno = errno;
+    umask(old_umask);
+    if (setegid(old_egid) == -1) {
+        perror("setegid failed");
+        return 1;
+    }
+    if (bound == -1) {
+        fprintf(stderr, "bind failed: %s\n", strerror(bind_errno));
+        return 1;
+    }
+    
+    if (fchdir(cwd_fd) == -1) {
+        perror("fchdir failed");
+        return 1;
+    }
+    close(cwd_fd);
+    
+    if (listen(listen_fd, SOMAXCONN) == -1) {
+        perror("listen failed");
+        return 1;
+    }
+    
+    fprintf(stderr, "setuid_runner daemon listening on %s\n", socket_path);
+    
+    struct pollfd pfds[MAX_CLIENTS + 2];
+    int slots[MAX_CLIENTS + 2];
+    
+    for (;;) {
+        int nfds = 0;
+        pfds[nfds].fd = listen_fd;
+        pfds[nfds].events = POLLIN;
+        slots[nfds++] = -1;
+        pfds[nfds].fd = wakeup_pipe[0];
+        pfds[nfds].events = POLLIN;
+        slots[nfds++] = -1;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            /* Clients with a worker in flight are not read until it finishes */
+            if (clients[i].fd >= 0 && clients[i].worker == 0) {
+                pfds[nfds].fd = clients[i].fd;
+                pfds[nfds].events = POLLIN;
+                slots[nfds++] = i;
+            }
+        }
+        
+        if (poll(pfds, nfds, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll failed");
+            return 1;
+        }
+        
+        if (pfds[1].revents & POLLIN) {
+            char drain[64];
+            int status;
+            pid_t pid;
+            while (read(wakeup_pipe[0], drain, sizeof(drain)) > 0) {
+            }
+            if (flush_requested) {
+                flush_requested = 0;
+                memset(cred_cache, 0, sizeof(cred_cache));
+                cred_generation++;
+                fprintf(stderr, "Credential cache flushed\n");
+            }
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                for (int i = 0; i < MAX_CLIENTS; i++) {
+                    if (clients[i].fd >= 0 && clients[i].worker == pid) {
+                        clients[i].worker = 0;
+                        collect_cred_entry(&clients[i]);
+                        /* A worker that died mid-reply leaves the stream unusable */
+                        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                            close_client(i);
+                        } else if (process_client_buffer(i, listen_fd) != 0) {
+                            close_client(i);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                struct ucred cred;
+                socklen_t cred_len = sizeof(cred);
+                int slot = -1;
+                
+                if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == -1 ||
+                    (cred.uid != 0 && cred.uid != client_uid)) {
+                    fprintf(stderr, "Rejected connection from uid %d\n", (int)cred.uid);
+                    close(fd);
+                } else {
+                    for (int i = 0; i < MAX_CLIENTS; i++) {
+                        if (clients[i].fd < 0) {
+                            slot = i;
+                            break;
+                        }
+                    }
+                    unsigned char* buf = slot < 0 ? NULL : malloc(FRAME_HEADER_LEN + MAX_REQUEST_LEN);
+                    if (!buf) {
+                        fprintf(stderr, "Too many clients, dropping connection\n");
+                        close(fd);
+                    } else {
+                        clients[slot].fd = fd;
+                        clients[slot].worker = 0;
+                        clients[slot].cred_fd = -1;
+                        clients[slot].len = 0;
+                        clients[slot].buf = buf;
+                    }
+                }
+            }
+        }
+        
+        for (int p = 2; p < nfds; p++) {
+            int i = slots[p];
+            if (clients[i].fd != pfds[p].fd || clients[i].worker != 0) continue;
+            if (!(pfds[p].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            
+            ssize_t n = read(clients[i].fd, clients[i].buf + clients[i].len,
+                             FRAME_HEADER_LEN + MAX_REQUEST_LEN - clients[i].len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close_client(i);
+                continue;
+            }
+            clients[i].len += (size_t)n;
+            if (process_client_buffer(i, listen_fd) != 0) {
+                close_client(i);
+            }
+        }
+    }
+}
+
+/* Read one batch frame from stdin, run it and write the answer frames to stdout */
+static int run_batch_cli(void) {
+    struct command_run runs[MAX_BATCH_COMMANDS];
+    int num_runs = 0, max_parallel = 0;
+    uint32_t deadline_ms = 0;
+    char* username = NULL;
+    size_t len = 0, cap = FRAME_HEADER_LEN + MAX_REQUEST_LEN;
+    unsigned char* buf = malloc(cap);
+    
+    if (!buf) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    while (len < cap) {
+        ssize_t n = read(STDIN_FILENO, buf + len, cap - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+        if (len >= FRAME_HEADER_LEN && len >= FRAME_HEADER_LEN + (size_t)get_u32(buf + 3)) break;
+    }
+    
+    if (len < FRAME_HEADER_LEN || buf[0] != FRAME_BATCH ||
+        get_u32(buf + 3) > MAX_REQUEST_LEN || len < FRAME_HEADER_LEN + (size_t)get_u32(buf + 3) ||
+        parse_batch_request(buf + FRAME_HEADER_LEN, get_u32(buf + 3), &deadline_ms, &max_parallel,
+                            &username, runs, &num_runs) != 0) {
+        fprintf(stderr, "Malformed batch request on stdin\n");
+        return 1;
+    }
+    
+    if (!is_valid_username(username)) {
+        fprintf(stderr, "Username cannot be empty\n");
+        return 1;
+    }
+    
+    if (capture_scheduler_environment(&sched_env) != 0) {
+        fprintf(stderr, "Failed to preserve environment variables\n");
+        return 1;
+    }
+    
+    struct passwd* pwd = getpwnam(username);
+    if (!pwd) {
+        fprintf(stderr, "User not found: %s\n", username);
+        return 1;
+    }
+    
+    /* Credentials are switched once for the whole batch */
+    if (switch_to_user(username, pwd, NULL, -1) != 0 ||
+        setup_user_environment(&user_env, username, pwd, &sched_env) != 0) {
+        return 1;
+    }
+    
+    return relay_commands(STDOUT_FILENO, runs, num_runs, max_parallel, deadline_ms, &user_env) == 0 ? 0 : 1;
+}
+
+/*
+ * Run one command and write its output to stdout as frames tagged 0 instead
+ * of letting it inherit our descriptors. The caller can then parse the
+ * output as it arrives and gets the exit status in-band; broker-side
+ * failures are reported as frames too.
+ */
+static int run_framed_cli(const char* username, char** cmd_argv, uint32_t deadline_ms) {
+    struct command_run run;
+    
+    memset(&run, 0, sizeof(run));
+    run.argv = cmd_argv;
+    
+    if (!is_valid_username(username)) {
+        return reply_error(STDOUT_FILENO, 0, "Username cannot be empty\n", NULL) == 0 ? 0 : 1;
+    }
+    
+    if (capture_scheduler_environment(&sched_env) != 0) {
+        return reply_error(STDOUT_FILENO, 0, "Failed to preserve environment variables\n", NULL) == 0 ? 0 : 1;
+    }
+    
+    struct passwd* pwd = getpwnam(username);
+    if (!pwd) {
+        return reply_error(STDOUT_FILENO, 0, "User not found: %s\n", username) == 0 ? 0 : 1;
+    }
+    
+    if (switch_to_user(username, pwd, NULL, -1) != 0) {
+        return reply_error(STDOUT_FILENO, 0, "Failed to change to user %s\n", username) == 0 ? 0 : 1;
+    }
+    if (setup_user_environment(&user_env, username, pwd, &sched_env) != 0) {
+        return reply_error(STDOUT_FILENO, 0, "Failed to set up environment for %s\n", username) == 0 ? 0 : 1;
+    }
+    
+    /* The allowlist is checked by relay_commands */
+    return relay_commands(STDOUT_FILENO, &run, 1, 1, deadline_ms, &user_env) == 0 ? 0 : 1;
+}
+
+/*
+ * Wait for the command started by the command-line mode. With a deadline
+ * the command's process group gets SIGTERM when it passes and SIGKILL
+ * KILL_GRACE_MS later, and DEADLINE_EXIT_CODE is returned. The caller blocks
+ * SIGCHLD before starting the command so its exit cannot be missed between
+ * waitpid() and sigtimedwait().
+ */
+static int wait_for_command(pid_t pid, uint32_t deadline_ms, const char* command) {
+    struct timespec start;
+    sigset_t sigchld;
+    int status, stage = 0;  /* 1 once SIGTERM was sent, 2 once SIGKILL was */
+    
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for (;;) {
+        pid_t rc = waitpid(pid, &status, deadline_ms > 0 && stage < 2 ? WNOHANG : 0);
+        if (rc == pid) break;
+        if (rc == -1) {
+            if (errno == EINTR) continue;
+            perror("waitpid failed");
+            return 1;
+        }
+        
+        long remaining = (long)deadline_ms + (stage ? KILL_GRACE_MS : 0) - elapsed_ms(&start);
+        if (remaining <= 0) {
+            killpg(pid, stage ? SIGKILL : SIGTERM);
+            stage++;
+            continue;
+        }
+        struct timespec wait = { remaining / 1000, (remaining % 1000) * 1000000L };
+        /* Returns on SIGCHLD or timeout; either way waitpid() decides */
+        sigtimedwait(&sigchld, NULL, &wait);
+    }
+    
+    if (stage) {
+        fprintf(stderr, "Deadline of %u ms exceeded, terminated %s\n", deadline_ms, command);
+        return DEADLINE_EXIT_CODE;
+    }
+    return exit_code_from_status(status);
+}
+
+int main(int argc, char* argv[]) {
+    struct passwd* pwd;
+    pid_t pid;
+    const char* prog = argv[0];
+    uint32_t deadline_ms = 0;
+    
+    /* --deadline-ms applies to the command-line and framed modes; requests carry their own */
+    if (argc >= 3 && strcmp(argv[1], "--deadline-ms") == 0) {
+        char* end;
+        errno = 0;
+        unsigned long value = strtoul(argv[2], &end, 10);
+        if (errno != 0 || *end != '\0' || end == argv[2] || value > UINT32_MAX) {
+            fprintf(stderr, "Invalid deadline: %s\n", argv[2]);
+            return 1;
+        }
+        deadline_ms = (uint32_t)value;
+        argv += 2;
+        argc -= 2;
+        if (argc >= 2 && (strcmp(argv[1], "--daemon") == 0 || strcmp(argv[1], "--batch") == 0)) {
+            fprintf(stderr, "--deadline-ms cannot be used with %s\n", argv[1]);
+            return 1;
+        }
+    }
+    
+    if (argc >= 2 && strcmp(argv[1], "--daemon") == 0) {
+        if (argc < 3 || argc > 4) {
+            fprintf(stderr, "Usage: %s --daemon <socket_path> [client_user]\n", prog);
+            return 1;
+        }
+        return run_daemon(argv[2], argc == 4 ? argv[3] : NULL);
+    }
+    
+    if (argc == 2 && strcmp(argv[1], "--batch") == 0) {
+        return run_batch_cli();
+    }
+    
+    if (argc >= 4 && strcmp(argv[1], "--framed") == 0) {
+        return run_framed_cli(argv[2], &argv[3], deadline_ms);
+    }
+    
+    /* Validate arguments */
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s [--deadline-ms N] <username> <command> [args...]\n", prog);
+        fprintf(stderr, "       %s --daemon <socket_path> [client_user]\n", prog);
+        fprintf(stderr, "       %s --batch < batch_frame\n", prog);
+        fprintf(stderr, "       %s [--deadline-ms N] --framed <username> <command> [args...]\n", prog);
+        return 1;
+    }
+    
+    const char* username = argv[1];
+    const char* command = argv[2];
+    
+    /* Basic username check */
+    if (!is_valid_username(username)) {
+        fprintf(stderr, "Username cannot be empty\n");
+        return 1;
+    }
+    
+    /* Validate command is in allowed list */
+    if (!is_allowed_command(command)) {
+        fprintf(stderr, "Command not allowed: %s\n", command);
+        return 1;
+    }
+    
+    /* Preserve LSF environment variables before clearing */
+    if (capture_scheduler_environment(&sched_env) != 0) {
+        fprintf(stderr, "Failed to preserve environment variables\n");
+        return 1;
+    }
+    
+    /* Get user information */
+    pwd = getpwnam(username);
+    if (!pwd) {
+        fprintf(stderr, "User not found: %s\n", username);
+        return 1;
+    }
+    
+    /*
+     * Change user in this process and spawn the command from it. Credentials
+     * have to be switched before posix_spawn() since it cannot change them,
+     * and initgroups() is not safe to call in a vfork child.
+     */
+    if (switch_to_user(username, pwd, NULL, -1) != 0) {
+        return 1;
+    }
+    
+    /* Setup environment with preserved LSF variables */
+    if (setup_user_environment(&user_env, username, pwd, &sched_env) != 0) {
+        return 1;
+    }
+    if (user_env.home_warning[0] != '\0') {
+        /* Not fatal - just warn and continue */
+        fputs(user_env.home_warning, stderr);
+    }
+    
+    /* Held until wait_for_command(); the command starts with an empty mask */
+    sigset_t sigchld;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &sigchld, NULL);
+    
+    /* Execute the command */
+    /* argv[2] onwards contains the command and its arguments */
+    int rc = spawn_user_command(&pid, &argv[2], &user_env, -1, -1);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to execute %s: %s\n", command, strerror(rc));
+        return 1;
+    }
+    
+    /* Return the exit status of the child process */
+    return wait_for_command(pid, deadline_ms, command);
 }
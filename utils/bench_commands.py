@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+# SPDX-FileCopyrightText: © 2025 Tenstorrent AI ULC
+# SPDX-License-Identifier: Apache-2.0
+"""
+MyVNC command path load test
+
+Drives concurrent scheduler calls through LSFManager/SLURMManager against
+mock bjobs/bread/squeue commands and reports latency percentiles and
+throughput, so regressions in the command path show up before a rollout
+and login nodes can be sized. The mocks print a canned listing of --rows
+jobs, so what is measured is myvnc's own overhead: process launches,
+setuid_runner, output parsing and the managers' bookkeeping.
+
+Modes:
+    direct   commands run as the server user (no setuid_runner)
+    runner   one setuid_runner launch per command (needs an installed
+             setuid-root setuid_runner, or running as root)
+    daemon   commands sent to a 'setuid_runner --daemon' started for the run
+             (same permission requirements as runner)
+
+Operations:
+    command  _run_command() of the listing command only
+    listing  get_active_vnc_jobs(all_users=True): the listing plus parsing
+             and per-job display lookups, as the web UI's poll does
+
+Usage:
+    bench_commands.py [--scheduler lsf|slurm] [--mode direct|runner|daemon]
+                      [--operation command|listing] [--concurrency N]
+                      [--requests N] [--rows N] [--user USER]
+                      [--setuid-runner PATH] [--json]
+"""
+
+import argparse
+import json
+import logging
+import os
+import pwd
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, REPO_ROOT)
+
+
+def write_mocks(mock_dir: str, rows: int):
+    """Write mock scheduler commands that print a canned listing of rows jobs"""
+    user = pwd.getpwuid(os.getuid()).pw_name
+    bjobs_rows = []
+    squeue_rows = []
+    for i in range(rows):
+        job_id = 1000 + i
+        name = 'myvnc_vncserver' if i % 3 else 'myvnc_tmux'
+        bjobs_rows.append(f"{job_id};RUN;{user};interactive;host{i % 40};{i}:02:03;4;4;"
+                          f"rusage[mem=16G] select[rh96];/usr/bin/vncserver -name session{i};{name}")
+        squeue_rows.append(f"{job_id}|R|{user}|interactive|host{i % 40}|{i}:02:03|4|16G|"
+                           f"{name}|/usr/bin/vncserver -name session{i}")
+
+    outputs = {
+        'bjobs': '\n'.join(bjobs_rows) + '\n',
+        'bread': 'VNC_DISPLAY=:1\n',
+        'squeue': '\n'.join(squeue_rows) + '\n',
+    }
+    for command, output in outputs.items():
+        output_path = os.path.join(mock_dir, f'{command}.out')
+        with open(output_path, 'w') as f:
+            f.write(output)
+        os.chmod(output_path, 0o644)
+        script_path = os.path.join(mock_dir, command)
+        with open(script_path, 'w') as f:
+            f.write(f"#!/bin/sh\nexec cat {output_path}\n")
+        os.chmod(script_path, 0o755)
+
+    # The rest only need to exist for the managers' startup checks
+    for command in ('bsub', 'bkill', 'bpost', 'sbatch', 'srun', 'scancel', 'scontrol'):
+        script_path = os.path.join(mock_dir, command)
+        with open(script_path, 'w') as f:
+            f.write("#!/bin/sh\nexit 0\n")
+        os.chmod(script_path, 0o755)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+def summarize(latencies, errors, wall):
+    ordered = sorted(latencies)
+    count = len(ordered)
+    return {
+        'requests': count + errors,
+        'errors': errors,
+        'wall_seconds': round(wall, 3),
+        'throughput_per_second': round(count / wall, 1) if wall > 0 else 0.0,
+        'mean_ms': round(sum(ordered) / count * 1000, 2) if count else 0.0,
+        'p50_ms': round(percentile(ordered, 50) * 1000, 2),
+        'p90_ms': round(percentile(ordered, 90) * 1000, 2),
+        'p99_ms': round(percentile(ordered, 99) * 1000, 2),
+        'max_ms': round(ordered[-1] * 1000, 2) if count else 0.0,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Load test the MyVNC scheduler command path against mock commands')
+    parser.add_argument('--scheduler', choices=['lsf', 'slurm'], default='lsf')
+    parser.add_argument('--mode', choices=['direct', 'runner', 'daemon'], default='direct')
+    parser.add_argument('--operation', choices=['command', 'listing'], default='command')
+    parser.add_argument('--concurrency', type=int, default=8, help='Concurrent callers (default: 8)')
+    parser.add_argument('--requests', type=int, default=400, help='Total calls (default: 400)')
+    parser.add_argument('--rows', type=int, default=50, help='Jobs in the mock listing (default: 50)')
+    parser.add_argument('--user', help='User to run commands as in runner/daemon mode (default: current user)')
+    parser.add_argument('--setuid-runner', default=os.path.join(REPO_ROOT, 'src', 'setuid_runner'),
+                        help='setuid_runner binary (default: src/setuid_runner)')
+    parser.add_argument('--json', action='store_true', help='Print the results as JSON')
+    parser.add_argument('--verbose', action='store_true', help='Keep the managers\' INFO logging')
+    args = parser.parse_args()
+
+    mock_dir = tempfile.mkdtemp(prefix='myvnc_bench_')
+    os.chmod(mock_dir, 0o755)
+    write_mocks(mock_dir, args.rows)
+    # The managers resolve scheduler commands on PATH when they are created,
+    # and setuid_runner passes PATH on to the commands it runs
+    os.environ['PATH'] = mock_dir + os.pathsep + os.environ.get('PATH', '')
+
+    from myvnc.utils.log_manager import get_logger
+    get_logger()
+    if not args.verbose:
+        logging.getLogger('myvnc').setLevel(logging.WARNING)
+
+    if args.scheduler == 'lsf':
+        from myvnc.utils.lsf_manager import LSFManager
+        manager = LSFManager()
+    else:
+        from myvnc.utils.slurm_manager import SLURMManager
+        manager = SLURMManager()
+    manager.setuid_binary = args.setuid_runner
+    manager.runner_client = None
+    manager.job_snapshot = None
+    manager.display_collector = None
+
+    daemon = None
+    user = None
+    if args.mode != 'direct':
+        user = args.user or pwd.getpwuid(os.getuid()).pw_name
+    if args.mode == 'daemon':
+        from myvnc.utils.runner_client import RunnerClient
+        socket_path = os.path.join(mock_dir, 'setuid_runner.sock')
+        daemon = subprocess.Popen([args.setuid_runner, '--daemon', socket_path],
+                                  stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        manager.runner_client = RunnerClient(socket_path)
+        deadline = time.monotonic() + 5
+        while not os.path.exists(socket_path) and daemon.poll() is None and time.monotonic() < deadline:
+            time.sleep(0.05)
+
+    if args.scheduler == 'lsf':
+        command = ['bjobs', '-u', 'all', '-noheader', '-J', 'myvnc_*']
+    else:
+        command = ['squeue', '--noheader', '--name', 'myvnc_vncserver,myvnc_tmux']
+
+    def call():
+        if args.operation == 'listing':
+            jobs = manager.get_active_vnc_jobs(user, all_users=True)
+            if len(jobs) != args.rows:
+                raise RuntimeError(f"listing returned {len(jobs)} of {args.rows} jobs")
+        else:
+            manager._run_command(command, user)
+
+    latencies = []
+    errors = []
+    lock = threading.Lock()
+
+    def timed_call(_):
+        start = time.perf_counter()
+        try:
+            call()
+        except Exception as e:
+            with lock:
+                errors.append(str(e))
+            return
+        elapsed = time.perf_counter() - start
+        with lock:
+            latencies.append(elapsed)
+
+    try:
+        # One warm-up call starts the daemon connection and fails fast on setup errors
+        timed_call(None)
+        if errors:
+            print(f"Warm-up call failed: {errors[0]}", file=sys.stderr)
+            return 1
+        latencies.clear()
+
+        wall_start = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=args.concurrency) as pool:
+            list(pool.map(timed_call, range(args.requests)))
+        wall = time.perf_counter() - wall_start
+    finally:
+        if daemon:
+            daemon.terminate()
+            daemon.wait()
+        shutil.rmtree(mock_dir, ignore_errors=True)
+
+    results = summarize(latencies, len(errors), wall)
+    results.update({'scheduler': args.scheduler, 'mode': args.mode, 'operation': args.operation,
+                    'concurrency': args.concurrency, 'rows': args.rows})
+    if args.json:
+        print(json.dumps(results, indent=2))
+    else:
+        print(f"{args.scheduler} {args.operation} via {args.mode}: {args.requests} calls, "
+              f"{args.concurrency} concurrent, {args.rows} mock jobs")
+        print(f"  throughput {results['throughput_per_second']}/s over {results['wall_seconds']}s, "
+              f"{results['errors']} errors")
+        print(f"  latency ms: mean {results['mean_ms']}  p50 {results['p50_ms']}  p90 {results['p90_ms']}  "
+              f"p99 {results['p99_ms']}  max {results['max_ms']}")
+        if errors:
+            print(f"  first error: {errors[0]}")
+    return 1 if errors else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -10,6 +10,10 @@
 #      Guardians are rescanned every iteration because the tmux server
 #      daemonizes (PPID=1) and isn't in our ancestor chain.
 #
+# src/cgroup_watchdog.c is a compiled drop-in replacement with the same flags
+# and environment variables that is woken by memory.events/PSI instead of
+# polling; config/vnc/xstartup.sh uses it when it has been built.
+#
 # Launch from a VNC xstartup script (truncating the log each session so it
 # only reflects the current run):
 #     nohup "$HOME/myvnc/utils/cgroup_earlyoom.sh" \
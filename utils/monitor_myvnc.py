@@ -3,6 +3,13 @@
 MyVNC Server Monitor
 Monitors MyVNC server health and restarts it if unresponsive.
 Designed to run from cron with semaphore locking to prevent overlapping executions.
+
+When the main page does not answer, the server's /metrics are scraped to
+tell a server that is slow (scheduler commands running within their
+deadline, or requests still completing) from one that is hung. Only hung
+checks count towards a restart, and only after --failures-before-restart
+of them in a row; a restart drops every user's in-memory state, so one slow
+check is not worth it. The count is kept in a state file next to the log.
 """
 
 import sys
@@ -23,8 +30,44 @@ from pathlib import Path
 from contextlib import contextmanager
 
 
+def parse_metrics(text):
+    """
+    Parse the Prometheus text format into {name: [(labels dict, value), ...]}
+    
+    Only what /metrics emits is supported: no escaped quotes or commas in
+    label values and no timestamps.
+    """
+    metrics = {}
+    for line in text.splitlines():
+        line = line.strip()
+        if not line or line.startswith('#'):
+            continue
+        try:
+            series, value = line.rsplit(' ', 1)
+            labels = {}
+            if '{' in series:
+                name, label_text = series.split('{', 1)
+                for pair in label_text.rstrip('}').split(','):
+                    if '=' in pair:
+                        key, label_value = pair.split('=', 1)
+                        labels[key] = label_value.strip('"')
+            else:
+                name = series
+            metrics.setdefault(name, []).append((labels, float(value)))
+        except ValueError:
+            continue
+    return metrics
+
+
+def metric_value(metrics, name, **labels):
+    """Sum of the samples of a metric whose labels include the given ones (0 if there are none)"""
+    return sum(value for sample_labels, value in metrics.get(name, [])
+               if all(sample_labels.get(key) == wanted for key, wanted in labels.items()))
+
+
 class ServerMonitor:
-    def __init__(self, server_url, logfile, quiet=False, debug=False, timeout=10, restart_cmd=None, verify_ssl=True, log_history_minutes=2):
+    def __init__(self, server_url, logfile, quiet=False, debug=False, timeout=10, restart_cmd=None, verify_ssl=True, log_history_minutes=2,
+                 failures_before_restart=3, hung_command_seconds=600, use_metrics=True):
         """
         Initialize the server monitor
         
@@ -37,6 +80,9 @@ class ServerMonitor:
             restart_cmd: Command to restart the server
             verify_ssl: If True, verify SSL certificates (default: True)
             log_history_minutes: Number of minutes of log history to capture in diagnostics
+            failures_before_restart: Consecutive hung checks before the server is restarted
+            hung_command_seconds: A scheduler command running longer than this counts as hung
+            use_metrics: If False, restart on the first failed check without scraping /metrics
         """
         self.server_url = server_url.rstrip('/')
         self.logfile = Path(logfile)
@@ -46,7 +92,11 @@ class ServerMonitor:
         self.restart_cmd = restart_cmd
         self.verify_ssl = verify_ssl
         self.log_history_minutes = log_history_minutes
+        self.failures_before_restart = max(1, failures_before_restart)
+        self.hung_command_seconds = hung_command_seconds
+        self.use_metrics = use_metrics
         self.lock_file = None
+        self.state_file = self.logfile.parent / f".{self.logfile.stem}.state.json"
         
         # Disable SSL warnings if verification is disabled
         if not self.verify_ssl:
@@ -179,6 +229,88 @@ class ServerMonitor:
             self.log(f"Unexpected error: {e}", "ERROR")
             return False, f"Unexpected error: {e}", False
     
+    def fetch_metrics(self):
+        """
+        Scrape the server's /metrics
+        
+        Returns:
+            dict: Parsed metrics (see parse_metrics), or None if they could not be fetched
+        """
+        try:
+            response = requests.get(f"{self.server_url}/metrics", timeout=self.timeout, verify=self.verify_ssl)
+            if response.status_code != 200:
+                self.log(f"/metrics returned status {response.status_code}", "WARNING")
+                return None
+            return parse_metrics(response.text)
+        except requests.exceptions.RequestException as e:
+            self.log(f"Could not fetch /metrics: {e}", "WARNING")
+            return None
+    
+    def summarize_metrics(self, metrics):
+        """One line of the signals the health decision is based on"""
+        return (f"in flight: {metric_value(metrics, 'myvnc_http_requests_in_flight', kind='scheduler'):.0f} scheduler, "
+                f"{metric_value(metrics, 'myvnc_http_requests_in_flight', kind='other'):.0f} other, "
+                f"{metric_value(metrics, 'myvnc_http_requests_in_flight', kind='updates'):.0f} update streams; "
+                f"worker queue {metric_value(metrics, 'myvnc_http_worker_queue_depth'):.0f} "
+                f"of {metric_value(metrics, 'myvnc_http_workers'):.0f} workers; "
+                f"commands running {metric_value(metrics, 'myvnc_commands_running'):.0f} "
+                f"(oldest {metric_value(metrics, 'myvnc_command_oldest_running_seconds'):.1f}s); "
+                f"requests served {metric_value(metrics, 'myvnc_http_requests_total'):.0f}")
+    
+    def assess_metrics(self, metrics, state):
+        """
+        Decide from the server's metrics whether an unresponsive server is hung
+        
+        Args:
+            metrics: Parsed /metrics of this check
+            state: State saved by the previous check
+            
+        Returns:
+            tuple: (is_hung: bool, reason: str)
+        """
+        running = metric_value(metrics, 'myvnc_commands_running')
+        oldest = metric_value(metrics, 'myvnc_command_oldest_running_seconds')
+        if running and oldest > self.hung_command_seconds:
+            return True, f"a scheduler command has been running for {oldest:.0f}s (over {self.hung_command_seconds}s)"
+        
+        # Requests completed since the last check, less the previous check's own /metrics request
+        served = metric_value(metrics, 'myvnc_http_requests_total')
+        same_process = state.get('start_time') == metric_value(metrics, 'myvnc_process_start_time_seconds')
+        if same_process and state.get('requests') is not None and served - state['requests'] > 1:
+            return False, f"still serving ({served - state['requests'] - 1:.0f} requests completed since the last check)"
+        
+        if running:
+            return False, f"waiting on the scheduler ({running:.0f} commands running, oldest {oldest:.0f}s)"
+        
+        workers = metric_value(metrics, 'myvnc_http_workers')
+        queued = metric_value(metrics, 'myvnc_http_worker_queue_depth')
+        if workers and queued:
+            return True, f"no requests completed since the last check with {queued:.0f} connections waiting for workers"
+        if not same_process:
+            # First check of this server process, so there is nothing to compare with yet
+            return False, "no earlier check of this server process to compare with"
+        return True, "no requests completed since the last check"
+    
+    def load_state(self):
+        """Return the state saved by the previous check, or an empty one"""
+        try:
+            with open(self.state_file, 'r') as f:
+                return json.load(f)
+        except (OSError, ValueError):
+            return {}
+    
+    def save_state(self, failures, metrics=None):
+        """Save the consecutive failure count and the counters the next check compares with"""
+        state = {'failures': failures, 'checked_at': time.time()}
+        if metrics:
+            state['start_time'] = metric_value(metrics, 'myvnc_process_start_time_seconds')
+            state['requests'] = metric_value(metrics, 'myvnc_http_requests_total')
+        try:
+            with open(self.state_file, 'w') as f:
+                json.dump(state, f)
+        except OSError as e:
+            self.log(f"Could not save monitor state to {self.state_file}: {e}", "WARNING")
+    
     def find_server_process(self):
         """
         Find the MyVNC server process (excluding the monitor itself)
@@ -599,13 +731,37 @@ class ServerMonitor:
                 
                 # Check if server is healthy
                 is_healthy, message, diagnostics_collected = self.check_server_health()
+                state = self.load_state()
+                metrics = self.fetch_metrics() if self.use_metrics and not diagnostics_collected else None
+                if metrics:
+                    self.log(f"Server metrics: {self.summarize_metrics(metrics)}", "DEBUG" if is_healthy else "INFO")
                 
                 if is_healthy:
                     self.log(f"✓ {message}", "INFO")
+                    self.save_state(0, metrics)
                     return 0
                 else:
                     self.log(f"✗ Server is unresponsive: {message}", "ERROR")
                     
+                    # A refused connection means nothing is listening, so there is nothing to wait for
+                    if self.use_metrics and not diagnostics_collected:
+                        if metrics is None:
+                            is_hung, reason = True, "/metrics did not answer either"
+                        else:
+                            is_hung, reason = self.assess_metrics(metrics, state)
+                        failures = state.get('failures', 0)
+                        if not is_hung:
+                            self.log(f"Not restarting: server is slow, not hung: {reason}", "WARNING")
+                            self.save_state(failures, metrics)
+                            return 0
+                        failures += 1
+                        if failures < self.failures_before_restart:
+                            self.log(f"Server looks hung ({reason}); check {failures} of "
+                                     f"{self.failures_before_restart} before a restart", "WARNING")
+                            self.save_state(failures, metrics)
+                            return 0
+                        self.log(f"Server looks hung ({reason}) for {failures} consecutive checks", "ERROR")
+                    
                     # Collect diagnostics before attempting restart (if not already collected)
                     if not diagnostics_collected:
                         self.log("Collecting diagnostics before restart...", "INFO")
@@ -614,7 +770,9 @@ class ServerMonitor:
                         self.log("Diagnostics already collected during health check", "DEBUG")
                     
                     # Attempt restart
-                    if self.restart_server():
+                    restarted = self.restart_server()
+                    self.save_state(0)
+                    if restarted:
                         self.log("Server restart successful", "INFO")
                         return 0
                     else:
@@ -709,6 +867,26 @@ Cron example (check every minute):
         help='Collect detailed diagnostics without restarting the server'
     )
     
+    parser.add_argument(
+        '--failures-before-restart',
+        type=int,
+        default=3,
+        help='Consecutive checks the server must look hung before it is restarted (default: 3)'
+    )
+    
+    parser.add_argument(
+        '--hung-command-seconds',
+        type=int,
+        default=600,
+        help='A scheduler command running longer than this means the server is hung (default: 600)'
+    )
+    
+    parser.add_argument(
+        '--no-metrics',
+        action='store_true',
+        help='Do not scrape /metrics; restart on the first failed check'
+    )
+    
     parser.add_argument(
         '--log-history-minutes',
         type=int,
@@ -727,7 +905,10 @@ Cron example (check every minute):
         timeout=args.timeout,
         restart_cmd=args.restart_cmd,
         verify_ssl=not args.no_verify_ssl,  # Invert the flag
-        log_history_minutes=args.log_history_minutes
+        log_history_minutes=args.log_history_minutes,
+        failures_before_restart=args.failures_before_restart,
+        hung_command_seconds=args.hung_command_seconds,
+        use_metrics=not args.no_metrics
     )
     
     # Run monitoring check